@@ -0,0 +1,415 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// async.c -- background file loading
+
+#include "quakedef.h"
+
+#define ASYNC_THREADS	2	// reads are mostly waiting on the disk
+
+typedef enum
+{
+	ASYNC_QUEUED,
+	ASYNC_READING,
+	ASYNC_DONE
+} asyncstate_t;
+
+struct asyncfile_s
+{
+	filelocation_t	loc;
+	asyncstate_t	state;
+	qboolean		cancelled;	// freed by the loader thread once read
+	asyncworkfunc_t	work;
+	asyncfunc_t		func;
+	void			*userdata;
+	byte			*data;
+	int				len;
+	struct asyncfile_s	*next;
+};
+
+typedef struct
+{
+	asyncfile_t	*head, *tail;
+} asynclist_t;
+
+static struct
+{
+	SDL_Thread	*threads[ASYNC_THREADS];
+	int			numthreads;
+	SDL_mutex	*lock;		// guards everything below and the state of all files
+	SDL_cond	*queued;	// signalled for every queued file
+	SDL_cond	*done;		// broadcast whenever a file has been read
+	qboolean	quit;
+
+	asynclist_t	queue;
+	asynclist_t	finished;	// in the order they were read
+} async;
+
+static void Async_Push (asynclist_t *list, asyncfile_t *file)
+{
+	file->next = NULL;
+	if (list->tail)
+		list->tail->next = file;
+	else
+		list->head = file;
+	list->tail = file;
+}
+
+static asyncfile_t *Async_Pop (asynclist_t *list)
+{
+	asyncfile_t	*file = list->head;
+
+	if (file)
+	{
+		list->head = file->next;
+		if (!list->head)
+			list->tail = NULL;
+	}
+
+	return file;
+}
+
+static void Async_Remove (asynclist_t *list, asyncfile_t *file)
+{
+	asyncfile_t	**link, *prev = NULL;
+
+	for (link = &list->head; *link; prev = *link, link = &(*link)->next)
+	{
+		if (*link == file)
+		{
+			*link = file->next;
+			if (list->tail == file)
+				list->tail = prev;
+			return;
+		}
+	}
+}
+
+// runs on any thread, touches nothing but loc
+static byte *Async_Read (const filelocation_t *loc, int *len)
+{
+	FILE	*f;
+	byte	*in, *data;
+	int		length, size;
+
+	f = fopen (loc->path, "rb");
+	if (!f)
+		return NULL;
+
+	length = loc->length;
+	if (length < 0)
+	{
+		fseek (f, 0, SEEK_END);
+		length = ftell (f);
+		if (length < 0)
+		{
+			fclose (f);
+			return NULL;
+		}
+	}
+	size = loc->ziplength ? loc->ziplength : length;
+
+	in = (byte *) malloc (size + 1);
+	if (in && (fseek (f, loc->offset, SEEK_SET) || (int) fread (in, 1, size, f) != size))
+	{
+		free (in);
+		in = NULL;
+	}
+	fclose (f);
+
+	if (!in || !loc->ziplength)
+		data = in;
+	else
+	{
+		data = (byte *) malloc (length + 1);
+		if (data && !COM_Inflate (in, size, data, length))
+		{
+			free (data);
+			data = NULL;
+		}
+		free (in);
+	}
+
+	if (data)
+	{
+		data[length] = 0;
+		*len = length;
+	}
+
+	return data;
+}
+
+// reads the file and does its work, on any thread without the lock
+static void Async_Process (asyncfile_t *file)
+{
+	file->data = Async_Read (&file->loc, &file->len);
+	if (file->data && file->work)
+		file->work (file->data, file->len, file->userdata);
+}
+
+// called with the lock held
+static void Async_Complete (asyncfile_t *file)
+{
+	if (file->cancelled)
+	{
+		free (file->data);
+		free (file);
+		return;
+	}
+
+	file->state = ASYNC_DONE;
+	Async_Push (&async.finished, file);
+	SDL_CondBroadcast (async.done);
+}
+
+static int SDLCALL Async_Thread (void *unused)
+{
+	asyncfile_t	*file;
+
+	SDL_LockMutex (async.lock);
+
+	for (;;)
+	{
+		while (!async.queue.head && !async.quit)
+			SDL_CondWait (async.queued, async.lock);
+
+		if (async.quit)
+			break;
+
+		file = Async_Pop (&async.queue);
+		file->state = ASYNC_READING;
+		SDL_UnlockMutex (async.lock);
+
+		Async_Process (file);
+
+		SDL_LockMutex (async.lock);
+		Async_Complete (file);
+	}
+
+	SDL_UnlockMutex (async.lock);
+	return 0;
+}
+
+// passes the data on to the callback, the handle is gone afterwards
+static void Async_Call (asyncfile_t *file)
+{
+	file->func (file->data, file->len, file->userdata);
+	free (file);
+}
+
+/*
+=============
+Async_ProcessFile
+=============
+*/
+asyncfile_t *Async_ProcessFile (const char *path, unsigned int *path_id, asyncworkfunc_t work,
+								asyncfunc_t func, void *userdata)
+{
+	asyncfile_t	*file;
+	filelocation_t	loc;
+
+	if (!COM_LocateFile (path, &loc, path_id))
+		return NULL;
+
+	file = (asyncfile_t *) calloc (1, sizeof(asyncfile_t));
+	if (!file)
+		Sys_Error ("Async_ProcessFile: out of memory");
+
+	file->loc = loc;
+	file->work = work;
+	file->func = func;
+	file->userdata = userdata;
+
+	SDL_LockMutex (async.lock);
+
+	if (async.numthreads)
+	{
+		file->state = ASYNC_QUEUED;
+		Async_Push (&async.queue, file);
+		SDL_CondSignal (async.queued);
+	}
+	else
+	{
+		Async_Process (file);
+		Async_Complete (file);
+	}
+
+	SDL_UnlockMutex (async.lock);
+
+	return file;
+}
+
+/*
+=============
+Async_LoadFile
+=============
+*/
+asyncfile_t *Async_LoadFile (const char *path, asyncfunc_t func, void *userdata)
+{
+	return Async_ProcessFile (path, NULL, NULL, func, userdata);
+}
+
+/*
+=============
+Async_Finish
+=============
+*/
+void Async_Finish (asyncfile_t *file)
+{
+	SDL_LockMutex (async.lock);
+
+	if (file->state == ASYNC_QUEUED)
+	{
+		// don't wait behind the rest of the queue
+		Async_Remove (&async.queue, file);
+		file->state = ASYNC_READING;
+		SDL_UnlockMutex (async.lock);
+
+		Async_Process (file);
+
+		SDL_LockMutex (async.lock);
+		file->state = ASYNC_DONE;
+	}
+	else
+	{
+		while (file->state == ASYNC_READING)
+			SDL_CondWait (async.done, async.lock);
+
+		Async_Remove (&async.finished, file);
+	}
+
+	SDL_UnlockMutex (async.lock);
+
+	Async_Call (file);
+}
+
+/*
+=============
+Async_Cancel
+=============
+*/
+void Async_Cancel (asyncfile_t *file)
+{
+	SDL_LockMutex (async.lock);
+
+	switch (file->state)
+	{
+	case ASYNC_QUEUED:
+		Async_Remove (&async.queue, file);
+		free (file);
+		break;
+	case ASYNC_READING:
+		if (!file->work)
+		{
+			file->cancelled = true;
+			break;
+		}
+		// userdata may go away right after this
+		while (file->state == ASYNC_READING)
+			SDL_CondWait (async.done, async.lock);
+		// fall through
+	case ASYNC_DONE:
+		Async_Remove (&async.finished, file);
+		free (file->data);
+		free (file);
+		break;
+	}
+
+	SDL_UnlockMutex (async.lock);
+}
+
+/*
+=============
+Async_Frame
+=============
+*/
+void Async_Frame (void)
+{
+	asyncfile_t	*file;
+
+	// one at a time, a callback may finish or cancel other files
+	for (;;)
+	{
+		SDL_LockMutex (async.lock);
+		file = Async_Pop (&async.finished);
+		SDL_UnlockMutex (async.lock);
+
+		if (!file)
+			break;
+
+		Async_Call (file);
+	}
+}
+
+/*
+=============
+Async_Init
+=============
+*/
+void Async_Init (void)
+{
+	int	i;
+
+	async.lock = SDL_CreateMutex ();
+	async.queued = SDL_CreateCond ();
+	async.done = SDL_CreateCond ();
+	if (!async.lock || !async.queued || !async.done)
+		Sys_Error ("Async_Init: %s", SDL_GetError ());
+
+	if (COM_CheckParm ("-noasync"))
+		return;
+
+	for (i = 0; i < ASYNC_THREADS; i++)
+	{
+		async.threads[i] = SDL_CreateThread (Async_Thread, "Loader", NULL);
+		if (!async.threads[i])
+		{
+			Con_Printf ("Couldn't create loader thread: %s\n", SDL_GetError ());
+			break;
+		}
+		async.numthreads++;
+	}
+}
+
+/*
+=============
+Async_Shutdown
+
+Whatever is still queued is dropped
+=============
+*/
+void Async_Shutdown (void)
+{
+	int	i;
+
+	if (!async.lock)
+		return;
+
+	SDL_LockMutex (async.lock);
+	async.quit = true;
+	SDL_CondBroadcast (async.queued);
+	SDL_UnlockMutex (async.lock);
+
+	for (i = 0; i < async.numthreads; i++)
+		SDL_WaitThread (async.threads[i], NULL);
+
+	async.numthreads = 0;
+}
@@ -0,0 +1,61 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#ifndef __ASYNC_H
+#define __ASYNC_H
+
+// async.h -- background file loading
+// Files are looked up on the main thread when they are requested, and read
+// on loader threads. Completion callbacks always run on the main thread,
+// either from Async_Frame or from Async_Finish.
+
+typedef struct asyncfile_s asyncfile_t;
+
+typedef void (*asyncfunc_t) (byte *data, int len, void *userdata);
+// data is malloc'd with a 0 byte appended and belongs to the callback,
+// it is NULL if the file couldn't be read
+
+typedef void (*asyncworkfunc_t) (const byte *data, int len, void *userdata);
+// runs on the loader thread once the file has been read, to do work that
+// doesn't touch anything the main thread uses. Its results are passed on
+// through userdata.
+
+void	Async_Init (void);
+void	Async_Shutdown (void);
+
+asyncfile_t	*Async_LoadFile (const char *path, asyncfunc_t func, void *userdata);
+// returns NULL without calling func if path doesn't exist. The handle is
+// valid until func has been called.
+
+asyncfile_t	*Async_ProcessFile (const char *path, unsigned int *path_id, asyncworkfunc_t work,
+								asyncfunc_t func, void *userdata);
+// Async_LoadFile with a work func, path_id is set right away
+
+void	Async_Finish (asyncfile_t *file);
+// waits for the file and calls its func right away
+
+void	Async_Cancel (asyncfile_t *file);
+// func is never called, waits for work to finish if it is running
+
+void	Async_Frame (void);
+// calls func for every file that has been read, once per host frame
+
+#endif	/* __ASYNC_H */
@@ -20,6 +20,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 
 #include "quakedef.h"
+#include "deflate.h"
+#include "miniz.h"
 
 static void CL_FinishTimeDemo (void);
 
@@ -40,6 +42,397 @@ read from the demo file.
 static byte		*demo_head;
 static int		*demo_head_sizes;
 
+/*
+==============================================================================
+
+DEMO FILE I/O
+
+Recording hands everything to a writer thread through a single producer,
+single consumer ring buffer, so disk access never blocks the main thread.
+With cl_democompress enabled the writer deflates the stream, and the file
+starts with DEMO_COMPRESSED_MAGIC instead of the cd track line. Playback
+detects the magic and inflates transparently.
+==============================================================================
+*/
+
+#define DEMO_COMPRESSED_MAGIC	"QDZ\1"
+#define DEMO_QUEUE_SIZE			(1 << 22)
+#define DEMO_INPUT_SIZE			16384
+
+cvar_t	cl_democompress = {"cl_democompress", "0", CVAR_ARCHIVE};
+
+static struct
+{
+	FILE			*file;
+	qboolean		compress;
+	byte			*queue;		// [DEMO_QUEUE_SIZE]
+	SDL_atomic_t	head;		// advanced by main thread only
+	SDL_atomic_t	tail;		// advanced by writer thread only
+	SDL_atomic_t	finish;
+	SDL_sem			*wakeup;
+	SDL_Thread		*thread;
+	SDL_atomic_t	error;
+	deflatestream_t	*deflate;
+} demo_writer;
+
+struct demoreader_s
+{
+	FILE				*file;
+	qboolean			compressed;
+	long				start;		// file position of compressed data
+	long				position;	// uncompressed bytes consumed so far
+	tinfl_decompressor	inflator;
+	tinfl_status		status;
+	byte				input[DEMO_INPUT_SIZE];
+	size_t				inputpos, inputsize;
+	byte				window[TINFL_LZ_DICT_SIZE];
+	size_t				windowpos;	// where the next output goes
+	size_t				readpos, readsize;	// inflated bytes not consumed yet
+};
+
+static demoreader_t	*demo_reader;
+
+static void CL_DemoWriterOutput (const byte *data, int size, void *userdata)
+{
+	if (fwrite (data, 1, size, demo_writer.file) != (size_t)size)
+		SDL_AtomicSet (&demo_writer.error, 1);
+}
+
+// passes queued bytes to the file, runs on writer thread
+static void CL_DemoWriterDrain (void)
+{
+	unsigned int	head, tail;
+	int		offset, count;
+
+	head = SDL_AtomicGet (&demo_writer.head);
+	SDL_MemoryBarrierAcquire ();
+	tail = SDL_AtomicGet (&demo_writer.tail);
+
+	if (head == tail)
+		return;
+
+	while (tail != head)
+	{
+		offset = tail & (DEMO_QUEUE_SIZE - 1);
+		count = q_min (head - tail, (unsigned int)(DEMO_QUEUE_SIZE - offset));
+
+		if (demo_writer.compress)
+			Deflate_Write (demo_writer.deflate, demo_writer.queue + offset, count);
+		else
+			CL_DemoWriterOutput (demo_writer.queue + offset, count, NULL);
+
+		tail += count;
+	}
+
+	SDL_MemoryBarrierRelease ();
+	SDL_AtomicSet (&demo_writer.tail, tail);
+
+	if (!demo_writer.compress)
+		fflush (demo_writer.file);
+}
+
+static int SDLCALL CL_DemoWriterThread (void *unused)
+{
+	for (;;)
+	{
+		SDL_SemWait (demo_writer.wakeup);
+
+		if (SDL_AtomicGet (&demo_writer.finish))
+			break;
+
+		CL_DemoWriterDrain ();
+	}
+
+	CL_DemoWriterDrain ();
+	return 0;
+}
+
+/*
+====================
+CL_DemoWrite
+
+Queues data for the writer thread, only waits when the queue is full
+====================
+*/
+static void CL_DemoWrite (const void *data, int size)
+{
+	const byte	*bytes = (const byte *) data;
+	unsigned int	head, tail;
+	int		offset, count;
+
+	head = SDL_AtomicGet (&demo_writer.head);
+
+	while (size > 0)
+	{
+		tail = SDL_AtomicGet (&demo_writer.tail);
+		SDL_MemoryBarrierAcquire ();
+
+		count = q_min ((unsigned int)size, DEMO_QUEUE_SIZE - (head - tail));
+		if (count == 0)
+		{
+			if (demo_writer.thread)
+			{
+				SDL_SemPost (demo_writer.wakeup);
+				SDL_Delay (1);
+			}
+			else
+				CL_DemoWriterDrain ();
+			continue;
+		}
+
+		offset = head & (DEMO_QUEUE_SIZE - 1);
+		count = q_min (count, DEMO_QUEUE_SIZE - offset);
+		memcpy (demo_writer.queue + offset, bytes, count);
+
+		head += count;
+		bytes += count;
+		size -= count;
+
+		SDL_MemoryBarrierRelease ();
+		SDL_AtomicSet (&demo_writer.head, head);
+	}
+}
+
+// wakes up writer thread once a complete message is queued
+static void CL_DemoWriteFlush (void)
+{
+	if (demo_writer.thread)
+		SDL_SemPost (demo_writer.wakeup);
+	else
+		CL_DemoWriterDrain ();
+}
+
+static void CL_DemoWriterStart (FILE *file, qboolean compress)
+{
+	memset (&demo_writer, 0, sizeof(demo_writer));
+	demo_writer.file = file;
+	demo_writer.compress = compress;
+	demo_writer.queue = (byte *) malloc (DEMO_QUEUE_SIZE);
+
+	if (compress)
+	{
+		fwrite (DEMO_COMPRESSED_MAGIC, 4, 1, file);
+		demo_writer.deflate = (deflatestream_t *) malloc (sizeof(deflatestream_t));
+		Deflate_Init (demo_writer.deflate, CL_DemoWriterOutput, NULL);
+	}
+
+	demo_writer.wakeup = SDL_CreateSemaphore (0);
+	if (demo_writer.wakeup)
+		demo_writer.thread = SDL_CreateThread (CL_DemoWriterThread, "DemoWriter", NULL);
+	if (!demo_writer.thread)
+		Con_DPrintf ("Couldn't create demo writer thread: %s\n", SDL_GetError());
+}
+
+static void CL_DemoWriterStop (void)
+{
+	if (demo_writer.thread)
+	{
+		SDL_AtomicSet (&demo_writer.finish, 1);
+		SDL_SemPost (demo_writer.wakeup);
+		SDL_WaitThread (demo_writer.thread, NULL);
+	}
+	else
+		CL_DemoWriterDrain ();
+
+	if (demo_writer.compress)
+	{
+		Deflate_Finish (demo_writer.deflate);
+		free (demo_writer.deflate);
+	}
+
+	if (demo_writer.wakeup)
+		SDL_DestroySemaphore (demo_writer.wakeup);
+
+	if (SDL_AtomicGet (&demo_writer.error))
+		Con_Printf ("ERROR: couldn't write demo file\n");
+
+	fclose (demo_writer.file);
+	free (demo_writer.queue);
+	memset (&demo_writer, 0, sizeof(demo_writer));
+}
+
+/*
+====================
+CL_DemoReaderOpen
+
+Checks for compressed demo and prepares the reader, file stays owned by the caller
+====================
+*/
+demoreader_t *CL_DemoReaderOpen (FILE *file)
+{
+	demoreader_t	*reader;
+	char	magic[4];
+
+	reader = (demoreader_t *) calloc (1, sizeof(demoreader_t));
+	reader->file = file;
+
+	if (fread (magic, 4, 1, file) == 1 && !memcmp (magic, DEMO_COMPRESSED_MAGIC, 4))
+	{
+		reader->compressed = true;
+		reader->start = ftell (file);
+		reader->status = TINFL_STATUS_NEEDS_MORE_INPUT;
+		tinfl_init (&reader->inflator);
+	}
+	else
+		fseek (file, -4, SEEK_CUR);
+
+	return reader;
+}
+
+void CL_DemoReaderClose (demoreader_t *reader)
+{
+	free (reader);
+}
+
+/*
+====================
+CL_DemoRead
+
+Returns number of bytes read from the demo, inflating it when needed
+====================
+*/
+size_t CL_DemoRead (demoreader_t *reader, void *data, size_t size)
+{
+	byte	*bytes = (byte *) data;
+	size_t	count, insize, outsize, total;
+
+	if (!reader->compressed)
+		return fread (data, 1, size, reader->file);
+
+	total = 0;
+
+	while (size > 0)
+	{
+		if (reader->readsize > 0)
+		{
+			count = q_min (size, reader->readsize);
+			memcpy (bytes, reader->window + reader->readpos, count);
+			reader->readpos += count;
+			reader->readsize -= count;
+			bytes += count;
+			size -= count;
+			total += count;
+			continue;
+		}
+
+		if (reader->status <= TINFL_STATUS_DONE)
+			break;	// end of stream or corrupted data
+
+		if (reader->inputpos == reader->inputsize)
+		{
+			reader->inputpos = 0;
+			reader->inputsize = fread (reader->input, 1, DEMO_INPUT_SIZE, reader->file);
+
+			if (reader->inputsize == 0)
+				break;	// truncated file
+		}
+
+		// the stream marks its own end, so more input is always assumed
+		insize = reader->inputsize - reader->inputpos;
+		outsize = TINFL_LZ_DICT_SIZE - reader->windowpos;
+		reader->status = tinfl_decompress (&reader->inflator,
+			reader->input + reader->inputpos, &insize,
+			reader->window, reader->window + reader->windowpos, &outsize,
+			TINFL_FLAG_HAS_MORE_INPUT);
+
+		reader->inputpos += insize;
+		reader->readpos = reader->windowpos;
+		reader->readsize = outsize;
+		reader->windowpos = (reader->windowpos + outsize) & (TINFL_LZ_DICT_SIZE - 1);
+	}
+
+	reader->position += total;
+	return total;
+}
+
+static long CL_DemoTell (demoreader_t *reader)
+{
+	return reader->compressed ? reader->position : ftell (reader->file);
+}
+
+// compressed demos can only go forward, so rewinding restarts the stream
+static void CL_DemoSeek (demoreader_t *reader, long position)
+{
+	byte	skip[4096];
+
+	if (!reader->compressed)
+	{
+		fseek (reader->file, position, SEEK_SET);
+		return;
+	}
+
+	if (position < reader->position)
+	{
+		fseek (reader->file, reader->start, SEEK_SET);
+		reader->position = 0;
+		reader->status = TINFL_STATUS_NEEDS_MORE_INPUT;
+		reader->inputpos = reader->inputsize = 0;
+		reader->windowpos = reader->readpos = reader->readsize = 0;
+		tinfl_init (&reader->inflator);
+	}
+
+	while (reader->position < position)
+	{
+		if (!CL_DemoRead (reader, skip, q_min (sizeof(skip), (size_t)(position - reader->position))))
+			break;
+	}
+}
+
+/*
+====================
+CL_DemoReadTrack
+
+Reads cd track line that starts every demo
+====================
+*/
+qboolean CL_DemoReadTrack (demoreader_t *reader, int *track)
+{
+	char	line[16];
+	int		i;
+
+	for (i = 0; i < (int)sizeof(line) - 1; i++)
+	{
+		if (CL_DemoRead (reader, &line[i], 1) != 1)
+			return false;
+		if (line[i] == '\n')
+			break;
+	}
+
+	if (i == 0 || line[i] != '\n')
+		return false;
+
+	line[i] = '\0';
+	return sscanf (line, "%i", track) == 1;
+}
+
+/*
+==============================================================================
+
+DEMO KEYFRAMES
+
+While a demo plays, a snapshot of the client state is taken every
+cl_demokeyframes seconds of server time. Seeking restores the nearest
+snapshot before the requested time and parses the remaining messages
+without rendering. Snapshots are only valid for the map they were taken on,
+so the index is wiped together with the client state.
+==============================================================================
+*/
+
+typedef struct
+{
+	long			filepos;	// demo file position after the last parsed message
+	client_state_t	state;
+	entity_t		*entities;	// [state.num_entities]
+	scoreboard_t	*scores;	// [state.maxclients]
+	lightstyle_t	lightstyles[MAX_LIGHTSTYLES];
+	dlight_t		dlights[MAX_DLIGHTS];
+	beam_t			beams[MAX_BEAMS];
+} demokeyframe_t;
+
+static demokeyframe_t	**demo_keyframes;
+
+cvar_t	cl_demokeyframes = {"cl_demokeyframes", "10", CVAR_ARCHIVE};	// seconds between keyframes, 0 disables them
+
 /*
 ==============
 CL_ClearSignons
@@ -64,6 +457,10 @@ void CL_StopPlayback (void)
 	if (!cls.demoplayback)
 		return;
 
+	CL_ClearDemoKeyframes ();
+
+	CL_DemoReaderClose (demo_reader);
+	demo_reader = NULL;
 	fclose (cls.demofile);
 	cls.demoplayback = false;
 	cls.demopaused = false;
@@ -88,21 +485,20 @@ static void CL_WriteDemoMessage (void)
 	float	f;
 
 	len = LittleLong (net_message.cursize);
-	fwrite (&len, 4, 1, cls.demofile);
+	CL_DemoWrite (&len, 4);
 	for (i = 0; i < 3; i++)
 	{
 		f = LittleFloat (cl.viewangles[i]);
-		fwrite (&f, 4, 1, cls.demofile);
+		CL_DemoWrite (&f, 4);
 	}
-	fwrite (net_message.data, net_message.cursize, 1, cls.demofile);
-	fflush (cls.demofile);
+	CL_DemoWrite (net_message.data, net_message.cursize);
+	CL_DemoWriteFlush ();
 }
 
+static int CL_ReadDemoMessage (qboolean seeking);
+
 static int CL_GetDemoMessage (void)
 {
-	int	r, i;
-	float	f;
-
 	if (cls.demopaused)
 		return 0;
 
@@ -125,27 +521,248 @@ static int CL_GetDemoMessage (void)
 		}
 	}
 
+	return CL_ReadDemoMessage (false);
+}
+
+/*
+====================
+CL_ReadDemoMessage
+
+Reads the next message from the demo file regardless of timing.
+When seeking, a message cut short by the end of the file puts the demo
+back at its start and returns -1 instead of ending playback.
+====================
+*/
+static int CL_ReadDemoMessage (qboolean seeking)
+{
+	int	i;
+	long	start;
+	float	f[3];
+
+	start = seeking ? CL_DemoTell (demo_reader) : 0;
+
 // get the next message
-	if (! fread(&net_message.cursize, 4, 1, cls.demofile))
-		Sys_Error ("Demo read error");
-	VectorCopy (cl.mviewangles[0], cl.mviewangles[1]);
-	for (i = 0 ; i < 3 ; i++)
+	if (CL_DemoRead (demo_reader, &net_message.cursize, 4) != 4)
 	{
-		r = fread (&f, 4, 1, cls.demofile);
-		cl.mviewangles[0][i] = LittleFloat (f);
+		if (seeking)
+			goto truncated;
+		Sys_Error ("Demo read error");
 	}
+	if (CL_DemoRead (demo_reader, f, sizeof(f)) != sizeof(f) && seeking)
+		goto truncated;
 
 	net_message.cursize = LittleLong (net_message.cursize);
-	if (net_message.cursize > MAX_MSGLEN)
+	if (net_message.cursize < 0 || net_message.cursize > MAX_MSGLEN)
+	{
+		if (seeking)
+			goto truncated;
 		Sys_Error ("Demo message > MAX_MSGLEN");
-	r = fread (net_message.data, net_message.cursize, 1, cls.demofile);
-	if (r != 1)
+	}
+	if (CL_DemoRead (demo_reader, net_message.data, net_message.cursize) != (size_t)net_message.cursize)
 	{
+		if (seeking)
+			goto truncated;
 		CL_StopPlayback ();
 		return 0;
 	}
 
+	VectorCopy (cl.mviewangles[0], cl.mviewangles[1]);
+	for (i = 0 ; i < 3 ; i++)
+		cl.mviewangles[0][i] = LittleFloat (f[i]);
+
 	return 1;
+
+truncated:
+	CL_DemoSeek (demo_reader, start);
+	SZ_Clear (&net_message);
+	return -1;
+}
+
+/*
+====================
+CL_ClearDemoKeyframes
+====================
+*/
+void CL_ClearDemoKeyframes (void)
+{
+	int	i, count;
+
+	for (i = 0, count = VEC_SIZE (demo_keyframes); i < count; i++)
+	{
+		free (demo_keyframes[i]->entities);
+		free (demo_keyframes[i]->scores);
+		free (demo_keyframes[i]);
+	}
+
+	VEC_CLEAR (demo_keyframes);
+}
+
+/*
+====================
+CL_UpdateDemoKeyframes
+
+Called after server messages were parsed during demo playback
+====================
+*/
+void CL_UpdateDemoKeyframes (void)
+{
+	demokeyframe_t	*keyframe;
+	int		count;
+
+	if (!cls.demoplayback || cls.signon != SIGNONS || cl_demokeyframes.value <= 0)
+		return;
+
+	count = VEC_SIZE (demo_keyframes);
+	if (count > 0 && cl.mtime[0] < demo_keyframes[count - 1]->state.mtime[0] + cl_demokeyframes.value)
+		return;
+
+	keyframe = (demokeyframe_t *) malloc (sizeof (demokeyframe_t));
+	keyframe->filepos = CL_DemoTell (demo_reader);
+	keyframe->state = cl;
+
+	keyframe->entities = (entity_t *) malloc (cl.num_entities * sizeof (entity_t));
+	memcpy (keyframe->entities, cl_entities, cl.num_entities * sizeof (entity_t));
+	keyframe->scores = (scoreboard_t *) malloc (cl.maxclients * sizeof (scoreboard_t));
+	memcpy (keyframe->scores, cl.scores, cl.maxclients * sizeof (scoreboard_t));
+
+	memcpy (keyframe->lightstyles, cl_lightstyle, sizeof (cl_lightstyle));
+	memcpy (keyframe->dlights, cl_dlights, sizeof (cl_dlights));
+	memcpy (keyframe->beams, cl_beams, sizeof (cl_beams));
+
+	VEC_PUSH (demo_keyframes, keyframe);
+}
+
+/*
+====================
+CL_RestoreDemoKeyframe
+====================
+*/
+static void CL_RestoreDemoKeyframe (const demokeyframe_t *keyframe)
+{
+	// precaches, scores and static entities belong to the same map and stay as is
+	cl = keyframe->state;
+
+	memcpy (cl_entities, keyframe->entities, cl.num_entities * sizeof (entity_t));
+	memcpy (cl.scores, keyframe->scores, cl.maxclients * sizeof (scoreboard_t));
+
+	memcpy (cl_lightstyle, keyframe->lightstyles, sizeof (cl_lightstyle));
+	memcpy (cl_dlights, keyframe->dlights, sizeof (cl_dlights));
+	memcpy (cl_beams, keyframe->beams, sizeof (cl_beams));
+
+	CL_DemoSeek (demo_reader, keyframe->filepos);
+}
+
+/*
+====================
+CL_SeekDemo
+
+Moves demo playback to the given server time of the current map. When the
+demo is cut short before that time, playback stays at its last complete
+message. Returns false and sets error when the seek didn't reach its target.
+====================
+*/
+qboolean CL_SeekDemo (double time, const char **error)
+{
+	demokeyframe_t	*keyframe = NULL;
+	int		i, count, result;
+
+	*error = NULL;
+
+	if (!cls.demoplayback || cls.signon != SIGNONS)
+	{
+		*error = "not playing a demo";
+		return false;
+	}
+
+	// the latest keyframe that doesn't pass the target time
+	for (i = 0, count = VEC_SIZE (demo_keyframes); i < count; i++)
+	{
+		if (demo_keyframes[i]->state.mtime[0] > time)
+			break;
+		keyframe = demo_keyframes[i];
+	}
+
+	if (time < cl.mtime[0] && count == 0)
+	{
+		*error = "no keyframe to rewind to";
+		return false;
+	}
+
+	if (keyframe && (time < cl.mtime[0] || keyframe->state.mtime[0] > cl.mtime[0]))
+		CL_RestoreDemoKeyframe (keyframe);
+	else if (time < cl.mtime[0] && count > 0)
+		CL_RestoreDemoKeyframe (demo_keyframes[0]);	// clamp to the map start
+
+	// replay the remaining messages without rendering
+	while (cl.mtime[0] < time)
+	{
+		if ((result = CL_ReadDemoMessage (true)) <= 0)
+		{
+			if (result < 0)
+				*error = "demo is truncated";
+			break;
+		}
+
+		CL_ParseServerMessage ();
+		SZ_Clear (&cls.message);
+
+		// demo ended, disconnected or moved to the next map
+		if (!cls.demoplayback || cls.state != ca_connected || cls.signon != SIGNONS)
+			break;
+
+		CL_UpdateDemoKeyframes ();
+	}
+
+	if (!cls.demoplayback)
+	{
+		*error = "demo ended";
+		return false;
+	}
+
+	cl.time = cl.oldtime = cl.mtime[1] = cl.mtime[0];
+	VectorCopy (cl.mviewangles[0], cl.mviewangles[1]);
+
+	// don't lerp between positions before and after the jump
+	for (i = 0; i < cl.num_entities; i++)
+		cl_entities[i].lerpflags |= LERP_RESETANIM | LERP_RESETMOVE;
+
+	S_StopAllSounds (true);
+	R_ClearParticles ();
+
+	if (cls.timedemo)
+		cls.td_lastframe = -1;
+
+	return *error == NULL;
+}
+
+/*
+====================
+CL_DemoSeek_f
+
+demoseek <seconds>
+====================
+*/
+void CL_DemoSeek_f (void)
+{
+	const char	*error;
+
+	if (cmd_source != src_command)
+		return;
+
+	if (Cmd_Argc() != 2)
+	{
+		Con_Printf ("demoseek <seconds> : moves demo playback to the given time\n");
+		return;
+	}
+
+	if (!cls.demoplayback)
+	{
+		Con_Printf ("Not playing a demo.\n");
+		return;
+	}
+
+	if (!CL_SeekDemo (Q_atof (Cmd_Argv (1)), &error))
+		Con_Printf ("Can't seek demo: %s\n", error);
 }
 
 /*
@@ -215,7 +832,7 @@ void CL_Stop_f (void)
 	CL_WriteDemoMessage ();
 
 // finish up
-	fclose (cls.demofile);
+	CL_DemoWriterStop ();
 	cls.demofile = NULL;
 	cls.demorecording = false;
 	Con_Printf ("Completed demo\n");
@@ -235,6 +852,7 @@ void CL_Record_f (void)
 {
 	int		c;
 	char	name[MAX_OSPATH];
+	char	trackline[16];
 	int		track;
 
 	if (cmd_source != src_command)
@@ -306,9 +924,12 @@ void CL_Record_f (void)
 		Con_Printf ("ERROR: couldn't create %s\n", name);
 		return;
 	}
+	COM_InvalidateLooseFiles ();
 
 	cls.forcetrack = track;
-	fprintf (cls.demofile, "%i\n", cls.forcetrack);
+	CL_DemoWriterStart (cls.demofile, cl_democompress.value != 0);
+	q_snprintf (trackline, sizeof(trackline), "%i\n", cls.forcetrack);
+	CL_DemoWrite (trackline, strlen(trackline));
 
 	cls.demorecording = true;
 
@@ -397,24 +1018,15 @@ CL_PlayDemo_f
 play [demoname]
 ====================
 */
-void CL_PlayDemo_f (void)
+static void CL_PlayDemo (const char *demoname)
 {
 	char	name[MAX_OSPATH];
 
-	if (cmd_source != src_command)
-		return;
-
-	if (Cmd_Argc() != 2)
-	{
-		Con_Printf ("playdemo <demoname> : plays a demo\n");
-		return;
-	}
-
 // disconnect from server
 	CL_Disconnect ();
 
 // open the demo file
-	q_strlcpy (name, Cmd_Argv(1), sizeof(name));
+	q_strlcpy (name, demoname, sizeof(name));
 	COM_AddExtension (name, ".dem", sizeof(name));
 
 	Con_Printf ("Playing demo from %s.\n", name);
@@ -427,12 +1039,16 @@ void CL_PlayDemo_f (void)
 		return;
 	}
 
+	demo_reader = CL_DemoReaderOpen (cls.demofile);
+
 // ZOID, fscanf is evil
 // O.S.: if a space character e.g. 0x20 (' ') follows '\n',
 // fscanf skips that byte too and screws up further reads.
 //	fscanf (cls.demofile, "%i\n", &cls.forcetrack);
-	if (fscanf (cls.demofile, "%i", &cls.forcetrack) != 1 || fgetc (cls.demofile) != '\n')
+	if (!CL_DemoReadTrack (demo_reader, &cls.forcetrack))
 	{
+		CL_DemoReaderClose (demo_reader);
+		demo_reader = NULL;
 		fclose (cls.demofile);
 		cls.demofile = NULL;
 		cls.demonum = -1;	// stop demo loop
@@ -448,6 +1064,20 @@ void CL_PlayDemo_f (void)
 	key_dest = key_game;
 }
 
+void CL_PlayDemo_f (void)
+{
+	if (cmd_source != src_command)
+		return;
+
+	if (Cmd_Argc() != 2)
+	{
+		Con_Printf ("playdemo <demoname> : plays a demo\n");
+		return;
+	}
+
+	CL_PlayDemo (Cmd_Argv(1));
+}
+
 /*
 ====================
 CL_FinishTimeDemo
@@ -467,27 +1097,60 @@ static void CL_FinishTimeDemo (void)
 	if (!time)
 		time = 1;
 	Con_Printf ("%i frames %5.1f seconds %5.1f fps\n", frames, time, frames/time);
+
+	if (frames > 0)
+	{
+		Con_Printf ("per frame: parse %.3f ms, relink %.3f ms, tents %.3f ms, particles %.3f ms\n",
+			cls.td_parsetime * 1000.0 / frames, cls.td_relinktime * 1000.0 / frames,
+			cls.td_tenttime * 1000.0 / frames, cls.td_particletime * 1000.0 / frames);
+	}
+
+	cls.td_norender = false;
+}
+
+/*
+====================
+CL_TimeDemoStage
+
+Adds time spent in a client stage since the given start time, returns current time
+====================
+*/
+double CL_TimeDemoStage (double *total, double start)
+{
+	double	now;
+
+	now = Sys_DoubleTime ();
+
+	// same frames that count towards the final fps
+	if (cls.timedemo && cls.signon == SIGNONS && host_framecount > cls.td_startframe + 1)
+		*total += now - start;
+
+	return now;
 }
 
 /*
 ====================
 CL_TimeDemo_f
 
-timedemo [demoname]
+timedemo [demoname] [-norender]
 ====================
 */
 void CL_TimeDemo_f (void)
 {
+	qboolean	norender;
+
 	if (cmd_source != src_command)
 		return;
 
-	if (Cmd_Argc() != 2)
+	norender = Cmd_Argc() == 3 && !q_strcasecmp (Cmd_Argv(2), "-norender");
+
+	if (Cmd_Argc() != 2 && !norender)
 	{
-		Con_Printf ("timedemo <demoname> : gets demo speeds\n");
+		Con_Printf ("timedemo <demoname> [-norender] : gets demo speeds\n");
 		return;
 	}
 
-	CL_PlayDemo_f ();
+	CL_PlayDemo (Cmd_Argv(1));
 	if (!cls.demofile)
 		return;
 
@@ -497,5 +1160,11 @@ void CL_TimeDemo_f (void)
 	cls.timedemo = true;
 	cls.td_startframe = host_framecount;
 	cls.td_lastframe = -1;	// get a new message this frame
+
+	cls.td_norender = norender;
+	cls.td_parsetime = 0;
+	cls.td_relinktime = 0;
+	cls.td_tenttime = 0;
+	cls.td_particletime = 0;
 }
 
@@ -0,0 +1,565 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// cl_demoscan.c -- batch demo analysis without a running client
+
+#include "quakedef.h"
+
+/*
+==============================================================================
+
+DEMO SCANNER
+
+Decodes server messages with the CL_Read* functions CL_ParseServerMessage
+uses, but into a private context that only keeps what the statistics need. Apart from
+opening the file nothing global is touched, so every job worker can scan
+its own demo. Works on a dedicated server too:
+
+quakespasm -dedicated +demoscan +quit
+==============================================================================
+*/
+
+typedef struct
+{
+	char		name[MAX_QPATH];
+	char		error[64];	// empty on success
+	int			protocol;
+	char		mapname[MAX_QPATH];	// first map of the demo
+	int			maps;
+	int			messages;
+	double		duration;	// server time summed over all maps
+	qboolean	completed;	// last map reached intermission
+	int			kills, totalkills;
+	int			secrets, totalsecrets;
+} demoscanresult_t;
+
+typedef struct
+{
+	demoscanresult_t	*result;
+
+	sizebuf_t	message;	// data is [MAX_MSGLEN]
+	msgreader_t	msg;
+	svcreader_t	reader;
+
+	int			stats[MAX_CL_STATS];
+	qboolean	inmap;
+	qboolean	intermission;
+	qboolean	disconnected;
+	double		starttime;	// first svc_time of the map, negative if none yet
+	double		endtime;
+} demoscan_t;
+
+static struct
+{
+	demoscanresult_t	*results;
+	int				count;
+	demoscan_t		*scans[MAX_JOB_WORKERS];	// one context per worker
+	SDL_mutex		*fslock;	// search paths and com_filesize aren't thread safe
+} demo_scan;
+
+
+static qboolean CL_ScanError (demoscan_t *scan, const char *format, ...) FUNC_PRINTF(2,3);
+
+static qboolean CL_ScanError (demoscan_t *scan, const char *format, ...)
+{
+	va_list	argptr;
+
+	va_start (argptr, format);
+	q_vsnprintf (scan->result->error, sizeof(scan->result->error), format, argptr);
+	va_end (argptr);
+
+	return false;
+}
+
+/*
+==============================================================================
+
+MESSAGE PARSING
+
+==============================================================================
+*/
+
+// adds statistics of the map that just ended
+static void CL_ScanEndMap (demoscan_t *scan)
+{
+	demoscanresult_t	*result = scan->result;
+
+	if (!scan->inmap)
+		return;
+
+	if (scan->starttime >= 0)
+		result->duration += scan->endtime - scan->starttime;
+
+	result->kills += scan->stats[STAT_MONSTERS];
+	result->totalkills += scan->stats[STAT_TOTALMONSTERS];
+	result->secrets += scan->stats[STAT_SECRETS];
+	result->totalsecrets += scan->stats[STAT_TOTALSECRETS];
+	result->completed = scan->intermission;
+
+	scan->inmap = false;
+}
+
+static qboolean CL_ScanProtocol (demoscan_t *scan, int protocol)
+{
+	if (protocol != PROTOCOL_NETQUAKE && protocol != PROTOCOL_FITZQUAKE && protocol != PROTOCOL_RMQ)
+		return CL_ScanError (scan, "unknown protocol %i", protocol);
+
+	scan->reader.protocol = protocol;
+	return true;
+}
+
+// see CL_ParseServerInfo
+static qboolean CL_ScanServerInfo (demoscan_t *scan)
+{
+	demoscanresult_t	*result = scan->result;
+	serverinfo_t	info;
+	char	models[2][MAX_QPATH];
+	char	mapname[MAX_QPATH];
+
+	CL_ScanEndMap (scan);
+
+	CL_ReadServerInfo (&scan->reader, &info);
+
+	if (!CL_ScanProtocol (scan, info.protocol))
+		return false;
+	scan->reader.protocolflags = info.protocolflags;
+
+	if (info.maxclients < 1 || info.maxclients > MAX_SCOREBOARD)
+		return CL_ScanError (scan, "bad maxclients (%i)", info.maxclients);
+
+	mapname[0] = 0;
+	if (CL_ReadPrecacheList (&scan->reader, models, Q_COUNTOF(models)) > 1)
+		COM_StripExtension (COM_SkipPath (models[1]), mapname, sizeof(mapname));
+
+	CL_ReadPrecacheList (&scan->reader, NULL, 0);	// sounds
+
+	if (result->maps++ == 0)
+	{
+		result->protocol = info.protocol;
+		q_strlcpy (result->mapname, mapname, sizeof(result->mapname));
+	}
+
+	memset (scan->stats, 0, sizeof(scan->stats));
+	scan->inmap = true;
+	scan->intermission = false;
+	scan->starttime = -1;
+	scan->endtime = 0;
+
+	return true;
+}
+
+/*
+=====================
+CL_ScanMessage
+
+Mirrors CL_ParseServerMessage, returns false on malformed data
+=====================
+*/
+static qboolean CL_ScanMessage (demoscan_t *scan)
+{
+	msgreader_t	*msg = &scan->msg;
+	svcreader_t	*reader = &scan->reader;
+	int		cmd, i;
+	float	time;
+	union
+	{
+		entityupdate_t		update;
+		entity_state_t		baseline;
+		clientdata_t		clientdata;
+		soundpacket_t		sound;
+		staticsound_t		staticsound;
+		tempentity_t		tent;
+		damage_t			damage;
+		particleeffect_t	particle;
+		fogupdate_t			fog;
+	} svc;
+
+	MSGR_BeginReading (msg, &scan->message);
+
+	while (1)
+	{
+		if (msg->badread)
+			return CL_ScanError (scan, "bad server message");
+
+		cmd = MSGR_ReadByte (msg);
+
+		if (cmd == -1)
+			return true;	// end of message
+
+		if (cmd & U_SIGNAL)
+		{
+			CL_ReadUpdate (reader, cmd & 127, &svc.update);
+			continue;
+		}
+
+		switch (cmd)
+		{
+		default:
+			return CL_ScanError (scan, "illegible server message %i", cmd);
+
+		case svc_nop:
+		case svc_sellscreen:
+		case svc_bf:
+			break;
+
+		case svc_time:
+			time = MSGR_ReadFloat (msg);
+			if (scan->starttime < 0)
+				scan->starttime = time;
+			if (!scan->intermission)
+				scan->endtime = time;
+			break;
+
+		case svc_clientdata:
+			CL_ReadClientdata (reader, &svc.clientdata);
+			break;
+
+		case svc_version:
+			if (!CL_ScanProtocol (scan, MSGR_ReadLong (msg)))
+				return false;
+			break;
+
+		case svc_disconnect:
+			scan->disconnected = true;
+			return true;
+
+		case svc_print:
+		case svc_centerprint:
+		case svc_stufftext:
+		case svc_skybox:
+		case svc_achievement:
+			MSGR_ReadString (msg);
+			break;
+
+		case svc_damage:
+			CL_ReadDamage (reader, &svc.damage);
+			break;
+
+		case svc_serverinfo:
+			if (!CL_ScanServerInfo (scan))
+				return false;
+			break;
+
+		case svc_setangle:
+			for (i = 0; i < 3; i++)
+				MSGR_ReadAngle (msg, reader->protocolflags);
+			break;
+
+		case svc_setview:
+		case svc_stopsound:
+			MSGR_ReadShort (msg);
+			break;
+
+		case svc_lightstyle:
+		case svc_updatename:
+			MSGR_ReadByte (msg);
+			MSGR_ReadString (msg);
+			break;
+
+		case svc_sound:
+			CL_ReadSound (reader, &svc.sound);
+			break;
+
+		case svc_updatefrags:
+			MSGR_ReadByte (msg);
+			MSGR_ReadShort (msg);
+			break;
+
+		case svc_updatecolors:
+		case svc_cdtrack:
+			MSGR_ReadByte (msg);
+			MSGR_ReadByte (msg);
+			break;
+
+		case svc_particle:
+			CL_ReadParticleEffect (reader, &svc.particle);
+			break;
+
+		case svc_spawnbaseline:
+			MSGR_ReadShort (msg);	// entity
+			CL_ReadBaseline (reader, 1, &svc.baseline);
+			break;
+
+		case svc_spawnstatic:
+			CL_ReadBaseline (reader, 1, &svc.baseline);
+			break;
+
+		case svc_temp_entity:
+			if (!CL_ReadTEnt (reader, &svc.tent))
+				return CL_ScanError (scan, "bad temp entity type %i", svc.tent.type);
+			break;
+
+		case svc_setpause:
+		case svc_signonnum:
+			MSGR_ReadByte (msg);
+			break;
+
+		case svc_killedmonster:
+			scan->stats[STAT_MONSTERS]++;
+			break;
+
+		case svc_foundsecret:
+			scan->stats[STAT_SECRETS]++;
+			break;
+
+		case svc_updatestat:
+			i = MSGR_ReadByte (msg);
+			if (i < 0 || i >= MAX_CL_STATS)
+				return CL_ScanError (scan, "svc_updatestat: %i is invalid", i);
+			scan->stats[i] = MSGR_ReadLong (msg);
+			break;
+
+		case svc_spawnstaticsound:
+			CL_ReadStaticSound (reader, 1, &svc.staticsound);
+			break;
+
+		case svc_intermission:
+			scan->intermission = true;
+			break;
+
+		case svc_finale:
+			scan->intermission = true;
+			MSGR_ReadString (msg);
+			break;
+
+		case svc_cutscene:
+			MSGR_ReadString (msg);
+			break;
+
+		case svc_fog:
+			CL_ReadFog (reader, &svc.fog);
+			break;
+
+		case svc_spawnbaseline2:
+			MSGR_ReadShort (msg);	// entity
+			CL_ReadBaseline (reader, 2, &svc.baseline);
+			break;
+
+		case svc_spawnstatic2:
+			CL_ReadBaseline (reader, 2, &svc.baseline);
+			break;
+
+		case svc_spawnstaticsound2:
+			CL_ReadStaticSound (reader, 2, &svc.staticsound);
+			break;
+
+		case svc_localsound:
+			CL_ReadLocalSound (reader);
+			break;
+		}
+	}
+}
+
+/*
+==============================================================================
+
+WORKERS
+
+==============================================================================
+*/
+
+static void CL_ScanDemo (demoscan_t *scan, demoscanresult_t *result)
+{
+	char	name[MAX_OSPATH];
+	FILE	*file;
+	demoreader_t	*reader;
+	int		track, size;
+	float	angles[3];
+	byte	*data;
+
+	data = scan->message.data;
+	memset (scan, 0, sizeof(*scan));
+	scan->message.data = data;
+	scan->message.maxsize = MAX_MSGLEN;
+	scan->reader.msg = &scan->msg;
+	scan->result = result;
+
+	q_strlcpy (name, result->name, sizeof(name));
+	COM_AddExtension (name, ".dem", sizeof(name));
+
+	SDL_LockMutex (demo_scan.fslock);
+	COM_FOpenFile (name, &file, NULL);
+	SDL_UnlockMutex (demo_scan.fslock);
+
+	if (!file)
+	{
+		CL_ScanError (scan, "couldn't open");
+		return;
+	}
+
+	reader = CL_DemoReaderOpen (file);
+
+	if (!CL_DemoReadTrack (reader, &track))
+		CL_ScanError (scan, "invalid demo");
+	else
+	{
+		while (!scan->disconnected)
+		{
+			// a truncated message ends the demo, like during playback
+			if (CL_DemoRead (reader, &size, 4) != 4)
+				break;
+
+			size = LittleLong (size);
+			if (size < 0 || size > MAX_MSGLEN)
+			{
+				CL_ScanError (scan, "message > MAX_MSGLEN");
+				break;
+			}
+
+			if (CL_DemoRead (reader, angles, sizeof(angles)) != sizeof(angles) ||
+				CL_DemoRead (reader, scan->message.data, size) != (size_t)size)
+				break;
+
+			scan->message.cursize = size;
+			result->messages++;
+
+			if (!CL_ScanMessage (scan))
+				break;
+		}
+
+		CL_ScanEndMap (scan);
+	}
+
+	CL_DemoReaderClose (reader);
+	fclose (file);
+}
+
+static void CL_DemoScanJob (void *data, int index, int worker)
+{
+	CL_ScanDemo (demo_scan.scans[worker], &demo_scan.results[index]);
+}
+
+static void CL_PrintDemoScanResult (const demoscanresult_t *result)
+{
+	int	minutes;
+
+	if (result->error[0])
+	{
+		Con_Printf ("%-16s ERROR: %s\n", result->name, result->error);
+		return;
+	}
+
+	minutes = (int)result->duration / 60;
+
+	Con_Printf ("%-16s %-10s %c %3i %3i:%06.3f %4i/%-4i %3i/%-3i %s\n",
+		result->name,
+		result->mapname[0] ? result->mapname : "-",
+		result->maps > 1 ? '+' : ' ',
+		result->protocol,
+		minutes, result->duration - minutes * 60,
+		result->kills, result->totalkills,
+		result->secrets, result->totalsecrets,
+		result->completed ? "completed" : "");
+}
+
+/*
+====================
+CL_DemoScan_f
+
+demoscan [demoname ...]
+
+Scans the given demos, or all demos of the game, with the job system and
+prints per demo statistics. Map is the first one of the demo, '+' means
+more maps follow, and time, kills and secrets are summed over all of them.
+====================
+*/
+void CL_DemoScan_f (void)
+{
+	filelist_item_t	*item;
+	int		i, numworkers, failed;
+	double	time;
+
+	if (Cmd_Argc () > 1)
+	{
+		demo_scan.count = Cmd_Argc () - 1;
+		demo_scan.results = (demoscanresult_t *) calloc (demo_scan.count, sizeof(demoscanresult_t));
+
+		for (i = 0; i < demo_scan.count; i++)
+			q_strlcpy (demo_scan.results[i].name, Cmd_Argv (i + 1), sizeof(demo_scan.results[i].name));
+	}
+	else
+	{
+		if (!demolist)
+			DemoList_Init ();	// dedicated server doesn't have the list yet
+
+		for (demo_scan.count = 0, item = demolist; item; item = item->next)
+			demo_scan.count++;
+
+		if (demo_scan.count == 0)
+		{
+			Con_Printf ("demoscan [demoname ...] : prints statistics of demos\n");
+			return;
+		}
+
+		demo_scan.results = (demoscanresult_t *) calloc (demo_scan.count, sizeof(demoscanresult_t));
+
+		for (i = 0, item = demolist; item; item = item->next, i++)
+			q_strlcpy (demo_scan.results[i].name, item->name, sizeof(demo_scan.results[i].name));
+	}
+
+	time = Sys_DoubleTime ();
+
+	demo_scan.fslock = SDL_CreateMutex ();
+	numworkers = Jobs_NumWorkers ();
+
+	for (i = 0; i < numworkers; i++)
+	{
+		demo_scan.scans[i] = (demoscan_t *) malloc (sizeof(demoscan_t));
+		demo_scan.scans[i]->message.data = (byte *) malloc (MAX_MSGLEN);
+	}
+
+	if (demo_scan.fslock)
+		Jobs_ParallelFor (CL_DemoScanJob, NULL, demo_scan.count);
+	else
+	{
+		numworkers = 1;
+		for (i = 0; i < demo_scan.count; i++)
+			CL_DemoScanJob (NULL, i, 0);
+	}
+
+	for (i = 0; i < Jobs_NumWorkers (); i++)
+	{
+		free (demo_scan.scans[i]->message.data);
+		free (demo_scan.scans[i]);
+		demo_scan.scans[i] = NULL;
+	}
+
+	if (demo_scan.fslock)
+		SDL_DestroyMutex (demo_scan.fslock);
+	demo_scan.fslock = NULL;
+
+	time = Sys_DoubleTime () - time;
+
+	Con_Printf ("%-16s %-10s   %3s %10s %9s %7s\n", "demo", "map", "pro", "time", "kills", "secrets");
+
+	for (i = 0, failed = 0; i < demo_scan.count; i++)
+	{
+		CL_PrintDemoScanResult (&demo_scan.results[i]);
+		if (demo_scan.results[i].error[0])
+			failed++;
+	}
+
+	Con_Printf ("%i demos, %i failed, %.2f seconds, %i workers\n", demo_scan.count, failed, time, q_min (numworkers, demo_scan.count));
+
+	free (demo_scan.results);
+	demo_scan.results = NULL;
+	demo_scan.count = 0;
+}
@@ -78,6 +78,7 @@ void CL_ClearState (void)
 
 // wipe the entire cl structure
 	memset (&cl, 0, sizeof(cl));
+	CL_ClearDemoKeyframes ();
 
 	SZ_Clear (&cls.message);
 
@@ -213,6 +214,7 @@ void CL_SignonReply (void)
 
 	case 4:
 		SCR_EndLoadingPlaque ();		// allow normal screen updates
+		COM_EndFileTrace (true);
 		break;
 	}
 }
@@ -622,11 +624,14 @@ int CL_ReadFromServer (void)
 	beam_t		*b; //johnfitz
 	dlight_t	*l; //johnfitz
 	int			i; //johnfitz
+	double		time;
 
 
 	cl.oldtime = cl.time;
 	cl.time += host_frametime;
 
+	time = Sys_DoubleTime ();
+
 	do
 	{
 		ret = CL_GetMessage ();
@@ -639,11 +644,18 @@ int CL_ReadFromServer (void)
 		CL_ParseServerMessage ();
 	} while (ret && cls.state == ca_connected);
 
+	time = CL_TimeDemoStage (&cls.td_parsetime, time);
+
 	if (cl_shownet.value)
 		Con_Printf ("\n");
 
+	CL_UpdateDemoKeyframes ();
+
+	time = Sys_DoubleTime ();
 	CL_RelinkEntities ();
+	time = CL_TimeDemoStage (&cls.td_relinktime, time);
 	CL_UpdateTEnts ();
+	CL_TimeDemoStage (&cls.td_tenttime, time);
 
 //johnfitz -- devstats
 
@@ -827,6 +839,8 @@ void CL_Init (void)
 	Cvar_RegisterVariable (&cl_minpitch); //johnfitz -- variable pitch clamping
 
 	Cvar_RegisterVariable (&cl_startdemos);
+	Cvar_RegisterVariable (&cl_demokeyframes);
+	Cvar_RegisterVariable (&cl_democompress);
 
 	Cmd_AddCommand ("entities", CL_PrintEntities_f);
 	Cmd_AddCommand ("disconnect", CL_Disconnect_f);
@@ -834,6 +848,7 @@ void CL_Init (void)
 	Cmd_AddCommand ("stop", CL_Stop_f);
 	Cmd_AddCommand ("playdemo", CL_PlayDemo_f);
 	Cmd_AddCommand ("timedemo", CL_TimeDemo_f);
+	Cmd_AddCommand ("demoseek", CL_DemoSeek_f);
 
 	Cmd_AddCommand ("tracepos", CL_Tracepos_f); //johnfitz
 	Cmd_AddCommand ("viewpos", CL_Viewpos_f); //johnfitz
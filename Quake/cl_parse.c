@@ -134,65 +134,463 @@ entity_t	*CL_EntityNum (int num)
 	return &cl_entities[num];
 }
 
+/*
+==============================================================================
+
+MESSAGE DECODING
+
+The CL_Read* functions turn svc_* payloads into plain structs and leave all
+validation and side effects to the caller. They only touch the reader, so
+CL_ParseServerMessage and the demo scanner workers decode the protocol with
+the same code.
+==============================================================================
+*/
 
 /*
 ==================
-CL_ParseStartSoundPacket
+CL_ServerReader
+
+Reader for net_message, following the protocol of the current server
 ==================
 */
-void CL_ParseStartSoundPacket(void)
+svcreader_t *CL_ServerReader (void)
 {
-	vec3_t	pos;
-	int	channel, ent;
-	int	sound_num;
-	int	volume;
+	static svcreader_t	reader;
+
+	reader.msg = &net_reader;
+	reader.protocol = cl.protocol;
+	reader.protocolflags = cl.protocolflags;
+
+	return &reader;
+}
+
+/*
+==================
+CL_ReadServerInfo
+
+Reads the svc_serverinfo header, the precache lists follow
+==================
+*/
+void CL_ReadServerInfo (svcreader_t *reader, serverinfo_t *info)
+{
+	msgreader_t	*msg = reader->msg;
+
+	info->protocol = MSGR_ReadLong (msg);
+	if (info->protocol == PROTOCOL_RMQ)
+		info->protocolflags = (unsigned int) MSGR_ReadLong (msg);
+	else
+		info->protocolflags = 0;
+
+	info->maxclients = MSGR_ReadByte (msg);
+	info->gametype = MSGR_ReadByte (msg);
+	q_strlcpy (info->levelname, MSGR_ReadString (msg), sizeof(info->levelname));
+}
+
+/*
+==================
+CL_ReadPrecacheList
+
+Reads a model or sound precache list into names[1..maxnames-1], names may be
+NULL to skip it. Returns the number of precaches plus one for the unused
+index 0, which can be more than maxnames.
+==================
+*/
+int CL_ReadPrecacheList (svcreader_t *reader, char (*names)[MAX_QPATH], int maxnames)
+{
+	const char	*str;
+	int		count;
+
+	for (count = 1 ; ; count++)
+	{
+		str = MSGR_ReadString (reader->msg);
+		if (!str[0])
+			break;
+		if (names && count < maxnames)
+			q_strlcpy (names[count], str, MAX_QPATH);
+	}
+
+	return count;
+}
+
+/*
+==================
+CL_ReadUpdate
+==================
+*/
+void CL_ReadUpdate (svcreader_t *reader, int bits, entityupdate_t *update)
+{
+	msgreader_t	*msg = reader->msg;
+	unsigned int	flags = reader->protocolflags;
+	qboolean	fitzquake = reader->protocol == PROTOCOL_FITZQUAKE || reader->protocol == PROTOCOL_RMQ;
+	float		a, b;
+
+	if (bits & U_MOREBITS)
+		bits |= MSGR_ReadByte (msg) << 8;
+
+	//johnfitz -- PROTOCOL_FITZQUAKE
+	if (fitzquake)
+	{
+		if (bits & U_EXTEND1)
+			bits |= MSGR_ReadByte (msg) << 16;
+		if (bits & U_EXTEND2)
+			bits |= MSGR_ReadByte (msg) << 24;
+	}
+	//johnfitz
+
+	update->bits = bits;
+
+	if (bits & U_LONGENTITY)
+		update->num = MSGR_ReadShort (msg);
+	else
+		update->num = MSGR_ReadByte (msg);
+
+	if (bits & U_MODEL)
+		update->modelindex = MSGR_ReadByte (msg);
+	if (bits & U_FRAME)
+		update->frame = MSGR_ReadByte (msg);
+	if (bits & U_COLORMAP)
+		update->colormap = MSGR_ReadByte (msg);
+	if (bits & U_SKIN)
+		update->skin = MSGR_ReadByte (msg);
+	if (bits & U_EFFECTS)
+		update->effects = MSGR_ReadByte (msg);
+
+	if (bits & U_ORIGIN1)
+		update->origin[0] = MSGR_ReadCoord (msg, flags);
+	if (bits & U_ANGLE1)
+		update->angles[0] = MSGR_ReadAngle (msg, flags);
+	if (bits & U_ORIGIN2)
+		update->origin[1] = MSGR_ReadCoord (msg, flags);
+	if (bits & U_ANGLE2)
+		update->angles[1] = MSGR_ReadAngle (msg, flags);
+	if (bits & U_ORIGIN3)
+		update->origin[2] = MSGR_ReadCoord (msg, flags);
+	if (bits & U_ANGLE3)
+		update->angles[2] = MSGR_ReadAngle (msg, flags);
+
+	//johnfitz -- PROTOCOL_FITZQUAKE and PROTOCOL_NEHAHRA
+	if (fitzquake)
+	{
+		if (bits & U_ALPHA)
+			update->alpha = MSGR_ReadByte (msg);
+		if (bits & U_SCALE)
+			update->scale = MSGR_ReadByte (msg);
+		if (bits & U_FRAME2)
+			update->frame2 = MSGR_ReadByte (msg);
+		if (bits & U_MODEL2)
+			update->model2 = MSGR_ReadByte (msg);
+		if (bits & U_LERPFINISH)
+			update->lerpfinish = MSGR_ReadByte (msg);
+	}
+	else if (reader->protocol == PROTOCOL_NETQUAKE && (bits & U_TRANS))
+	{
+		//HACK: if this bit is set, assume this is PROTOCOL_NEHAHRA
+		a = MSGR_ReadFloat (msg);
+		b = MSGR_ReadFloat (msg); //alpha
+		if (a == 2)
+			MSGR_ReadFloat (msg); //fullbright (not using this yet)
+		update->alpha = ENTALPHA_ENCODE(b);
+	}
+	//johnfitz
+}
+
+/*
+==================
+CL_ReadBaseline
+
+Fills everything but the effects of baseline
+==================
+*/
+void CL_ReadBaseline (svcreader_t *reader, int version, entity_state_t *baseline)
+{
+	msgreader_t	*msg = reader->msg;
+	int	i;
+	int bits; //johnfitz
+
+	//johnfitz -- PROTOCOL_FITZQUAKE
+	bits = (version == 2) ? MSGR_ReadByte (msg) : 0;
+	baseline->modelindex = (bits & B_LARGEMODEL) ? MSGR_ReadShort (msg) : MSGR_ReadByte (msg);
+	baseline->frame = (bits & B_LARGEFRAME) ? MSGR_ReadShort (msg) : MSGR_ReadByte (msg);
+	//johnfitz
+
+	baseline->colormap = MSGR_ReadByte (msg);
+	baseline->skin = MSGR_ReadByte (msg);
+	for (i = 0; i < 3; i++)
+	{
+		baseline->origin[i] = MSGR_ReadCoord (msg, reader->protocolflags);
+		baseline->angles[i] = MSGR_ReadAngle (msg, reader->protocolflags);
+	}
+
+	baseline->alpha = (bits & B_ALPHA) ? MSGR_ReadByte (msg) : ENTALPHA_DEFAULT; //johnfitz -- PROTOCOL_FITZQUAKE
+	baseline->scale = (bits & B_SCALE) ? MSGR_ReadByte (msg) : ENTSCALE_DEFAULT;
+}
+
+/*
+==================
+CL_ReadClientdata
+
+Fields that weren't sent get their defaults
+==================
+*/
+void CL_ReadClientdata (svcreader_t *reader, clientdata_t *data)
+{
+	msgreader_t	*msg = reader->msg;
+	int		i, bits;
+
+	bits = (unsigned short) MSGR_ReadShort (msg);
+
+	//johnfitz -- PROTOCOL_FITZQUAKE
+	if (bits & SU_EXTEND1)
+		bits |= (MSGR_ReadByte (msg) << 16);
+	if (bits & SU_EXTEND2)
+		bits |= (MSGR_ReadByte (msg) << 24);
+	//johnfitz
+
+	data->bits = bits;
+	data->viewheight = (bits & SU_VIEWHEIGHT) ? MSGR_ReadChar (msg) : DEFAULT_VIEWHEIGHT;
+	data->idealpitch = (bits & SU_IDEALPITCH) ? MSGR_ReadChar (msg) : 0;
+
+	for (i = 0; i < 3; i++)
+	{
+		data->punchangle[i] = (bits & (SU_PUNCH1<<i)) ? MSGR_ReadChar (msg) : 0;
+		data->velocity[i] = (bits & (SU_VELOCITY1<<i)) ? MSGR_ReadChar (msg) * 16 : 0;
+	}
+
+// [always sent]	if (bits & SU_ITEMS)
+	data->items = MSGR_ReadLong (msg);
+
+	data->weaponframe = (bits & SU_WEAPONFRAME) ? MSGR_ReadByte (msg) : 0;
+	data->armor = (bits & SU_ARMOR) ? MSGR_ReadByte (msg) : 0;
+	data->weapon = (bits & SU_WEAPON) ? MSGR_ReadByte (msg) : 0;
+	data->health = MSGR_ReadShort (msg);
+	data->ammo = MSGR_ReadByte (msg);
+	for (i = 0; i < 4; i++)
+		data->ammocounts[i] = MSGR_ReadByte (msg);
+	data->activeweapon = MSGR_ReadByte (msg);
+
+	//johnfitz -- PROTOCOL_FITZQUAKE
+	if (bits & SU_WEAPON2)
+		data->weapon |= (MSGR_ReadByte (msg) << 8);
+	if (bits & SU_ARMOR2)
+		data->armor |= (MSGR_ReadByte (msg) << 8);
+	if (bits & SU_AMMO2)
+		data->ammo |= (MSGR_ReadByte (msg) << 8);
+	for (i = 0; i < 4; i++)
+		if (bits & (SU_SHELLS2<<i))
+			data->ammocounts[i] |= (MSGR_ReadByte (msg) << 8);
+	if (bits & SU_WEAPONFRAME2)
+		data->weaponframe |= (MSGR_ReadByte (msg) << 8);
+	data->weaponalpha = (bits & SU_WEAPONALPHA) ? MSGR_ReadByte (msg) : ENTALPHA_DEFAULT;
+	//johnfitz
+}
+
+/*
+==================
+CL_ReadSound
+==================
+*/
+void CL_ReadSound (svcreader_t *reader, soundpacket_t *sound)
+{
+	msgreader_t	*msg = reader->msg;
 	int	field_mask;
-	float	attenuation;
 	int	i;
 
-	field_mask = MSG_ReadByte();
+	field_mask = MSGR_ReadByte (msg);
 
 	if (field_mask & SND_VOLUME)
-		volume = MSG_ReadByte ();
+		sound->volume = MSGR_ReadByte (msg);
 	else
-		volume = DEFAULT_SOUND_PACKET_VOLUME;
+		sound->volume = DEFAULT_SOUND_PACKET_VOLUME;
 
 	if (field_mask & SND_ATTENUATION)
-		attenuation = MSG_ReadByte () / 64.0;
+		sound->attenuation = MSGR_ReadByte (msg) / 64.0;
 	else
-		attenuation = DEFAULT_SOUND_PACKET_ATTENUATION;
+		sound->attenuation = DEFAULT_SOUND_PACKET_ATTENUATION;
 
 	//johnfitz -- PROTOCOL_FITZQUAKE
 	if (field_mask & SND_LARGEENTITY)
 	{
-		ent = (unsigned short) MSG_ReadShort ();
-		channel = MSG_ReadByte ();
+		sound->entity = (unsigned short) MSGR_ReadShort (msg);
+		sound->channel = MSGR_ReadByte (msg);
 	}
 	else
 	{
-		channel = (unsigned short) MSG_ReadShort ();
-		ent = channel >> 3;
-		channel &= 7;
+		sound->channel = (unsigned short) MSGR_ReadShort (msg);
+		sound->entity = sound->channel >> 3;
+		sound->channel &= 7;
 	}
 
 	if (field_mask & SND_LARGESOUND)
-		sound_num = (unsigned short) MSG_ReadShort ();
+		sound->sound = (unsigned short) MSGR_ReadShort (msg);
 	else
-		sound_num = MSG_ReadByte ();
+		sound->sound = MSGR_ReadByte (msg);
 	//johnfitz
 
-	//johnfitz -- check soundnum
-	if (sound_num >= MAX_SOUNDS)
-		Host_Error ("CL_ParseStartSoundPacket: %i > MAX_SOUNDS", sound_num);
+	for (i = 0; i < 3; i++)
+		sound->origin[i] = MSGR_ReadCoord (msg, reader->protocolflags);
+}
+
+/*
+==================
+CL_ReadLocalSound
+
+Returns the sound number of svc_localsound
+==================
+*/
+int CL_ReadLocalSound (svcreader_t *reader)
+{
+	int	field_mask;
+
+	field_mask = MSGR_ReadByte (reader->msg);
+
+	return (field_mask & SND_LARGESOUND) ? MSGR_ReadShort (reader->msg) : MSGR_ReadByte (reader->msg);
+}
+
+/*
+==================
+CL_ReadStaticSound
+==================
+*/
+void CL_ReadStaticSound (svcreader_t *reader, int version, staticsound_t *sound)
+{
+	msgreader_t	*msg = reader->msg;
+	int	i;
+
+	for (i = 0; i < 3; i++)
+		sound->origin[i] = MSGR_ReadCoord (msg, reader->protocolflags);
+
+	//johnfitz -- PROTOCOL_FITZQUAKE
+	if (version == 2)
+		sound->sound = MSGR_ReadShort (msg);
+	else
+		sound->sound = MSGR_ReadByte (msg);
 	//johnfitz
 
-	if (ent > cl_max_edicts) //johnfitz -- no more MAX_EDICTS
-		Host_Error ("CL_ParseStartSoundPacket: ent = %i", ent);
+	sound->volume = MSGR_ReadByte (msg);
+	sound->attenuation = MSGR_ReadByte (msg);
+}
 
+/*
+==================
+CL_ReadTEnt
+
+Returns false for an unknown type, the rest of the message can't be decoded
+==================
+*/
+qboolean CL_ReadTEnt (svcreader_t *reader, tempentity_t *tent)
+{
+	msgreader_t	*msg = reader->msg;
+	int	i;
+
+	tent->type = MSGR_ReadByte (msg);
+
+	switch (tent->type)
+	{
+	case TE_WIZSPIKE:
+	case TE_KNIGHTSPIKE:
+	case TE_SPIKE:
+	case TE_SUPERSPIKE:
+	case TE_GUNSHOT:
+	case TE_EXPLOSION:
+	case TE_TAREXPLOSION:
+	case TE_LAVASPLASH:
+	case TE_TELEPORT:
+		for (i = 0; i < 3; i++)
+			tent->start[i] = MSGR_ReadCoord (msg, reader->protocolflags);
+		return true;
+
+	case TE_EXPLOSION2:				// color mapped explosion
+		for (i = 0; i < 3; i++)
+			tent->start[i] = MSGR_ReadCoord (msg, reader->protocolflags);
+		tent->colorstart = MSGR_ReadByte (msg);
+		tent->colorlength = MSGR_ReadByte (msg);
+		return true;
+
+	case TE_LIGHTNING1:				// lightning bolts
+	case TE_LIGHTNING2:
+	case TE_LIGHTNING3:
+	case TE_BEAM:					// grappling hook beam
+		tent->entity = MSGR_ReadShort (msg);
+		for (i = 0; i < 3; i++)
+			tent->start[i] = MSGR_ReadCoord (msg, reader->protocolflags);
+		for (i = 0; i < 3; i++)
+			tent->end[i] = MSGR_ReadCoord (msg, reader->protocolflags);
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+/*
+==================
+CL_ReadDamage
+==================
+*/
+void CL_ReadDamage (svcreader_t *reader, damage_t *damage)
+{
+	int	i;
+
+	damage->armor = MSGR_ReadByte (reader->msg);
+	damage->blood = MSGR_ReadByte (reader->msg);
 	for (i = 0; i < 3; i++)
-		pos[i] = MSG_ReadCoord (cl.protocolflags);
+		damage->from[i] = MSGR_ReadCoord (reader->msg, reader->protocolflags);
+}
+
+/*
+==================
+CL_ReadParticleEffect
+==================
+*/
+void CL_ReadParticleEffect (svcreader_t *reader, particleeffect_t *effect)
+{
+	int	i;
 
-	S_StartSound (ent, channel, cl.sound_precache[sound_num], pos, volume/255.0, attenuation);
+	for (i = 0; i < 3; i++)
+		effect->origin[i] = MSGR_ReadCoord (reader->msg, reader->protocolflags);
+	for (i = 0; i < 3; i++)
+		effect->dir[i] = MSGR_ReadChar (reader->msg) * (1.0/16);
+	effect->count = MSGR_ReadByte (reader->msg);
+	effect->color = MSGR_ReadByte (reader->msg);
+}
+
+/*
+==================
+CL_ReadFog
+==================
+*/
+void CL_ReadFog (svcreader_t *reader, fogupdate_t *fog)
+{
+	fog->density = MSGR_ReadByte (reader->msg);
+	fog->red = MSGR_ReadByte (reader->msg);
+	fog->green = MSGR_ReadByte (reader->msg);
+	fog->blue = MSGR_ReadByte (reader->msg);
+	fog->time = MSGR_ReadShort (reader->msg);
+}
+
+//=============================================================================
+
+
+/*
+==================
+CL_ParseStartSoundPacket
+==================
+*/
+void CL_ParseStartSoundPacket(void)
+{
+	soundpacket_t	sound;
+
+	CL_ReadSound (CL_ServerReader (), &sound);
+
+	//johnfitz -- check soundnum
+	if (sound.sound >= MAX_SOUNDS)
+		Host_Error ("CL_ParseStartSoundPacket: %i > MAX_SOUNDS", sound.sound);
+	//johnfitz
+
+	if (sound.entity > cl_max_edicts) //johnfitz -- no more MAX_EDICTS
+		Host_Error ("CL_ParseStartSoundPacket: ent = %i", sound.entity);
+
+	S_StartSound (sound.entity, sound.channel, cl.sound_precache[sound.sound], sound.origin, sound.volume/255.0, sound.attenuation);
 }
 
 /*
@@ -202,10 +600,9 @@ CL_ParseLocalSound - for 2021 rerelease
 */
 void CL_ParseLocalSound(void)
 {
-	int field_mask, sound_num;
+	int sound_num;
 
-	field_mask = MSG_ReadByte();
-	sound_num = (field_mask&SND_LARGESOUND) ? MSG_ReadShort() : MSG_ReadByte();
+	sound_num = CL_ReadLocalSound (CL_ServerReader ());
 	if (sound_num >= MAX_SOUNDS)
 		Host_Error ("CL_ParseLocalSound: %i > MAX_SOUNDS", sound_num);
 
@@ -282,7 +679,7 @@ CL_ParseServerInfo
 */
 void CL_ParseServerInfo (void)
 {
-	const char	*str;
+	serverinfo_t	info;
 	int		i;
 	int		nummodels, numsounds;
 	char	model_precache[MAX_MODELS][MAX_QPATH];
@@ -300,8 +697,12 @@ void CL_ParseServerInfo (void)
 //
 	CL_ClearState ();
 
+	COM_InvalidateLooseFiles ();	// pick up files added since the last map
+
+	CL_ReadServerInfo (CL_ServerReader (), &info);
+
 // parse protocol version number
-	i = MSG_ReadLong ();
+	i = info.protocol;
 	//johnfitz -- support multiple protocols
 	if (i != PROTOCOL_NETQUAKE && i != PROTOCOL_FITZQUAKE && i != PROTOCOL_RMQ) {
 		Con_Printf ("\n"); //because there's no newline after serverinfo print
@@ -310,22 +711,20 @@ void CL_ParseServerInfo (void)
 	cl.protocol = i;
 	//johnfitz
 
+	// mh - read protocol flags from server so that we know what protocol features to expect
+	cl.protocolflags = info.protocolflags;
 	if (cl.protocol == PROTOCOL_RMQ)
 	{
 		const unsigned int supportedflags = (PRFL_SHORTANGLE | PRFL_FLOATANGLE | PRFL_24BITCOORD | PRFL_FLOATCOORD | PRFL_EDICTSCALE | PRFL_INT32COORD);
-		
-		// mh - read protocol flags from server so that we know what protocol features to expect
-		cl.protocolflags = (unsigned int) MSG_ReadLong ();
-		
+
 		if (0 != (cl.protocolflags & (~supportedflags)))
 		{
 			Con_Warning("PROTOCOL_RMQ protocolflags %i contains unsupported flags\n", cl.protocolflags);
 		}
 	}
-	else cl.protocolflags = 0;
 
 // parse maxclients
-	cl.maxclients = MSG_ReadByte ();
+	cl.maxclients = info.maxclients;
 	if (cl.maxclients < 1 || cl.maxclients > MAX_SCOREBOARD)
 	{
 		Host_Error ("Bad maxclients (%u) from server", cl.maxclients);
@@ -333,11 +732,10 @@ void CL_ParseServerInfo (void)
 	cl.scores = (scoreboard_t *) Hunk_AllocName (cl.maxclients*sizeof(*cl.scores), "scores");
 
 // parse gametype
-	cl.gametype = MSG_ReadByte ();
+	cl.gametype = info.gametype;
 
 // parse signon message
-	str = MSG_ReadString ();
-	q_strlcpy (cl.levelname, str, sizeof(cl.levelname));
+	q_strlcpy (cl.levelname, info.levelname, sizeof(cl.levelname));
 
 // first we go through and touch all of the precache data that still
 // happens to be in the cache, so precaching something else doesn't
@@ -345,18 +743,13 @@ void CL_ParseServerInfo (void)
 
 // precache models
 	memset (cl.model_precache, 0, sizeof(cl.model_precache));
-	for (nummodels = 1 ; ; nummodels++)
+	nummodels = CL_ReadPrecacheList (CL_ServerReader (), model_precache, MAX_MODELS);
+	if (nummodels > MAX_MODELS)
 	{
-		str = MSG_ReadString ();
-		if (!str[0])
-			break;
-		if (nummodels == MAX_MODELS)
-		{
-			Host_Error ("Server sent too many model precaches");
-		}
-		q_strlcpy (model_precache[nummodels], str, MAX_QPATH);
-		Mod_TouchModel (str);
+		Host_Error ("Server sent too many model precaches");
 	}
+	for (i = 1; i < nummodels; i++)
+		Mod_TouchModel (model_precache[i]);
 
 	//johnfitz -- check for excessive models
 	if (nummodels >= 2048)
@@ -367,18 +760,13 @@ void CL_ParseServerInfo (void)
 
 // precache sounds
 	memset (cl.sound_precache, 0, sizeof(cl.sound_precache));
-	for (numsounds = 1 ; ; numsounds++)
+	numsounds = CL_ReadPrecacheList (CL_ServerReader (), sound_precache, MAX_SOUNDS);
+	if (numsounds > MAX_SOUNDS)
 	{
-		str = MSG_ReadString ();
-		if (!str[0])
-			break;
-		if (numsounds == MAX_SOUNDS)
-		{
-			Host_Error ("Server sent too many sound precaches");
-		}
-		q_strlcpy (sound_precache[numsounds], str, MAX_QPATH);
-		S_TouchSound (str);
+		Host_Error ("Server sent too many sound precaches");
 	}
+	for (i = 1; i < numsounds; i++)
+		S_TouchSound (sound_precache[i]);
 
 	//johnfitz -- check for excessive sounds
 	if (numsounds >= 256)
@@ -400,7 +788,16 @@ void CL_ParseServerInfo (void)
 	Con_Printf ("%c%s\n", 2, cl.levelname);
 
 	//johnfitz -- tell user which protocol this is
-	Con_Printf ("Using protocol %i\n", i);
+	Con_Printf ("Using protocol %i\n", cl.protocol);
+
+	// sounds are read in the background, so start them before the models
+	S_BeginPrecaching ();
+	for (i = 1; i < numsounds; i++)
+	{
+		cl.sound_precache[i] = S_PrecacheSound (sound_precache[i]);
+		CL_KeepaliveMessage ();
+	}
+	S_EndPrecaching ();
 
 	for (i = 1; i < nummodels; i++)
 	{
@@ -412,14 +809,6 @@ void CL_ParseServerInfo (void)
 		CL_KeepaliveMessage ();
 	}
 
-	S_BeginPrecaching ();
-	for (i = 1; i < numsounds; i++)
-	{
-		cl.sound_precache[i] = S_PrecacheSound (sound_precache[i]);
-		CL_KeepaliveMessage ();
-	}
-	S_EndPrecaching ();
-
 // local state
 	cl_entities[0].model = cl.worldmodel = cl.model_precache[1];
 
@@ -460,6 +849,7 @@ void CL_ParseUpdate (int bits)
 	entity_t	*ent;
 	int		num;
 	int		skin;
+	entityupdate_t	u;
 
 	if (cls.signon == SIGNONS - 1)
 	{	// first update is the final signon stage
@@ -467,26 +857,9 @@ void CL_ParseUpdate (int bits)
 		CL_SignonReply ();
 	}
 
-	if (bits & U_MOREBITS)
-	{
-		i = MSG_ReadByte ();
-		bits |= (i<<8);
-	}
-
-	//johnfitz -- PROTOCOL_FITZQUAKE
-	if (cl.protocol == PROTOCOL_FITZQUAKE || cl.protocol == PROTOCOL_RMQ)
-	{
-		if (bits & U_EXTEND1)
-			bits |= MSG_ReadByte() << 16;
-		if (bits & U_EXTEND2)
-			bits |= MSG_ReadByte() << 24;
-	}
-	//johnfitz
-
-	if (bits & U_LONGENTITY)
-		num = MSG_ReadShort ();
-	else
-		num = MSG_ReadByte ();
+	CL_ReadUpdate (CL_ServerReader (), bits, &u);
+	bits = u.bits;
+	num = u.num;
 
 	ent = CL_EntityNum (num);
 
@@ -504,7 +877,7 @@ void CL_ParseUpdate (int bits)
 
 	if (bits & U_MODEL)
 	{
-		modnum = MSG_ReadByte ();
+		modnum = u.modelindex;
 		if (modnum >= MAX_MODELS)
 			Host_Error ("CL_ParseModel: bad modnum");
 	}
@@ -512,12 +885,12 @@ void CL_ParseUpdate (int bits)
 		modnum = ent->baseline.modelindex;
 
 	if (bits & U_FRAME)
-		ent->frame = MSG_ReadByte ();
+		ent->frame = u.frame;
 	else
 		ent->frame = ent->baseline.frame;
 
 	if (bits & U_COLORMAP)
-		i = MSG_ReadByte();
+		i = u.colormap;
 	else
 		i = ent->baseline.colormap;
 	if (!i)
@@ -529,7 +902,7 @@ void CL_ParseUpdate (int bits)
 		ent->colormap = cl.scores[i-1].translations;
 	}
 	if (bits & U_SKIN)
-		skin = MSG_ReadByte();
+		skin = u.skin;
 	else
 		skin = ent->baseline.skin;
 	if (skin != ent->skinnum)
@@ -539,7 +912,7 @@ void CL_ParseUpdate (int bits)
 			R_TranslateNewPlayerSkin (num - 1); //johnfitz -- was R_TranslatePlayerSkin
 	}
 	if (bits & U_EFFECTS)
-		ent->effects = MSG_ReadByte();
+		ent->effects = u.effects;
 	else
 		ent->effects = ent->baseline.effects;
 
@@ -547,32 +920,12 @@ void CL_ParseUpdate (int bits)
 	VectorCopy (ent->msg_origins[0], ent->msg_origins[1]);
 	VectorCopy (ent->msg_angles[0], ent->msg_angles[1]);
 
-	if (bits & U_ORIGIN1)
-		ent->msg_origins[0][0] = MSG_ReadCoord (cl.protocolflags);
-	else
-		ent->msg_origins[0][0] = ent->baseline.origin[0];
-	if (bits & U_ANGLE1)
-		ent->msg_angles[0][0] = MSG_ReadAngle(cl.protocolflags);
-	else
-		ent->msg_angles[0][0] = ent->baseline.angles[0];
-
-	if (bits & U_ORIGIN2)
-		ent->msg_origins[0][1] = MSG_ReadCoord (cl.protocolflags);
-	else
-		ent->msg_origins[0][1] = ent->baseline.origin[1];
-	if (bits & U_ANGLE2)
-		ent->msg_angles[0][1] = MSG_ReadAngle(cl.protocolflags);
-	else
-		ent->msg_angles[0][1] = ent->baseline.angles[1];
-
-	if (bits & U_ORIGIN3)
-		ent->msg_origins[0][2] = MSG_ReadCoord (cl.protocolflags);
-	else
-		ent->msg_origins[0][2] = ent->baseline.origin[2];
-	if (bits & U_ANGLE3)
-		ent->msg_angles[0][2] = MSG_ReadAngle(cl.protocolflags);
-	else
-		ent->msg_angles[0][2] = ent->baseline.angles[2];
+	ent->msg_origins[0][0] = (bits & U_ORIGIN1) ? u.origin[0] : ent->baseline.origin[0];
+	ent->msg_origins[0][1] = (bits & U_ORIGIN2) ? u.origin[1] : ent->baseline.origin[1];
+	ent->msg_origins[0][2] = (bits & U_ORIGIN3) ? u.origin[2] : ent->baseline.origin[2];
+	ent->msg_angles[0][0] = (bits & U_ANGLE1) ? u.angles[0] : ent->baseline.angles[0];
+	ent->msg_angles[0][1] = (bits & U_ANGLE2) ? u.angles[1] : ent->baseline.angles[1];
+	ent->msg_angles[0][2] = (bits & U_ANGLE3) ? u.angles[2] : ent->baseline.angles[2];
 
 	//johnfitz -- lerping for movetype_step entities
 	if (bits & U_STEP)
@@ -588,20 +941,20 @@ void CL_ParseUpdate (int bits)
 	if (cl.protocol == PROTOCOL_FITZQUAKE || cl.protocol == PROTOCOL_RMQ)
 	{
 		if (bits & U_ALPHA)
-			ent->alpha = MSG_ReadByte();
+			ent->alpha = u.alpha;
 		else
 			ent->alpha = ent->baseline.alpha;
 		if (bits & U_SCALE)
-			ent->scale = MSG_ReadByte();
+			ent->scale = u.scale;
 		else
 			ent->scale = ent->baseline.scale;
 		if (bits & U_FRAME2)
-			ent->frame = (ent->frame & 0x00FF) | (MSG_ReadByte() << 8);
+			ent->frame = (ent->frame & 0x00FF) | (u.frame2 << 8);
 		if (bits & U_MODEL2)
-			modnum = (modnum & 0x00FF) | (MSG_ReadByte() << 8);
+			modnum = (modnum & 0x00FF) | (u.model2 << 8);
 		if (bits & U_LERPFINISH)
 		{
-			ent->lerpfinish = ent->msgtime + ((float)(MSG_ReadByte()) / 255);
+			ent->lerpfinish = ent->msgtime + ((float)(u.lerpfinish) / 255);
 			ent->lerpflags |= LERP_FINISH;
 		}
 		else
@@ -612,19 +965,13 @@ void CL_ParseUpdate (int bits)
 		//HACK: if this bit is set, assume this is PROTOCOL_NEHAHRA
 		if (bits & U_TRANS)
 		{
-			float a, b;
-
 			if (warn_about_nehahra_protocol)
 			{
 				Con_Warning ("nonstandard update bit, assuming Nehahra protocol\n");
 				warn_about_nehahra_protocol = false;
 			}
 
-			a = MSG_ReadFloat();
-			b = MSG_ReadFloat(); //alpha
-			if (a == 2)
-				MSG_ReadFloat(); //fullbright (not using this yet)
-			ent->alpha = ENTALPHA_ENCODE(b);
+			ent->alpha = u.alpha;
 		}
 		else
 			ent->alpha = ent->baseline.alpha;
@@ -672,25 +1019,7 @@ CL_ParseBaseline
 */
 void CL_ParseBaseline (entity_t *ent, int version) //johnfitz -- added argument
 {
-	int	i;
-	int bits; //johnfitz
-
-	//johnfitz -- PROTOCOL_FITZQUAKE
-	bits = (version == 2) ? MSG_ReadByte() : 0;
-	ent->baseline.modelindex = (bits & B_LARGEMODEL) ? MSG_ReadShort() : MSG_ReadByte();
-	ent->baseline.frame = (bits & B_LARGEFRAME) ? MSG_ReadShort() : MSG_ReadByte();
-	//johnfitz
-
-	ent->baseline.colormap = MSG_ReadByte();
-	ent->baseline.skin = MSG_ReadByte();
-	for (i = 0; i < 3; i++)
-	{
-		ent->baseline.origin[i] = MSG_ReadCoord (cl.protocolflags);
-		ent->baseline.angles[i] = MSG_ReadAngle (cl.protocolflags);
-	}
-
-	ent->baseline.alpha = (bits & B_ALPHA) ? MSG_ReadByte() : ENTALPHA_DEFAULT; //johnfitz -- PROTOCOL_FITZQUAKE
-	ent->baseline.scale = (bits & B_SCALE) ? MSG_ReadByte() : ENTSCALE_DEFAULT;
+	CL_ReadBaseline (CL_ServerReader (), version, &ent->baseline);
 }
 
 
@@ -704,39 +1033,18 @@ Server information pertaining to this client only
 void CL_ParseClientdata (void)
 {
 	int		i, j;
-	int		bits; //johnfitz
-
-	bits = (unsigned short)MSG_ReadShort (); //johnfitz -- read bits here isntead of in CL_ParseServerMessage()
-
-	//johnfitz -- PROTOCOL_FITZQUAKE
-	if (bits & SU_EXTEND1)
-		bits |= (MSG_ReadByte() << 16);
-	if (bits & SU_EXTEND2)
-		bits |= (MSG_ReadByte() << 24);
-	//johnfitz
+	clientdata_t	data;
 
-	if (bits & SU_VIEWHEIGHT)
-		cl.viewheight = MSG_ReadChar ();
-	else
-		cl.viewheight = DEFAULT_VIEWHEIGHT;
+	CL_ReadClientdata (CL_ServerReader (), &data);
 
-	if (bits & SU_IDEALPITCH)
-		cl.idealpitch = MSG_ReadChar ();
-	else
-		cl.idealpitch = 0;
+	cl.viewheight = data.viewheight;
+	cl.idealpitch = data.idealpitch;
 
 	VectorCopy (cl.mvelocity[0], cl.mvelocity[1]);
 	for (i = 0; i < 3; i++)
 	{
-		if (bits & (SU_PUNCH1<<i) )
-			cl.punchangle[i] = MSG_ReadChar();
-		else
-			cl.punchangle[i] = 0;
-
-		if (bits & (SU_VELOCITY1<<i) )
-			cl.mvelocity[0][i] = MSG_ReadChar()*16;
-		else
-			cl.mvelocity[0][i] = 0;
+		cl.punchangle[i] = data.punchangle[i];
+		cl.mvelocity[0][i] = data.velocity[i];
 	}
 
 	//johnfitz -- update v_punchangles
@@ -747,9 +1055,7 @@ void CL_ParseClientdata (void)
 	}
 	//johnfitz
 
-// [always sent]	if (bits & SU_ITEMS)
-		i = MSG_ReadLong ();
-
+	i = data.items;
 	if (cl.items != i)
 	{	// set flash times
 		Sbar_Changed ();
@@ -759,59 +1065,45 @@ void CL_ParseClientdata (void)
 		cl.items = i;
 	}
 
-	cl.onground = (bits & SU_ONGROUND) != 0;
-	cl.inwater = (bits & SU_INWATER) != 0;
+	cl.onground = (data.bits & SU_ONGROUND) != 0;
+	cl.inwater = (data.bits & SU_INWATER) != 0;
 
-	if (bits & SU_WEAPONFRAME)
-		cl.stats[STAT_WEAPONFRAME] = MSG_ReadByte ();
-	else
-		cl.stats[STAT_WEAPONFRAME] = 0;
+	cl.stats[STAT_WEAPONFRAME] = data.weaponframe;
 
-	if (bits & SU_ARMOR)
-		i = MSG_ReadByte ();
-	else
-		i = 0;
-	if (cl.stats[STAT_ARMOR] != i)
+	if (cl.stats[STAT_ARMOR] != data.armor)
 	{
-		cl.stats[STAT_ARMOR] = i;
+		cl.stats[STAT_ARMOR] = data.armor;
 		Sbar_Changed ();
 	}
 
-	if (bits & SU_WEAPON)
-		i = MSG_ReadByte ();
-	else
-		i = 0;
-	if (cl.stats[STAT_WEAPON] != i)
+	if (cl.stats[STAT_WEAPON] != data.weapon)
 	{
-		cl.stats[STAT_WEAPON] = i;
+		cl.stats[STAT_WEAPON] = data.weapon;
 		Sbar_Changed ();
 	}
 
-	i = MSG_ReadShort ();
-	if (cl.stats[STAT_HEALTH] != i)
+	if (cl.stats[STAT_HEALTH] != data.health)
 	{
-		cl.stats[STAT_HEALTH] = i;
+		cl.stats[STAT_HEALTH] = data.health;
 		Sbar_Changed ();
 	}
 
-	i = MSG_ReadByte ();
-	if (cl.stats[STAT_AMMO] != i)
+	if (cl.stats[STAT_AMMO] != data.ammo)
 	{
-		cl.stats[STAT_AMMO] = i;
+		cl.stats[STAT_AMMO] = data.ammo;
 		Sbar_Changed ();
 	}
 
 	for (i = 0; i < 4; i++)
 	{
-		j = MSG_ReadByte ();
-		if (cl.stats[STAT_SHELLS+i] != j)
+		if (cl.stats[STAT_SHELLS+i] != data.ammocounts[i])
 		{
-			cl.stats[STAT_SHELLS+i] = j;
+			cl.stats[STAT_SHELLS+i] = data.ammocounts[i];
 			Sbar_Changed ();
 		}
 	}
 
-	i = MSG_ReadByte ();
+	i = data.activeweapon;
 
 	if (standard_quake)
 	{
@@ -830,28 +1122,7 @@ void CL_ParseClientdata (void)
 		}
 	}
 
-	//johnfitz -- PROTOCOL_FITZQUAKE
-	if (bits & SU_WEAPON2)
-		cl.stats[STAT_WEAPON] |= (MSG_ReadByte() << 8);
-	if (bits & SU_ARMOR2)
-		cl.stats[STAT_ARMOR] |= (MSG_ReadByte() << 8);
-	if (bits & SU_AMMO2)
-		cl.stats[STAT_AMMO] |= (MSG_ReadByte() << 8);
-	if (bits & SU_SHELLS2)
-		cl.stats[STAT_SHELLS] |= (MSG_ReadByte() << 8);
-	if (bits & SU_NAILS2)
-		cl.stats[STAT_NAILS] |= (MSG_ReadByte() << 8);
-	if (bits & SU_ROCKETS2)
-		cl.stats[STAT_ROCKETS] |= (MSG_ReadByte() << 8);
-	if (bits & SU_CELLS2)
-		cl.stats[STAT_CELLS] |= (MSG_ReadByte() << 8);
-	if (bits & SU_WEAPONFRAME2)
-		cl.stats[STAT_WEAPONFRAME] |= (MSG_ReadByte() << 8);
-	if (bits & SU_WEAPONALPHA)
-		cl.viewent.alpha = MSG_ReadByte();
-	else
-		cl.viewent.alpha = ENTALPHA_DEFAULT;
-	//johnfitz
+	cl.viewent.alpha = data.weaponalpha; //johnfitz
 
 	//johnfitz -- lerping
 	//ericw -- this was done before the upper 8 bits of cl.stats[STAT_WEAPON] were filled in, breaking on large maps like zendar.bsp
@@ -943,27 +1214,13 @@ CL_ParseStaticSound
 */
 void CL_ParseStaticSound (int version) //johnfitz -- added argument
 {
-	vec3_t		org;
-	int			sound_num, vol, atten;
-	int			i;
-
-	for (i = 0; i < 3; i++)
-		org[i] = MSG_ReadCoord (cl.protocolflags);
-
-	//johnfitz -- PROTOCOL_FITZQUAKE
-	if (version == 2)
-		sound_num = MSG_ReadShort ();
-	else
-		sound_num = MSG_ReadByte ();
-	//johnfitz
+	staticsound_t	sound;
 
-	vol = MSG_ReadByte ();
-	atten = MSG_ReadByte ();
+	CL_ReadStaticSound (CL_ServerReader (), version, &sound);
 
-	S_StaticSound (cl.sound_precache[sound_num], org, vol, atten);
+	S_StaticSound (cl.sound_precache[sound.sound], sound.origin, sound.volume, sound.attenuation);
 }
 
-
 #if 0	/* for debugging. from fteqw. */
 static void CL_DumpPacket (void)
 {
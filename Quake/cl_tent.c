@@ -56,22 +56,16 @@ void CL_InitTEnts (void)
 CL_ParseBeam
 =================
 */
-void CL_ParseBeam (qmodel_t *m)
+void CL_ParseBeam (const tempentity_t *tent, qmodel_t *m)
 {
 	int		ent;
 	vec3_t	start, end;
 	beam_t	*b;
 	int		i;
 
-	ent = MSG_ReadShort ();
-
-	start[0] = MSG_ReadCoord (cl.protocolflags);
-	start[1] = MSG_ReadCoord (cl.protocolflags);
-	start[2] = MSG_ReadCoord (cl.protocolflags);
-
-	end[0] = MSG_ReadCoord (cl.protocolflags);
-	end[1] = MSG_ReadCoord (cl.protocolflags);
-	end[2] = MSG_ReadCoord (cl.protocolflags);
+	ent = tent->entity;
+	VectorCopy (tent->start, start);
+	VectorCopy (tent->end, end);
 
 // override any beam with the same entity
 	for (i=0, b=cl_beams ; i< MAX_BEAMS ; i++, b++)
@@ -119,31 +113,26 @@ void CL_ParseTEnt (void)
 	vec3_t	pos;
 	dlight_t	*dl;
 	int		rnd;
-	int		colorStart, colorLength;
+	tempentity_t	tent;
 
-	type = MSG_ReadByte ();
+	if (!CL_ReadTEnt (CL_ServerReader (), &tent))
+		Sys_Error ("CL_ParseTEnt: bad type");
+
+	type = tent.type;
+	VectorCopy (tent.start, pos);
 	switch (type)
 	{
 	case TE_WIZSPIKE:			// spike hitting wall
-		pos[0] = MSG_ReadCoord (cl.protocolflags);
-		pos[1] = MSG_ReadCoord (cl.protocolflags);
-		pos[2] = MSG_ReadCoord (cl.protocolflags);
 		R_RunParticleEffect (pos, vec3_origin, 20, 30);
 		S_StartSound (-1, 0, cl_sfx_wizhit, pos, 1, 1);
 		break;
 
 	case TE_KNIGHTSPIKE:			// spike hitting wall
-		pos[0] = MSG_ReadCoord (cl.protocolflags);
-		pos[1] = MSG_ReadCoord (cl.protocolflags);
-		pos[2] = MSG_ReadCoord (cl.protocolflags);
 		R_RunParticleEffect (pos, vec3_origin, 226, 20);
 		S_StartSound (-1, 0, cl_sfx_knighthit, pos, 1, 1);
 		break;
 
 	case TE_SPIKE:			// spike hitting wall
-		pos[0] = MSG_ReadCoord (cl.protocolflags);
-		pos[1] = MSG_ReadCoord (cl.protocolflags);
-		pos[2] = MSG_ReadCoord (cl.protocolflags);
 		R_RunParticleEffect (pos, vec3_origin, 0, 10);
 		if ( rand() % 5 )
 			S_StartSound (-1, 0, cl_sfx_tink1, pos, 1, 1);
@@ -159,9 +148,6 @@ void CL_ParseTEnt (void)
 		}
 		break;
 	case TE_SUPERSPIKE:			// super spike hitting wall
-		pos[0] = MSG_ReadCoord (cl.protocolflags);
-		pos[1] = MSG_ReadCoord (cl.protocolflags);
-		pos[2] = MSG_ReadCoord (cl.protocolflags);
 		R_RunParticleEffect (pos, vec3_origin, 0, 20);
 
 		if ( rand() % 5 )
@@ -179,16 +165,10 @@ void CL_ParseTEnt (void)
 		break;
 
 	case TE_GUNSHOT:			// bullet hitting wall
-		pos[0] = MSG_ReadCoord (cl.protocolflags);
-		pos[1] = MSG_ReadCoord (cl.protocolflags);
-		pos[2] = MSG_ReadCoord (cl.protocolflags);
 		R_RunParticleEffect (pos, vec3_origin, 0, 20);
 		break;
 
 	case TE_EXPLOSION:			// rocket explosion
-		pos[0] = MSG_ReadCoord (cl.protocolflags);
-		pos[1] = MSG_ReadCoord (cl.protocolflags);
-		pos[2] = MSG_ReadCoord (cl.protocolflags);
 		R_ParticleExplosion (pos);
 		dl = CL_AllocDlight (0);
 		VectorCopy (pos, dl->origin);
@@ -199,53 +179,39 @@ void CL_ParseTEnt (void)
 		break;
 
 	case TE_TAREXPLOSION:			// tarbaby explosion
-		pos[0] = MSG_ReadCoord (cl.protocolflags);
-		pos[1] = MSG_ReadCoord (cl.protocolflags);
-		pos[2] = MSG_ReadCoord (cl.protocolflags);
 		R_BlobExplosion (pos);
 
 		S_StartSound (-1, 0, cl_sfx_r_exp3, pos, 1, 1);
 		break;
 
 	case TE_LIGHTNING1:				// lightning bolts
-		CL_ParseBeam (Mod_ForName("progs/bolt.mdl", true));
+		CL_ParseBeam (&tent, Mod_ForName("progs/bolt.mdl", true));
 		break;
 
 	case TE_LIGHTNING2:				// lightning bolts
-		CL_ParseBeam (Mod_ForName("progs/bolt2.mdl", true));
+		CL_ParseBeam (&tent, Mod_ForName("progs/bolt2.mdl", true));
 		break;
 
 	case TE_LIGHTNING3:				// lightning bolts
-		CL_ParseBeam (Mod_ForName("progs/bolt3.mdl", true));
+		CL_ParseBeam (&tent, Mod_ForName("progs/bolt3.mdl", true));
 		break;
 
 // PGM 01/21/97
 	case TE_BEAM:				// grappling hook beam
-		CL_ParseBeam (Mod_ForName("progs/beam.mdl", true));
+		CL_ParseBeam (&tent, Mod_ForName("progs/beam.mdl", true));
 		break;
 // PGM 01/21/97
 
 	case TE_LAVASPLASH:
-		pos[0] = MSG_ReadCoord (cl.protocolflags);
-		pos[1] = MSG_ReadCoord (cl.protocolflags);
-		pos[2] = MSG_ReadCoord (cl.protocolflags);
 		R_LavaSplash (pos);
 		break;
 
 	case TE_TELEPORT:
-		pos[0] = MSG_ReadCoord (cl.protocolflags);
-		pos[1] = MSG_ReadCoord (cl.protocolflags);
-		pos[2] = MSG_ReadCoord (cl.protocolflags);
 		R_TeleportSplash (pos);
 		break;
 
 	case TE_EXPLOSION2:				// color mapped explosion
-		pos[0] = MSG_ReadCoord (cl.protocolflags);
-		pos[1] = MSG_ReadCoord (cl.protocolflags);
-		pos[2] = MSG_ReadCoord (cl.protocolflags);
-		colorStart = MSG_ReadByte ();
-		colorLength = MSG_ReadByte ();
-		R_ParticleExplosion2 (pos, colorStart, colorLength);
+		R_ParticleExplosion2 (pos, tent.colorstart, tent.colorlength);
 		dl = CL_AllocDlight (0);
 		VectorCopy (pos, dl->origin);
 		dl->radius = 350;
@@ -254,8 +220,6 @@ void CL_ParseTEnt (void)
 		S_StartSound (-1, 0, cl_sfx_r_exp3, pos, 1, 1);
 		break;
 
-	default:
-		Sys_Error ("CL_ParseTEnt: bad type");
 	}
 }
 
@@ -125,6 +125,11 @@ typedef struct
 	int		td_lastframe;		// to meter out one message a frame
 	int		td_startframe;		// host_framecount at start
 	float		td_starttime;		// realtime at second frame of timedemo
+	qboolean	td_norender;		// timedemo without screen updates
+	double		td_parsetime;		// seconds spent in client stages during timedemo
+	double		td_relinktime;
+	double		td_tenttime;
+	double		td_particletime;
 
 // connection information
 	int		signon;			// 0 to SIGNONS
@@ -340,6 +345,28 @@ void CL_Stop_f (void);
 void CL_Record_f (void);
 void CL_PlayDemo_f (void);
 void CL_TimeDemo_f (void);
+void CL_DemoSeek_f (void);
+double CL_TimeDemoStage (double *total, double start);
+
+extern	cvar_t	cl_demokeyframes;
+extern	cvar_t	cl_democompress;
+
+void CL_ClearDemoKeyframes (void);
+void CL_UpdateDemoKeyframes (void);
+qboolean CL_SeekDemo (double time, const char **error);
+
+// reading does not touch client state, so any thread may use its own reader
+typedef struct demoreader_s demoreader_t;
+
+demoreader_t *CL_DemoReaderOpen (FILE *file);
+void CL_DemoReaderClose (demoreader_t *reader);
+size_t CL_DemoRead (demoreader_t *reader, void *data, size_t size);
+qboolean CL_DemoReadTrack (demoreader_t *reader, int *track);
+
+//
+// cl_demoscan.c
+//
+void CL_DemoScan_f (void);
 
 //
 // cl_parse.c
@@ -347,6 +374,124 @@ void CL_TimeDemo_f (void);
 void CL_ParseServerMessage (void);
 void CL_NewTranslation (int slot);
 
+// svc_* payloads are decoded by the CL_Read* functions, which only touch
+// the reader, so the client and demoscan share one decoder for the protocol
+typedef struct svcreader_s
+{
+	msgreader_t		*msg;
+	int				protocol;
+	unsigned int	protocolflags;
+} svcreader_t;
+
+typedef struct
+{
+	int		protocol;
+	unsigned int	protocolflags;	// only sent by PROTOCOL_RMQ
+	int		maxclients;
+	int		gametype;
+	char	levelname[128];
+} serverinfo_t;
+
+typedef struct
+{
+	int		bits;		// U_* with the extension bytes merged in
+	int		num;
+	int		modelindex;	// a field is only valid if its bit is set
+	int		frame;
+	int		colormap;
+	int		skin;
+	int		effects;
+	vec3_t	origin;
+	vec3_t	angles;
+	int		alpha;		// U_ALPHA, or U_TRANS in the Nehahra protocol
+	int		scale;
+	int		frame2;		// upper 8 bits of frame and modelindex
+	int		model2;
+	int		lerpfinish;
+} entityupdate_t;
+
+typedef struct
+{
+	int		bits;
+	int		viewheight;
+	int		idealpitch;
+	int		punchangle[3];
+	int		velocity[3];
+	int		items;
+	int		weaponframe;	// stats have their upper 8 bits merged in
+	int		armor;
+	int		weapon;
+	int		health;
+	int		ammo;
+	int		ammocounts[4];	// shells, nails, rockets, cells
+	int		activeweapon;
+	int		weaponalpha;
+} clientdata_t;
+
+typedef struct
+{
+	int		entity;
+	int		channel;
+	int		sound;
+	int		volume;
+	float	attenuation;
+	vec3_t	origin;
+} soundpacket_t;
+
+typedef struct
+{
+	vec3_t	origin;
+	int		sound;
+	int		volume;
+	int		attenuation;
+} staticsound_t;
+
+typedef struct
+{
+	int		type;
+	int		entity;		// beams only
+	vec3_t	start;
+	vec3_t	end;		// beams only
+	int		colorstart;	// TE_EXPLOSION2 only
+	int		colorlength;
+} tempentity_t;
+
+typedef struct
+{
+	int		armor;
+	int		blood;
+	vec3_t	from;
+} damage_t;
+
+typedef struct
+{
+	vec3_t	origin;
+	vec3_t	dir;
+	int		count;
+	int		color;
+} particleeffect_t;
+
+typedef struct
+{
+	int		density;
+	int		red, green, blue;
+	int		time;	// in 1/100 seconds
+} fogupdate_t;
+
+svcreader_t *CL_ServerReader (void);
+void CL_ReadServerInfo (svcreader_t *reader, serverinfo_t *info);
+int CL_ReadPrecacheList (svcreader_t *reader, char (*names)[MAX_QPATH], int maxnames);
+void CL_ReadUpdate (svcreader_t *reader, int bits, entityupdate_t *update);
+void CL_ReadBaseline (svcreader_t *reader, int version, entity_state_t *baseline);
+void CL_ReadClientdata (svcreader_t *reader, clientdata_t *data);
+void CL_ReadSound (svcreader_t *reader, soundpacket_t *sound);
+int CL_ReadLocalSound (svcreader_t *reader);
+void CL_ReadStaticSound (svcreader_t *reader, int version, staticsound_t *sound);
+qboolean CL_ReadTEnt (svcreader_t *reader, tempentity_t *tent);
+void CL_ReadDamage (svcreader_t *reader, damage_t *damage);
+void CL_ReadParticleEffect (svcreader_t *reader, particleeffect_t *effect);
+void CL_ReadFog (svcreader_t *reader, fogupdate_t *fog);
+
 //
 // view
 //
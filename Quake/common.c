@@ -36,6 +36,7 @@ int		safemode;
 cvar_t	registered = {"registered","1",CVAR_ROM}; /* set to correct value in COM_CheckRegistered() */
 cvar_t	cmdline = {"cmdline","",CVAR_ROM/*|CVAR_SERVERINFO*/}; /* sending cmdline upon CCREQ_RULE_INFO is evil */
 cvar_t	allowloaderrors = {"allowloaderrors","0",0};
+static cvar_t	com_prefetch = {"com_prefetch","1",CVAR_ARCHIVE};
 
 static qboolean		com_modified;	// set true if using non-id files
 
@@ -865,171 +866,210 @@ void MSG_WriteAngle16 (sizebuf_t *sb, float f, unsigned int flags)
 //
 // reading functions
 //
-int		msg_readcount;
-qboolean	msg_badread;
+// every reader keeps its own position, so a message that isn't net_message
+// can be decoded on any thread. The MSG_Read* functions use net_reader.
+//
+msgreader_t	net_reader = {&net_message};
 
-void MSG_BeginReading (void)
+void MSGR_BeginReading (msgreader_t *msg, sizebuf_t *buf)
 {
-	msg_readcount = 0;
-	msg_badread = false;
+	msg->buf = buf;
+	msg->readcount = 0;
+	msg->badread = false;
 }
 
-// returns -1 and sets msg_badread if no more characters are available
-int MSG_ReadChar (void)
+// returns -1 and sets msg->badread if no more characters are available
+int MSGR_ReadChar (msgreader_t *msg)
 {
 	int	c;
 
-	if (msg_readcount+1 > net_message.cursize)
+	if (msg->readcount+1 > msg->buf->cursize)
 	{
-		msg_badread = true;
+		msg->badread = true;
 		return -1;
 	}
 
-	c = (signed char)net_message.data[msg_readcount];
-	msg_readcount++;
+	c = (signed char)msg->buf->data[msg->readcount];
+	msg->readcount++;
 
 	return c;
 }
 
-int MSG_ReadByte (void)
+int MSGR_ReadByte (msgreader_t *msg)
 {
 	int	c;
 
-	if (msg_readcount+1 > net_message.cursize)
+	if (msg->readcount+1 > msg->buf->cursize)
 	{
-		msg_badread = true;
+		msg->badread = true;
 		return -1;
 	}
 
-	c = (unsigned char)net_message.data[msg_readcount];
-	msg_readcount++;
+	c = (unsigned char)msg->buf->data[msg->readcount];
+	msg->readcount++;
 
 	return c;
 }
 
-int MSG_ReadShort (void)
+int MSGR_ReadShort (msgreader_t *msg)
 {
 	int	c;
 
-	if (msg_readcount+2 > net_message.cursize)
+	if (msg->readcount+2 > msg->buf->cursize)
 	{
-		msg_badread = true;
+		msg->badread = true;
 		return -1;
 	}
 
-	c = (short)(net_message.data[msg_readcount]
-			+ (net_message.data[msg_readcount+1]<<8));
+	c = (short)(msg->buf->data[msg->readcount]
+			+ (msg->buf->data[msg->readcount+1]<<8));
 
-	msg_readcount += 2;
+	msg->readcount += 2;
 
 	return c;
 }
 
-int MSG_ReadLong (void)
+int MSGR_ReadLong (msgreader_t *msg)
 {
 	int	c;
 
-	if (msg_readcount+4 > net_message.cursize)
+	if (msg->readcount+4 > msg->buf->cursize)
 	{
-		msg_badread = true;
+		msg->badread = true;
 		return -1;
 	}
 
-	c = net_message.data[msg_readcount]
-			+ (net_message.data[msg_readcount+1]<<8)
-			+ (net_message.data[msg_readcount+2]<<16)
-			+ (net_message.data[msg_readcount+3]<<24);
+	c = msg->buf->data[msg->readcount]
+			+ (msg->buf->data[msg->readcount+1]<<8)
+			+ (msg->buf->data[msg->readcount+2]<<16)
+			+ (msg->buf->data[msg->readcount+3]<<24);
 
-	msg_readcount += 4;
+	msg->readcount += 4;
 
 	return c;
 }
 
-float MSG_ReadFloat (void)
+float MSGR_ReadFloat (msgreader_t *msg)
 {
 	union
 	{
-		byte	b[4];
 		float	f;
 		int	l;
 	} dat;
 
-	dat.b[0] = net_message.data[msg_readcount];
-	dat.b[1] = net_message.data[msg_readcount+1];
-	dat.b[2] = net_message.data[msg_readcount+2];
-	dat.b[3] = net_message.data[msg_readcount+3];
-	msg_readcount += 4;
-
-	dat.l = LittleLong (dat.l);
+	dat.l = MSGR_ReadLong (msg);	// assembled in host order
 
 	return dat.f;
 }
 
-const char *MSG_ReadString (void)
+const char *MSGR_ReadString (msgreader_t *msg)
 {
-	static char	string[2048];
 	int		c;
 	size_t		l;
 
 	l = 0;
 	do
 	{
-		c = MSG_ReadByte ();
+		c = MSGR_ReadByte (msg);
 		if (c == -1 || c == 0)
 			break;
-		string[l] = c;
+		msg->string[l] = c;
 		l++;
-	} while (l < sizeof(string) - 1);
+	} while (l < sizeof(msg->string) - 1);
 
-	string[l] = 0;
+	msg->string[l] = 0;
 
-	return string;
+	return msg->string;
 }
 
 //johnfitz -- original behavior, 13.3 fixed point coords, max range +-4096
-float MSG_ReadCoord16 (void)
+static float MSGR_ReadCoord16 (msgreader_t *msg)
 {
-	return MSG_ReadShort() * (1.0/8);
+	return MSGR_ReadShort(msg) * (1.0/8);
 }
 
 //johnfitz -- 16.8 fixed point coords, max range +-32768
-float MSG_ReadCoord24 (void)
-{
-	return MSG_ReadShort() + MSG_ReadByte() * (1.0/255);
-}
-
-//johnfitz -- 32-bit float coords
-float MSG_ReadCoord32f (void)
+static float MSGR_ReadCoord24 (msgreader_t *msg)
 {
-	return MSG_ReadFloat();
+	return MSGR_ReadShort(msg) + MSGR_ReadByte(msg) * (1.0/255);
 }
 
-float MSG_ReadCoord (unsigned int flags)
+float MSGR_ReadCoord (msgreader_t *msg, unsigned int flags)
 {
 	if (flags & PRFL_FLOATCOORD)
-		return MSG_ReadFloat ();
+		return MSGR_ReadFloat (msg);
 	else if (flags & PRFL_INT32COORD)
-		return MSG_ReadLong () * (1.0 / 16.0);
+		return MSGR_ReadLong (msg) * (1.0 / 16.0);
 	else if (flags & PRFL_24BITCOORD)
-		return MSG_ReadCoord24 ();
-	else return MSG_ReadCoord16 ();
+		return MSGR_ReadCoord24 (msg);
+	else return MSGR_ReadCoord16 (msg);
 }
 
-float MSG_ReadAngle (unsigned int flags)
+float MSGR_ReadAngle (msgreader_t *msg, unsigned int flags)
 {
 	if (flags & PRFL_FLOATANGLE)
-		return MSG_ReadFloat ();
+		return MSGR_ReadFloat (msg);
 	else if (flags & PRFL_SHORTANGLE)
-		return MSG_ReadShort () * (360.0 / 65536);
-	else return MSG_ReadChar () * (360.0 / 256);
+		return MSGR_ReadShort (msg) * (360.0 / 65536);
+	else return MSGR_ReadChar (msg) * (360.0 / 256);
 }
 
 //johnfitz -- for PROTOCOL_FITZQUAKE
-float MSG_ReadAngle16 (unsigned int flags)
+float MSGR_ReadAngle16 (msgreader_t *msg, unsigned int flags)
 {
 	if (flags & PRFL_FLOATANGLE)
-		return MSG_ReadFloat ();	// make sure
-	else return MSG_ReadShort () * (360.0 / 65536);
+		return MSGR_ReadFloat (msg);	// make sure
+	else return MSGR_ReadShort (msg) * (360.0 / 65536);
+}
+
+void MSG_BeginReading (void)
+{
+	MSGR_BeginReading (&net_reader, &net_message);
+}
+
+int MSG_ReadChar (void)
+{
+	return MSGR_ReadChar (&net_reader);
+}
+
+int MSG_ReadByte (void)
+{
+	return MSGR_ReadByte (&net_reader);
+}
+
+int MSG_ReadShort (void)
+{
+	return MSGR_ReadShort (&net_reader);
+}
+
+int MSG_ReadLong (void)
+{
+	return MSGR_ReadLong (&net_reader);
+}
+
+float MSG_ReadFloat (void)
+{
+	return MSGR_ReadFloat (&net_reader);
+}
+
+const char *MSG_ReadString (void)
+{
+	return MSGR_ReadString (&net_reader);
+}
+
+float MSG_ReadCoord (unsigned int flags)
+{
+	return MSGR_ReadCoord (&net_reader, flags);
+}
+
+float MSG_ReadAngle (unsigned int flags)
+{
+	return MSGR_ReadAngle (&net_reader, flags);
+}
+
+float MSG_ReadAngle16 (unsigned int flags)
+{
+	return MSGR_ReadAngle16 (&net_reader, flags);
 }
 //johnfitz
 
@@ -1453,6 +1493,7 @@ static void COM_CheckRegistered (void)
 
 	Cvar_SetROM ("cmdline", &com_cmdline[i]);
 	Cvar_SetROM ("registered", "1");
+	COM_InvalidateLooseFiles ();	// names with paths were skipped until now
 	Con_Printf ("Playing registered version.\n");
 }
 
@@ -1633,10 +1674,662 @@ typedef struct
 char	com_gamedir[MAX_OSPATH];
 char	com_basedir[MAX_OSPATH];
 int	file_from_pak;		// ZOID: global indicating that file came from a pak
+static int	com_fileofs;	// of the last file found, inside its pak or 0
+static qboolean	com_nomapfiles;	// -nomapfiles, always read through COM_MapFile
 
 searchpath_t	*com_searchpaths;
 searchpath_t	*com_base_searchpaths;
 
+/*
+==============================================================================
+
+PK3 FILES
+
+Pk3 entries look like pak entries, stored ones are read the same way once
+filepos has been moved past their local header. Deflated ones are inflated
+into a small cache, and handed out as a copy.
+
+==============================================================================
+*/
+
+#define ZIPCACHE_ENTRIES	8
+#define ZIPCACHE_SIZE		(8 * 1024 * 1024)	// the newest entry is kept even if larger
+
+static struct
+{
+	packfile_t	*file;
+	byte		*data;
+	int			used;		// zipcache_sequence when last used
+} zipcache[ZIPCACHE_ENTRIES];
+
+static int	zipcache_size;
+static int	zipcache_sequence;
+
+static void COM_ClearZipCache (void)
+{
+	int	i;
+
+	for (i = 0; i < ZIPCACHE_ENTRIES; i++)
+		free (zipcache[i].data);
+
+	memset (zipcache, 0, sizeof(zipcache));
+	zipcache_size = 0;
+}
+
+// frees the least recently used entry, returns its slot or -1 if empty
+static int COM_ZipCacheEvict (void)
+{
+	int	i, slot;
+
+	for (i = 0, slot = -1; i < ZIPCACHE_ENTRIES; i++)
+	{
+		if (zipcache[i].file && (slot == -1 || zipcache[i].used < zipcache[slot].used))
+			slot = i;
+	}
+
+	if (slot != -1)
+	{
+		zipcache_size -= zipcache[slot].file->filelen;
+		free (zipcache[slot].data);
+		zipcache[slot].file = NULL;
+		zipcache[slot].data = NULL;
+	}
+
+	return slot;
+}
+
+/*
+============
+COM_ZipDataOffset
+
+Moves filepos from the local header to the data
+============
+*/
+static qboolean COM_ZipDataOffset (pack_t *pak, packfile_t *file)
+{
+	byte	header[30];
+
+	Sys_FileSeek (pak->handle, file->filepos);
+	if (Sys_FileRead (pak->handle, header, sizeof(header)) != (int) sizeof(header) ||
+	    header[0] != 'P' || header[1] != 'K' || header[2] != 3 || header[3] != 4)
+	{
+		Con_Printf ("%s: bad local header for %s\n", pak->filename, file->name);
+		return false;
+	}
+
+	file->filepos += sizeof(header) + (header[26] | (header[27] << 8)) + (header[28] | (header[29] << 8));
+	file->zipheader = false;
+	return true;
+}
+
+/*
+============
+COM_Inflate
+
+Inflates raw deflate data into out, which takes exactly outlen bytes.
+Touches no shared state, so it can be called from any thread.
+============
+*/
+qboolean COM_Inflate (const byte *in, int inlen, byte *out, int outlen)
+{
+	tinfl_decompressor	*inflator;
+	tinfl_status	status;
+	size_t	insize = inlen, outsize = outlen;
+
+	inflator = (tinfl_decompressor *) malloc (sizeof(tinfl_decompressor));
+	if (!inflator)
+		return false;
+
+	tinfl_init (inflator);
+	status = tinfl_decompress (inflator, in, &insize, out, out, &outsize, TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+	free (inflator);
+
+	return status == TINFL_STATUS_DONE && outsize == (size_t) outlen;
+}
+
+/*
+============
+COM_InflateZipFile
+
+Returns the inflated data with a 0 byte appended, owned by the cache and only
+valid until the next call
+============
+*/
+static byte *COM_InflateZipFile (pack_t *pak, packfile_t *file)
+{
+	byte	*in, *out;
+	void	*mapping = NULL;
+	size_t	mapsize;
+	qboolean	ok;
+	int		slot;
+
+	for (slot = 0; slot < ZIPCACHE_ENTRIES; slot++)
+	{
+		if (zipcache[slot].file == file)
+		{
+			zipcache[slot].used = ++zipcache_sequence;
+			return zipcache[slot].data;
+		}
+	}
+
+	in = NULL;
+	if (!com_nomapfiles)
+		in = (byte *) Sys_FileMap (pak->handle, file->filepos, file->zipsize, &mapping, &mapsize);
+	if (!in)
+	{
+		in = (byte *) malloc (file->zipsize);
+		if (!in)
+			Sys_Error ("COM_InflateZipFile: not enough space for %s", file->name);
+		Sys_FileSeek (pak->handle, file->filepos);
+		if (Sys_FileRead (pak->handle, in, file->zipsize) != file->zipsize)
+			memset (in, 0, file->zipsize);	// fails below
+	}
+
+	out = (byte *) malloc (file->filelen + 1);
+	if (!out)
+		Sys_Error ("COM_InflateZipFile: not enough space for %s", file->name);
+
+	ok = COM_Inflate (in, file->zipsize, out, file->filelen);
+
+	if (mapping)
+		Sys_FileUnmap (mapping, mapsize);
+	else
+		free (in);
+
+	if (!ok)
+	{
+		Con_Printf ("%s: couldn't inflate %s\n", pak->filename, file->name);
+		free (out);
+		return NULL;
+	}
+	out[file->filelen] = 0;
+
+	while (zipcache_size + file->filelen > ZIPCACHE_SIZE && COM_ZipCacheEvict () != -1)
+		;
+	for (slot = 0; slot < ZIPCACHE_ENTRIES && zipcache[slot].file; slot++)
+		;
+	if (slot == ZIPCACHE_ENTRIES)
+		slot = COM_ZipCacheEvict ();
+
+	zipcache[slot].file = file;
+	zipcache[slot].data = out;
+	zipcache[slot].used = ++zipcache_sequence;
+	zipcache_size += file->filelen;
+
+	return out;
+}
+
+/*
+==============================================================================
+
+FILE INDEX
+
+Every name that is looked up gets one entry, telling which search path it is
+read from. Pack entries are added in one go when the search paths change,
+loose files are only checked for on the first lookup of a name and then kept
+until COM_InvalidateLooseFiles. That happens whenever the engine writes to a
+game directory and on every map load. Files added from outside the engine
+in between are only seen after "path_rescan".
+
+==============================================================================
+*/
+
+typedef struct fileentry_s
+{
+	const char			*name;
+	searchpath_t		*pack;		// highest priority pack holding the name, or NULL
+	int					index;		// into pack->pack->files
+	searchpath_t		*search;	// where the file is read from, NULL if nowhere
+	int					generation;	// of the loose file check that set search
+	int					tracestamp;	// com_filetrace.stamp once in the trace
+	struct fileentry_s	*next;
+} fileentry_t;
+
+static struct
+{
+	qboolean	valid;
+	fileentry_t	**buckets;
+	int			numbuckets;		// power of two
+	fileentry_t	*packentries;	// one block for every pack entry
+	int			numentries;
+	int			generation;		// bumped when loose files may have changed
+
+	double		buildtime;
+	int			lookups;
+	int			loosechecks;
+	double		looktime;
+} com_fileindex;
+
+/*
+============
+COM_ClearFileIndex
+
+Called whenever the search paths change
+============
+*/
+static void COM_ClearFileIndex (void)
+{
+	fileentry_t	*e, *next;
+	int		i;
+
+	for (i = 0; i < com_fileindex.numbuckets; i++)
+	{
+		for (e = com_fileindex.buckets[i]; e; e = next)
+		{
+			next = e->next;
+			if (!e->pack)
+				free (e);	// made by a lookup, not part of packentries
+		}
+	}
+
+	free (com_fileindex.buckets);
+	free (com_fileindex.packentries);
+	COM_ClearZipCache ();	// points into the packs
+	com_fileindex.buckets = NULL;
+	com_fileindex.packentries = NULL;
+	com_fileindex.numbuckets = 0;
+	com_fileindex.numentries = 0;
+	com_fileindex.valid = false;
+}
+
+/*
+============
+COM_InvalidateLooseFiles
+============
+*/
+void COM_InvalidateLooseFiles (void)
+{
+	com_fileindex.generation++;
+}
+
+static fileentry_t *COM_FileIndexFind (const char *name, unsigned hash)
+{
+	fileentry_t	*e;
+
+	for (e = com_fileindex.buckets[hash & (com_fileindex.numbuckets - 1)]; e; e = e->next)
+		if (!strcmp (e->name, name))
+			return e;
+
+	return NULL;
+}
+
+static void COM_FileIndexInsert (fileentry_t *e, unsigned hash)
+{
+	fileentry_t	**bucket = &com_fileindex.buckets[hash & (com_fileindex.numbuckets - 1)];
+
+	e->generation = com_fileindex.generation - 1;	// not checked for loose files yet
+	e->tracestamp = 0;
+	e->next = *bucket;
+	*bucket = e;
+	com_fileindex.numentries++;
+}
+
+/*
+============
+COM_BuildFileIndex
+============
+*/
+static void COM_BuildFileIndex (void)
+{
+	searchpath_t	*search;
+	fileentry_t		*e;
+	double		time = Sys_DoubleTime ();
+	unsigned	hash;
+	int		i, count;
+
+	COM_ClearFileIndex ();
+
+	count = 0;
+	for (search = com_searchpaths; search; search = search->next)
+		if (search->pack)
+			count += search->pack->numfiles;
+
+	com_fileindex.numbuckets = 1024;
+	while (com_fileindex.numbuckets < count * 2)
+		com_fileindex.numbuckets <<= 1;
+
+	com_fileindex.buckets = (fileentry_t **) calloc (com_fileindex.numbuckets, sizeof(fileentry_t *));
+	com_fileindex.packentries = (fileentry_t *) malloc (q_max (count, 1) * sizeof(fileentry_t));
+	if (!com_fileindex.buckets || !com_fileindex.packentries)
+		Sys_Error ("COM_BuildFileIndex: out of memory");
+
+	// higher priority paths come first, so a name already in the index wins
+	e = com_fileindex.packentries;
+	for (search = com_searchpaths; search; search = search->next)
+	{
+		if (!search->pack)
+			continue;
+
+		for (i = 0; i < search->pack->numfiles; i++)
+		{
+			hash = COM_HashString (search->pack->files[i].name);
+			if (COM_FileIndexFind (search->pack->files[i].name, hash))
+				continue;
+
+			e->name = search->pack->files[i].name;
+			e->pack = search;
+			e->index = i;
+			COM_FileIndexInsert (e++, hash);
+		}
+	}
+
+	com_fileindex.valid = true;
+	com_fileindex.buildtime = Sys_DoubleTime () - time;
+}
+
+/*
+============
+COM_FileIndexLookup
+
+Never returns NULL, entry->search is NULL if the file doesn't exist
+============
+*/
+static fileentry_t *COM_FileIndexLookup (const char *filename)
+{
+	searchpath_t	*search;
+	fileentry_t		*e;
+	char		netpath[MAX_OSPATH];
+	unsigned	hash;
+	size_t		len;
+
+	if (!com_fileindex.valid)
+		COM_BuildFileIndex ();
+
+	com_fileindex.lookups++;
+
+	hash = COM_HashString (filename);
+	e = COM_FileIndexFind (filename, hash);
+	if (!e)
+	{
+		len = strlen (filename) + 1;
+		e = (fileentry_t *) malloc (sizeof(fileentry_t) + len);
+		if (!e)
+			Sys_Error ("COM_FileIndexLookup: out of memory");
+		memcpy (e + 1, filename, len);
+		e->name = (const char *) (e + 1);
+		e->pack = NULL;
+		e->index = -1;
+		COM_FileIndexInsert (e, hash);
+	}
+
+	if (e->generation == com_fileindex.generation)
+		return e;
+
+	// only directories ahead of the pack can override it
+	for (search = com_searchpaths; search; search = search->next)
+	{
+		if (search == e->pack)
+			break;
+		if (search->pack)
+			continue;
+
+		if (!registered.value)
+		{ /* if not a registered version, don't ever go beyond base */
+			if ( strchr (filename, '/') || strchr (filename,'\\'))
+				continue;
+		}
+
+		com_fileindex.loosechecks++;
+		q_snprintf (netpath, sizeof(netpath), "%s/%s",search->filename, filename);
+		if (Sys_FileType(netpath) & FS_ENT_FILE)
+			break;
+	}
+
+	e->search = search;
+	e->generation = com_fileindex.generation;
+	return e;
+}
+
+/*
+==============================================================================
+
+FILE TRACES
+
+Every file found while a map loads is written to traces/<map>.txt in the game
+directory. When the same map is loaded again, a thread reads the files from
+the last trace ahead of the loader, so that they are in the OS file cache by
+the time they are needed.
+
+==============================================================================
+*/
+
+#define PREFETCH_CHUNK	65536
+
+typedef struct
+{
+	char	path[MAX_OSPATH];	// pak or loose file
+	int		offset;
+	int		length;				// -1 for the whole file
+} prefetchitem_t;
+
+static struct
+{
+	qboolean	active;
+	char		name[MAX_QPATH];
+	int			stamp;			// bumped for every trace
+	char		(*files)[MAX_QPATH];
+	int			numfiles, maxfiles;
+	double		starttime;
+	double		lasttime;		// load time when the old trace was written, 0 if none
+
+	prefetchitem_t	*items;
+	int			numitems;
+	SDL_Thread	*thread;
+	SDL_atomic_t	cancel;
+	SDL_atomic_t	prefetched;	// items done by the thread
+	SDL_atomic_t	prefetchkb;
+} com_filetrace;
+
+static void COM_TraceFile (fileentry_t *e)
+{
+	if (!com_filetrace.active || e->tracestamp == com_filetrace.stamp)
+		return;
+	e->tracestamp = com_filetrace.stamp;
+
+	if (com_filetrace.numfiles == com_filetrace.maxfiles)
+	{
+		com_filetrace.maxfiles = q_max (com_filetrace.maxfiles * 2, 256);
+		com_filetrace.files = (char (*)[MAX_QPATH]) realloc (com_filetrace.files, com_filetrace.maxfiles * MAX_QPATH);
+		if (!com_filetrace.files)
+			Sys_Error ("COM_TraceFile: out of memory");
+	}
+
+	q_strlcpy (com_filetrace.files[com_filetrace.numfiles++], e->name, MAX_QPATH);
+}
+
+static int SDLCALL COM_PrefetchThread (void *data)
+{
+	prefetchitem_t	*item;
+	const char	*current = NULL;
+	FILE	*f = NULL;
+	byte	*buffer;
+	int		i, left, count, bytes;
+
+	buffer = (byte *) malloc (PREFETCH_CHUNK);
+	if (!buffer)
+		return 0;
+
+	for (i = 0, item = com_filetrace.items; i < com_filetrace.numitems; i++, item++)
+	{
+		if (SDL_AtomicGet (&com_filetrace.cancel))
+			break;
+
+		// consecutive items are often in the same pak
+		if (!current || strcmp (current, item->path))
+		{
+			if (f)
+				fclose (f);
+			f = fopen (item->path, "rb");
+			current = item->path;
+		}
+		if (!f)
+			continue;
+
+		fseek (f, item->offset, SEEK_SET);
+		for (left = item->length, bytes = 0; left && !SDL_AtomicGet (&com_filetrace.cancel); )
+		{
+			count = (left < 0) ? PREFETCH_CHUNK : q_min (left, PREFETCH_CHUNK);
+			count = (int) fread (buffer, 1, count, f);
+			if (count <= 0)
+				break;
+			if (left > 0)
+				left -= count;
+			bytes += count;
+		}
+
+		SDL_AtomicAdd (&com_filetrace.prefetched, 1);
+		SDL_AtomicAdd (&com_filetrace.prefetchkb, bytes >> 10);
+	}
+
+	if (f)
+		fclose (f);
+	free (buffer);
+	return 0;
+}
+
+// where the loader will find name, the lookups also warm the file index
+static qboolean COM_PrefetchItem (const char *name, prefetchitem_t *item)
+{
+	fileentry_t	*e = COM_FileIndexLookup (name);
+	packfile_t	*pf;
+
+	if (!e->search)
+		return false;
+
+	if (e->search->pack)
+	{
+		pf = &e->search->pack->files[e->index];
+		if (pf->zipheader && !COM_ZipDataOffset (e->search->pack, pf))
+			return false;
+		q_strlcpy (item->path, e->search->pack->filename, sizeof(item->path));
+		item->offset = pf->filepos;
+		item->length = pf->zipsize ? pf->zipsize : pf->filelen;
+	}
+	else
+	{
+		q_snprintf (item->path, sizeof(item->path), "%s/%s", e->search->filename, name);
+		item->offset = 0;
+		item->length = -1;
+	}
+
+	return true;
+}
+
+/*
+============
+COM_BeginFileTrace
+
+Called when a map starts loading
+============
+*/
+void COM_BeginFileTrace (const char *name)
+{
+	char	path[MAX_OSPATH], line[MAX_QPATH + 16];
+	FILE	*f;
+	int		len, count;
+
+	COM_EndFileTrace (false);
+
+	if (!com_prefetch.value)
+		return;
+
+	com_filetrace.active = true;
+	com_filetrace.stamp++;
+	q_strlcpy (com_filetrace.name, name, sizeof(com_filetrace.name));
+	com_filetrace.numfiles = 0;
+	com_filetrace.lasttime = 0;
+	com_filetrace.starttime = Sys_DoubleTime ();
+
+	q_snprintf (path, sizeof(path), "%s/traces/%s.txt", com_gamedir, name);
+	f = fopen (path, "r");
+	if (!f)
+		return;
+
+	count = 0;
+	while (fgets (line, sizeof(line), f))
+	{
+		len = strlen (line);
+		while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+			line[--len] = 0;
+
+		if (!count++ && sscanf (line, "time %lf", &com_filetrace.lasttime) == 1)
+			continue;
+		if (!len)
+			continue;
+
+		com_filetrace.items = (prefetchitem_t *) realloc (com_filetrace.items, (com_filetrace.numitems + 1) * sizeof(prefetchitem_t));
+		if (!com_filetrace.items)
+			Sys_Error ("COM_BeginFileTrace: out of memory");
+		if (COM_PrefetchItem (line, &com_filetrace.items[com_filetrace.numitems]))
+			com_filetrace.numitems++;
+	}
+	fclose (f);
+
+	SDL_AtomicSet (&com_filetrace.cancel, 0);
+	SDL_AtomicSet (&com_filetrace.prefetched, 0);
+	SDL_AtomicSet (&com_filetrace.prefetchkb, 0);
+	if (com_filetrace.numitems)
+		com_filetrace.thread = SDL_CreateThread (COM_PrefetchThread, "Prefetch", NULL);
+}
+
+/*
+============
+COM_EndFileTrace
+
+Called when the map has finished loading, or with save false when the load
+was abandoned
+============
+*/
+void COM_EndFileTrace (qboolean save)
+{
+	char	path[MAX_OSPATH];
+	double	time;
+	FILE	*f;
+	int		i;
+
+	if (!com_filetrace.active)
+		return;
+	com_filetrace.active = false;
+
+	// whatever it hasn't read by now is no longer needed
+	if (com_filetrace.thread)
+	{
+		SDL_AtomicSet (&com_filetrace.cancel, 1);
+		SDL_WaitThread (com_filetrace.thread, NULL);
+		com_filetrace.thread = NULL;
+	}
+
+	time = (Sys_DoubleTime () - com_filetrace.starttime) * 1000.0;
+
+	if (save)
+	{
+		if (com_filetrace.lasttime)
+			Con_DPrintf ("%s loaded in %.0f ms (%.0f ms last time), prefetched %i of %i files, %i KB\n",
+				com_filetrace.name, time, com_filetrace.lasttime,
+				SDL_AtomicGet (&com_filetrace.prefetched), com_filetrace.numitems,
+				SDL_AtomicGet (&com_filetrace.prefetchkb));
+		else
+			Con_DPrintf ("%s loaded in %.0f ms, no trace to prefetch from\n", com_filetrace.name, time);
+
+		Sys_mkdir (com_gamedir);
+		q_snprintf (path, sizeof(path), "%s/traces", com_gamedir);
+		Sys_mkdir (path);
+		q_snprintf (path, sizeof(path), "%s/traces/%s.txt", com_gamedir, com_filetrace.name);
+		f = fopen (path, "w");
+		if (f)
+		{
+			fprintf (f, "time %.1f\n", time);
+			for (i = 0; i < com_filetrace.numfiles; i++)
+				fprintf (f, "%s\n", com_filetrace.files[i]);
+			fclose (f);
+		}
+	}
+
+	free (com_filetrace.items);
+	com_filetrace.items = NULL;
+	com_filetrace.numitems = 0;
+}
+
 /*
 ============
 COM_Path_f
@@ -1656,6 +2349,9 @@ static void COM_Path_f (void)
 		else
 			Con_Printf ("%s\n", s->filename);
 	}
+
+	Con_Printf ("File index: %i names, built in %.2f ms\n", com_fileindex.numentries, com_fileindex.buildtime * 1000.0);
+	Con_Printf ("%i lookups, %i loose file checks, %.2f ms\n", com_fileindex.lookups, com_fileindex.loosechecks, com_fileindex.looktime * 1000.0);
 }
 
 /*
@@ -1684,6 +2380,7 @@ void COM_WriteFile (const char *filename, const void *data, int len)
 	Sys_Printf ("COM_WriteFile: %s\n", name);
 	Sys_FileWrite (handle, data, len);
 	Sys_FileClose (handle);
+	COM_InvalidateLooseFiles ();
 }
 
 /*
@@ -1731,14 +2428,20 @@ Finds the file in the search path.
 Sets com_filesize and one of handle or file
 If neither of file or handle is set, this
 can be used for detecting a file's presence.
+If zipdata is set, deflated pk3 entries are
+returned there instead of through a temp file.
 ===========
 */
 static int COM_FindFile (const char *filename, int *handle, FILE **file,
-							unsigned int *path_id)
+							unsigned int *path_id, byte **zipdata)
 {
 	searchpath_t	*search;
+	fileentry_t	*entry;
+	packfile_t	*pf;
 	char		netpath[MAX_OSPATH];
 	pack_t		*pak;
+	byte		*data = NULL;
+	double		time;
 	int		i;
 
 	if (file && handle)
@@ -1746,72 +2449,105 @@ static int COM_FindFile (const char *filename, int *handle, FILE **file,
 
 	file_from_pak = 0;
 
-//
-// search through the path, one element at a time
-//
-	for (search = com_searchpaths; search; search = search->next)
+	time = Sys_DoubleTime ();
+	entry = COM_FileIndexLookup (filename);
+	com_fileindex.looktime += Sys_DoubleTime () - time;
+
+	if (entry->search)
+		COM_TraceFile (entry);
+
+	search = entry->search;
+	if (search && search->pack && (handle || file))
 	{
-		if (search->pack)	/* look through all the pak file elements */
+		pf = &search->pack->files[entry->index];
+		if (pf->zipheader && !COM_ZipDataOffset (search->pack, pf))
+			search = NULL;
+		else if (pf->zipsize && !(data = COM_InflateZipFile (search->pack, pf)))
+			search = NULL;
+	}
+
+	if (search && search->pack)
+	{
+		pak = search->pack;
+		i = entry->index;
+		com_filesize = pak->files[i].filelen;
+		com_fileofs = pak->files[i].filepos;
+		file_from_pak = 1;
+		if (path_id)
+			*path_id = search->path_id;
+		if (data)	/* deflated pk3 entry */
 		{
-			pak = search->pack;
-			for (i = 0; i < pak->numfiles; i++)
+			com_fileofs = 0;
+			if (zipdata)
 			{
-				if (strcmp(pak->files[i].name, filename) != 0)
-					continue;
-				// found it!
-				com_filesize = pak->files[i].filelen;
-				file_from_pak = 1;
-				if (path_id)
-					*path_id = search->path_id;
+				*zipdata = data;
 				if (handle)
+					*handle = -1;
+			}
+			else if (handle)
+			{
+				*handle = Sys_FileOpenTemp ();
+				if (*handle == -1)
+					com_filesize = -1;
+				else
 				{
-					*handle = pak->handle;
-					Sys_FileSeek (pak->handle, pak->files[i].filepos);
-					return com_filesize;
+					Sys_FileWrite (*handle, data, com_filesize);
+					Sys_FileSeek (*handle, 0);
 				}
-				else if (file)
-				{ /* open a new file on the pakfile */
-					*file = fopen (pak->filename, "rb");
-					if (*file)
-						fseek (*file, pak->files[i].filepos, SEEK_SET);
-					return com_filesize;
-				}
-				else /* for COM_FileExists() */
+			}
+			else
+			{
+				*file = tmpfile ();
+				if (*file == NULL)
+					com_filesize = -1;
+				else
 				{
-					return com_filesize;
+					fwrite (data, 1, com_filesize, *file);
+					rewind (*file);
 				}
 			}
+			return com_filesize;
 		}
-		else	/* check a file in the directory tree */
+		if (handle)
 		{
-			if (!registered.value)
-			{ /* if not a registered version, don't ever go beyond base */
-				if ( strchr (filename, '/') || strchr (filename,'\\'))
-					continue;
-			}
-
-			q_snprintf (netpath, sizeof(netpath), "%s/%s",search->filename, filename);
-			if (! (Sys_FileType(netpath) & FS_ENT_FILE))
-				continue;
+			*handle = pak->handle;
+			Sys_FileSeek (pak->handle, pak->files[i].filepos);
+			return com_filesize;
+		}
+		else if (file)
+		{ /* open a new file on the pakfile */
+			*file = fopen (pak->filename, "rb");
+			if (*file)
+				fseek (*file, pak->files[i].filepos, SEEK_SET);
+			return com_filesize;
+		}
+		else /* for COM_FileExists() */
+		{
+			return com_filesize;
+		}
+	}
+	else if (search)	/* a file in the directory tree */
+	{
+		q_snprintf (netpath, sizeof(netpath), "%s/%s",search->filename, filename);
+		com_fileofs = 0;
 
-			if (path_id)
-				*path_id = search->path_id;
-			if (handle)
-			{
-				com_filesize = Sys_FileOpenRead (netpath, &i);
-				*handle = i;
-				return com_filesize;
-			}
-			else if (file)
-			{
-				*file = fopen (netpath, "rb");
-				com_filesize = (*file == NULL) ? -1 : COM_filelength (*file);
-				return com_filesize;
-			}
-			else
-			{
-				return 0; /* dummy valid value for COM_FileExists() */
-			}
+		if (path_id)
+			*path_id = search->path_id;
+		if (handle)
+		{
+			com_filesize = Sys_FileOpenRead (netpath, &i);
+			*handle = i;
+			return com_filesize;
+		}
+		else if (file)
+		{
+			*file = fopen (netpath, "rb");
+			com_filesize = (*file == NULL) ? -1 : COM_filelength (*file);
+			return com_filesize;
+		}
+		else
+		{
+			return 0; /* dummy valid value for COM_FileExists() */
 		}
 	}
 
@@ -1841,7 +2577,7 @@ Returns whether the file is found in the quake filesystem.
 */
 qboolean COM_FileExists (const char *filename, unsigned int *path_id)
 {
-	int ret = COM_FindFile (filename, NULL, NULL, path_id);
+	int ret = COM_FindFile (filename, NULL, NULL, path_id, NULL);
 	return (ret == -1) ? false : true;
 }
 
@@ -1856,7 +2592,7 @@ it may actually be inside a pak file
 */
 int COM_OpenFile (const char *filename, int *handle, unsigned int *path_id)
 {
-	return COM_FindFile (filename, handle, NULL, path_id);
+	return COM_FindFile (filename, handle, NULL, path_id, NULL);
 }
 
 /*
@@ -1869,7 +2605,7 @@ into the file.
 */
 int COM_FOpenFile (const char *filename, FILE **file, unsigned int *path_id)
 {
-	return COM_FindFile (filename, NULL, file, path_id);
+	return COM_FindFile (filename, NULL, file, path_id, NULL);
 }
 
 /*
@@ -1913,15 +2649,15 @@ static int	loadsize;
 byte *COM_LoadFile (const char *path, int usehunk, unsigned int *path_id)
 {
 	int		h;
-	byte	*buf;
+	byte	*buf, *zipdata = NULL;
 	char	base[32];
 	int	len, nread;
 
 	buf = NULL;	// quiet compiler warning
 
 // look for it in the filesystem or pack files
-	len = COM_OpenFile (path, &h, path_id);
-	if (h == -1)
+	len = COM_FindFile (path, &h, NULL, path_id, &zipdata);
+	if (h == -1 && !zipdata)
 		return NULL;
 
 // extract the filename base name for hunk tag
@@ -1959,6 +2695,12 @@ byte *COM_LoadFile (const char *path, int usehunk, unsigned int *path_id)
 
 	((byte *)buf)[len] = 0;
 
+	if (zipdata)
+	{
+		memcpy (buf, zipdata, len);
+		return buf;
+	}
+
 	nread = Sys_FileRead (h, buf, len);
 	COM_CloseFile (h);
 	if (nread != len)
@@ -2006,6 +2748,114 @@ byte *COM_LoadMallocFile (const char *path, unsigned int *path_id)
 	return COM_LoadFile (path, LOADFILE_MALLOC, path_id);
 }
 
+/*
+============
+COM_MapFile
+
+Maps the file straight from its pak or directory where the system allows it,
+otherwise reads it into malloc'd memory. Either way file->data is private to
+the caller, who can also write to it, and is released by COM_UnmapFile.
+Unlike COM_LoadFile no 0 byte is appended.
+============
+*/
+qboolean COM_MapFile (const char *path, mappedfile_t *file, unsigned int *path_id)
+{
+	int		h, nread;
+	byte	*zipdata = NULL;
+
+	memset (file, 0, sizeof(*file));
+
+	file->len = COM_FindFile (path, &h, NULL, path_id, &zipdata);
+	if (zipdata)
+	{
+		file->data = (byte *) malloc (file->len + 1);
+		if (!file->data)
+			Sys_Error ("COM_MapFile: not enough space for %s", path);
+		memcpy (file->data, zipdata, file->len + 1);
+		return true;
+	}
+	if (h == -1)
+		return false;
+
+	if (!com_nomapfiles)
+		file->data = (byte *) Sys_FileMap (h, com_fileofs, file->len, &file->mapping, &file->mapsize);
+
+	if (!file->data)
+	{
+		file->data = (byte *) malloc (file->len + 1);
+		if (!file->data)
+			Sys_Error ("COM_MapFile: not enough space for %s", path);
+		file->data[file->len] = 0;
+
+		nread = Sys_FileRead (h, file->data, file->len);
+		if (nread != file->len)
+			Sys_Error ("COM_MapFile: Error reading %s", path);
+	}
+
+	COM_CloseFile (h);
+	return true;
+}
+
+/*
+============
+COM_UnmapFile
+============
+*/
+void COM_UnmapFile (mappedfile_t *file)
+{
+	if (file->mapping)
+		Sys_FileUnmap (file->mapping, file->mapsize);
+	else
+		free (file->data);
+
+	memset (file, 0, sizeof(*file));
+}
+
+/*
+============
+COM_LocateFile
+
+Tells where the data of a file is on disk, so that it can be read without
+going through the search paths, e.g. from another thread
+============
+*/
+qboolean COM_LocateFile (const char *path, filelocation_t *loc, unsigned int *path_id)
+{
+	fileentry_t	*entry;
+	searchpath_t	*search;
+	packfile_t	*pf;
+
+	entry = COM_FileIndexLookup (path);
+	search = entry->search;
+	if (!search)
+		return false;
+
+	COM_TraceFile (entry);
+
+	if (search->pack)
+	{
+		pf = &search->pack->files[entry->index];
+		if (pf->zipheader && !COM_ZipDataOffset (search->pack, pf))
+			return false;
+
+		q_strlcpy (loc->path, search->pack->filename, sizeof(loc->path));
+		loc->offset = pf->filepos;
+		loc->length = pf->filelen;
+		loc->ziplength = pf->zipsize;
+	}
+	else
+	{
+		q_snprintf (loc->path, sizeof(loc->path), "%s/%s", search->filename, path);
+		loc->offset = 0;
+		loc->length = -1;
+		loc->ziplength = 0;
+	}
+
+	if (path_id)
+		*path_id = search->path_id;
+	return true;
+}
+
 byte *COM_LoadMallocFile_TextMode_OSPath (const char *path, long *len_out)
 {
 	FILE	*f;
@@ -2153,6 +3003,101 @@ static pack_t *COM_LoadPackFile (const char *packfile)
 	return pack;
 }
 
+static size_t COM_ZipRead (void *opaque, mz_uint64 ofs, void *buf, size_t n)
+{
+	int	handle = (int)(intptr_t) opaque;
+
+	Sys_FileSeek (handle, (int) ofs);
+	return q_max (Sys_FileRead (handle, buf, (int) n), 0);
+}
+
+/*
+=================
+COM_LoadZipFile
+
+Takes an explicit path to a pk3 file, and reads its central directory.
+Local headers are only looked at once an entry is opened.
+=================
+*/
+static pack_t *COM_LoadZipFile (const char *packfile)
+{
+	mz_zip_archive	archive;
+	mz_zip_archive_file_stat	stat;
+	packfile_t	*newfiles;
+	pack_t		*pack;
+	int		packhandle, size;
+	int		i, numentries, numpackfiles;
+
+	size = Sys_FileOpenRead (packfile, &packhandle);
+	if (size == -1)
+		return NULL;
+
+	memset (&archive, 0, sizeof(archive));
+	archive.m_pRead = COM_ZipRead;
+	archive.m_pIO_opaque = (void *)(intptr_t) packhandle;
+	if (!mz_zip_reader_init (&archive, size, 0))
+	{
+		Sys_Printf ("WARNING: %s is not a valid pk3, ignored\n", packfile);
+		Sys_FileClose (packhandle);
+		return NULL;
+	}
+
+	numentries = mz_zip_reader_get_num_files (&archive);
+	newfiles = (packfile_t *) malloc (q_max (numentries, 1) * sizeof(packfile_t));
+	if (!newfiles)
+		Sys_Error ("COM_LoadZipFile: not enough space for %s", packfile);
+
+	for (i = 0, numpackfiles = 0; i < numentries; i++)
+	{
+		if (!mz_zip_reader_file_stat (&archive, i, &stat) || stat.m_is_directory)
+			continue;
+
+		if (!stat.m_is_supported || (stat.m_method != 0 && stat.m_method != MZ_DEFLATED))
+		{
+			Con_DPrintf ("%s: %s is encrypted or uses an unsupported method\n", packfile, stat.m_filename);
+			continue;
+		}
+		if (strlen (stat.m_filename) >= MAX_QPATH)
+		{
+			Con_DPrintf ("%s: %s has too long a name\n", packfile, stat.m_filename);
+			continue;
+		}
+		if (stat.m_uncomp_size > INT_MAX || stat.m_comp_size > INT_MAX || stat.m_local_header_ofs > INT_MAX)
+		{
+			Con_DPrintf ("%s: %s is too large\n", packfile, stat.m_filename);
+			continue;
+		}
+
+		q_strlcpy (newfiles[numpackfiles].name, stat.m_filename, sizeof(newfiles[numpackfiles].name));
+		newfiles[numpackfiles].filepos = (int) stat.m_local_header_ofs;
+		newfiles[numpackfiles].filelen = (int) stat.m_uncomp_size;
+		newfiles[numpackfiles].zipsize = (stat.m_method == MZ_DEFLATED && stat.m_uncomp_size) ? (int) stat.m_comp_size : 0;
+		newfiles[numpackfiles].zipheader = true;
+		numpackfiles++;
+	}
+
+	mz_zip_reader_end (&archive);
+
+	if (!numpackfiles)
+	{
+		Sys_Printf ("WARNING: %s has no files, ignored\n", packfile);
+		Sys_FileClose (packhandle);
+		free (newfiles);
+		return NULL;
+	}
+
+	com_modified = true;	// not the original data
+
+	pack = (pack_t *) Z_Malloc (sizeof (pack_t));
+	q_strlcpy (pack->filename, packfile, sizeof(pack->filename));
+	pack->handle = packhandle;
+	pack->numfiles = numpackfiles;
+	pack->files = newfiles;
+	pack->zip = true;
+
+	return pack;
+}
+
 /*
 =================
 COM_AddGameDirectory -- johnfitz -- modified based on topaz's tutorial
@@ -2213,6 +3158,20 @@ _add_path:
 		if (!pak) break;
 	}
 
+	// pk3 files in the same format, they override all pak files here
+	for (i = 0; ; i++)
+	{
+		q_snprintf (pakfile, sizeof(pakfile), "%s/pak%i.pk3", com_gamedir, i);
+		pak = COM_LoadZipFile (pakfile);
+		if (!pak) break;
+
+		search = (searchpath_t *) Z_Malloc(sizeof(searchpath_t));
+		search->path_id = path_id;
+		search->pack = pak;
+		search->next = com_searchpaths;
+		com_searchpaths = search;
+	}
+
 	if (!been_here && host_parms->userdir != host_parms->basedir)
 	{
 		been_here = true;
@@ -2220,6 +3179,7 @@ _add_path:
 		Sys_mkdir(com_gamedir);
 		goto _add_path;
 	}
+	COM_ClearFileIndex ();
 }
 
 //==============================================================================
@@ -2296,12 +3256,16 @@ static void COM_Game_f (void)
 		Host_WriteConfiguration ();
 
 		//Kill the extra game if it is loaded
+		COM_ClearFileIndex ();
 		while (com_searchpaths != com_base_searchpaths)
 		{
 			if (com_searchpaths->pack)
 			{
 				Sys_FileClose (com_searchpaths->pack->handle);
-				Z_Free (com_searchpaths->pack->files);
+				if (com_searchpaths->pack->zip)
+					free (com_searchpaths->pack->files);
+				else
+					Z_Free (com_searchpaths->pack->files);
 				Z_Free (com_searchpaths->pack);
 			}
 			search = com_searchpaths->next;
@@ -2383,9 +3347,13 @@ void COM_InitFilesystem (void) //johnfitz -- modified based on topaz's tutorial
 	Cvar_RegisterVariable (&registered);
 	Cvar_RegisterVariable (&cmdline);
 	Cvar_RegisterVariable (&allowloaderrors);
+	Cvar_RegisterVariable (&com_prefetch);
 	Cmd_AddCommand ("path", COM_Path_f);
+	Cmd_AddCommand ("path_rescan", COM_InvalidateLooseFiles);
 	Cmd_AddCommand ("game", COM_Game_f); //johnfitz
 
+	com_nomapfiles = COM_CheckParm ("-nomapfiles") != 0;
+
 	i = COM_CheckParm ("-basedir");
 	if (i && i < com_argc-1)
 		q_strlcpy (com_basedir, com_argv[i + 1], sizeof(com_basedir));
@@ -2652,6 +3620,23 @@ unsigned COM_HashString (const char *str)
 	return hash;
 }
 
+/*
+================
+COM_HashBlock
+Computes the FNV-1a hash of len bytes at data
+================
+*/
+unsigned COM_HashBlock (const byte *data, size_t len)
+{
+	unsigned hash = 0x811c9dc5u;
+	while (len--)
+	{
+		hash ^= *data++;
+		hash *= 0x01000193u;
+	}
+	return hash;
+}
+
 static size_t mz_zip_file_read_func(void *opaque, mz_uint64 ofs, void *buf, size_t n)
 {
 	if (SDL_RWseek((SDL_RWops*)opaque, (Sint64)ofs, RW_SEEK_SET) < 0)
@@ -187,8 +187,31 @@ void MSG_WriteCoord (sizebuf_t *sb, float f, unsigned int flags);
 void MSG_WriteAngle (sizebuf_t *sb, float f, unsigned int flags);
 void MSG_WriteAngle16 (sizebuf_t *sb, float f, unsigned int flags); //johnfitz
 
-extern	int			msg_readcount;
-extern	qboolean	msg_badread;		// set if a read goes beyond end of message
+typedef struct msgreader_s
+{
+	sizebuf_t	*buf;
+	int			readcount;
+	qboolean	badread;		// set if a read goes beyond end of message
+	char		string[2048];	// returned by MSGR_ReadString
+} msgreader_t;
+
+void MSGR_BeginReading (msgreader_t *msg, sizebuf_t *buf);
+int MSGR_ReadChar (msgreader_t *msg);
+int MSGR_ReadByte (msgreader_t *msg);
+int MSGR_ReadShort (msgreader_t *msg);
+int MSGR_ReadLong (msgreader_t *msg);
+float MSGR_ReadFloat (msgreader_t *msg);
+const char *MSGR_ReadString (msgreader_t *msg);
+
+float MSGR_ReadCoord (msgreader_t *msg, unsigned int flags);
+float MSGR_ReadAngle (msgreader_t *msg, unsigned int flags);
+float MSGR_ReadAngle16 (msgreader_t *msg, unsigned int flags);
+
+// the MSG_Read* functions read net_message
+extern	msgreader_t	net_reader;
+
+#define	msg_readcount	net_reader.readcount
+#define	msg_badread		net_reader.badread
 
 void MSG_BeginReading (void);
 int MSG_ReadChar (void);
@@ -286,6 +309,7 @@ char *va (const char *format, ...) FUNC_PRINTF(1,2);
 // does a varargs printf into a temp buffer
 
 unsigned COM_HashString (const char *str);
+unsigned COM_HashBlock (const byte *data, size_t len);
 
 // localization support for 2021 rerelease version:
 void LOC_Init (void);
@@ -302,6 +326,8 @@ typedef struct
 {
 	char	name[MAX_QPATH];
 	int		filepos, filelen;
+	int		zipsize;		// pk3 only: size of the deflated data, 0 if stored
+	qboolean	zipheader;	// pk3 only: filepos is still at the local header
 } packfile_t;
 
 typedef struct pack_s
@@ -310,6 +336,7 @@ typedef struct pack_s
 	int		handle;
 	int		numfiles;
 	packfile_t	*files;
+	qboolean	zip;		// pk3, files is malloc'd instead of on the zone
 } pack_t;
 
 typedef struct searchpath_s
@@ -336,6 +363,11 @@ void COM_WriteFile (const char *filename, const void *data, int len);
 int COM_OpenFile (const char *filename, int *handle, unsigned int *path_id);
 int COM_FOpenFile (const char *filename, FILE **file, unsigned int *path_id);
 qboolean COM_FileExists (const char *filename, unsigned int *path_id);
+// call after creating files in a game directory outside of COM_WriteFile
+void COM_InvalidateLooseFiles (void);
+// record the files a map load reads, and prefetch the last trace of that map
+void COM_BeginFileTrace (const char *name);
+void COM_EndFileTrace (qboolean save);
 void COM_CloseFile (int h);
 
 // these procedures open a file using COM_FindFile and loads it into a proper
@@ -358,6 +390,31 @@ void COM_LoadCacheFile (const char *path, struct cache_user_s *cu,
 byte *COM_LoadMallocFile (const char *path, unsigned int *path_id);
 	// allocates the buffer on the system mem (malloc).
 
+typedef struct
+{
+	byte	*data;
+	int		len;
+	void	*mapping;		// NULL if data is malloc'd
+	size_t	mapsize;
+} mappedfile_t;
+
+qboolean COM_MapFile (const char *path, mappedfile_t *file, unsigned int *path_id);
+	// maps the file without copying it where possible, no 0 byte is appended.
+void COM_UnmapFile (mappedfile_t *file);
+
+typedef struct
+{
+	char	path[MAX_OSPATH];	// pak or loose file
+	int		offset;
+	int		length;				// -1 for a loose file, read up to its end
+	int		ziplength;			// deflated size of a compressed pk3 entry, else 0
+} filelocation_t;
+
+qboolean COM_LocateFile (const char *path, filelocation_t *loc, unsigned int *path_id);
+	// where to read path from, without going through the search paths
+qboolean COM_Inflate (const byte *in, int inlen, byte *out, int outlen);
+	// raw deflate data, safe to call from any thread
+
 // Opens the given path directly, ignoring search paths.
 // Returns NULL on failure, or else a '\0'-terminated malloc'ed buffer.
 // Loads in "t" mode so CRLF to LF translation is performed on Windows.
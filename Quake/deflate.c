@@ -0,0 +1,295 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// deflate.c -- minimal streaming deflate encoder, see RFC 1951
+
+#include "quakedef.h"
+#include "deflate.h"
+
+#define MIN_MATCH	3
+#define MAX_MATCH	258
+#define MAX_CHAIN	32
+
+#define HASH_SIZE	(1 << DEFLATE_HASH_BITS)
+#define WINDOW_MASK	(DEFLATE_WINDOW - 1)
+
+static const unsigned short length_base[29] =
+{
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const byte length_extra[29] =
+{
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const unsigned short dist_base[30] =
+{
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const byte dist_extra[30] =
+{
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+
+static void Deflate_FlushOutput (deflatestream_t *stream)
+{
+	if (stream->outlen > 0)
+	{
+		stream->write (stream->out, stream->outlen, stream->userdata);
+		stream->outlen = 0;
+	}
+}
+
+// value is stored starting from the least significant bit
+static void Deflate_PutBits (deflatestream_t *stream, unsigned int value, int count)
+{
+	stream->bits |= value << stream->bitcount;
+	stream->bitcount += count;
+
+	while (stream->bitcount >= 8)
+	{
+		if (stream->outlen == DEFLATE_OUTSIZE)
+			Deflate_FlushOutput (stream);
+
+		stream->out[stream->outlen++] = stream->bits & 0xff;
+		stream->bits >>= 8;
+		stream->bitcount -= 8;
+	}
+}
+
+// Huffman codes are stored starting from the most significant bit
+static void Deflate_PutCode (deflatestream_t *stream, unsigned int code, int length)
+{
+	unsigned int	reversed = 0;
+	int		i;
+
+	for (i = 0; i < length; i++, code >>= 1)
+		reversed = (reversed << 1) | (code & 1);
+
+	Deflate_PutBits (stream, reversed, length);
+}
+
+// fixed literal/length code
+static void Deflate_PutSymbol (deflatestream_t *stream, int symbol)
+{
+	if (symbol < 144)
+		Deflate_PutCode (stream, 0x30 + symbol, 8);
+	else if (symbol < 256)
+		Deflate_PutCode (stream, 0x190 + symbol - 144, 9);
+	else if (symbol < 280)
+		Deflate_PutCode (stream, symbol - 256, 7);
+	else
+		Deflate_PutCode (stream, 0xc0 + symbol - 280, 8);
+}
+
+static void Deflate_BeginBlock (deflatestream_t *stream)
+{
+	if (!stream->inblock)
+	{
+		Deflate_PutBits (stream, 2, 3);	// not final, fixed Huffman codes
+		stream->inblock = true;
+	}
+}
+
+static void Deflate_PutMatch (deflatestream_t *stream, int length, int distance)
+{
+	int	i;
+
+	for (i = 28; length_base[i] > length; i--)
+		;
+	Deflate_PutSymbol (stream, 257 + i);
+	Deflate_PutBits (stream, length - length_base[i], length_extra[i]);
+
+	for (i = 29; dist_base[i] > distance; i--)
+		;
+	Deflate_PutCode (stream, i, 5);
+	Deflate_PutBits (stream, distance - dist_base[i], dist_extra[i]);
+}
+
+static unsigned int Deflate_Hash (const byte *data)
+{
+	return ((data[0] << 10) ^ (data[1] << 5) ^ data[2]) & (HASH_SIZE - 1);
+}
+
+static void Deflate_Insert (deflatestream_t *stream, int index)
+{
+	unsigned int	hash, position;
+
+	if (stream->end - index < MIN_MATCH)
+		return;
+
+	hash = Deflate_Hash (stream->window + index);
+	position = stream->offset + index;
+
+	stream->prev[position & WINDOW_MASK] = stream->head[hash];
+	stream->head[hash] = position + 1;
+}
+
+static int Deflate_FindMatch (deflatestream_t *stream, int index, int *distance)
+{
+	const byte		*current, *candidate;
+	unsigned int	position, next;
+	int		chain, length, best, maxlength;
+
+	maxlength = q_min (stream->end - index, MAX_MATCH);
+	if (maxlength < MIN_MATCH)
+		return 0;
+
+	current = stream->window + index;
+	position = stream->offset + index;
+	next = stream->head[Deflate_Hash (current)];
+	best = 0;
+
+	for (chain = MAX_CHAIN; next && chain > 0; chain--)
+	{
+		next--;
+
+		if (next >= position || position - next > DEFLATE_WINDOW || next < stream->offset)
+			break;
+
+		candidate = stream->window + (next - stream->offset);
+
+		if (candidate[best] == current[best])
+		{
+			for (length = 0; length < maxlength && candidate[length] == current[length]; length++)
+				;
+
+			if (length > best)
+			{
+				best = length;
+				*distance = position - next;
+
+				if (best == maxlength)
+					break;
+			}
+		}
+
+		next = stream->prev[next & WINDOW_MASK];
+	}
+
+	return best >= MIN_MATCH ? best : 0;
+}
+
+// final pass encodes everything, otherwise enough lookahead is kept for a full match
+static void Deflate_Encode (deflatestream_t *stream, qboolean final)
+{
+	int	limit, length, distance, i;
+
+	limit = final ? stream->end : stream->end - MAX_MATCH;
+
+	if (stream->start < limit)
+		Deflate_BeginBlock (stream);
+
+	while (stream->start < limit)
+	{
+		length = Deflate_FindMatch (stream, stream->start, &distance);
+
+		if (length)
+		{
+			Deflate_PutMatch (stream, length, distance);
+
+			for (i = 0; i < length; i++)
+				Deflate_Insert (stream, stream->start + i);
+
+			stream->start += length;
+		}
+		else
+		{
+			Deflate_PutSymbol (stream, stream->window[stream->start]);
+			Deflate_Insert (stream, stream->start);
+			stream->start++;
+		}
+	}
+}
+
+
+/*
+=============
+Deflate_Init
+=============
+*/
+void Deflate_Init (deflatestream_t *stream, deflatewrite_t write, void *userdata)
+{
+	memset (stream, 0, sizeof(*stream));
+	stream->write = write;
+	stream->userdata = userdata;
+}
+
+/*
+=============
+Deflate_Write
+=============
+*/
+void Deflate_Write (deflatestream_t *stream, const void *data, int size)
+{
+	const byte	*bytes = (const byte *) data;
+	int		count;
+
+	while (size > 0)
+	{
+		if (stream->end == (int) sizeof(stream->window))
+		{
+			Deflate_Encode (stream, false);
+
+			// drop the oldest half, the rest is still in reach of matches
+			memmove (stream->window, stream->window + DEFLATE_WINDOW, DEFLATE_WINDOW);
+			stream->start -= DEFLATE_WINDOW;
+			stream->end -= DEFLATE_WINDOW;
+			stream->offset += DEFLATE_WINDOW;
+		}
+
+		count = q_min (size, (int) sizeof(stream->window) - stream->end);
+		memcpy (stream->window + stream->end, bytes, count);
+		stream->end += count;
+		bytes += count;
+		size -= count;
+	}
+}
+
+/*
+=============
+Deflate_Finish
+=============
+*/
+void Deflate_Finish (deflatestream_t *stream)
+{
+	Deflate_Encode (stream, true);
+
+	if (stream->inblock)
+		Deflate_PutSymbol (stream, 256);	// end of block
+
+	// empty final block
+	Deflate_PutBits (stream, 3, 3);
+	Deflate_PutSymbol (stream, 256);
+
+	// pad to byte boundary
+	if (stream->bitcount > 0)
+		Deflate_PutBits (stream, 0, 8 - stream->bitcount);
+
+	Deflate_FlushOutput (stream);
+}
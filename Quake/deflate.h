@@ -0,0 +1,60 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#ifndef __DEFLATE_H
+#define __DEFLATE_H
+
+// deflate.h -- minimal streaming deflate encoder
+// The bundled miniz is built without its compressor, so this produces a raw
+// deflate stream (LZ77 with the fixed Huffman code) for tinfl_decompress().
+
+#define DEFLATE_WINDOW		32768
+#define DEFLATE_HASH_BITS	15
+#define DEFLATE_OUTSIZE		16384
+
+typedef void (*deflatewrite_t) (const byte *data, int size, void *userdata);
+
+typedef struct
+{
+	byte			window[DEFLATE_WINDOW * 2];	// history followed by pending input
+	int				start;		// first byte that isn't encoded yet
+	int				end;		// end of pending input
+	unsigned int	offset;		// stream position of window[0]
+
+	unsigned int	head[1 << DEFLATE_HASH_BITS];	// stream position + 1 of the latest string, 0 = none
+	unsigned int	prev[DEFLATE_WINDOW];			// previous position + 1 with the same hash
+
+	unsigned int	bits;
+	int				bitcount;
+	qboolean		inblock;
+
+	byte			out[DEFLATE_OUTSIZE];
+	int				outlen;
+	deflatewrite_t	write;
+	void			*userdata;
+} deflatestream_t;
+
+void Deflate_Init (deflatestream_t *stream, deflatewrite_t write, void *userdata);
+void Deflate_Write (deflatestream_t *stream, const void *data, int size);
+void Deflate_Finish (deflatestream_t *stream);
+// encodes all pending input, terminates the stream and flushes output
+
+#endif	/* __DEFLATE_H */
@@ -95,12 +95,14 @@ handle an SVC_FOG message from server
 void Fog_ParseServerMessage (void)
 {
 	float density, red, green, blue, time;
-
-	density = MSG_ReadByte() / 255.0;
-	red = MSG_ReadByte() / 255.0;
-	green = MSG_ReadByte() / 255.0;
-	blue = MSG_ReadByte() / 255.0;
-	time = MSG_ReadShort() / 100.0;
+	fogupdate_t fog;
+
+	CL_ReadFog (CL_ServerReader (), &fog);
+	density = fog.density / 255.0;
+	red = fog.red / 255.0;
+	green = fog.green / 255.0;
+	blue = fog.blue / 255.0;
+	time = fog.time / 100.0;
 	if (time < 0.0f) time = 0.0f;
 
 	Fog_Update (density, red, green, blue, time);
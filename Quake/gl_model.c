@@ -35,10 +35,19 @@ static void Mod_LoadAliasModel (qmodel_t *mod, void *buffer);
 static qmodel_t *Mod_LoadModel (qmodel_t *mod, qboolean crash);
 
 static void Mod_Print (void);
+static void Mod_LoadBench_f (void);
+static void Mod_PVSInfo_f (void);
+static void Mod_PVSCacheChanged (cvar_t *var);
+static cvar_t	mod_parallelload;
+static cvar_t	mod_pvscache;
+static void Mod_CancelRequests (void);
+
+extern cvar_t	r_bspcache;
 
 static cvar_t	external_ents = {"external_ents", "1", CVAR_ARCHIVE};
 static cvar_t	external_vis = {"external_vis", "1", CVAR_ARCHIVE};
 static cvar_t	external_textures = {"external_textures", "1", CVAR_ARCHIVE};
+static cvar_t	mod_requesttime = {"mod_requesttime", "4", CVAR_NONE};
 
 static byte	*mod_novis;
 static int	mod_novis_capacity;
@@ -50,6 +59,11 @@ static int	mod_decompressed_capacity;
 static qmodel_t	mod_known[MAX_MOD_KNOWN];
 static int		mod_numknown;
 
+#define	MOD_HASH_SIZE	(MAX_MOD_KNOWN * 2)	// power of two
+static int		mod_hash[MOD_HASH_SIZE];	// first mod_known index of every chain, -1 if empty
+static int		mod_hashnext[MAX_MOD_KNOWN];
+static int		mod_lookups, mod_probes;
+
 texture_t	*r_notexture_mip; //johnfitz -- moved here from r_main.c
 texture_t	*r_notexture_mip2; //johnfitz -- used for non-lightmapped surfs with a missing texture
 
@@ -64,8 +78,16 @@ void Mod_Init (void)
 	Cvar_RegisterVariable (&external_vis);
 	Cvar_RegisterVariable (&external_ents);
 	Cvar_RegisterVariable (&external_textures);
+	Cvar_RegisterVariable (&mod_parallelload);
+	Cvar_RegisterVariable (&mod_requesttime);
+	Cvar_RegisterVariable (&mod_pvscache);
+	Cvar_SetCallback (&mod_pvscache, Mod_PVSCacheChanged);
 
 	Cmd_AddCommand ("mcache", Mod_Print);
+	Cmd_AddCommand ("mod_loadbench", Mod_LoadBench_f);
+	Cmd_AddCommand ("mod_pvsinfo", Mod_PVSInfo_f);
+
+	memset (mod_hash, 0xff, sizeof(mod_hash));
 
 	//johnfitz -- create notexture miptex
 	r_notexture_mip = (texture_t *) Hunk_AllocName (sizeof(texture_t), "r_notexture_mip");
@@ -133,10 +155,10 @@ mleaf_t *Mod_PointInLeaf (vec3_t p, qmodel_t *model)
 
 /*
 ===================
-Mod_DecompressVis
+Mod_DecompressVisRow
 ===================
 */
-static byte *Mod_DecompressVis (byte *in, qmodel_t *model)
+static void Mod_DecompressVisRow (byte *in, qmodel_t *model, byte *dest)
 {
 	int		c;
 	byte	*out;
@@ -144,15 +166,8 @@ static byte *Mod_DecompressVis (byte *in, qmodel_t *model)
 	int		row;
 
 	row = (model->numleafs+7)>>3;
-	if (mod_decompressed == NULL || row > mod_decompressed_capacity)
-	{
-		mod_decompressed_capacity = row;
-		mod_decompressed = (byte *) realloc (mod_decompressed, mod_decompressed_capacity);
-		if (!mod_decompressed)
-			Sys_Error ("Mod_DecompressVis: realloc() failed on %d bytes", mod_decompressed_capacity);
-	}
-	out = mod_decompressed;
-	outend = mod_decompressed + row;
+	out = dest;
+	outend = dest + row;
 
 	if (!in)
 	{	// no vis info, so make all visible
@@ -161,7 +176,7 @@ static byte *Mod_DecompressVis (byte *in, qmodel_t *model)
 			*out++ = 0xff;
 			row--;
 		}
-		return mod_decompressed;
+		return;
 	}
 
 	do
@@ -182,20 +197,243 @@ static byte *Mod_DecompressVis (byte *in, qmodel_t *model)
 					model->viswarn = true;
 					Con_Warning("Mod_DecompressVis: output overrun on model \"%s\"\n", model->name);
 				}
-				return mod_decompressed;
+				return;
 			}
 			*out++ = 0;
 			c--;
 		}
-	} while (out - mod_decompressed < row);
+	} while (out - dest < row);
+}
+
+/*
+===================
+Mod_DecompressVis
+===================
+*/
+static byte *Mod_DecompressVis (byte *in, qmodel_t *model)
+{
+	int		row;
+
+	row = (model->numleafs+7)>>3;
+	if (mod_decompressed == NULL || row > mod_decompressed_capacity)
+	{
+		mod_decompressed_capacity = row;
+		mod_decompressed = (byte *) realloc (mod_decompressed, mod_decompressed_capacity);
+		if (!mod_decompressed)
+			Sys_Error ("Mod_DecompressVis: realloc() failed on %d bytes", mod_decompressed_capacity);
+	}
+
+	Mod_DecompressVisRow (in, model, mod_decompressed);
 
 	return mod_decompressed;
 }
 
+/*
+===============================================================================
+
+PVS CACHE
+
+Decompressed rows of one model, looked up by leaf number through a small hash
+and kept in least recently used order. mod_pvscache is the budget in
+kilobytes, when all rows of the model fit nothing is ever evicted.
+
+===============================================================================
+*/
+
+static cvar_t	mod_pvscache = {"mod_pvscache", "16384", CVAR_ARCHIVE};
+
+static struct
+{
+	qmodel_t	*model;
+	int			rowbytes;
+	int			numslots, numused;
+	byte		*rows;			// [numslots][rowbytes]
+	int			*leafnum;		// of every slot
+	int			*prev, *next;	// most recent first, -1 terminated
+	int			head, tail;
+	int			*hash;			// first slot of every chain, -1 if empty
+	int			*hashnext;
+	int			hashmask;
+
+	unsigned	hits, misses, evictions;
+} pvscache;
+
+/*
+===================
+Mod_ClearPVSCache
+===================
+*/
+static void Mod_ClearPVSCache (void)
+{
+	free (pvscache.rows);
+	free (pvscache.leafnum);
+	memset (&pvscache, 0, sizeof(pvscache));
+}
+
+static void Mod_PVSCacheChanged (cvar_t *var)
+{
+	Mod_ClearPVSCache ();
+}
+
+/*
+===================
+Mod_SetupPVSCache
+===================
+*/
+static void Mod_SetupPVSCache (qmodel_t *model)
+{
+	int		i, numslots, hashsize;
+	double	budget;
+
+	Mod_ClearPVSCache ();
+
+	pvscache.model = model;
+	pvscache.rowbytes = (model->numleafs+7)>>3;
+
+	budget = mod_pvscache.value * 1024.0;
+	numslots = (int) q_min (budget / q_max (pvscache.rowbytes, 1), (double) model->numleafs + 1);
+	if (numslots <= 0)
+		return;
+
+	for (hashsize = 1; hashsize < numslots; hashsize <<= 1)
+		;
+
+	pvscache.rows = (byte *) malloc ((size_t) numslots * pvscache.rowbytes);
+	pvscache.leafnum = (int *) malloc ((numslots * 4 + hashsize) * sizeof(int));
+	if (!pvscache.rows || !pvscache.leafnum)
+	{
+		Con_Warning ("Mod_SetupPVSCache: couldn't allocate %i rows\n", numslots);
+		Mod_ClearPVSCache ();
+		pvscache.model = model;
+		return;
+	}
+	pvscache.prev = pvscache.leafnum + numslots;
+	pvscache.next = pvscache.prev + numslots;
+	pvscache.hashnext = pvscache.next + numslots;
+	pvscache.hash = pvscache.hashnext + numslots;
+	pvscache.hashmask = hashsize - 1;
+	for (i = 0; i < hashsize; i++)
+		pvscache.hash[i] = -1;
+
+	pvscache.numslots = numslots;
+	pvscache.head = pvscache.tail = -1;
+}
+
+static void Mod_UnlinkPVSSlot (int slot)
+{
+	if (pvscache.prev[slot] >= 0)
+		pvscache.next[pvscache.prev[slot]] = pvscache.next[slot];
+	else
+		pvscache.head = pvscache.next[slot];
+	if (pvscache.next[slot] >= 0)
+		pvscache.prev[pvscache.next[slot]] = pvscache.prev[slot];
+	else
+		pvscache.tail = pvscache.prev[slot];
+}
+
+static void Mod_LinkPVSSlot (int slot)
+{
+	pvscache.prev[slot] = -1;
+	pvscache.next[slot] = pvscache.head;
+	if (pvscache.head >= 0)
+		pvscache.prev[pvscache.head] = slot;
+	else
+		pvscache.tail = slot;
+	pvscache.head = slot;
+}
+
+/*
+===================
+Mod_CachedPVS
+===================
+*/
+static byte *Mod_CachedPVS (mleaf_t *leaf, qmodel_t *model)
+{
+	int		leafnum, slot, *link;
+
+	if (pvscache.model != model)
+		Mod_SetupPVSCache (model);
+	if (!pvscache.numslots)
+		return Mod_DecompressVis (leaf->compressed_vis, model);
+
+	leafnum = leaf - model->leafs;
+	for (slot = pvscache.hash[leafnum & pvscache.hashmask]; slot >= 0; slot = pvscache.hashnext[slot])
+	{
+		if (pvscache.leafnum[slot] == leafnum)
+		{
+			pvscache.hits++;
+			if (slot != pvscache.head)
+			{
+				Mod_UnlinkPVSSlot (slot);
+				Mod_LinkPVSSlot (slot);
+			}
+			return pvscache.rows + (size_t) slot * pvscache.rowbytes;
+		}
+	}
+
+	pvscache.misses++;
+
+	if (pvscache.numused < pvscache.numslots)
+		slot = pvscache.numused++;
+	else
+	{
+		// reuse the least recently used row
+		slot = pvscache.tail;
+		Mod_UnlinkPVSSlot (slot);
+		for (link = &pvscache.hash[pvscache.leafnum[slot] & pvscache.hashmask]; *link != slot; link = &pvscache.hashnext[*link])
+			;
+		*link = pvscache.hashnext[slot];
+		pvscache.evictions++;
+	}
+
+	pvscache.leafnum[slot] = leafnum;
+	pvscache.hashnext[slot] = pvscache.hash[leafnum & pvscache.hashmask];
+	pvscache.hash[leafnum & pvscache.hashmask] = slot;
+	Mod_LinkPVSSlot (slot);
+
+	Mod_DecompressVisRow (leaf->compressed_vis, model, pvscache.rows + (size_t) slot * pvscache.rowbytes);
+
+	return pvscache.rows + (size_t) slot * pvscache.rowbytes;
+}
+
+/*
+===================
+Mod_PVSInfo_f
+===================
+*/
+static void Mod_PVSInfo_f (void)
+{
+	unsigned	lookups;
+
+	if (!pvscache.model)
+	{
+		Con_Printf ("PVS cache is empty\n");
+		return;
+	}
+
+	lookups = pvscache.hits + pvscache.misses;
+	Con_Printf ("%s: %i of %i rows cached, %i bytes each, %.1f KB%s\n", pvscache.model->name,
+		pvscache.numused, pvscache.model->numleafs, pvscache.rowbytes,
+		(double) pvscache.numslots * pvscache.rowbytes / 1024.0,
+		pvscache.numslots > pvscache.model->numleafs ? ", all fit" : "");
+	Con_Printf ("%u hits, %u misses, %u evictions, %.1f%% hit rate\n",
+		pvscache.hits, pvscache.misses, pvscache.evictions,
+		lookups ? 100.0 * pvscache.hits / lookups : 0.0);
+}
+
+/*
+===================
+Mod_LeafPVS
+
+The row stays valid until the next call
+===================
+*/
 byte *Mod_LeafPVS (mleaf_t *leaf, qmodel_t *model)
 {
 	if (leaf == model->leafs)
 		return Mod_NoVisPVS (model);
+	if (mod_pvscache.value > 0)
+		return Mod_CachedPVS (leaf, model);
 	return Mod_DecompressVis (leaf->compressed_vis, model);
 }
 
@@ -234,6 +472,9 @@ void Mod_ClearAll (void)
 			TexMgr_FreeTexturesForOwner (mod); //johnfitz
 		}
 	}
+
+	Mod_ClearPVSCache ();
+	Mod_CancelRequests ();
 }
 
 void Mod_ResetAll (void)
@@ -241,6 +482,8 @@ void Mod_ResetAll (void)
 	int		i;
 	qmodel_t	*mod;
 
+	Mod_CancelRequests ();
+
 	//ericw -- free alias model VBOs
 	GLMesh_DeleteVertexBuffers ();
 
@@ -251,6 +494,9 @@ void Mod_ResetAll (void)
 		memset(mod, 0, sizeof(qmodel_t));
 	}
 	mod_numknown = 0;
+	memset (mod_hash, 0xff, sizeof(mod_hash));
+
+	Mod_ClearPVSCache ();
 }
 
 /*
@@ -262,6 +508,7 @@ Mod_FindName
 static qmodel_t *Mod_FindName (const char *name)
 {
 	int		i;
+	unsigned	hash;
 	qmodel_t	*mod;
 
 	if (!name[0])
@@ -270,20 +517,23 @@ static qmodel_t *Mod_FindName (const char *name)
 //
 // search the currently loaded models
 //
-	for (i=0 , mod=mod_known ; i<mod_numknown ; i++, mod++)
+	mod_lookups++;
+	hash = COM_HashString (name) & (MOD_HASH_SIZE - 1);
+	for (i = mod_hash[hash]; i >= 0; i = mod_hashnext[i])
 	{
-		if (!strcmp (mod->name, name) )
-			break;
+		mod_probes++;
+		if (!strcmp (mod_known[i].name, name) )
+			return &mod_known[i];
 	}
 
-	if (i == mod_numknown)
-	{
-		if (mod_numknown == MAX_MOD_KNOWN)
-			Sys_Error ("mod_numknown == MAX_MOD_KNOWN");
-		q_strlcpy (mod->name, name, MAX_QPATH);
-		mod->needload = true;
-		mod_numknown++;
-	}
+	if (mod_numknown == MAX_MOD_KNOWN)
+		Sys_Error ("mod_numknown == MAX_MOD_KNOWN");
+	mod = &mod_known[mod_numknown];
+	q_strlcpy (mod->name, name, MAX_QPATH);
+	mod->needload = true;
+	mod_hashnext[mod_numknown] = mod_hash[hash];
+	mod_hash[hash] = mod_numknown;
+	mod_numknown++;
 
 	return mod;
 }
@@ -309,27 +559,85 @@ void Mod_TouchModel (const char *name)
 
 /*
 ==================
-Mod_LoadModel
+Mod_IsLoaded
 
-Loads a model into the cache
+True if mod doesn't need loading and, for alias models, is still cached
 ==================
 */
-static qmodel_t *Mod_LoadModel (qmodel_t *mod, qboolean crash)
+static qboolean Mod_IsLoaded (qmodel_t *mod)
 {
-	byte	*buf;
-	byte	stackbuf[1024];		// avoid dirtying the cache heap
-	int	mod_type;
-
 	if (!mod->needload)
 	{
 		if (mod->type == mod_alias)
 		{
 			if (Cache_Check (&mod->cache))
-				return mod;
+				return true;
 		}
 		else
-			return mod;		// not cached at all
+			return true;		// not cached at all
+	}
+
+	return false;
+}
+
+/*
+==================
+Mod_LoadBuffer
+
+Loads mod from the whole file in buf
+==================
+*/
+static void Mod_LoadBuffer (qmodel_t *mod, byte *buf, int len)
+{
+	int	mod_type;
+
+//
+// allocate a new model
+//
+	COM_FileBase (mod->name, loadname, sizeof(loadname));
+
+	loadmodel = mod;
+
+//
+// fill it in
+//
+
+// call the apropriate loader
+	mod->needload = false;
+
+	mod_type = (buf[0] | (buf[1] << 8) | (buf[2] << 16) | (buf[3] << 24));
+	switch (mod_type)
+	{
+	case IDPOLYHEADER:
+		Mod_LoadAliasModel (mod, buf);
+		break;
+
+	case IDSPRITEHEADER:
+		Mod_LoadSpriteModel (mod, buf);
+		break;
+
+	default:
+		mod->filesize = r_bspcache.value ? len : -1;
+		mod->filehash = r_bspcache.value ? COM_HashBlock (buf, len) : 0;
+		Mod_LoadBrushModel (mod, buf);
+		break;
 	}
+}
+
+/*
+==================
+Mod_LoadModel
+
+Loads a model into the cache
+==================
+*/
+static qmodel_t *Mod_LoadModel (qmodel_t *mod, qboolean crash)
+{
+	static mappedfile_t	file;	// static so a Host_Error during loading doesn't leak it
+	byte	*buf;
+
+	if (Mod_IsLoaded (mod))
+		return mod;
 
 //
 // because the world is so huge, load it one piece at a time
@@ -342,7 +650,10 @@ static qmodel_t *Mod_LoadModel (qmodel_t *mod, qboolean crash)
 //
 // load the file
 //
-	buf = COM_LoadStackFile (mod->name, stackbuf, sizeof(stackbuf), & mod->path_id);
+	if (file.data)
+		COM_UnmapFile (&file);
+
+	buf = COM_MapFile (mod->name, &file, & mod->path_id) ? file.data : NULL;
 	if (!buf)
 	{
 		if (crash)
@@ -367,35 +678,9 @@ static qmodel_t *Mod_LoadModel (qmodel_t *mod, qboolean crash)
 		return NULL;
 	}
 
-//
-// allocate a new model
-//
-	COM_FileBase (mod->name, loadname, sizeof(loadname));
-
-	loadmodel = mod;
-
-//
-// fill it in
-//
-
-// call the apropriate loader
-	mod->needload = false;
-
-	mod_type = (buf[0] | (buf[1] << 8) | (buf[2] << 16) | (buf[3] << 24));
-	switch (mod_type)
-	{
-	case IDPOLYHEADER:
-		Mod_LoadAliasModel (mod, buf);
-		break;
-
-	case IDSPRITEHEADER:
-		Mod_LoadSpriteModel (mod, buf);
-		break;
+	Mod_LoadBuffer (mod, buf, file.len);
 
-	default:
-		Mod_LoadBrushModel (mod, buf);
-		break;
-	}
+	COM_UnmapFile (&file);
 
 	return mod;
 }
@@ -417,6 +702,168 @@ qmodel_t *Mod_ForName (const char *name, qboolean crash)
 }
 
 
+/*
+===============================================================================
+
+BACKGROUND LOADING
+
+Models precached while the game runs are read on the loader threads, and
+loaded on the main thread a few at a time, so that a burst of late precaches
+doesn't stall a single frame. Brush models are still loaded right away, the
+server needs their hulls as soon as they are set.
+
+===============================================================================
+*/
+
+typedef struct modelrequest_s
+{
+	qmodel_t		*mod;
+	asyncfile_t		*file;		// NULL once read
+	unsigned int	path_id;
+	byte			*data;		// NULL if the read failed
+	int				len;
+	modelfunc_t		func;
+	void			*userdata;
+	struct modelrequest_s	*next;
+} modelrequest_t;
+
+static modelrequest_t	*mod_requests;	// in request order
+
+static void Mod_RequestRead (byte *data, int len, void *userdata)
+{
+	modelrequest_t	*req = (modelrequest_t *) userdata;
+
+	req->file = NULL;
+	req->data = data;
+	req->len = len;
+}
+
+/*
+==================
+Mod_RequestModel
+==================
+*/
+qboolean Mod_RequestModel (const char *name, modelfunc_t func, void *userdata)
+{
+	modelrequest_t	*req, **link;
+	qmodel_t		*mod;
+	const char		*ext;
+
+	ext = COM_FileGetExtension (name);
+	if (name[0] == '*' || !q_strcasecmp (ext, "bsp"))
+		return false;
+
+	mod = Mod_FindName (name);
+	if (Mod_IsLoaded (mod))
+		return false;
+
+	req = (modelrequest_t *) calloc (1, sizeof(modelrequest_t));
+	if (!req)
+		Sys_Error ("Mod_RequestModel: out of memory");
+
+	req->mod = mod;
+	req->func = func;
+	req->userdata = userdata;
+	req->file = Async_ProcessFile (name, &req->path_id, NULL, Mod_RequestRead, req);
+	if (!req->file)
+	{
+		free (req);
+		return false;	// let Mod_ForName complain
+	}
+
+	for (link = &mod_requests; *link; link = &(*link)->next)
+		;
+	*link = req;
+
+	return true;
+}
+
+/*
+==================
+Mod_LoadRequests
+==================
+*/
+void Mod_LoadRequests (void)
+{
+	static byte		*data;	// static so a Host_Error during loading doesn't leak it
+	modelrequest_t	*req, **link;
+	qmodel_t		*mod;
+	modelfunc_t		func;
+	void			*userdata;
+	unsigned int	path_id;
+	int				len;
+	double			start;
+	qboolean		first;
+
+	free (data);
+	data = NULL;
+
+	if (!mod_requests)
+		return;
+
+	start = Sys_DoubleTime ();
+	first = true;
+
+	for (link = &mod_requests; *link; )
+	{
+		req = *link;
+		if (req->file)
+		{
+			link = &req->next;
+			continue;
+		}
+		if (!first && (Sys_DoubleTime () - start) * 1000.0 >= mod_requesttime.value)
+			break;
+
+		*link = req->next;
+		first = false;
+
+		mod = req->mod;
+		data = req->data;
+		len = req->len;
+		path_id = req->path_id;
+		func = req->func;
+		userdata = req->userdata;
+		free (req);
+
+		if (!Mod_IsLoaded (mod))
+		{
+			if (data)
+			{
+				mod->path_id = path_id;
+				Mod_LoadBuffer (mod, data, len);
+			}
+			else
+				mod = Mod_LoadModel (mod, false);
+		}
+		free (data);
+		data = NULL;
+
+		func (mod, userdata);
+	}
+}
+
+/*
+==================
+Mod_CancelRequests
+==================
+*/
+static void Mod_CancelRequests (void)
+{
+	modelrequest_t	*req;
+
+	while (mod_requests)
+	{
+		req = mod_requests;
+		mod_requests = req->next;
+		if (req->file)
+			Async_Cancel (req->file);
+		free (req->data);
+		free (req);
+	}
+}
+
+
 /*
 ===============================================================================
 
@@ -639,7 +1086,93 @@ static qboolean Mod_CheckAnimTextureArrayQ64(texture_t *anims[], int numTex)
 		if (!anims[i])
 			return false;
 	}
-	return true;
+	return true;
+}
+
+#define EXTTEX_AHEAD	16	// external textures being read ahead of the one that is loaded
+
+typedef struct
+{
+	char			name[MAX_OSPATH];	// without extension, empty if there is none
+	char			glowname[MAX_OSPATH];
+	imagerequest_t	image, glow;
+} exttexture_t;
+
+// indexed by texture number modulo EXTTEX_AHEAD. Not on the stack, since
+// a load error can leave reads behind that still write to it.
+static exttexture_t	exttextures[EXTTEX_AHEAD];
+
+static void Mod_CancelExternalTexture (exttexture_t *ext)
+{
+	Image_CancelImage (&ext->image);
+	Image_CancelImage (&ext->glow);
+	ext->name[0] = ext->glowname[0] = 0;
+}
+
+/*
+=================
+Mod_RequestExternalTexture
+
+Starts reading the external images Mod_LoadTextures will use for texture
+num, looking in the same places
+=================
+*/
+static void Mod_RequestExternalTexture (dmiptexlump_t *m, int num, const char *mapname)
+{
+	exttexture_t	*ext = &exttextures[num % EXTTEX_AHEAD];
+	char		name[sizeof(((miptex_t *)0)->name) + 1];
+	miptex_t	*mt;
+	int			ofs;
+
+	Mod_CancelExternalTexture (ext);
+
+	ofs = LittleLong (m->dataofs[num]);	// not swapped yet
+	if (ofs == -1)
+		return;
+	mt = (miptex_t *)((byte *)m + ofs);
+	memcpy (name, mt->name, sizeof(mt->name));
+	name[sizeof(mt->name)] = 0;
+
+#ifdef BSP29_VALVE
+	if (loadmodel->bspversion != BSPVERSION_VALVE && !q_strncasecmp(name,"sky",3))
+#else
+	if (!q_strncasecmp(name,"sky",3))
+#endif
+		return;
+
+	if (name[0] == '*' || name[0] == '!')
+	{
+		q_snprintf (ext->name, sizeof(ext->name), "textures/%s/#%s", mapname, name+1);
+		if (Image_RequestImage (ext->name, &ext->image))
+			return;
+		q_snprintf (ext->name, sizeof(ext->name), "textures/#%s", name+1);
+		if (Image_RequestImage (ext->name, &ext->image))
+			return;
+	}
+	else
+	{
+		q_snprintf (ext->name, sizeof(ext->name), "textures/%s/%s", mapname, name);
+		if (!Image_RequestImage (ext->name, &ext->image))
+		{
+			q_snprintf (ext->name, sizeof(ext->name), "textures/%s", name);
+			if (!Image_RequestImage (ext->name, &ext->image))
+			{
+				ext->name[0] = 0;
+				return;
+			}
+		}
+
+		q_snprintf (ext->glowname, sizeof(ext->glowname), "%s_glow", ext->name);
+		if (Image_RequestImage (ext->glowname, &ext->glow))
+			return;
+		q_snprintf (ext->glowname, sizeof(ext->glowname), "%s_luma", ext->name);
+		if (Image_RequestImage (ext->glowname, &ext->glow))
+			return;
+		ext->glowname[0] = 0;
+		return;
+	}
+
+	ext->name[0] = 0;
 }
 
 /*
@@ -662,6 +1195,8 @@ static void Mod_LoadTextures (lump_t *l)
 	int			mark, fwidth, fheight;
 	char		filename[MAX_OSPATH], mapname[MAX_OSPATH];
 	byte		*data;
+	exttexture_t	*ext;
+	int			requested;
 	extern byte *hunk_base;
 //johnfitz
 	unsigned int	flags;
@@ -698,8 +1233,19 @@ static void Mod_LoadTextures (lump_t *l)
 	// load any wads this map may need to load external textures from
 	wads = Mod_LoadWadFiles (loadmodel);
 
+	//external textures -- first look in "textures/mapname/" then look in "textures/"
+	COM_StripExtension (loadmodel->name + 5, mapname, sizeof(mapname));
+	for (i=0 ; i<EXTTEX_AHEAD ; i++)
+		Mod_CancelExternalTexture (&exttextures[i]);	// left behind by an error
+	requested = 0;
+
 	for (i=0 ; i<nummiptex ; i++)
 	{
+		// no texture uploading for dedicated server
+		for ( ; !isDedicated && requested < nummiptex && requested < i + EXTTEX_AHEAD; requested++)
+			Mod_RequestExternalTexture (m, requested, mapname);
+		ext = &exttextures[i % EXTTEX_AHEAD];
+
 		m->dataofs[i] = LittleLong(m->dataofs[i]);
 		if (m->dataofs[i] == -1)
 			continue;
@@ -835,15 +1381,13 @@ _load_texture:
 			}
 			else if (tx->name[0] == '*' || tx->name[0] == '!') //warping texture
 			{
-				//external textures -- first look in "textures/mapname/" then look in "textures/"
+				//external textures, already being read by Mod_RequestExternalTexture
 				mark = Hunk_LowMark();
-				COM_StripExtension (loadmodel->name + 5, mapname, sizeof(mapname));
-				q_snprintf (filename, sizeof(filename), "textures/%s/#%s", mapname, tx->name+1); //this also replaces the '*' with a '#'
-				data = Image_LoadImage (filename, &fwidth, &fheight);
-				if (!data)
+				data = NULL;
+				if (ext->name[0]) //the name has the '*' replaced with a '#'
 				{
-					q_snprintf (filename, sizeof(filename), "textures/#%s", tx->name+1);
-					data = Image_LoadImage (filename, &fwidth, &fheight);
+					q_strlcpy (filename, ext->name, sizeof(filename));
+					data = Image_FinishImage (&ext->image, &fwidth, &fheight);
 				}
 
 				//now load whatever we found
@@ -895,15 +1439,13 @@ _load_texture:
 					extraflags |= TEXPREF_ALPHA;
 				// ericw
 
-				//external textures -- first look in "textures/mapname/" then look in "textures/"
+				//external textures, already being read by Mod_RequestExternalTexture
 				mark = Hunk_LowMark ();
-				COM_StripExtension (loadmodel->name + 5, mapname, sizeof(mapname));
-				q_snprintf (filename, sizeof(filename), "textures/%s/%s", mapname, tx->name);
-				data = Image_LoadImage (filename, &fwidth, &fheight);
-				if (!data)
+				data = NULL;
+				if (ext->name[0])
 				{
-					q_snprintf (filename, sizeof(filename), "textures/%s", tx->name);
-					data = Image_LoadImage (filename, &fwidth, &fheight);
+					q_strlcpy (filename, ext->name, sizeof(filename));
+					data = Image_FinishImage (&ext->image, &fwidth, &fheight);
 				}
 
 				//now load whatever we found
@@ -915,12 +1457,11 @@ _load_texture:
 
 					//now try to load glow/luma image from the same place
 					Hunk_FreeToLowMark (mark);
-					q_snprintf (filename2, sizeof(filename2), "%s_glow", filename);
-					data = Image_LoadImage (filename2, &fwidth, &fheight);
-					if (!data)
+					data = NULL;
+					if (ext->glowname[0])
 					{
-						q_snprintf (filename2, sizeof(filename2), "%s_luma", filename);
-						data = Image_LoadImage (filename2, &fwidth, &fheight);
+						q_strlcpy (filename2, ext->glowname, sizeof(filename2));
+						data = Image_FinishImage (&ext->glow, &fwidth, &fheight);
 					}
 
 					if (data)
@@ -973,6 +1514,9 @@ _load_texture:
 		//johnfitz
 	}
 
+	for (i=0 ; i<EXTTEX_AHEAD ; i++)
+		Mod_CancelExternalTexture (&exttextures[i]);	// textures that were skipped
+
 	// we no longer need the wads after this point
 	W_FreeWadList (wads);
 
@@ -1281,16 +1825,123 @@ _load_embedded:
 }
 
 
+/*
+==============================================================================
+
+PARALLEL LUMP CONVERSION
+
+Lumps that only have to be converted into hunk memory that is already
+allocated are queued, and the queue is run on the job workers once a later
+stage needs them. All hunk allocations stay on the main thread and in the
+original order, so the model comes out exactly as with a serial load.
+
+==============================================================================
+*/
+
+#define LUMP_CHUNK		2048	// elements per job
+#define MAX_LUMP_TASKS	8
+
+// converts elements [first, first + count) of in to out
+typedef void (*lumpfunc_t) (const void *in, void *out, int first, int count);
+
+typedef struct
+{
+	lumpfunc_t	func;
+	const void	*in;
+	void		*out;
+	int			count;
+	int			firstjob;
+} lumptask_t;
+
+static lumptask_t	mod_lumptasks[MAX_LUMP_TASKS];
+static int			mod_numlumptasks;
+static int			mod_numlumpjobs;
+
+// set by workers, reported on the main thread once the queue is done
+static SDL_atomic_t	mod_badextents;
+static SDL_atomic_t	mod_badclipnodes;
+
+static cvar_t	mod_parallelload = {"mod_parallelload", "1", CVAR_NONE};	// 0 converts every lump right away
+
+static void Mod_LumpJob (void *data, int index, int worker)
+{
+	lumptask_t	*task = mod_lumptasks;
+	int			first;
+
+	while (task + 1 < mod_lumptasks + mod_numlumptasks && task[1].firstjob <= index)
+		task++;
+
+	first = (index - task->firstjob) * LUMP_CHUNK;
+	task->func (task->in, task->out, first, q_min (task->count - first, LUMP_CHUNK));
+}
+
+/*
+=================
+Mod_FinishLumps
+
+Runs everything queued so far
+=================
+*/
+static void Mod_FinishLumps (void)
+{
+	if (mod_numlumpjobs)
+		Jobs_ParallelFor (Mod_LumpJob, NULL, mod_numlumpjobs);
+
+	mod_numlumptasks = mod_numlumpjobs = 0;
+
+	if (SDL_AtomicSet (&mod_badextents, 0))
+		Sys_Error ("Bad surface extents");
+	if (SDL_AtomicSet (&mod_badclipnodes, 0))
+		Host_Error ("Mod_LoadClipnodes: planenum out of bounds");
+}
+
+static void Mod_QueueLump (lumpfunc_t func, const void *in, void *out, int count)
+{
+	lumptask_t	*task;
+
+	if (!mod_parallelload.value || Jobs_NumWorkers () == 1)
+	{
+		func (in, out, 0, count);
+		return;
+	}
+
+	if (mod_numlumptasks == MAX_LUMP_TASKS)
+		Mod_FinishLumps ();
+
+	task = &mod_lumptasks[mod_numlumptasks++];
+	task->func = func;
+	task->in = in;
+	task->out = out;
+	task->count = count;
+	task->firstjob = mod_numlumpjobs;
+	mod_numlumpjobs += (count + LUMP_CHUNK - 1) / LUMP_CHUNK;
+}
+
+
 /*
 =================
 Mod_LoadVertexes
 =================
 */
+static void Mod_ConvertVertexes (const void *data, void *outdata, int first, int count)
+{
+	const dvertex_t	*in = (const dvertex_t *) data + first;
+	mvertex_t	*out = (mvertex_t *) outdata + first;
+	int			i;
+
+	for (i=0 ; i<count ; i++, in++, out++)
+	{
+		out->position[0] = LittleFloat (in->point[0]);
+		out->position[1] = LittleFloat (in->point[1]);
+		out->position[2] = LittleFloat (in->point[2]);
+	}
+}
+
 static void Mod_LoadVertexes (lump_t *l)
 {
 	dvertex_t	*in;
 	mvertex_t	*out;
-	int			i, count;
+	int			count;
 
 	in = (dvertex_t *)(mod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
@@ -1301,12 +1952,7 @@ static void Mod_LoadVertexes (lump_t *l)
 	loadmodel->vertexes = out;
 	loadmodel->numvertexes = count;
 
-	for (i=0 ; i<count ; i++, in++, out++)
-	{
-		out->position[0] = LittleFloat (in->point[0]);
-		out->position[1] = LittleFloat (in->point[1]);
-		out->position[2] = LittleFloat (in->point[2]);
-	}
+	Mod_QueueLump (Mod_ConvertVertexes, in, out, count);
 }
 
 /*
@@ -1314,10 +1960,36 @@ static void Mod_LoadVertexes (lump_t *l)
 Mod_LoadEdges
 =================
 */
+static void Mod_ConvertEdgesL (const void *data, void *outdata, int first, int count)
+{
+	const dledge_t	*in = (const dledge_t *) data + first;
+	medge_t	*out = (medge_t *) outdata + first;
+	int		i;
+
+	for (i=0 ; i<count ; i++, in++, out++)
+	{
+		out->v[0] = LittleLong(in->v[0]);
+		out->v[1] = LittleLong(in->v[1]);
+	}
+}
+
+static void Mod_ConvertEdgesS (const void *data, void *outdata, int first, int count)
+{
+	const dsedge_t	*in = (const dsedge_t *) data + first;
+	medge_t	*out = (medge_t *) outdata + first;
+	int		i;
+
+	for (i=0 ; i<count ; i++, in++, out++)
+	{
+		out->v[0] = (unsigned short)LittleShort(in->v[0]);
+		out->v[1] = (unsigned short)LittleShort(in->v[1]);
+	}
+}
+
 static void Mod_LoadEdges (lump_t *l, int bsp2)
 {
 	medge_t *out;
-	int 	i, count;
+	int 	count;
 
 	if (bsp2)
 	{
@@ -1332,11 +2004,7 @@ static void Mod_LoadEdges (lump_t *l, int bsp2)
 		loadmodel->edges = out;
 		loadmodel->numedges = count;
 
-		for (i=0 ; i<count ; i++, in++, out++)
-		{
-			out->v[0] = LittleLong(in->v[0]);
-			out->v[1] = LittleLong(in->v[1]);
-		}
+		Mod_QueueLump (Mod_ConvertEdgesL, in, out, count);
 	}
 	else
 	{
@@ -1351,11 +2019,7 @@ static void Mod_LoadEdges (lump_t *l, int bsp2)
 		loadmodel->edges = out;
 		loadmodel->numedges = count;
 
-		for (i=0 ; i<count ; i++, in++, out++)
-		{
-			out->v[0] = (unsigned short)LittleShort(in->v[0]);
-			out->v[1] = (unsigned short)LittleShort(in->v[1]);
-		}
+		Mod_QueueLump (Mod_ConvertEdgesS, in, out, count);
 	}
 }
 
@@ -1480,7 +2144,7 @@ static void CalcSurfaceExtents (msurface_t *s)
 		s->extents[i] = (bmaxs[i] - bmins[i]) * 16;
 
 		if ( !(tex->flags & TEX_SPECIAL) && s->extents[i] > 2000) //johnfitz -- was 512 in glquake, 256 in winquake
-			Sys_Error ("Bad surface extents");
+			SDL_AtomicSet (&mod_badextents, 1);	// may be on a worker, Mod_FinishLumps reports it
 	}
 }
 
@@ -1563,13 +2227,76 @@ static void Mod_CalcSurfaceBounds (msurface_t *s)
 Mod_LoadFaces
 =================
 */
+// everything that only depends on the face itself
+static void Mod_SetupFace (msurface_t *out, int planenum, int side, int texinfon, int lofs)
+{
+	out->flags = 0;
+
+	if (side)
+		out->flags |= SURF_PLANEBACK;
+
+	out->plane = loadmodel->planes + planenum;
+
+	out->texinfo = loadmodel->texinfo + texinfon;
+
+	CalcSurfaceExtents (out);
+
+	Mod_CalcSurfaceBounds (out); //johnfitz -- for per-surface frustum culling
+
+// lighting info
+	if (loadmodel->bspversion == BSPVERSION_QUAKE64)
+		lofs /= 2; // Q64 samples are 16bits instead 8 in normal Quake 
+
+	if (lofs == -1)
+		out->samples = NULL;
+#ifdef BSP29_VALVE
+	else if (loadmodel->bspversion == BSPVERSION_VALVE)
+		out->samples = loadmodel->lightdata + lofs; // accounts for RGB light data
+#endif
+	else
+		out->samples = loadmodel->lightdata + (lofs * 3); //johnfitz -- lit support via lordhavoc (was "+ i")
+}
+
+static void Mod_ConvertFacesL (const void *data, void *outdata, int first, int count)
+{
+	const dlface_t	*inl = (const dlface_t *) data + first;
+	msurface_t	*out = (msurface_t *) outdata + first;
+	int			i, j;
+
+	for (i=0 ; i<count ; i++, inl++, out++)
+	{
+		out->firstedge = LittleLong(inl->firstedge);
+		out->numedges = LittleLong(inl->numedges);
+		for (j=0 ; j<MAXLIGHTMAPS ; j++)
+			out->styles[j] = inl->styles[j];
+		Mod_SetupFace (out, LittleLong(inl->planenum), LittleLong(inl->side),
+			LittleLong (inl->texinfo), LittleLong(inl->lightofs));
+	}
+}
+
+static void Mod_ConvertFacesS (const void *data, void *outdata, int first, int count)
+{
+	const dsface_t	*ins = (const dsface_t *) data + first;
+	msurface_t	*out = (msurface_t *) outdata + first;
+	int			i, j;
+
+	for (i=0 ; i<count ; i++, ins++, out++)
+	{
+		out->firstedge = LittleLong(ins->firstedge);
+		out->numedges = LittleShort(ins->numedges);
+		for (j=0 ; j<MAXLIGHTMAPS ; j++)
+			out->styles[j] = ins->styles[j];
+		Mod_SetupFace (out, LittleShort(ins->planenum), LittleShort(ins->side),
+			LittleShort (ins->texinfo), LittleLong(ins->lightofs));
+	}
+}
+
 static void Mod_LoadFaces (lump_t *l, qboolean bsp2)
 {
 	dsface_t	*ins;
 	dlface_t	*inl;
 	msurface_t 	*out;
-	int			i, count, surfnum, lofs;
-	int			planenum, side, texinfon;
+	int			count, surfnum;
 
 	if (bsp2)
 	{
@@ -1597,66 +2324,26 @@ static void Mod_LoadFaces (lump_t *l, qboolean bsp2)
 	loadmodel->surfaces = out;
 	loadmodel->numsurfaces = count;
 
+	// faces need the vertexes, edges and planes, then the per face work
+	// runs on the workers, and only what allocates is left for this loop
+	Mod_FinishLumps ();
+	if (bsp2)
+		Mod_QueueLump (Mod_ConvertFacesL, inl, out, count);
+	else
+		Mod_QueueLump (Mod_ConvertFacesS, ins, out, count);
+	Mod_FinishLumps ();
+
 	for (surfnum=0 ; surfnum<count ; surfnum++, out++)
 	{
-		if (bsp2)
-		{
-			out->firstedge = LittleLong(inl->firstedge);
-			out->numedges = LittleLong(inl->numedges);
-			planenum = LittleLong(inl->planenum);
-			side = LittleLong(inl->side);
-			texinfon = LittleLong (inl->texinfo);
-			for (i=0 ; i<MAXLIGHTMAPS ; i++)
-				out->styles[i] = inl->styles[i];
-			lofs = LittleLong(inl->lightofs);
-			inl++;
-		}
-		else
-		{
-			out->firstedge = LittleLong(ins->firstedge);
-			out->numedges = LittleShort(ins->numedges);
-			planenum = LittleShort(ins->planenum);
-			side = LittleShort(ins->side);
-			texinfon = LittleShort (ins->texinfo);
-			for (i=0 ; i<MAXLIGHTMAPS ; i++)
-				out->styles[i] = ins->styles[i];
-			lofs = LittleLong(ins->lightofs);
-			ins++;
-		}
-
-		out->flags = 0;
 		if (out->numedges < 3)
 			Con_Warning("surfnum %d: bad numedges %d\n", surfnum, out->numedges);
 
-		if (side)
-			out->flags |= SURF_PLANEBACK;
-
-		out->plane = loadmodel->planes + planenum;
-
-		out->texinfo = loadmodel->texinfo + texinfon;
-
-		CalcSurfaceExtents (out);
-
-		Mod_CalcSurfaceBounds (out); //johnfitz -- for per-surface frustum culling
-
-	// lighting info
-		if (loadmodel->bspversion == BSPVERSION_QUAKE64)
-			lofs /= 2; // Q64 samples are 16bits instead 8 in normal Quake 
-
-		if (lofs == -1)
-			out->samples = NULL;
-#ifdef BSP29_VALVE
-		else if (loadmodel->bspversion == BSPVERSION_VALVE)
-			out->samples = loadmodel->lightdata + lofs; // accounts for RGB light data
-#endif
-		else
-			out->samples = loadmodel->lightdata + (lofs * 3); //johnfitz -- lit support via lordhavoc (was "+ i")
-
 		//johnfitz -- this section rewritten
 		if (!q_strncasecmp(out->texinfo->texture->name,"sky",3)) // sky surface //also note -- was Q_strncmp, changed to match qbsp
 		{
 			out->flags |= (SURF_DRAWSKY | SURF_DRAWTILED);
 			Mod_PolyForUnlitSurface (out); //no more subdivision
+			out->skybounds = (skybounds_t *) Hunk_Alloc (sizeof(skybounds_t));
 		}
 		else if (out->texinfo->texture->name[0] == '*' || out->texinfo->texture->name[0] == '!') // warp surface
 		{
@@ -2052,13 +2739,61 @@ static void Mod_LoadLeafs (lump_t *l, int bsp2)
 Mod_LoadClipnodes
 =================
 */
+static void Mod_ConvertClipnodesL (const void *data, void *outdata, int first, int count)
+{
+	const dlclipnode_t	*inl = (const dlclipnode_t *) data + first;
+	mclipnode_t	*out = (mclipnode_t *) outdata + first;
+	int			i;
+
+	for (i=0 ; i<count ; i++, out++, inl++)
+	{
+		out->planenum = LittleLong(inl->planenum);
+
+		//johnfitz -- bounds check
+		if (out->planenum < 0 || out->planenum >= loadmodel->numplanes)
+			SDL_AtomicSet (&mod_badclipnodes, 1);
+		//johnfitz
+
+		out->children[0] = LittleLong(inl->children[0]);
+		out->children[1] = LittleLong(inl->children[1]);
+		//Spike: FIXME: bounds check
+	}
+}
+
+static void Mod_ConvertClipnodesS (const void *data, void *outdata, int first, int count)
+{
+	const dsclipnode_t	*ins = (const dsclipnode_t *) data + first;
+	mclipnode_t	*out = (mclipnode_t *) outdata + first;
+	int			i;
+
+	for (i=0 ; i<count ; i++, out++, ins++)
+	{
+		out->planenum = LittleLong(ins->planenum);
+
+		//johnfitz -- bounds check
+		if (out->planenum < 0 || out->planenum >= loadmodel->numplanes)
+			SDL_AtomicSet (&mod_badclipnodes, 1);
+		//johnfitz
+
+		//johnfitz -- support clipnodes > 32k
+		out->children[0] = (unsigned short)LittleShort(ins->children[0]);
+		out->children[1] = (unsigned short)LittleShort(ins->children[1]);
+
+		if (out->children[0] >= loadmodel->numclipnodes)
+			out->children[0] -= 65536;
+		if (out->children[1] >= loadmodel->numclipnodes)
+			out->children[1] -= 65536;
+		//johnfitz
+	}
+}
+
 static void Mod_LoadClipnodes (lump_t *l, qboolean bsp2)
 {
 	dsclipnode_t *ins;
 	dlclipnode_t *inl;
 
 	mclipnode_t *out; //johnfitz -- was dclipnode_t
-	int			i, count;
+	int			count;
 	hull_t		*hull;
 
 	if (bsp2)
@@ -2114,43 +2849,9 @@ static void Mod_LoadClipnodes (lump_t *l, qboolean bsp2)
 	hull->clip_maxs[2] = 64;
 
 	if (bsp2)
-	{
-		for (i=0 ; i<count ; i++, out++, inl++)
-		{
-			out->planenum = LittleLong(inl->planenum);
-
-			//johnfitz -- bounds check
-			if (out->planenum < 0 || out->planenum >= loadmodel->numplanes)
-				Host_Error ("Mod_LoadClipnodes: planenum out of bounds");
-			//johnfitz
-
-			out->children[0] = LittleLong(inl->children[0]);
-			out->children[1] = LittleLong(inl->children[1]);
-			//Spike: FIXME: bounds check
-		}
-	}
+		Mod_QueueLump (Mod_ConvertClipnodesL, inl, out, count);
 	else
-	{
-		for (i=0 ; i<count ; i++, out++, ins++)
-		{
-			out->planenum = LittleLong(ins->planenum);
-
-			//johnfitz -- bounds check
-			if (out->planenum < 0 || out->planenum >= loadmodel->numplanes)
-				Host_Error ("Mod_LoadClipnodes: planenum out of bounds");
-			//johnfitz
-
-			//johnfitz -- support clipnodes > 32k
-			out->children[0] = (unsigned short)LittleShort(ins->children[0]);
-			out->children[1] = (unsigned short)LittleShort(ins->children[1]);
-
-			if (out->children[0] >= count)
-				out->children[0] -= 65536;
-			if (out->children[1] >= count)
-				out->children[1] -= 65536;
-			//johnfitz
-		}
-	}
+		Mod_QueueLump (Mod_ConvertClipnodesS, ins, out, count);
 }
 
 /*
@@ -2255,9 +2956,19 @@ static void Mod_LoadMarksurfaces (lump_t *l, int bsp2)
 Mod_LoadSurfedges
 =================
 */
+static void Mod_ConvertSurfedges (const void *data, void *outdata, int first, int count)
+{
+	const int	*in = (const int *) data;
+	int		*out = (int *) outdata;
+	int		i;
+
+	for (i=first ; i<first+count ; i++)
+		out[i] = LittleLong (in[i]);
+}
+
 static void Mod_LoadSurfedges (lump_t *l)
 {
-	int		i, count;
+	int		count;
 	int		*in, *out;
 
 	in = (int *)(mod_base + l->fileofs);
@@ -2269,8 +2980,7 @@ static void Mod_LoadSurfedges (lump_t *l)
 	loadmodel->surfedges = out;
 	loadmodel->numsurfedges = count;
 
-	for (i=0 ; i<count ; i++)
-		out[i] = LittleLong (in[i]);
+	Mod_QueueLump (Mod_ConvertSurfedges, in, out, count);
 }
 
 
@@ -2279,22 +2989,11 @@ static void Mod_LoadSurfedges (lump_t *l)
 Mod_LoadPlanes
 =================
 */
-static void Mod_LoadPlanes (lump_t *l)
+static void Mod_ConvertPlanes (const void *data, void *outdata, int first, int count)
 {
-	int			i, j;
-	mplane_t	*out;
-	dplane_t 	*in;
-	int			count;
-	int			bits;
-
-	in = (dplane_t *)(mod_base + l->fileofs);
-	if (l->filelen % sizeof(*in))
-		Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
-	count = l->filelen / sizeof(*in);
-	out = (mplane_t *) Hunk_AllocName ( count*2*sizeof(*out), loadname);
-
-	loadmodel->planes = out;
-	loadmodel->numplanes = count;
+	const dplane_t	*in = (const dplane_t *) data + first;
+	mplane_t	*out = (mplane_t *) outdata + first;
+	int			i, j, bits;
 
 	for (i=0 ; i<count ; i++, in++, out++)
 	{
@@ -2312,6 +3011,24 @@ static void Mod_LoadPlanes (lump_t *l)
 	}
 }
 
+static void Mod_LoadPlanes (lump_t *l)
+{
+	mplane_t	*out;
+	dplane_t 	*in;
+	int			count;
+
+	in = (dplane_t *)(mod_base + l->fileofs);
+	if (l->filelen % sizeof(*in))
+		Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
+	count = l->filelen / sizeof(*in);
+	out = (mplane_t *) Hunk_AllocName ( count*2*sizeof(*out), loadname);
+
+	loadmodel->planes = out;
+	loadmodel->numplanes = count;
+
+	Mod_QueueLump (Mod_ConvertPlanes, in, out, count);
+}
+
 /*
 =================
 RadiusFromBounds
@@ -2537,6 +3254,9 @@ static void Mod_LoadBrushModel (qmodel_t *mod, void *buffer)
 
 	loadmodel->type = mod_brush;
 
+	if (pvscache.model == mod)
+		Mod_ClearPVSCache ();
+
 	header = (dheader_t *)buffer;
 
 	mod->bspversion = LittleLong (header->version);
@@ -2567,6 +3287,9 @@ static void Mod_LoadBrushModel (qmodel_t *mod, void *buffer)
 
 // swap all the lumps
 	mod_base = (byte *)header;
+	mod_numlumptasks = mod_numlumpjobs = 0;	// in case an error left some behind
+	SDL_AtomicSet (&mod_badextents, 0);
+	SDL_AtomicSet (&mod_badclipnodes, 0);
 
 	for (i = 0; i < (int) sizeof(dheader_t) / 4; i++)
 		((int *)header)[i] = LittleLong ( ((int *)header)[i]);
@@ -2613,6 +3336,7 @@ visdone:
 	Mod_LoadNodes (&header->lumps[LUMP_NODES], bsp2);
 	Mod_LoadClipnodes (&header->lumps[LUMP_CLIPNODES], bsp2);
 	Mod_LoadSubmodels (&header->lumps[LUMP_MODELS]);
+	Mod_FinishLumps ();
 
 	Mod_MakeHull0 ();
 
@@ -2677,6 +3401,112 @@ visdone:
 	}
 }
 
+/*
+=================
+Mod_BrushChecksum
+
+Covers the lumps that are converted in parallel
+=================
+*/
+static unsigned Mod_BrushChecksum (qmodel_t *mod)
+{
+	unsigned	crc;
+
+	crc = CRC_Block ((byte *) mod->vertexes, mod->numvertexes * sizeof(mvertex_t));
+	crc = crc * 31 + CRC_Block ((byte *) mod->edges, mod->numedges * sizeof(medge_t));
+	crc = crc * 31 + CRC_Block ((byte *) mod->surfedges, mod->numsurfedges * sizeof(int));
+	crc = crc * 31 + CRC_Block ((byte *) mod->planes, mod->numplanes * sizeof(mplane_t));
+	crc = crc * 31 + CRC_Block ((byte *) mod->surfaces, mod->numsurfaces * sizeof(msurface_t));
+	crc = crc * 31 + CRC_Block ((byte *) mod->clipnodes, mod->numclipnodes * sizeof(mclipnode_t));
+
+	return crc;
+}
+
+/*
+=================
+Mod_LoadBench_f
+
+Loads the given maps, or every map there is, once serially and once with
+mod_parallelload, and checks that both give the same model. Every map is
+loaded once more before that, so that both runs find it in the file cache.
+=================
+*/
+static void Mod_LoadBench_f (void)
+{
+	filelist_item_t	*level;
+	char		name[MAX_QPATH];
+	qmodel_t	*mod;
+	unsigned	crc[3];
+	double		start, time[3], total[3];
+	float		oldparallel;
+	int			i, pass, mark, nummaps, mismatches;
+
+	if (sv.active || cls.state == ca_connected)
+	{
+		Con_Printf ("mod_loadbench: disconnect first\n");
+		return;
+	}
+
+	oldparallel = mod_parallelload.value;
+	mark = Hunk_LowMark ();
+	total[1] = total[2] = 0;
+	nummaps = mismatches = 0;
+
+	Con_Printf ("%i workers\n", Jobs_NumWorkers ());
+	Con_Printf ("map                        serial   parallel\n");
+
+	for (i = 1, level = extralevels; ; )
+	{
+		if (Cmd_Argc () > 1)
+		{
+			if (i == Cmd_Argc ())
+				break;
+			q_snprintf (name, sizeof(name), "maps/%s.bsp", Cmd_Argv (i++));
+		}
+		else
+		{
+			if (!level)
+				break;
+			q_snprintf (name, sizeof(name), "maps/%s.bsp", level->name);
+			level = level->next;
+		}
+
+		// warm up, serial, parallel
+		for (pass = 0; pass < 3; pass++)
+		{
+			Cvar_SetValueQuick (&mod_parallelload, pass == 2);
+
+			start = Sys_DoubleTime ();
+			mod = Mod_ForName (name, false);
+			time[pass] = Sys_DoubleTime () - start;
+			crc[pass] = mod ? Mod_BrushChecksum (mod) : 0;
+
+			Mod_ClearAll ();
+			Hunk_FreeToLowMark (mark);
+
+			if (!mod || mod->type != mod_brush)
+				break;
+		}
+		if (pass < 3)
+			continue;
+
+		Con_Printf ("%-24s %8.2f ms %8.2f ms%s\n", name + 5, time[1] * 1000.0, time[2] * 1000.0,
+			crc[1] != crc[2] ? "  MISMATCH" : "");
+		total[1] += time[1];
+		total[2] += time[2];
+		nummaps++;
+		if (crc[1] != crc[2])
+			mismatches++;
+	}
+
+	Cvar_SetValueQuick (&mod_parallelload, oldparallel);
+
+	Con_Printf ("%i maps, serial %.1f ms, parallel %.1f ms, %.2fx\n", nummaps,
+		total[1] * 1000.0, total[2] * 1000.0, total[2] > 0 ? total[1] / total[2] : 0.0);
+	if (mismatches)
+		Con_Printf ("WARNING: %i maps loaded differently\n", mismatches);
+}
+
 /*
 ==============================================================================
 
@@ -3442,5 +4272,7 @@ static void Mod_Print (void)
 		Con_SafePrintf ("%8p : %s\n", mod->cache.data, mod->name); //johnfitz -- safeprint instead of print
 	}
 	Con_Printf ("%i models\n",mod_numknown); //johnfitz -- print the total too
+	Con_Printf ("%i lookups, %.2f compares per lookup\n", mod_lookups,
+		mod_lookups ? (double) mod_probes / mod_lookups : 0.0);
 }
 
@@ -140,6 +140,17 @@ typedef struct glpoly_s
 	float	verts[4][VERTEXSIZE];	// variable sized (xyz s1t1 s2t2)
 } glpoly_t;
 
+// sky face bounds of a sky surface, these depend on where the surface is seen
+// from, so they are kept until the view moves relative to it
+typedef struct skybounds_s
+{
+	qboolean	valid;
+	vec3_t		origin;			// view origin in model space
+	vec3_t		angles;			// of the entity, zero for the world
+	int			faces;			// bit per skybox face touched
+	float		mins[2][6], maxs[2][6];
+} skybounds_t;
+
 typedef struct msurface_s
 {
 	int			visframe;		// should be drawn when node is crossed
@@ -158,6 +169,7 @@ typedef struct msurface_s
 	int			light_s, light_t;	// gl lightmap coordinates
 
 	glpoly_t	*polys;				// multiple if warped
+	skybounds_t	*skybounds;			// sky surfaces only
 	struct	msurface_s	*texturechain;
 
 	mtexinfo_t	*texinfo;
@@ -485,6 +497,8 @@ typedef struct qmodel_s
 
 	int			bspversion;
 	qboolean	haslitwater;
+	int			filesize;		// of the .bsp, -1 if r_bspcache was off when it was loaded
+	unsigned int	filehash;	// FNV-1a of the .bsp, with filesize the key of the lightmap cache
 //
 // alias model
 //
@@ -511,6 +525,16 @@ qmodel_t *Mod_ForName (const char *name, qboolean crash);
 void	*Mod_Extradata (qmodel_t *mod);	// handles caching
 void	Mod_TouchModel (const char *name);
 
+typedef void (*modelfunc_t) (qmodel_t *mod, void *userdata);
+qboolean Mod_RequestModel (const char *name, modelfunc_t func, void *userdata);
+// reads the model in the background, func gets it from a later
+// Mod_LoadRequests, or NULL if it couldn't be loaded. Returns false without
+// calling func if it has to be loaded with Mod_ForName, brush models always
+// are. func is never called if the models are cleared first.
+void	Mod_LoadRequests (void);
+// loads the models that have been read, at most mod_requesttime ms worth
+// per call after the first one
+
 mleaf_t *Mod_PointInLeaf (vec3_t p, qmodel_t *model);
 byte	*Mod_LeafPVS (mleaf_t *leaf, qmodel_t *model);
 byte	*Mod_NoVisPVS (qmodel_t *model);
@@ -30,10 +30,14 @@ int			r_visframecount;	// bumped when going to a new PVS
 int			r_framecount;		// used for dlight push checking
 
 mplane_t	frustum[4];
+static int	r_frustumcount;	// bumped by R_SetFrustum, tags cached entity culling
 
 //johnfitz -- rendering statistics
 int rs_brushpolys, rs_aliaspolys, rs_skypolys;
 int rs_dynamiclightmaps, rs_brushpasses, rs_aliaspasses, rs_skypasses;
+int rs_pvsleafs, rs_pvssurfs, rs_pvsrebuilds;
+int rs_lightmaprects, rs_lightmapbytes;
+int rs_texbinds, rs_programbinds;
 
 //
 // view origin
@@ -89,6 +93,10 @@ cvar_t	gl_farclip = {"gl_farclip", "65536", CVAR_ARCHIVE};
 cvar_t	gl_overbright = {"gl_overbright", "1", CVAR_ARCHIVE};
 cvar_t	gl_overbright_models = {"gl_overbright_models", "1", CVAR_ARCHIVE};
 cvar_t	r_oldskyleaf = {"r_oldskyleaf", "0", CVAR_NONE};
+cvar_t	r_parallelcull = {"r_parallelcull", "1", CVAR_NONE};
+cvar_t	r_parallellightmaps = {"r_parallellightmaps", "1", CVAR_NONE};
+cvar_t	r_bspcache = {"r_bspcache", "1", CVAR_ARCHIVE};
+cvar_t	r_sortentities = {"r_sortentities", "1", CVAR_NONE};
 cvar_t	r_drawworld = {"r_drawworld", "1", CVAR_NONE};
 cvar_t	r_showtris = {"r_showtris", "0", CVAR_NONE};
 cvar_t	r_showbboxes = {"r_showbboxes", "0", CVAR_NONE};
@@ -259,7 +267,7 @@ void GLSLGamma_GammaCorrect (void)
 	glCopyTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0, glx, gly, glwidth, glheight);
 
 // draw the texture back to the framebuffer with a fragment shader
-	GL_UseProgramFunc (r_gamma_program);
+	GL_UseProgram (r_gamma_program);
 	GL_Uniform1fFunc (gammaLoc, vid_gamma.value);
 	GL_Uniform1fFunc (contrastLoc, q_min(2.0f, q_max(1.0f, vid_contrast.value)));
 	GL_Uniform1iFunc (textureLoc, 0); // use texture unit 0
@@ -283,7 +291,7 @@ void GLSLGamma_GammaCorrect (void)
 	glVertex2f (-1, 1);
 	glEnd ();
 
-	GL_UseProgramFunc (0);
+	GL_UseProgram (0);
 
 // clear cached binding
 	GL_ClearBindings ();
@@ -316,14 +324,126 @@ qboolean R_CullBox (vec3_t emins, vec3_t emaxs)
 	return false;
 }
 
+/*
+=================
+R_CullBoxes
+
+Tests boxes first to first + count - 1 against the frustum like R_CullBox,
+four at a time with SIMD. Sets visible[i] to 1 for the boxes that are at
+least partly inside and 0 for the others, returns the number of visible boxes.
+=================
+*/
+int R_CullBoxes (const cullboxes_t *boxes, int first, int count, byte *visible, qboolean simd)
+{
+	const float	*corner[4][3];	// the box corner furthest along each plane normal
+	mplane_t	*p;
+	int			i, j, end, numvisible;
+
+	for (i = 0; i < 4; i++)
+	{
+		p = frustum + i;
+		for (j = 0; j < 3; j++)
+			corner[i][j] = (p->signbits & (1 << j)) ? boxes->mins[j] : boxes->maxs[j];
+	}
+
+	i = first;
+	end = first + count;
+	numvisible = 0;
+
+#if defined(USE_SSE)
+	if (simd)
+	{
+		__m128	nx[4], ny[4], nz[4], dist[4], out, dot;
+		int		mask;
+
+		for (j = 0; j < 4; j++)
+		{
+			nx[j] = _mm_set1_ps (frustum[j].normal[0]);
+			ny[j] = _mm_set1_ps (frustum[j].normal[1]);
+			nz[j] = _mm_set1_ps (frustum[j].normal[2]);
+			dist[j] = _mm_set1_ps (frustum[j].dist);
+		}
+
+		for ( ; i + 4 <= end; i += 4)
+		{
+			out = _mm_setzero_ps ();
+			for (j = 0; j < 4; j++)
+			{
+				dot = _mm_add_ps (_mm_add_ps (
+					_mm_mul_ps (nx[j], _mm_loadu_ps (corner[j][0] + i)),
+					_mm_mul_ps (ny[j], _mm_loadu_ps (corner[j][1] + i))),
+					_mm_mul_ps (nz[j], _mm_loadu_ps (corner[j][2] + i)));
+				out = _mm_or_ps (out, _mm_cmplt_ps (dot, dist[j]));
+			}
+
+			mask = _mm_movemask_ps (out);
+			for (j = 0; j < 4; j++)
+			{
+				visible[i + j] = !(mask & (1 << j));
+				numvisible += visible[i + j];
+			}
+		}
+	}
+#elif defined(USE_NEON)
+	// separate multiply and add, so the result matches the scalar code
+	if (simd)
+	{
+		float32x4_t	nx[4], ny[4], nz[4], dist[4], dot;
+		uint32x4_t	out;
+
+		for (j = 0; j < 4; j++)
+		{
+			nx[j] = vdupq_n_f32 (frustum[j].normal[0]);
+			ny[j] = vdupq_n_f32 (frustum[j].normal[1]);
+			nz[j] = vdupq_n_f32 (frustum[j].normal[2]);
+			dist[j] = vdupq_n_f32 (frustum[j].dist);
+		}
+
+		for ( ; i + 4 <= end; i += 4)
+		{
+			out = vdupq_n_u32 (0);
+			for (j = 0; j < 4; j++)
+			{
+				dot = vaddq_f32 (vaddq_f32 (
+					vmulq_f32 (nx[j], vld1q_f32 (corner[j][0] + i)),
+					vmulq_f32 (ny[j], vld1q_f32 (corner[j][1] + i))),
+					vmulq_f32 (nz[j], vld1q_f32 (corner[j][2] + i)));
+				out = vorrq_u32 (out, vcltq_f32 (dot, dist[j]));
+			}
+
+			visible[i + 0] = !vgetq_lane_u32 (out, 0);
+			visible[i + 1] = !vgetq_lane_u32 (out, 1);
+			visible[i + 2] = !vgetq_lane_u32 (out, 2);
+			visible[i + 3] = !vgetq_lane_u32 (out, 3);
+			numvisible += visible[i] + visible[i + 1] + visible[i + 2] + visible[i + 3];
+		}
+	}
+#endif
+
+	for ( ; i < end; i++)
+	{
+		visible[i] = 1;
+		for (j = 0, p = frustum; j < 4; j++, p++)
+		{
+			if (p->normal[0]*corner[j][0][i] + p->normal[1]*corner[j][1][i] + p->normal[2]*corner[j][2][i] < p->dist)
+			{
+				visible[i] = 0;
+				break;
+			}
+		}
+		numvisible += visible[i];
+	}
+
+	return numvisible;
+}
+
 /*
 ===============
-R_CullModelForEntity -- johnfitz -- uses correct bounds based on rotation
+R_EntityBounds -- johnfitz -- uses correct bounds based on rotation
 ===============
 */
-qboolean R_CullModelForEntity (entity_t *e)
+static void R_EntityBounds (entity_t *e, vec3_t mins, vec3_t maxs)
 {
-	vec3_t mins, maxs;
 	vec_t scalefactor, *minbounds, *maxbounds;
 
 	if (e->angles[0] || e->angles[2]) //pitch or roll
@@ -353,7 +473,64 @@ qboolean R_CullModelForEntity (entity_t *e)
 		VectorAdd (e->origin, minbounds, mins);
 		VectorAdd (e->origin, maxbounds, maxs);
 	}
+}
+
+/*
+===============
+R_CullEntities
+
+Culls all visedicts in one batch, R_CullModelForEntity returns the stored
+result until the frustum changes
+===============
+*/
+void R_CullEntities (void)
+{
+	static float	bounds[6][MAX_VISEDICTS];
+	static byte		visible[MAX_VISEDICTS];
+	cullboxes_t		boxes;
+	vec3_t			mins, maxs;
+	entity_t		*e;
+	int				i, j;
+
+	for (j = 0; j < 3; j++)
+	{
+		boxes.mins[j] = bounds[j];
+		boxes.maxs[j] = bounds[3 + j];
+	}
+
+	for (i = 0; i < cl_numvisedicts; i++)
+	{
+		R_EntityBounds (cl_visedicts[i], mins, maxs);
+		for (j = 0; j < 3; j++)
+		{
+			bounds[j][i] = mins[j];
+			bounds[3 + j][i] = maxs[j];
+		}
+	}
 
+	R_CullBoxes (&boxes, 0, cl_numvisedicts, visible, true);
+
+	for (i = 0; i < cl_numvisedicts; i++)
+	{
+		e = cl_visedicts[i];
+		e->cullframe = r_frustumcount;
+		e->culled = !visible[i];
+	}
+}
+
+/*
+===============
+R_CullModelForEntity
+===============
+*/
+qboolean R_CullModelForEntity (entity_t *e)
+{
+	vec3_t mins, maxs;
+
+	if (e->cullframe == r_frustumcount)
+		return e->culled;
+
+	R_EntityBounds (e, mins, maxs);
 	return R_CullBox (mins, maxs);
 }
 
@@ -467,6 +644,8 @@ void R_SetFrustum (float fovx, float fovy)
 		frustum[i].dist = DotProduct (r_origin, frustum[i].normal); //FIXME: shouldn't this always be zero?
 		frustum[i].signbits = SignbitsForPlane (&frustum[i]);
 	}
+
+	r_frustumcount++;
 }
 
 /*
@@ -602,6 +781,8 @@ void R_SetupView (void)
 
 	R_MarkSurfaces (); //johnfitz -- create texture chains from PVS
 
+	R_CullEntities (); // after R_MarkSurfaces added the static entities
+
 	R_UpdateWarpTextures (); //johnfitz -- do this before R_Clear
 
 	R_Clear ();
@@ -626,6 +807,65 @@ void R_SetupView (void)
 //
 //==============================================================================
 
+/*
+=============
+R_EntitySortKey
+
+Opaque entities are drawn grouped by model type, which also decides the
+shader program, then by texture and model, so that runs of the same model
+share their program, textures and vertex buffers
+=============
+*/
+typedef struct
+{
+	entity_t	*ent;
+	int			type;
+	uintptr_t	texture;
+	uintptr_t	model;
+	int			index;		// visedict order, keeps the sort stable
+} entitysort_t;
+
+static entitysort_t	r_sortedents[MAX_VISEDICTS];
+
+static void R_EntitySortKey (entitysort_t *key, entity_t *e, int index)
+{
+	static const int	typeorder[] = {0, 2, 1};	// brush, alias, then sprites
+	gltexture_t			*tx, *fb;
+
+	key->ent = e;
+	key->type = typeorder[e->model->type];
+	key->model = (uintptr_t) e->model;
+	key->index = index;
+
+	switch (e->model->type)
+	{
+		case mod_alias:
+			R_AliasSkinTextures (e, (aliashdr_t *) Mod_Extradata (e->model), &tx, &fb);
+			key->texture = (uintptr_t) tx;
+			break;
+		case mod_sprite:
+			key->texture = (uintptr_t) R_GetSpriteFrame (e)->gltexture;
+			break;
+		default:
+			key->texture = 0;	// brush models bind per surface
+			break;
+	}
+}
+
+static int R_EntitySortCompare (const void *a, const void *b)
+{
+	const entitysort_t	*ka = (const entitysort_t *) a;
+	const entitysort_t	*kb = (const entitysort_t *) b;
+
+	if (ka->type != kb->type)
+		return ka->type - kb->type;
+	if (ka->texture != kb->texture)
+		return ka->texture < kb->texture ? -1 : 1;
+	if (ka->model != kb->model)
+		return ka->model < kb->model ? -1 : 1;
+	return ka->index - kb->index;
+}
+
 /*
 =============
 R_DrawEntitiesOnList
@@ -633,7 +873,7 @@ R_DrawEntitiesOnList
 */
 void R_DrawEntitiesOnList (qboolean alphapass) //johnfitz -- added parameter
 {
-	int		i;
+	int		i, count;
 
 	if (!r_drawentities.value)
 		return;
@@ -648,17 +888,31 @@ void R_DrawEntitiesOnList (qboolean alphapass) //johnfitz -- added parameter
 		glPolygonOffset(factor, units);
 	}
 
-	//johnfitz -- sprites are not a special case
+	//johnfitz -- if alphapass is true, draw only alpha entites this time
+	//if alphapass is false, draw only nonalpha entities this time
+	count = 0;
 	for (i=0 ; i<cl_numvisedicts ; i++)
 	{
-		currententity = cl_visedicts[i];
-
-		//johnfitz -- if alphapass is true, draw only alpha entites this time
-		//if alphapass is false, draw only nonalpha entities this time
-		if ((ENTALPHA_DECODE(currententity->alpha) < 1 && !alphapass) ||
-			(ENTALPHA_DECODE(currententity->alpha) == 1 && alphapass))
+		if ((ENTALPHA_DECODE(cl_visedicts[i]->alpha) < 1 && !alphapass) ||
+			(ENTALPHA_DECODE(cl_visedicts[i]->alpha) == 1 && alphapass))
 			continue;
 
+		if (!alphapass && r_sortentities.value)
+			R_EntitySortKey (&r_sortedents[count], cl_visedicts[i], i);
+		else
+			r_sortedents[count].ent = cl_visedicts[i];
+		count++;
+	}
+
+	// blended entities stay in visedict order
+	if (!alphapass && r_sortentities.value)
+		qsort (r_sortedents, count, sizeof(r_sortedents[0]), R_EntitySortCompare);
+
+	//johnfitz -- sprites are not a special case
+	for (i=0 ; i<count ; i++)
+	{
+		currententity = r_sortedents[i].ent;
+
 		//johnfitz -- chasecam
 		if (currententity == &cl_entities[cl.viewentity])
 			currententity->angles[0] *= 0.3;
@@ -670,14 +924,18 @@ void R_DrawEntitiesOnList (qboolean alphapass) //johnfitz -- added parameter
 				R_DrawAliasModel (currententity);
 				break;
 			case mod_brush:
+				GL_UseProgram (0);
 				R_DrawBrushModel (currententity);
 				break;
 			case mod_sprite:
+				GL_UseProgram (0);
 				R_DrawSpriteModel (currententity);
 				break;
 		}
 	}
 
+	GL_UseProgram (0); // alias models leave their program bound
+
 	if (polyoffset)
 		glDisable(GL_POLYGON_OFFSET_FILL);
 }
@@ -707,6 +965,7 @@ void R_DrawViewModel (void)
 	// hack the depth range to prevent view model from poking into walls
 	glDepthRange (0, 0.3);
 	R_DrawAliasModel (currententity);
+	GL_UseProgram (0);
 	glDepthRange (0, 1);
 }
 
@@ -1092,6 +1351,7 @@ void R_RenderView (void)
 		Sys_Error ("R_RenderView: NULL worldmodel");
 
 	time1 = 0; /* avoid compiler warning */
+	rs_lightmaprects = rs_lightmapbytes = 0; // also feeds devstats
 	if (r_speeds.value)
 	{
 		glFinish ();
@@ -1100,6 +1360,8 @@ void R_RenderView (void)
 		//johnfitz -- rendering statistics
 		rs_brushpolys = rs_aliaspolys = rs_skypolys =
 		rs_dynamiclightmaps = rs_aliaspasses = rs_skypasses = rs_brushpasses = 0;
+		rs_pvsleafs = rs_pvssurfs = rs_pvsrebuilds = 0;
+		rs_texbinds = rs_programbinds = 0;
 	}
 	else if (gl_finish.value)
 		glFinish ();
@@ -1153,6 +1415,9 @@ void R_RenderView (void)
 
 	R_ScaleView ();
 
+	dev_stats.lightmapkb = rs_lightmapbytes / 1024;
+	dev_peakstats.lightmapkb = q_max(dev_stats.lightmapkb, dev_peakstats.lightmapkb);
+
 	//johnfitz -- modified r_speeds output
 	time2 = Sys_DoubleTime ();
 	if (r_pos.value)
@@ -1164,6 +1429,7 @@ void R_RenderView (void)
 					(int)cl.viewangles[YAW],
 					(int)cl.viewangles[ROLL]);
 	else if (r_speeds.value == 2)
+	{
 		Con_Printf ("%3i ms  %4i/%4i wpoly %4i/%4i epoly %3i lmap %4i/%4i sky %1.1f mtex\n",
 					(int)((time2-time1)*1000),
 					rs_brushpolys,
@@ -1174,6 +1440,17 @@ void R_RenderView (void)
 					rs_skypolys,
 					rs_skypasses,
 					TexMgr_FrameUsage ());
+		Con_Printf ("        %5i/%5i leaf %6i marksurf %s %3i lmrect %5i KB lmap\n",
+					rs_pvsleafs,
+					cl.worldmodel->numleafs,
+					rs_pvssurfs,
+					rs_pvsrebuilds ? "pvs rebuilt" : "pvs cached",
+					rs_lightmaprects,
+					rs_lightmapbytes / 1024);
+		Con_Printf ("        %5i texbind %4i program\n",
+					rs_texbinds,
+					rs_programbinds);
+	}
 	else if (r_speeds.value)
 		Con_Printf ("%3i ms  %4i wpoly %4i epoly %3i lmap\n",
 					(int)((time2-time1)*1000),
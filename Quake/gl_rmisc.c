@@ -38,6 +38,10 @@ extern cvar_t r_waterquality;
 extern cvar_t r_oldwater;
 extern cvar_t r_waterwarp;
 extern cvar_t r_oldskyleaf;
+extern cvar_t r_parallelcull;
+extern cvar_t r_parallellightmaps;
+extern cvar_t r_bspcache;
+extern cvar_t r_sortentities;
 extern cvar_t r_drawworld;
 extern cvar_t r_showtris;
 extern cvar_t r_showbboxes;
@@ -166,7 +170,11 @@ R_Init
 void R_Init (void)
 {
 	Cmd_AddCommand ("timerefresh", R_TimeRefresh_f);
+	Cmd_AddCommand ("r_cullbench", R_CullBench_f);
+	Cmd_AddCommand ("r_lightbench", R_LightBench_f);
+	Cmd_AddCommand ("r_lightmapinfo", R_LightmapInfo_f);
 	Cmd_AddCommand ("pointfile", R_ReadPointFile_f);
+	Cmd_AddCommand ("r_particlebench", R_ParticleBench_f);
 
 	Cvar_RegisterVariable (&r_norefresh);
 	Cvar_RegisterVariable (&r_lightmap);
@@ -203,6 +211,10 @@ void R_Init (void)
 	Cvar_RegisterVariable (&r_drawflat);
 	Cvar_RegisterVariable (&r_flatlightstyles);
 	Cvar_RegisterVariable (&r_oldskyleaf);
+	Cvar_RegisterVariable (&r_parallelcull);
+	Cvar_RegisterVariable (&r_parallellightmaps);
+	Cvar_RegisterVariable (&r_bspcache);
+	Cvar_RegisterVariable (&r_sortentities);
 	Cvar_RegisterVariable (&r_drawworld);
 	Cvar_RegisterVariable (&r_showtris);
 	Cvar_RegisterVariable (&r_showbboxes);
@@ -392,6 +404,7 @@ void R_NewMap (void)
 		cl.worldmodel->leafs[i].efrags = NULL;
 
 	r_viewleaf = NULL;
+	R_InvalidatePVSCache ();
 	R_ClearParticles ();
 
 	GL_BuildLightmaps ();
@@ -585,6 +598,8 @@ void R_DeleteShaders (void)
 	if (!gl_glsl_able)
 		return;
 
+	GL_UseProgram (0);
+
 	for (i = 0; i < gl_num_programs; i++)
 	{
 		GL_DeleteProgramFunc (gl_programs[i]);
@@ -594,6 +609,7 @@ void R_DeleteShaders (void)
 }
 
 static GLuint current_array_buffer, current_element_array_buffer;
+static GLuint current_program;
 
 /*
 ====================
@@ -629,6 +645,23 @@ void GL_BindBuffer (GLenum target, GLuint buffer)
 	}
 }
 
+/*
+====================
+GL_UseProgram
+
+glUseProgram wrapper, skips redundant switches and counts the others
+====================
+*/
+void GL_UseProgram (GLuint program)
+{
+	if (program != current_program)
+	{
+		current_program = program;
+		GL_UseProgramFunc (program);
+		rs_programbinds++;
+	}
+}
+
 /*
 ====================
 GL_ClearBufferBindings
@@ -639,6 +672,8 @@ invalid (e.g. manually binding, destroying the context).
 */
 void GL_ClearBufferBindings (void)
 {
+	current_program = 0;
+
 	if (!gl_vbo_able)
 		return;
 
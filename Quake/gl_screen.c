@@ -512,7 +512,7 @@ SCR_DrawDevStats
 void SCR_DrawDevStats (void)
 {
 	char	str[40];
-	int		y = 25-9; //9=number of lines to print
+	int		y = 25-10; //10=number of lines to print
 	int		x = 0; //margin
 
 	if (!devstats.value)
@@ -520,7 +520,7 @@ void SCR_DrawDevStats (void)
 
 	GL_SetCanvas (CANVAS_BOTTOMLEFT);
 
-	Draw_Fill (x, y*8, 19*8, 9*8, 0, 0.5); //dark rectangle
+	Draw_Fill (x, y*8, 19*8, 10*8, 0, 0.5); //dark rectangle
 
 	sprintf (str, "devstats |Curr Peak");
 	Draw_String (x, (y++)*8-x, str);
@@ -548,6 +548,9 @@ void SCR_DrawDevStats (void)
 
 	sprintf (str, "Tempents |%4i %4i", dev_stats.tempents, dev_peakstats.tempents);
 	Draw_String (x, (y++)*8-x, str);
+
+	sprintf (str, "Lmap KB  |%4i %4i", dev_stats.lightmapkb, dev_peakstats.lightmapkb);
+	Draw_String (x, (y++)*8-x, str);
 }
 
 /*
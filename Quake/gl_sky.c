@@ -418,7 +418,7 @@ Sky_ProjectPoly
 update sky bounds
 =================
 */
-void Sky_ProjectPoly (int nump, vec3_t vecs)
+static void Sky_ProjectPoly (int nump, vec3_t vecs, skybounds_t *bounds)
 {
 	int		i,j;
 	vec3_t	v, av;
@@ -477,15 +477,17 @@ void Sky_ProjectPoly (int nump, vec3_t vecs)
 		else
 			t = vecs[j-1] / dv;
 
-		if (s < skymins[0][axis])
-			skymins[0][axis] = s;
-		if (t < skymins[1][axis])
-			skymins[1][axis] = t;
-		if (s > skymaxs[0][axis])
-			skymaxs[0][axis] = s;
-		if (t > skymaxs[1][axis])
-			skymaxs[1][axis] = t;
+		if (s < bounds->mins[0][axis])
+			bounds->mins[0][axis] = s;
+		if (t < bounds->mins[1][axis])
+			bounds->mins[1][axis] = t;
+		if (s > bounds->maxs[0][axis])
+			bounds->maxs[0][axis] = s;
+		if (t > bounds->maxs[1][axis])
+			bounds->maxs[1][axis] = t;
 	}
+
+	bounds->faces |= 1 << axis;
 }
 
 /*
@@ -493,7 +495,7 @@ void Sky_ProjectPoly (int nump, vec3_t vecs)
 Sky_ClipPoly
 =================
 */
-static void Sky_ClipPoly (int nump, vec3_t vecs, int stage)
+static void Sky_ClipPoly (int nump, vec3_t vecs, int stage, skybounds_t *bounds)
 {
 	const float	*norm;
 	float	*v;
@@ -511,7 +513,7 @@ static void Sky_ClipPoly (int nump, vec3_t vecs, int stage)
 
 	if (stage == 6) // fully clipped
 	{
-		Sky_ProjectPoly (nump, vecs);
+		Sky_ProjectPoly (nump, vecs, bounds);
 		return;
 	}
 
@@ -541,7 +543,7 @@ static void Sky_ClipPoly (int nump, vec3_t vecs, int stage)
 
 	if (!front || !back)
 	{	// not clipped
-		Sky_ClipPoly (nump, vecs, stage+1);
+		Sky_ClipPoly (nump, vecs, stage+1, bounds);
 		if (on_heap) {
 			free(dists);
 			free(sides);
@@ -594,8 +596,8 @@ static void Sky_ClipPoly (int nump, vec3_t vecs, int stage)
 	}
 
 	// continue
-	Sky_ClipPoly (newc[0], newv_0[0], stage+1);
-	Sky_ClipPoly (newc[1], newv_1[0], stage+1);
+	Sky_ClipPoly (newc[0], newv_0[0], stage+1, bounds);
+	Sky_ClipPoly (newc[1], newv_1[0], stage+1, bounds);
 
 	if (on_heap)
 	{
@@ -606,12 +608,36 @@ static void Sky_ClipPoly (int nump, vec3_t vecs, int stage)
 	}
 }
 
+/*
+================
+Sky_MergeBounds
+================
+*/
+static void Sky_MergeBounds (const skybounds_t *bounds)
+{
+	int	i;
+
+	for (i=0 ; i<6 ; i++)
+	{
+		if (!(bounds->faces & (1 << i)))
+			continue;
+
+		skymins[0][i] = q_min (skymins[0][i], bounds->mins[0][i]);
+		skymins[1][i] = q_min (skymins[1][i], bounds->mins[1][i]);
+		skymaxs[0][i] = q_max (skymaxs[0][i], bounds->maxs[0][i]);
+		skymaxs[1][i] = q_max (skymaxs[1][i], bounds->maxs[1][i]);
+	}
+}
+
 /*
 ================
 Sky_ProcessPoly
+
+p is in world space, origin and angles say where it is seen from in model
+space, the clipped bounds are only redone when that changes
 ================
 */
-void Sky_ProcessPoly (glpoly_t	*p)
+static void Sky_ProcessPoly (glpoly_t *p, skybounds_t *bounds, vec3_t origin, vec3_t angles)
 {
 	//draw it
 	DrawGLPoly(p);
@@ -620,20 +646,36 @@ void Sky_ProcessPoly (glpoly_t	*p)
 	//update sky bounds
 	if (!r_fastsky.value)
 	{
-		const int max_clip_verts = p->numverts + 2;
-		const int num_verts = p->numverts;
-		const int on_heap = max_clip_verts > MAX_CLIP_VERTS;
-		vec3_t *verts = (vec3_t *) (on_heap ?
-				 malloc(max_clip_verts * sizeof(vec3_t)) :
-				 alloca(max_clip_verts * sizeof(vec3_t)));
-		int i = 0;
-
-		for ( ; i < num_verts; i++) {
-			VectorSubtract (p->verts[i], r_origin, verts[i]);
+		if (!bounds->valid || !VectorCompare (bounds->origin, origin) || !VectorCompare (bounds->angles, angles))
+		{
+			const int max_clip_verts = p->numverts + 2;
+			const int num_verts = p->numverts;
+			const int on_heap = max_clip_verts > MAX_CLIP_VERTS;
+			vec3_t *verts = (vec3_t *) (on_heap ?
+					 malloc(max_clip_verts * sizeof(vec3_t)) :
+					 alloca(max_clip_verts * sizeof(vec3_t)));
+			int i = 0;
+
+			for ( ; i < num_verts; i++) {
+				VectorSubtract (p->verts[i], r_origin, verts[i]);
+			}
+
+			bounds->faces = 0;
+			for (i=0 ; i<6 ; i++)
+			{
+				bounds->mins[0][i] = bounds->mins[1][i] = FLT_MAX;
+				bounds->maxs[0][i] = bounds->maxs[1][i] = -FLT_MAX;
+			}
+			Sky_ClipPoly (num_verts, verts[0], 0, bounds);
+
+			VectorCopy (origin, bounds->origin);
+			VectorCopy (angles, bounds->angles);
+			bounds->valid = true;
+
+			if (on_heap) free(verts);
 		}
-		Sky_ClipPoly (num_verts, verts[0], 0);
 
-		if (on_heap) free(verts);
+		Sky_MergeBounds (bounds);
 	}
 }
 
@@ -659,7 +701,7 @@ void Sky_ProcessTextureChains (void)
 			continue;
 
 		for (s = t->texturechains[chain_world]; s; s = s->texturechain)
-			Sky_ProcessPoly (s->polys);
+			Sky_ProcessPoly (s->polys, s->skybounds, r_origin, vec3_origin);
 	}
 }
 
@@ -670,10 +712,11 @@ Sky_ProcessEntities -- handles sky polys on brush models
 */
 void Sky_ProcessEntities (void)
 {
+	static glpoly_t	*p;
+	static int		maxverts;
 	entity_t	*e;
 	msurface_t	*s;
-	glpoly_t	*p;
-	int			i,j,k,mark;
+	int			i,j,k;
 	float		dot;
 	qboolean	rotated;
 	vec3_t		temp, forward, right, up;
@@ -718,8 +761,13 @@ void Sky_ProcessEntities (void)
 					(!(s->flags & SURF_PLANEBACK) && (dot > BACKFACE_EPSILON)))
 				{
 					//copy the polygon and translate manually, since Sky_ProcessPoly needs it to be in world space
-					mark = Hunk_LowMark();
-					p = (glpoly_t *) Hunk_Alloc (sizeof(*s->polys)); //FIXME: don't allocate for each poly
+					if (s->polys->numverts > maxverts)
+					{
+						maxverts = s->polys->numverts;
+						p = (glpoly_t *) realloc (p, sizeof(*p) + (maxverts - 4) * VERTEXSIZE * sizeof(float));
+						if (!p)
+							Sys_Error ("Sky_ProcessEntities: out of memory");
+					}
 					p->numverts = s->polys->numverts;
 					for (k=0; k<p->numverts; k++)
 					{
@@ -738,8 +786,7 @@ void Sky_ProcessEntities (void)
 						else
 							VectorAdd(s->polys->verts[k], e->origin, p->verts[k]);
 					}
-					Sky_ProcessPoly (p);
-					Hunk_FreeToLowMark (mark);
+					Sky_ProcessPoly (p, s->skybounds, modelorg, e->angles);
 				}
 			}
 		}
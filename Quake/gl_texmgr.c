@@ -1615,6 +1615,7 @@ void GL_Bind (gltexture_t *texture)
 		currenttexture[currenttarget - GL_TEXTURE0_ARB] = texture->texnum;
 		glBindTexture (GL_TEXTURE_2D, texture->texnum);
 		texture->visframe = r_framecount;
+		rs_texbinds++;
 	}
 }
 
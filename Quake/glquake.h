@@ -49,7 +49,11 @@ extern	int glx, gly, glwidth, glheight;
 
 
 void R_TimeRefresh_f (void);
+void R_CullBench_f (void);
+void R_LightBench_f (void);
+void R_LightmapInfo_f (void);
 void R_ReadPointFile_f (void);
+void R_ParticleBench_f (void);
 texture_t *R_TextureAnimation (texture_t *base, int frame);
 
 typedef struct surfcache_s
@@ -85,14 +89,11 @@ typedef enum {
 	pt_static, pt_grav, pt_slowgrav, pt_fire, pt_explode, pt_explode2, pt_blob, pt_blob2
 } ptype_t;
 
-// !!! if this is changed, it must be changed in d_ifacea.h too !!!
+// a particle as the effects spawn it, r_part.c stores them split by type
 typedef struct particle_s
 {
-// driver-usable fields
 	vec3_t		org;
 	float		color;
-// drivers never touch the following fields
-	struct particle_s	*next;
 	vec3_t		vel;
 	float		ramp;
 	float		die;
@@ -279,6 +280,9 @@ extern qboolean gl_texture_env_add; // for GL_EXT_texture_env_add
 //johnfitz -- rendering statistics
 extern int rs_brushpolys, rs_aliaspolys, rs_skypolys;
 extern int rs_dynamiclightmaps, rs_brushpasses, rs_aliaspasses, rs_skypasses;
+extern int rs_pvsleafs, rs_pvssurfs, rs_pvsrebuilds;
+extern int rs_lightmaprects, rs_lightmapbytes;
+extern int rs_texbinds, rs_programbinds;
 
 //johnfitz -- track developer statistics that vary every frame
 extern cvar_t devstats;
@@ -290,6 +294,7 @@ typedef struct {
 	int		tempents;
 	int		beams;
 	int		dlights;
+	int		lightmapkb;
 } devstats_t;
 extern devstats_t dev_stats, dev_peakstats;
 
@@ -312,12 +317,14 @@ extern int gl_lightmap_format, lightmap_bytes;
 typedef struct glRect_s {
 	unsigned short l,t,w,h;
 } glRect_t;
+#define MAX_LIGHTMAP_RECTS	4	// dirty regions per block, more get merged
 struct lightmap_s
 {
 	gltexture_t *texture;
 	glpoly_t	*polys;
 	qboolean	modified;
-	glRect_t	rectchange;
+	glRect_t	dirty[MAX_LIGHTMAP_RECTS];
+	int			numdirty;
 
 	// the lightmap texture data needs to be kept in
 	// main memory so texsubimage can update properly
@@ -357,9 +364,21 @@ void R_NewGame (void);
 
 void R_AnimateLight (void);
 void R_MarkSurfaces (void);
+void R_InvalidatePVSCache (void);
+void R_FreeWorldIndices (void);
 qboolean R_CullBox (vec3_t emins, vec3_t emaxs);
 void R_StoreEfrags (efrag_t **ppefrag);
 qboolean R_CullModelForEntity (entity_t *e);
+void R_CullEntities (void);
+
+// boxes for R_CullBoxes, every coordinate in its own array
+typedef struct
+{
+	float	*mins[3];
+	float	*maxs[3];
+} cullboxes_t;
+
+int R_CullBoxes (const cullboxes_t *boxes, int first, int count, byte *visible, qboolean simd);
 void R_RotateForEntity (vec3_t origin, vec3_t angles, unsigned char scale);
 void R_MarkLights (dlight_t *light, int num, mnode_t *node);
 
@@ -374,8 +393,10 @@ void R_UpdateWarpTextures (void);
 
 void R_DrawWorld (void);
 void R_DrawAliasModel (entity_t *e);
+void R_AliasSkinTextures (entity_t *e, aliashdr_t *paliashdr, gltexture_t **tx, gltexture_t **fb);
 void R_DrawBrushModel (entity_t *e);
 void R_DrawSpriteModel (entity_t *e);
+mspriteframe_t *R_GetSpriteFrame (entity_t *currentent);
 
 void R_DrawTextureChains_Water (qmodel_t *model, entity_t *ent, texchain_t chain);
 
@@ -392,6 +413,7 @@ int R_LightPoint (vec3_t p);
 void GL_SubdivideSurface (msurface_t *fa);
 void R_BuildLightMap (msurface_t *surf, byte *dest, int stride);
 void R_RenderDynamicLightmaps (msurface_t *fa);
+void R_FlushLightmapUpdates (void);
 void R_UploadLightmaps (void);
 
 void R_DrawWorld_ShowTris (void);
@@ -428,6 +450,7 @@ void R_DrawWorld_Water (void);
 
 void GL_BindBuffer (GLenum target, GLuint buffer);
 void GL_ClearBufferBindings (void);
+void GL_UseProgram (GLuint program);
 
 void GLSLGamma_DeleteTexture (void);
 void GLSLGamma_GammaCorrect (void);
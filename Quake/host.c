@@ -103,6 +103,38 @@ void Hack_MarkModelToCacheInGame(int index)
 	Q_BITSET(hack_modelsToCacheInGame, 0);  // mark necessity of caching
 }
 
+static void Hack_SetModelInGame(int index, qmodel_t* model)
+{
+	sv.models[index] = model;
+
+	Mod_TouchModel(model->name);
+	cl.model_precache[index] = model;
+
+	if (model->type == mod_brush)
+		hack_rebuildLightmaps = true;
+}
+
+// called from Mod_LoadRequests, the models are cleared on every map change
+static void Hack_ModelLoadedInGame(qmodel_t* model, void* userdata)
+{
+	const int index = (int)(intptr_t)userdata;
+
+	if (!model || !sv.active || !sv.model_precache[index] || strcmp(sv.model_precache[index], model->name))
+		return;
+
+	Hack_SetModelInGame(index, model);
+
+	// setmodel gave zero bounds while the model was still loading,
+	// edicts that got a size from setsize since then are no longer pending
+	for (int i = 1; i < sv.num_edicts; ++i)
+	{
+		edict_t* ent = EDICT_NUM(i);
+
+		if (!ent->free && ent->sizepending && (int)ent->v.modelindex == index)
+			SV_SetModelSize(ent, model);
+	}
+}
+
 static void Hack_CacheModelsInGame()
 {
 	for (int i = 1; i < MAX_MODELS; ++i)
@@ -111,17 +143,14 @@ static void Hack_CacheModelsInGame()
 			continue;
 
 		const char* modelname = sv.model_precache[i];
-		qmodel_t* model = Mod_ForName(modelname, false);
 
-		if (model)
+		// loaded over the next frames if possible
+		if (!Mod_RequestModel(modelname, Hack_ModelLoadedInGame, (void*)(intptr_t)i))
 		{
-			sv.models[i] = model;
-
-			Mod_TouchModel(modelname);
-			cl.model_precache[i] = model;
+			qmodel_t* model = Mod_ForName(modelname, false);
 
-			if (model->type == mod_brush)
-				hack_rebuildLightmaps = true;
+			if (model)
+				Hack_SetModelInGame(i, model);
 		}
 
 		Q_BITCLEAR(hack_modelsToCacheInGame, i);
@@ -390,6 +419,7 @@ void Host_WriteConfiguration (void)
 			Con_Printf ("Couldn't write config.cfg.\n");
 			return;
 		}
+		COM_InvalidateLooseFiles ();
 
 		//VID_SyncCvars (); //johnfitz -- write actual current mode to config file, in case cvars were messed with
 
@@ -754,6 +784,7 @@ void _Host_Frame (float time)
 	static double		time1 = 0;
 	static double		time2 = 0;
 	static double		time3 = 0;
+	double			time4;
 	int			pass1, pass2, pass3;
 
 	if (setjmp (host_abortserver) )
@@ -766,6 +797,9 @@ void _Host_Frame (float time)
 	if (!Host_FilterTime (time))
 		return;			// don't run too fast, or packets will flood out
 
+// hand finished background loads to their owners
+	Async_Frame ();
+
 // get new key events
 	Key_UpdateForDest ();
 	IN_UpdateInputMode ();
@@ -820,9 +854,14 @@ void _Host_Frame (float time)
 	if (Q_BITTEST(hack_soundsToCacheInGame, 0))
 		Hack_CacheSoundsInGame();
 
-	SCR_UpdateScreen ();
+	Mod_LoadRequests ();
+
+	if (!cls.td_norender)
+		SCR_UpdateScreen ();
 
+	time4 = Sys_DoubleTime ();
 	CL_RunParticles (); //johnfitz -- seperated from rendering
+	CL_TimeDemoStage (&cls.td_particletime, time4);
 
 	if (host_speeds.value)
 		time2 = Sys_DoubleTime ();
@@ -915,6 +954,8 @@ void Host_Init (void)
 	LOG_Init (host_parms);
 	Cvar_Init (); //johnfitz
 	COM_Init ();
+	Jobs_Init ();
+	Async_Init ();
 	COM_InitFilesystem ();
 	Host_InitLocal ();
 	W_LoadWadFile (); //johnfitz -- filename is now hard-coded for honesty
@@ -1018,6 +1059,8 @@ void Host_Shutdown(void)
 #endif // USE_LUA_SCRIPTING
 
 	NET_Shutdown ();
+	Jobs_Shutdown ();
+	Async_Shutdown ();
 
 	if (cls.state != ca_dedicated)
 	{
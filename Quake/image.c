@@ -37,16 +37,28 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 static char loadfilename[MAX_OSPATH]; //file scope so that error messages can use it
 
 typedef struct stdio_buffer_s {
-	FILE *f;
-	unsigned char buffer[1024];
+	FILE *f; //NULL when reading from memory
+	unsigned char *data; //points to buffer, or to the whole file when reading from memory
 	int size;
 	int pos;
+	long start; //file offset of the image
+	unsigned char buffer[1024];
 } stdio_buffer_t;
 
 static stdio_buffer_t *Buf_Alloc(FILE *f)
 {
 	stdio_buffer_t *buf = (stdio_buffer_t *) calloc(1, sizeof(stdio_buffer_t));
 	buf->f = f;
+	buf->data = buf->buffer;
+	buf->start = ftell(f); //we might be inside a pak file
+	return buf;
+}
+
+static stdio_buffer_t *Buf_AllocMemory(byte *data, int size)
+{
+	stdio_buffer_t *buf = (stdio_buffer_t *) calloc(1, sizeof(stdio_buffer_t));
+	buf->data = data;
+	buf->size = size;
 	return buf;
 }
 
@@ -59,6 +71,9 @@ static inline int Buf_GetC(stdio_buffer_t *buf)
 {
 	if (buf->pos >= buf->size)
 	{
+		if (!buf->f)
+			return EOF;
+
 		buf->size = fread(buf->buffer, 1, sizeof(buf->buffer), buf->f);
 		buf->pos = 0;
 		
@@ -66,7 +81,44 @@ static inline int Buf_GetC(stdio_buffer_t *buf)
 			return EOF;
 	}
 
-	return buf->buffer[buf->pos++];
+	return buf->data[buf->pos++];
+}
+
+static int Buf_GetLittleShort(stdio_buffer_t *buf)
+{
+	byte	b1, b2;
+
+	b1 = Buf_GetC(buf);
+	b2 = Buf_GetC(buf);
+
+	return (short)(b1 + b2*256);
+}
+
+static qboolean Buf_Read(stdio_buffer_t *buf, void *out, int count)
+{
+	byte	*dst = (byte *) out;
+	int		c;
+
+	while (count-- > 0)
+	{
+		if ((c = Buf_GetC(buf)) == EOF)
+			return false;
+		*dst++ = c;
+	}
+
+	return true;
+}
+
+//offset is from the start of the image
+static void Buf_Seek(stdio_buffer_t *buf, int offset)
+{
+	if (buf->f)
+	{
+		fseek(buf->f, buf->start + offset, SEEK_SET);
+		buf->size = buf->pos = 0;
+	}
+	else
+		buf->pos = CLAMP(0, offset, buf->size);
 }
 
 /*
@@ -153,6 +205,7 @@ qboolean Image_WriteTGA (const char *name, byte *data, int width, int height, in
 	handle = Sys_FileOpenWrite (pathname);
 	if (handle == -1)
 		return false;
+	COM_InvalidateLooseFiles ();
 
 	Q_memset (header, 0, TARGAHEADERSIZE);
 	header[2] = 2; // uncompressed type
@@ -183,10 +236,10 @@ qboolean Image_WriteTGA (const char *name, byte *data, int width, int height, in
 
 /*
 =============
-Image_LoadTGA
+Image_ReadTGA
 =============
 */
-byte *Image_LoadTGA (FILE *fin, int *width, int *height)
+static byte *Image_ReadTGA (stdio_buffer_t *buf, int *width, int *height)
 {
 	int				columns, rows, numPixels;
 	byte			*pixbuf;
@@ -194,22 +247,21 @@ byte *Image_LoadTGA (FILE *fin, int *width, int *height)
 	byte			*targa_rgba;
 	int				realrow; //johnfitz -- fix for upside-down targas
 	qboolean		upside_down; //johnfitz -- fix for upside-down targas
-	stdio_buffer_t	*buf;
 	targaheader_t	targa_header;
 
-	targa_header.id_length = fgetc(fin);
-	targa_header.colormap_type = fgetc(fin);
-	targa_header.image_type = fgetc(fin);
+	targa_header.id_length = Buf_GetC(buf);
+	targa_header.colormap_type = Buf_GetC(buf);
+	targa_header.image_type = Buf_GetC(buf);
 
-	targa_header.colormap_index = fgetLittleShort(fin);
-	targa_header.colormap_length = fgetLittleShort(fin);
-	targa_header.colormap_size = fgetc(fin);
-	targa_header.x_origin = fgetLittleShort(fin);
-	targa_header.y_origin = fgetLittleShort(fin);
-	targa_header.width = fgetLittleShort(fin);
-	targa_header.height = fgetLittleShort(fin);
-	targa_header.pixel_size = fgetc(fin);
-	targa_header.attributes = fgetc(fin);
+	targa_header.colormap_index = Buf_GetLittleShort(buf);
+	targa_header.colormap_length = Buf_GetLittleShort(buf);
+	targa_header.colormap_size = Buf_GetC(buf);
+	targa_header.x_origin = Buf_GetLittleShort(buf);
+	targa_header.y_origin = Buf_GetLittleShort(buf);
+	targa_header.width = Buf_GetLittleShort(buf);
+	targa_header.height = Buf_GetLittleShort(buf);
+	targa_header.pixel_size = Buf_GetC(buf);
+	targa_header.attributes = Buf_GetC(buf);
 
 	if (targa_header.image_type==1)
 	{
@@ -241,9 +293,7 @@ byte *Image_LoadTGA (FILE *fin, int *width, int *height)
 	targa_rgba = (byte *) Hunk_Alloc (numPixels*4);
 
 	if (targa_header.id_length != 0)
-		fseek(fin, targa_header.id_length, SEEK_CUR);  // skip TARGA image comment
-
-	buf = Buf_Alloc(fin);
+		Buf_Seek(buf, TARGAHEADERSIZE + targa_header.id_length);  // skip TARGA image comment
 
 	if (targa_header.image_type==1) // Uncompressed, paletted images
 	{
@@ -430,14 +480,29 @@ byte *Image_LoadTGA (FILE *fin, int *width, int *height)
 		}
 	}
 
-	Buf_Free(buf);
-	fclose(fin);
-
 	*width = (int)(targa_header.width);
 	*height = (int)(targa_header.height);
 	return targa_rgba;
 }
 
+/*
+=============
+Image_LoadTGA
+=============
+*/
+byte *Image_LoadTGA (FILE *fin, int *width, int *height)
+{
+	stdio_buffer_t	*buf;
+	byte			*data;
+
+	buf = Buf_Alloc(fin);
+	data = Image_ReadTGA(buf, width, height);
+	Buf_Free(buf);
+	fclose(fin);
+
+	return data;
+}
+
 //==============================================================================
 //
 //  PCX
@@ -462,20 +527,17 @@ typedef struct
 
 /*
 ============
-Image_LoadPCX
+Image_ReadPCX
 ============
 */
-byte *Image_LoadPCX (FILE *f, int *width, int *height)
+static byte *Image_ReadPCX (stdio_buffer_t *buf, int filesize, int *width, int *height)
 {
 	pcxheader_t	pcx;
-	int			x, y, w, h, readbyte, runlength, start;
+	int			x, y, w, h, readbyte, runlength;
 	byte		*p, *data;
 	byte		palette[768];
-	stdio_buffer_t  *buf;
 
-	start = ftell (f); //save start of file (since we might be inside a pak file, SEEK_SET might not be the start of the pcx)
-
-	if (!fread(&pcx, sizeof(pcx), 1, f))
+	if (!Buf_Read(buf, &pcx, sizeof(pcx)))
 		Sys_Error ("Failed reading header from '%s'", loadfilename);
 	pcx.xmin = (unsigned short)LittleShort (pcx.xmin);
 	pcx.ymin = (unsigned short)LittleShort (pcx.ymin);
@@ -498,14 +560,12 @@ byte *Image_LoadPCX (FILE *f, int *width, int *height)
 	data = (byte *) Hunk_Alloc((w*h+1)*4); //+1 to allow reading padding byte on last line
 
 	//load palette
-	fseek (f, start + com_filesize - 768, SEEK_SET);
-	if (!fread (palette, 768, 1, f))
+	Buf_Seek (buf, filesize - 768);
+	if (!Buf_Read (buf, palette, 768))
 		Sys_Error ("Failed reading palette from '%s'", loadfilename);
 
 	//back to start of image data
-	fseek (f, start + sizeof(pcx), SEEK_SET);
-
-	buf = Buf_Alloc(f);
+	Buf_Seek (buf, sizeof(pcx));
 
 	for (y=0; y<h; y++)
 	{
@@ -535,14 +595,116 @@ byte *Image_LoadPCX (FILE *f, int *width, int *height)
 		}
 	}
 
+	*width = w;
+	*height = h;
+	return data;
+}
+
+/*
+============
+Image_LoadPCX
+============
+*/
+byte *Image_LoadPCX (FILE *f, int *width, int *height)
+{
+	stdio_buffer_t	*buf;
+	byte			*data;
+
+	buf = Buf_Alloc(f);
+	data = Image_ReadPCX(buf, com_filesize, width, height);
 	Buf_Free(buf);
 	fclose(f);
 
-	*width = w;
-	*height = h;
 	return data;
 }
 
+//==============================================================================
+//
+//  BACKGROUND LOADING
+//
+//==============================================================================
+
+static void Image_RequestRead (byte *data, int len, void *userdata)
+{
+	imagerequest_t *request = (imagerequest_t *) userdata;
+
+	request->file = NULL;
+	request->data = data;
+	request->len = len;
+}
+
+/*
+============
+Image_RequestImage
+
+starts reading name.tga or name.pcx, returns false if neither exists
+============
+*/
+qboolean Image_RequestImage (const char *name, imagerequest_t *request)
+{
+	static const char *extensions[] = { "tga", "pcx" };
+	int i;
+
+	memset (request, 0, sizeof(*request));
+
+	for (i = 0; i < (int) Q_COUNTOF(extensions); i++)
+	{
+		q_snprintf (request->filename, sizeof(request->filename), "%s.%s", name, extensions[i]);
+		request->file = Async_LoadFile (request->filename, Image_RequestRead, request);
+		if (request->file)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+============
+Image_FinishImage
+
+waits for a requested image, returns a pointer to hunk allocated RGBA data,
+or NULL if it couldn't be read
+============
+*/
+byte *Image_FinishImage (imagerequest_t *request, int *width, int *height)
+{
+	stdio_buffer_t *buf;
+	byte *data;
+
+	if (request->file)
+		Async_Finish (request->file);
+	if (!request->data)
+		return NULL;
+
+	q_strlcpy (loadfilename, request->filename, sizeof(loadfilename));
+
+	buf = Buf_AllocMemory (request->data, request->len);
+	if (!strcmp (COM_FileGetExtension (request->filename), "tga"))
+		data = Image_ReadTGA (buf, width, height);
+	else
+		data = Image_ReadPCX (buf, request->len, width, height);
+	Buf_Free (buf);
+
+	free (request->data);
+	request->data = NULL;
+
+	return data;
+}
+
+/*
+============
+Image_CancelImage
+============
+*/
+void Image_CancelImage (imagerequest_t *request)
+{
+	if (request->file)
+		Async_Cancel (request->file);
+	free (request->data);
+
+	memset (request, 0, sizeof(*request));
+}
+
 //==============================================================================
 //
 //  STB_IMAGE_WRITE
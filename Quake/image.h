@@ -30,6 +30,19 @@ byte *Image_LoadTGA (FILE *f, int *width, int *height);
 byte *Image_LoadPCX (FILE *f, int *width, int *height);
 byte *Image_LoadImage (const char *name, int *width, int *height);
 
+typedef struct
+{
+	char		filename[MAX_QPATH];	//with extension
+	asyncfile_t	*file;
+	byte		*data;
+	int			len;
+} imagerequest_t;
+
+//same search order as Image_LoadImage, but the file is read in the background
+qboolean Image_RequestImage (const char *name, imagerequest_t *request);
+byte *Image_FinishImage (imagerequest_t *request, int *width, int *height);
+void Image_CancelImage (imagerequest_t *request);
+
 qboolean Image_WriteTGA (const char *name, byte *data, int width, int height, int bpp, qboolean upsidedown);
 qboolean Image_WritePNG (const char *name, byte *data, int width, int height, int bpp, qboolean upsidedown);
 qboolean Image_WriteJPG (const char *name, byte *data, int width, int height, int bpp, int quality, qboolean upsidedown);
@@ -0,0 +1,193 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// jobs.c -- worker thread pool
+
+#include "quakedef.h"
+
+static struct
+{
+	SDL_Thread		*threads[MAX_JOB_WORKERS];
+	int				numthreads;
+	SDL_sem			*start;		// posted once per worker that should join a batch
+	SDL_sem			*done;		// posted by every worker leaving a batch
+	qboolean		quit;
+
+	// current batch, only changed while all threads are idle
+	jobfunc_t		func;
+	void			*data;
+	int				count;
+	SDL_atomic_t	next;		// next index to hand out
+	SDL_atomic_t	busy;		// batch is running, used to catch nested calls
+
+	SDL_TLSID		workerid;	// worker index + 1, unset on the main thread
+} jobs;
+
+static void Jobs_Run (int worker)
+{
+	int	index;
+
+	SDL_assert (worker >= 0 && worker < Jobs_NumWorkers ());
+
+	while ((index = SDL_AtomicAdd (&jobs.next, 1)) < jobs.count)
+		jobs.func (jobs.data, index, worker);
+}
+
+// worker index + 1 is passed as data, so that it is never NULL. The calling
+// thread is worker 0, the pool threads are 1 to numthreads.
+static int SDLCALL Jobs_Thread (void *data)
+{
+	int	worker = (int)(intptr_t) data - 1;
+
+	SDL_TLSSet (jobs.workerid, data, NULL);
+
+	for (;;)
+	{
+		SDL_SemWait (jobs.start);
+		SDL_MemoryBarrierAcquire ();
+
+		if (jobs.quit)
+			break;
+
+		Jobs_Run (worker);
+		SDL_SemPost (jobs.done);
+	}
+
+	return 0;
+}
+
+/*
+=============
+Jobs_ParallelFor
+=============
+*/
+void Jobs_ParallelFor (jobfunc_t func, void *data, int count)
+{
+	int	i, wake, worker;
+
+	if (count <= 0)
+		return;
+
+	if (jobs.numthreads == 0 || count == 1 || !SDL_AtomicCAS (&jobs.busy, 0, 1))
+	{
+		// nested call runs on the current worker, whose per worker data
+		// belongs to the calling job anyway
+		worker = jobs.workerid ? (int)(intptr_t) SDL_TLSGet (jobs.workerid) : 0;
+		worker = q_max (worker - 1, 0);
+		SDL_assert (worker < Jobs_NumWorkers ());
+
+		for (i = 0; i < count; i++)
+			func (data, i, worker);
+		return;
+	}
+
+	jobs.func = func;
+	jobs.data = data;
+	jobs.count = count;
+	SDL_AtomicSet (&jobs.next, 0);
+	SDL_MemoryBarrierRelease ();
+
+	wake = q_min (jobs.numthreads, count - 1);
+	for (i = 0; i < wake; i++)
+		SDL_SemPost (jobs.start);
+
+	Jobs_Run (0);
+
+	// nobody may still look at the batch when the next one is set up
+	for (i = 0; i < wake; i++)
+		SDL_SemWait (jobs.done);
+
+	SDL_AtomicSet (&jobs.busy, 0);
+}
+
+int Jobs_NumWorkers (void)
+{
+	return jobs.numthreads + 1;
+}
+
+/*
+=============
+Jobs_Init
+=============
+*/
+void Jobs_Init (void)
+{
+	int	i, count;
+
+	i = COM_CheckParm ("-jobs");
+	if (i && i < com_argc - 1)
+		count = atoi (com_argv[i + 1]) - 1;
+	else
+		count = host_parms->numcpus - 1;
+
+	count = CLAMP (0, count, MAX_JOB_WORKERS - 1);
+
+	if (count > 0)
+	{
+		jobs.workerid = SDL_TLSCreate ();
+		jobs.start = SDL_CreateSemaphore (0);
+		jobs.done = SDL_CreateSemaphore (0);
+	}
+
+	if (jobs.workerid && jobs.start && jobs.done)
+	{
+		for (i = 0; i < count; i++)
+		{
+			jobs.threads[i] = SDL_CreateThread (Jobs_Thread, "Worker", (void *)(intptr_t)(i + 2));
+			if (!jobs.threads[i])
+			{
+				Con_Printf ("Couldn't create worker thread: %s\n", SDL_GetError ());
+				break;
+			}
+			jobs.numthreads++;
+		}
+	}
+
+	Con_Printf ("Job system: %i workers\n", Jobs_NumWorkers ());
+}
+
+/*
+=============
+Jobs_Shutdown
+=============
+*/
+void Jobs_Shutdown (void)
+{
+	int	i;
+
+	jobs.quit = true;
+	SDL_MemoryBarrierRelease ();
+
+	for (i = 0; i < jobs.numthreads; i++)
+		SDL_SemPost (jobs.start);
+
+	for (i = 0; i < jobs.numthreads; i++)
+		SDL_WaitThread (jobs.threads[i], NULL);
+
+	jobs.numthreads = 0;
+
+	if (jobs.start)
+		SDL_DestroySemaphore (jobs.start);
+	if (jobs.done)
+		SDL_DestroySemaphore (jobs.done);
+
+	jobs.start = jobs.done = NULL;
+}
@@ -0,0 +1,45 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#ifndef __JOBS_H
+#define __JOBS_H
+
+// jobs.h -- worker thread pool
+// The pool is sized from the number of CPUs, the calling thread always takes
+// part in the work, so Jobs_NumWorkers() is at least 1.
+
+#define MAX_JOB_WORKERS	32
+
+typedef void (*jobfunc_t) (void *data, int index, int worker);
+// worker is in [0, Jobs_NumWorkers()), 0 is the calling thread
+
+void	Jobs_Init (void);
+void	Jobs_Shutdown (void);
+
+int		Jobs_NumWorkers (void);
+
+void	Jobs_ParallelFor (jobfunc_t func, void *data, int count);
+// calls func for every index in [0, count) and returns when all are done.
+// Indices are handed out in order, but may complete in any order.
+// Must be called from the main thread, nested calls from inside a job run
+// on the calling worker only.
+
+#endif	/* __JOBS_H */
@@ -39,6 +39,56 @@ extern cvar_t
 }
 
 
+//
+// Expose 'demo' global table
+//
+
+static int LS_global_demo_playing(lua_State* state)
+{
+	lua_pushboolean(state, cls.demoplayback);
+	return 1;
+}
+
+static int LS_global_demo_seek(lua_State* state)
+{
+	const lua_Number time = luaL_checknumber(state, 1);
+	const char* error;
+
+	if (CL_SeekDemo(time, &error))
+	{
+		lua_pushboolean(state, true);
+		return 1;
+	}
+
+	lua_pushboolean(state, false);
+	lua_pushstring(state, error);
+	return 2;
+}
+
+static int LS_global_demo_time(lua_State* state)
+{
+	if (!cls.demoplayback)
+		return 0;
+
+	lua_pushnumber(state, cl.mtime[0]);
+	return 1;
+}
+
+static void LS_InitDemoTable(lua_State* state)
+{
+	static const luaL_Reg functions[] =
+	{
+		{ "playing", LS_global_demo_playing },
+		{ "seek", LS_global_demo_seek },
+		{ "time", LS_global_demo_time },
+		{ NULL, NULL }
+	};
+
+	luaL_newlib(state, functions);
+	lua_setglobal(state, "demo");
+}
+
+
 //
 // Expose 'host' global table
 //
@@ -649,6 +699,7 @@ static void LS_InitTexturesTable(lua_State* state)
 
 void LS_InitEngineTables(lua_State* state)
 {
+	LS_InitDemoTable(state);
 	LS_InitHostTable(state);
 	LS_InitPlayerTable(state);
 	LS_InitRenderTable(state);
@@ -28,6 +28,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 #include "net_defs.h"
 #include "net_dgrm.h"
+#include "net_sim.h"
 
 // these two macros are to make the code more readable
 #define sfunc	net_landrivers[sock->landriver]
@@ -42,6 +43,17 @@ static int packetsReceived = 0;
 static int receivedDuplicateCount = 0;
 static int shortPacketCount = 0;
 static int droppedDatagrams;
+static int bytesSent = 0;
+static int bytesReceived = 0;
+static double statsStartTime = 0;
+
+/* round trip times of reliable messages, upper bounds of histogram buckets in ms */
+static const int rttBucketLimits[] = {10, 25, 50, 100, 200, 400, 800, INT_MAX};
+static int rttHistogram[Q_COUNTOF(rttBucketLimits)];
+static int rttSamples = 0;
+static double rttTotal = 0;
+static double rttMin = 0;
+static double rttMax = 0;
 
 static struct
 {
@@ -167,11 +179,13 @@ int Datagram_SendMessage (qsocket_t *sock, sizebuf_t *data)
 
 	sock->canSend = false;
 
-	if (sfunc.Write (sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
+	if (NetSim_Write (sock->landriver, sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
 		return -1;
 
 	sock->lastSendTime = net_time;
+	sock->reSent = false;
 	packetsSent++;
+	bytesSent += packetLen;
 	return 1;
 }
 
@@ -200,11 +214,13 @@ static int SendMessageNext (qsocket_t *sock)
 
 	sock->sendNext = false;
 
-	if (sfunc.Write (sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
+	if (NetSim_Write (sock->landriver, sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
 		return -1;
 
 	sock->lastSendTime = net_time;
+	sock->reSent = false;
 	packetsSent++;
+	bytesSent += packetLen;
 	return 1;
 }
 
@@ -233,11 +249,13 @@ static int ReSendMessage (qsocket_t *sock)
 
 	sock->sendNext = false;
 
-	if (sfunc.Write (sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
+	if (NetSim_Write (sock->landriver, sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
 		return -1;
 
 	sock->lastSendTime = net_time;
+	sock->reSent = true;
 	packetsReSent++;
+	bytesSent += packetLen;
 	return 1;
 }
 
@@ -275,14 +293,33 @@ int Datagram_SendUnreliableMessage (qsocket_t *sock, sizebuf_t *data)
 	packetBuffer.sequence = BigLong(sock->unreliableSendSequence++);
 	Q_memcpy (packetBuffer.data, data->data, data->cursize);
 
-	if (sfunc.Write (sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
+	if (NetSim_Write (sock->landriver, sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
 		return -1;
 
 	packetsSent++;
+	bytesSent += packetLen;
 	return 1;
 }
 
 
+static void RecordRoundTrip (double rtt)
+{
+	int	ms, i;
+
+	ms = (int)(rtt * 1000.0);
+	for (i = 0; ms >= rttBucketLimits[i]; i++)
+		;
+	rttHistogram[i]++;
+
+	if (rttSamples == 0 || rtt < rttMin)
+		rttMin = rtt;
+	if (rttSamples == 0 || rtt > rttMax)
+		rttMax = rtt;
+	rttTotal += rtt;
+	rttSamples++;
+}
+
+
 int	Datagram_GetMessage (qsocket_t *sock)
 {
 	unsigned int	length;
@@ -292,6 +329,8 @@ int	Datagram_GetMessage (qsocket_t *sock)
 	unsigned int	sequence;
 	unsigned int	count;
 
+	NetSim_Flush ();
+
 	if (!sock->canSend)
 		if ((net_time - sock->lastSendTime) > 1.0)
 			ReSendMessage (sock);
@@ -336,6 +375,7 @@ int	Datagram_GetMessage (qsocket_t *sock)
 
 		sequence = BigLong(packetBuffer.sequence);
 		packetsReceived++;
+		bytesReceived += length;
 
 		if (flags & NETFLAG_UNRELIABLE)
 		{
@@ -371,6 +411,9 @@ int	Datagram_GetMessage (qsocket_t *sock)
 			}
 			if (sequence == sock->ackSequence)
 			{
+				// retransmitted packets give ambiguous samples
+				if (!sock->reSent)
+					RecordRoundTrip (net_time - sock->lastSendTime);
 				sock->ackSequence++;
 				if (sock->ackSequence != sock->sendSequence)
 					Con_DPrintf("ack sequencing error\n");
@@ -398,7 +441,7 @@ int	Datagram_GetMessage (qsocket_t *sock)
 		{
 			packetBuffer.length = BigLong(NET_HEADERSIZE | NETFLAG_ACK);
 			packetBuffer.sequence = BigLong(sequence);
-			sfunc.Write (sock->socket, (byte *)&packetBuffer, NET_HEADERSIZE, &readaddr);
+			NetSim_Write (sock->landriver, sock->socket, (byte *)&packetBuffer, NET_HEADERSIZE, &readaddr);
 
 			if (sequence != sock->receiveSequence)
 			{
@@ -441,6 +484,58 @@ static void PrintStats(qsocket_t *s)
 	Con_Printf("\n");
 }
 
+static void PrintThroughputStats (void)
+{
+	double	elapsed;
+	int		i, lower;
+
+	elapsed = Sys_DoubleTime() - statsStartTime;
+
+	Con_Printf("bytesSent                  = %i (%.1f B/s)\n", bytesSent, elapsed > 0 ? bytesSent / elapsed : 0);
+	Con_Printf("bytesReceived              = %i (%.1f B/s)\n", bytesReceived, elapsed > 0 ? bytesReceived / elapsed : 0);
+	Con_Printf("resend ratio               = %.2f%%\n", packetsSent > 0 ? packetsReSent * 100.0 / packetsSent : 0);
+
+	if (rttSamples == 0)
+	{
+		Con_Printf("no round trip samples\n");
+		return;
+	}
+
+	Con_Printf("round trip min/avg/max     = %.1f/%.1f/%.1f ms over %i samples\n",
+		rttMin * 1000.0, rttTotal * 1000.0 / rttSamples, rttMax * 1000.0, rttSamples);
+
+	for (i = 0, lower = 0; i < (int)Q_COUNTOF(rttBucketLimits); lower = rttBucketLimits[i++])
+	{
+		if (rttBucketLimits[i] == INT_MAX)
+			Con_Printf("  %4i+      ms: %i\n", lower, rttHistogram[i]);
+		else
+			Con_Printf("  %4i-%-4i  ms: %i\n", lower, rttBucketLimits[i], rttHistogram[i]);
+	}
+}
+
+static void ResetStats (void)
+{
+	unreliableMessagesSent = 0;
+	unreliableMessagesReceived = 0;
+	messagesSent = 0;
+	messagesReceived = 0;
+	packetsSent = 0;
+	packetsReSent = 0;
+	packetsReceived = 0;
+	receivedDuplicateCount = 0;
+	shortPacketCount = 0;
+	droppedDatagrams = 0;
+	bytesSent = 0;
+	bytesReceived = 0;
+	statsStartTime = Sys_DoubleTime();
+
+	memset(rttHistogram, 0, sizeof(rttHistogram));
+	rttSamples = 0;
+	rttTotal = 0;
+	rttMin = 0;
+	rttMax = 0;
+}
+
 static void NET_Stats_f (void)
 {
 	qsocket_t	*s;
@@ -457,6 +552,13 @@ static void NET_Stats_f (void)
 		Con_Printf("receivedDuplicateCount     = %i\n", receivedDuplicateCount);
 		Con_Printf("shortPacketCount           = %i\n", shortPacketCount);
 		Con_Printf("droppedDatagrams           = %i\n", droppedDatagrams);
+		PrintThroughputStats();
+		NetSim_PrintStats();
+	}
+	else if (q_strcasecmp(Cmd_Argv(1), "reset") == 0)
+	{
+		ResetStats();
+		NetSim_ResetStats();
 	}
 	else if (Q_strcmp(Cmd_Argv(1), "*") == 0)
 	{
@@ -791,6 +893,8 @@ int Datagram_Init (void)
 	myDriverLevel = net_driverlevel;
 
 	Cmd_AddCommand ("net_stats", NET_Stats_f);
+	NetSim_Init ();
+	statsStartTime = Sys_DoubleTime();
 
 	if (safemode || COM_CheckParm("-nolan"))
 		return -1;
@@ -823,6 +927,8 @@ void Datagram_Shutdown (void)
 {
 	int i;
 
+	NetSim_Shutdown ();
+
 //
 // shutdown the lan drivers
 //
@@ -839,6 +945,7 @@ void Datagram_Shutdown (void)
 
 void Datagram_Close (qsocket_t *sock)
 {
+	NetSim_CloseSocket(sock->socket);
 	sfunc.Close_Socket(sock->socket);
 }
 
@@ -0,0 +1,326 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// net_sim.c -- simulated link layer for repeatable netcode testing
+
+#include "q_stdinc.h"
+#include "arch_def.h"
+#include "net_sys.h"
+#include "quakedef.h"
+#include "net_defs.h"
+#include "net_sim.h"
+
+static void NetSim_Seed_f (cvar_t *var);
+
+static cvar_t	net_sim = {"net_sim", "0", CVAR_NONE};
+static cvar_t	net_sim_latency = {"net_sim_latency", "0", CVAR_NONE};		// one way, milliseconds
+static cvar_t	net_sim_jitter = {"net_sim_jitter", "0", CVAR_NONE};		// +/- milliseconds
+static cvar_t	net_sim_loss = {"net_sim_loss", "0", CVAR_NONE};			// percent
+static cvar_t	net_sim_reorder = {"net_sim_reorder", "0", CVAR_NONE};		// percent
+static cvar_t	net_sim_bandwidth = {"net_sim_bandwidth", "0", CVAR_NONE};	// bytes per second, 0 is unlimited
+static cvar_t	net_sim_seed = {"net_sim_seed", "0", CVAR_NONE};
+
+// reordered packet is released with the next one, or after this delay
+#define REORDER_HOLD_TIME	0.1
+
+typedef struct simpacket_s
+{
+	struct simpacket_s	*next;
+	double		time;
+	int			landriver;
+	sys_socket_t	socket;
+	struct qsockaddr	addr;
+	int			length;
+	byte		data[1];	// variable sized
+} simpacket_t;
+
+static simpacket_t	*sim_queue;		// sorted by delivery time
+static simpacket_t	*sim_held;		// packet waiting to be reordered
+static double		sim_linkbusy;	// time when the emulated link becomes idle
+
+static unsigned int	sim_random;
+
+/* statistic counters */
+static int	simPacketsQueued;
+static int	simPacketsDropped;
+static int	simPacketsReordered;
+static int	simPacketsDelivered;
+static int	simBytesDelivered;
+static int	simQueueHighWater;
+static int	simQueueLength;
+
+
+static void NetSim_Seed_f (cvar_t *var)
+{
+	// xorshift state must not be zero
+	sim_random = (unsigned int)net_sim_seed.value * 2654435761u + 0x9e3779b9u;
+	if (sim_random == 0)
+		sim_random = 1;
+	sim_linkbusy = 0;
+}
+
+static unsigned int NetSim_Random (void)
+{
+	sim_random ^= sim_random << 13;
+	sim_random ^= sim_random >> 17;
+	sim_random ^= sim_random << 5;
+	return sim_random;
+}
+
+// returns random value in [0, 1)
+static double NetSim_RandomFraction (void)
+{
+	return (NetSim_Random () >> 8) * (1.0 / 16777216.0);
+}
+
+
+static void NetSim_Deliver (simpacket_t *packet)
+{
+	net_landrivers[packet->landriver].Write (packet->socket, packet->data, packet->length, &packet->addr);
+	simPacketsDelivered++;
+	simBytesDelivered += packet->length;
+	simQueueLength--;
+	free (packet);
+}
+
+static void NetSim_Enqueue (simpacket_t *packet)
+{
+	simpacket_t	**link;
+
+	// equal times keep submission order
+	for (link = &sim_queue; *link; link = &(*link)->next)
+	{
+		if ((*link)->time > packet->time)
+			break;
+	}
+
+	packet->next = *link;
+	*link = packet;
+}
+
+
+/*
+=============
+NetSim_Write
+=============
+*/
+int NetSim_Write (int landriver, sys_socket_t socketid, byte *buf, int len, struct qsockaddr *addr)
+{
+	simpacket_t	*packet;
+	double		now, time, jitter;
+
+	if (!net_sim.value && !sim_queue && !sim_held)
+		return net_landrivers[landriver].Write (socketid, buf, len, addr);
+
+	NetSim_Flush ();
+
+	if (!net_sim.value)
+	{
+		// keep ordering with packets still in flight
+		if (!sim_queue && !sim_held)
+			return net_landrivers[landriver].Write (socketid, buf, len, addr);
+	}
+	else if (net_sim_loss.value > 0 && NetSim_RandomFraction () * 100.0 < net_sim_loss.value)
+	{
+		simPacketsDropped++;
+		return len;	// lost packets look like successfully sent ones
+	}
+
+	now = Sys_DoubleTime ();
+	time = now;
+
+	if (net_sim.value)
+	{
+		// serialization delay over a bandwidth limited link
+		if (net_sim_bandwidth.value > 0)
+		{
+			if (sim_linkbusy > time)
+				time = sim_linkbusy;
+			time += len / net_sim_bandwidth.value;
+			sim_linkbusy = time;
+		}
+
+		time += q_max (net_sim_latency.value, 0) * 0.001;
+
+		if (net_sim_jitter.value > 0)
+		{
+			jitter = (NetSim_RandomFraction () * 2.0 - 1.0) * net_sim_jitter.value * 0.001;
+			time = q_max (time + jitter, now);
+		}
+	}
+
+	packet = (simpacket_t *) malloc (sizeof(simpacket_t) + len);
+	packet->time = time;
+	packet->landriver = landriver;
+	packet->socket = socketid;
+	packet->addr = *addr;
+	packet->length = len;
+	memcpy (packet->data, buf, len);
+
+	simPacketsQueued++;
+	simQueueLength++;
+	if (simQueueLength > simQueueHighWater)
+		simQueueHighWater = simQueueLength;
+
+	// previously held packet goes right after this one
+	if (sim_held)
+	{
+		sim_held->time = time;
+		NetSim_Enqueue (packet);
+		NetSim_Enqueue (sim_held);
+		sim_held = NULL;
+	}
+	else if (net_sim.value && net_sim_reorder.value > 0 && NetSim_RandomFraction () * 100.0 < net_sim_reorder.value)
+	{
+		packet->time = time + REORDER_HOLD_TIME;
+		sim_held = packet;
+		simPacketsReordered++;
+	}
+	else
+		NetSim_Enqueue (packet);
+
+	return len;
+}
+
+
+/*
+=============
+NetSim_Flush
+=============
+*/
+void NetSim_Flush (void)
+{
+	simpacket_t	*packet;
+	double		now;
+
+	if (!sim_queue && !sim_held)
+		return;
+
+	now = Sys_DoubleTime ();
+
+	if (sim_held && (sim_held->time <= now || !net_sim.value))
+	{
+		NetSim_Enqueue (sim_held);
+		sim_held = NULL;
+	}
+
+	while (sim_queue && (sim_queue->time <= now || !net_sim.value))
+	{
+		packet = sim_queue;
+		sim_queue = packet->next;
+		NetSim_Deliver (packet);
+	}
+}
+
+
+/*
+=============
+NetSim_CloseSocket
+=============
+*/
+void NetSim_CloseSocket (sys_socket_t socketid)
+{
+	simpacket_t	**link, *packet;
+
+	if (sim_held && sim_held->socket == socketid)
+	{
+		free (sim_held);
+		sim_held = NULL;
+		simQueueLength--;
+	}
+
+	for (link = &sim_queue; *link; )
+	{
+		packet = *link;
+
+		if (packet->socket == socketid)
+		{
+			*link = packet->next;
+			free (packet);
+			simQueueLength--;
+		}
+		else
+			link = &packet->next;
+	}
+}
+
+
+void NetSim_PrintStats (void)
+{
+	Con_Printf("net_sim                    = %s\n", net_sim.value ? "on" : "off");
+	Con_Printf("  latency %g ms, jitter %g ms, loss %g%%, reorder %g%%, bandwidth %g B/s\n",
+		net_sim_latency.value, net_sim_jitter.value, net_sim_loss.value,
+		net_sim_reorder.value, net_sim_bandwidth.value);
+	Con_Printf("simPacketsQueued           = %i\n", simPacketsQueued);
+	Con_Printf("simPacketsDropped          = %i\n", simPacketsDropped);
+	Con_Printf("simPacketsReordered        = %i\n", simPacketsReordered);
+	Con_Printf("simPacketsDelivered        = %i\n", simPacketsDelivered);
+	Con_Printf("simBytesDelivered          = %i\n", simBytesDelivered);
+	Con_Printf("simQueueLength             = %i (max %i)\n", simQueueLength, simQueueHighWater);
+}
+
+void NetSim_ResetStats (void)
+{
+	simPacketsQueued = 0;
+	simPacketsDropped = 0;
+	simPacketsReordered = 0;
+	simPacketsDelivered = 0;
+	simBytesDelivered = 0;
+	simQueueHighWater = simQueueLength;
+
+	// restart the random sequence so that runs are repeatable
+	NetSim_Seed_f (&net_sim_seed);
+}
+
+
+void NetSim_Init (void)
+{
+	Cvar_RegisterVariable (&net_sim);
+	Cvar_RegisterVariable (&net_sim_latency);
+	Cvar_RegisterVariable (&net_sim_jitter);
+	Cvar_RegisterVariable (&net_sim_loss);
+	Cvar_RegisterVariable (&net_sim_reorder);
+	Cvar_RegisterVariable (&net_sim_bandwidth);
+	Cvar_RegisterVariable (&net_sim_seed);
+	Cvar_SetCallback (&net_sim_seed, NetSim_Seed_f);
+
+	NetSim_Seed_f (&net_sim_seed);
+}
+
+void NetSim_Shutdown (void)
+{
+	simpacket_t	*packet;
+
+	if (sim_held)
+	{
+		free (sim_held);
+		sim_held = NULL;
+	}
+
+	while (sim_queue)
+	{
+		packet = sim_queue;
+		sim_queue = packet->next;
+		free (packet);
+	}
+
+	simQueueLength = 0;
+}
@@ -0,0 +1,44 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#ifndef __NET_SIM_H
+#define __NET_SIM_H
+
+// net_sim.c -- network condition emulator sitting between the datagram
+// driver and a lan driver. Outgoing packets can be delayed, dropped,
+// reordered and rate limited according to net_sim_* cvars.
+
+void	NetSim_Init (void);
+void	NetSim_Shutdown (void);
+
+int		NetSim_Write (int landriver, sys_socket_t socketid, byte *buf, int len, struct qsockaddr *addr);
+// same contract as net_landriver_t.Write, packets are queued when emulation is active
+
+void	NetSim_Flush (void);
+// hands over all queued packets whose delivery time has come
+
+void	NetSim_CloseSocket (sys_socket_t socketid);
+// discards queued packets of a socket that is about to be closed
+
+void	NetSim_PrintStats (void);
+void	NetSim_ResetStats (void);
+
+#endif	/* __NET_SIM_H */
@@ -282,9 +282,35 @@ static void PF_setsize (void)
 	minvec = G_VECTOR(OFS_PARM1);
 	maxvec = G_VECTOR(OFS_PARM2);
 	SetMinMaxSize (e, minvec, maxvec, false);
+	e->sizepending = false;
 }
 
 
+/*
+=================
+SV_SetModelSize
+
+Sets the size of e to the bounds of mod. A model that is still streaming
+gives zero bounds and marks e to be sized again once it arrives
+=================
+*/
+void SV_SetModelSize (edict_t *e, qmodel_t *mod)
+{
+	e->sizepending = !mod && e->v.modelindex;
+
+	if (mod)
+	//johnfitz -- correct physics cullboxes for bmodels
+	{
+		if (mod->type == mod_brush)
+			SetMinMaxSize (e, mod->clipmins, mod->clipmaxs, true);
+		else
+			SetMinMaxSize (e, mod->mins, mod->maxs, true);
+	}
+	//johnfitz
+	else
+		SetMinMaxSize (e, vec3_origin, vec3_origin, true);
+}
+
 /*
 =================
 PF_setmodel
@@ -318,17 +344,7 @@ static void PF_setmodel (void)
 
 	mod = sv.models[ (int)e->v.modelindex];  // Mod_ForName (m, true);
 
-	if (mod)
-	//johnfitz -- correct physics cullboxes for bmodels
-	{
-		if (mod->type == mod_brush)
-			SetMinMaxSize (e, mod->clipmins, mod->clipmaxs, true);
-		else
-			SetMinMaxSize (e, mod->mins, mod->maxs, true);
-	}
-	//johnfitz
-	else
-		SetMinMaxSize (e, vec3_origin, vec3_origin, true);
+	SV_SetModelSize (e, mod);
 }
 
 /*
@@ -161,6 +161,7 @@ void ED_Free (edict_t *ed)
 	ed->v.solid = 0;
 	ed->alpha = ENTALPHA_DEFAULT; //johnfitz -- reset alpha for next entity
 	ed->scale = ENTSCALE_DEFAULT;
+	ed->sizepending = false;
 
 	ed->freetime = sv.time;
 }
@@ -51,6 +51,7 @@ typedef struct edict_s
 	qboolean	sendinterval;		/* johnfitz -- send time until nextthink to client for better lerp timing */
 	float		oldframe;
 	float		oldthinktime;
+	qboolean	sizepending;		/* setmodel before the model finished streaming, sized on arrival */
 
 	float		freetime;		/* sv.time when the object was freed */
 	entvars_t	v;			/* C exported fields from progs */
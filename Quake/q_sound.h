@@ -36,6 +36,7 @@ typedef struct sfx_s
 {
 	char	name[MAX_QPATH];
 	cache_user_t	cache;
+	asyncfile_t	*request;	// being read in the background
 } sfx_t;
 
 /* !!! if this is changed, it must be changed in asm_i386.h too !!! */
@@ -181,6 +182,7 @@ extern	cvar_t		bgmvolume;
 
 void S_LocalSound (const char *name);
 sfxcache_t *S_LoadSound (sfx_t *s);
+void S_RequestSound (sfx_t *s);
 
 wavinfo_t GetWavinfo (const char *name, byte *wav, int wavlength);
 
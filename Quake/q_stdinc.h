@@ -255,4 +255,21 @@ typedef ptrdiff_t	ssize_t;
 
 /*==========================================================================*/
 
+/* SIMD instruction sets the compiler targets, for the vectorized
+ * renderer paths. The NEON paths assume little endian. */
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define USE_SSE
+#include <xmmintrin.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define USE_SSE2
+#include <emmintrin.h>
+#endif
+#elif defined(__ARM_NEON) && !defined(__ARM_BIG_ENDIAN)
+#define USE_NEON
+#include <arm_neon.h>
+#endif	/* SIMD */
+
+/*==========================================================================*/
+
 #endif	/* QSTDINC_H */
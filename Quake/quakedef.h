@@ -211,6 +211,8 @@ typedef struct
 #include "common.h"
 #include "bspfile.h"
 #include "sys.h"
+#include "jobs.h"
+#include "async.h"
 #include "zone.h"
 #include "mathlib.h"
 #include "cvar.h"
@@ -219,6 +219,9 @@ static VBOs), and lerping and lighting is done in the vertex shader.
 
 Supports optional overbright, optional fullbright pixels.
 
+r_alias_program is left bound, so that a run of alias models doesn't switch
+programs, whoever draws them calls GL_UseProgram (0) afterwards.
+
 Based on code by MH from RMQEngine
 =============
 */
@@ -235,7 +238,7 @@ void GL_DrawAliasFrame_GLSL (aliashdr_t *paliashdr, lerpdata_t lerpdata, gltextu
 		blend = 0;
 	}
 
-	GL_UseProgramFunc (r_alias_program);
+	GL_UseProgram (r_alias_program);
 
 	GL_BindBuffer (GL_ARRAY_BUFFER, currententity->model->meshvbo);
 	GL_BindBuffer (GL_ELEMENT_ARRAY_BUFFER, currententity->model->meshindexesvbo);
@@ -283,7 +286,6 @@ void GL_DrawAliasFrame_GLSL (aliashdr_t *paliashdr, lerpdata_t lerpdata, gltextu
 	GL_DisableVertexAttribArrayFunc (pose1NormalAttrIndex);
 	GL_DisableVertexAttribArrayFunc (pose2NormalAttrIndex);
 
-	GL_UseProgramFunc (0);
 	GL_SelectTexture (GL_TEXTURE0);
 
 	rs_aliaspasses += paliashdr->numtris;
@@ -625,6 +627,32 @@ void R_SetupAliasLighting (entity_t	*e)
 	VectorScale (lightcolor, 1.0f / 200.0f, lightcolor);
 }
 
+/*
+=================
+R_AliasSkinTextures
+
+Picks the skin and fullbright textures the entity is drawn with this frame
+=================
+*/
+void R_AliasSkinTextures (entity_t *e, aliashdr_t *paliashdr, gltexture_t **tx, gltexture_t **fb)
+{
+	int		anim, skinnum;
+
+	anim = (int)(cl.time*10) & 3;
+	skinnum = e->skinnum;
+	if ((skinnum >= paliashdr->numskins) || (skinnum < 0))
+		skinnum = 0; // ericw -- display skin 0 for winquake compatibility
+	*tx = paliashdr->gltextures[skinnum][anim];
+	*fb = paliashdr->fbtextures[skinnum][anim];
+	if (e->colormap != vid.colormap && !gl_nocolors.value)
+	{
+		if ((uintptr_t)e >= (uintptr_t)&cl_entities[1] && (uintptr_t)e <= (uintptr_t)&cl_entities[cl.maxclients]) /* && !strcmp (currententity->model->name, "progs/player.mdl") */
+			*tx = playertextures[e - cl_entities - 1];
+	}
+	if (!gl_fullbrights.value)
+		*fb = NULL;
+}
+
 /*
 =================
 R_DrawAliasModel -- johnfitz -- almost completely rewritten
@@ -633,7 +661,6 @@ R_DrawAliasModel -- johnfitz -- almost completely rewritten
 void R_DrawAliasModel (entity_t *e)
 {
 	aliashdr_t	*paliashdr;
-	int		anim, skinnum;
 	gltexture_t	*tx, *fb;
 	lerpdata_t	lerpdata;
 	qboolean	alphatest = !!(e->model->flags & MF_HOLEY);
@@ -701,23 +728,9 @@ void R_DrawAliasModel (entity_t *e)
 	// set up textures
 	//
 	GL_DisableMultitexture();
-	anim = (int)(cl.time*10) & 3;
-	skinnum = e->skinnum;
-	if ((skinnum >= paliashdr->numskins) || (skinnum < 0))
-	{
-		Con_DPrintf ("R_DrawAliasModel: no such skin # %d for '%s'\n", skinnum, e->model->name);
-		// ericw -- display skin 0 for winquake compatibility
-		skinnum = 0;
-	}
-	tx = paliashdr->gltextures[skinnum][anim];
-	fb = paliashdr->fbtextures[skinnum][anim];
-	if (e->colormap != vid.colormap && !gl_nocolors.value)
-	{
-		if ((uintptr_t)e >= (uintptr_t)&cl_entities[1] && (uintptr_t)e <= (uintptr_t)&cl_entities[cl.maxclients]) /* && !strcmp (currententity->model->name, "progs/player.mdl") */
-			tx = playertextures[e - cl_entities - 1];
-	}
-	if (!gl_fullbrights.value)
-		fb = NULL;
+	if ((e->skinnum >= paliashdr->numskins) || (e->skinnum < 0))
+		Con_DPrintf ("R_DrawAliasModel: no such skin # %d for '%s'\n", e->skinnum, e->model->name);
+	R_AliasSkinTextures (e, paliashdr, &tx, &fb);
 
 	//
 	// draw it
@@ -24,8 +24,19 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "quakedef.h"
 
+// the SIMD lightmap code builds little endian texels
+#if defined(USE_SSE2)
+#define LIGHTMAP_SIMD_NAME	"sse2"
+#elif defined(USE_NEON)
+#define LIGHTMAP_SIMD_NAME	"neon"
+#else
+#define LIGHTMAP_SIMD_NAME	"nosimd"
+#endif
+
 extern cvar_t gl_fullbrights, r_drawflat, gl_overbright, r_oldwater; //johnfitz
 extern cvar_t gl_zfix; // QuakeSpasm z-fighting fix
+extern cvar_t r_parallellightmaps;
+extern cvar_t r_bspcache;
 
 int		gl_lightmap_format;
 int		lightmap_bytes;
@@ -34,10 +45,13 @@ int		lightmap_bytes;
 struct lightmap_s	*lightmaps;
 int		lightmap_count;
 
-static int	allocated[LMBLOCK_WIDTH];
-static int	last_lightmap_allocated;
+#define LIGHTMAP_OPEN_BLOCKS	4	// AllocBlock only tries the last few blocks
+
+static int	*allocated;	// [lightmap_count][LMBLOCK_WIDTH] used height of every column
 
-static unsigned	blocklights[LMBLOCK_WIDTH*LMBLOCK_HEIGHT*3]; //johnfitz -- was 18*18, added lit support (*3) and loosened surface extents maximum (LMBLOCK_WIDTH*LMBLOCK_HEIGHT)
+static unsigned	*blocklights[MAX_JOB_WORKERS]; //johnfitz -- was 18*18, added lit support (*3) and loosened surface extents maximum (LMBLOCK_WIDTH*LMBLOCK_HEIGHT)
+
+static void R_QueueLightMap (msurface_t *surf);
 
 
 /*
@@ -200,6 +214,7 @@ void R_DrawBrushModel (entity_t *e)
 			rs_brushpolys++;
 		}
 	}
+	R_FlushLightmapUpdates ();
 
 	R_DrawTextureChains (clmodel, e, chain_model);
 	R_DrawTextureChains_Water (clmodel, e, chain_model);
@@ -276,6 +291,81 @@ void R_DrawBrushModel_ShowTris (entity_t *e)
 =============================================================
 */
 
+/*
+================
+R_UnionRect
+================
+*/
+static void R_UnionRect (const glRect_t *a, const glRect_t *b, glRect_t *out)
+{
+	int	l, t, r, bottom;
+
+	l = q_min (a->l, b->l);
+	t = q_min (a->t, b->t);
+	r = q_max (a->l + a->w, b->l + b->w);
+	bottom = q_max (a->t + a->h, b->t + b->h);
+
+	out->l = l;
+	out->t = t;
+	out->w = r - l;
+	out->h = bottom - t;
+}
+
+#define RECT_AREA(r)	((int)(r)->w * (r)->h)
+
+/*
+================
+R_AddDirtyRect
+
+Adds a region to the dirty rectangles of a lightmap block. It is merged into
+a rectangle when the union doesn't waste much more than a quarter of its
+area, or into the one that grows least when all slots are taken. A merged
+rectangle may now touch others, so merging repeats until nothing changes.
+================
+*/
+static void R_AddDirtyRect (struct lightmap_s *lm, const glRect_t *rect)
+{
+	glRect_t	add, merged;
+	int			i, best, growth, bestgrowth;
+
+	add = *rect;
+
+	for (i = 0; i < lm->numdirty; )
+	{
+		R_UnionRect (&lm->dirty[i], &add, &merged);
+		if (RECT_AREA (&merged) * 3 > (RECT_AREA (&lm->dirty[i]) + RECT_AREA (&add)) * 4)
+		{
+			i++;
+			continue;
+		}
+
+		// take it out and try to merge the union with the remaining ones
+		add = merged;
+		lm->dirty[i] = lm->dirty[--lm->numdirty];
+		i = 0;
+	}
+
+	if (lm->numdirty < MAX_LIGHTMAP_RECTS)
+	{
+		lm->dirty[lm->numdirty++] = add;
+		return;
+	}
+
+	best = 0;
+	bestgrowth = INT_MAX;
+	for (i = 0; i < lm->numdirty; i++)
+	{
+		R_UnionRect (&lm->dirty[i], &add, &merged);
+		growth = RECT_AREA (&merged) - RECT_AREA (&lm->dirty[i]);
+		if (growth < bestgrowth)
+		{
+			bestgrowth = growth;
+			best = i;
+		}
+	}
+	R_UnionRect (&lm->dirty[best], &add, &lm->dirty[best]);
+}
+
 /*
 ================
 R_RenderDynamicLightmaps
@@ -284,10 +374,8 @@ called during rendering
 */
 void R_RenderDynamicLightmaps (msurface_t *fa)
 {
-	byte		*base;
 	int			maps;
-	glRect_t    *theRect;
-	int smax, tmax;
+	glRect_t	rect;
 
 	if (fa->flags & SURF_DRAWTILED) //johnfitz -- not a lightmapped surface
 		return;
@@ -309,89 +397,196 @@ dynamic:
 		{
 			struct lightmap_s *lm = &lightmaps[fa->lightmaptexturenum];
 			lm->modified = true;
-			theRect = &lm->rectchange;
-			if (fa->light_t < theRect->t) {
-				if (theRect->h)
-					theRect->h += theRect->t - fa->light_t;
-				theRect->t = fa->light_t;
-			}
-			if (fa->light_s < theRect->l) {
-				if (theRect->w)
-					theRect->w += theRect->l - fa->light_s;
-				theRect->l = fa->light_s;
-			}
-			smax = (fa->extents[0]>>4)+1;
-			tmax = (fa->extents[1]>>4)+1;
-			if ((theRect->w + theRect->l) < (fa->light_s + smax))
-				theRect->w = (fa->light_s-theRect->l)+smax;
-			if ((theRect->h + theRect->t) < (fa->light_t + tmax))
-				theRect->h = (fa->light_t-theRect->t)+tmax;
-			base = lm->data;
-			base += fa->light_t * LMBLOCK_WIDTH * lightmap_bytes + fa->light_s * lightmap_bytes;
-			R_BuildLightMap (fa, base, LMBLOCK_WIDTH*lightmap_bytes);
+			rect.l = fa->light_s;
+			rect.t = fa->light_t;
+			rect.w = (fa->extents[0]>>4)+1;
+			rect.h = (fa->extents[1]>>4)+1;
+			R_AddDirtyRect (lm, &rect);
+			R_QueueLightMap (fa);
 		}
 	}
 }
 
 /*
 ========================
-AllocBlock -- returns a texture number and the position inside it
+R_SkylineFit
+
+Finds the spot for a w*h rectangle on the skyline of a lightmap block, which
+holds the used height of every column. The lowest spot wins, ties go to the
+one that leaves the least unused space below the rectangle. legacy matches
+the first fit search AllocBlock used to do. Returns the y, or -1 with x
+set to 0 when nothing fits.
 ========================
 */
-int AllocBlock (int w, int h, int *x, int *y)
+static int R_SkylineFit (const int *skyline, int w, int h, int *x, qboolean legacy)
 {
-	int		i, j;
-	int		best, best2;
-	int		texnum;
-
-	// ericw -- rather than searching starting at lightmap 0 every time,
-	// start at the last lightmap we allocated a surface in.
-	// This makes AllocBlock much faster on large levels (can shave off 3+ seconds
-	// of load time on a level with 180 lightmaps), at a cost of not quite packing
-	// lightmaps as tightly vs. not doing this (uses ~5% more lightmaps)
-	for (texnum=last_lightmap_allocated ; texnum<MAX_SANITY_LIGHTMAPS ; texnum++)
+	int		i, j, y, top, gap;
+	int		best, bestgap;
+
+	*x = 0;
+	best = LMBLOCK_HEIGHT;
+	bestgap = INT_MAX;
+
+	for (i=0 ; legacy ? i<LMBLOCK_WIDTH-w : i<=LMBLOCK_WIDTH-w ; i++)
 	{
-		if (texnum == lightmap_count)
+		top = 0;
+		for (j=0 ; j<w ; j++)
 		{
-			lightmap_count++;
-			lightmaps = (struct lightmap_s *) realloc(lightmaps, sizeof(*lightmaps)*lightmap_count);
-			memset(&lightmaps[texnum], 0, sizeof(lightmaps[texnum]));
-			lightmaps[texnum].data = (byte *) calloc(1, 4*LMBLOCK_WIDTH*LMBLOCK_HEIGHT);
-			//as we're only tracking one texture, we don't need multiple copies of allocated any more.
-			memset(allocated, 0, sizeof(allocated));
+			if (skyline[i+j] > best || (legacy && skyline[i+j] == best))
+				break;
+			if (skyline[i+j] > top)
+				top = skyline[i+j];
 		}
-		best = LMBLOCK_HEIGHT;
+		if (j < w)
+			continue;
 
-		for (i=0 ; i<LMBLOCK_WIDTH-w ; i++)
+		gap = 0;
+		if (!legacy)
 		{
-			best2 = 0;
-
 			for (j=0 ; j<w ; j++)
-			{
-				if (allocated[i+j] >= best)
-					break;
-				if (allocated[i+j] > best2)
-					best2 = allocated[i+j];
-			}
-			if (j == w)
-			{	// this is a valid spot
-				*x = i;
-				*y = best = best2;
-			}
+				gap += top - skyline[i+j];
+			if (top == best && gap >= bestgap)
+				continue;
 		}
 
-		if (best + h > LMBLOCK_HEIGHT)
+		*x = i;
+		best = top;
+		bestgap = gap;
+	}
+
+	y = best;
+	if (y + h > LMBLOCK_HEIGHT)
+		return -1;
+
+	return y;
+}
+
+/*
+========================
+AllocBlock -- returns a texture number and the position inside it
+
+Surfaces come in sorted by height, so older blocks fill up from the bottom
+and only the last few are worth searching, which keeps loading fast on big
+maps.
+========================
+*/
+int AllocBlock (int w, int h, int *x, int *y)
+{
+	int		i, texnum;
+	int		*skyline;
+
+	if (w > LMBLOCK_WIDTH || h > LMBLOCK_HEIGHT)
+		Sys_Error ("AllocBlock: %ix%i doesn't fit", w, h);
+
+	for (texnum=q_max (0, lightmap_count - LIGHTMAP_OPEN_BLOCKS) ; texnum<lightmap_count ; texnum++)
+	{
+		skyline = allocated + texnum * LMBLOCK_WIDTH;
+		if ((*y = R_SkylineFit (skyline, w, h, x, false)) < 0)
 			continue;
 
 		for (i=0 ; i<w ; i++)
-			allocated[*x + i] = best + h;
+			skyline[*x + i] = *y + h;
 
-		last_lightmap_allocated = texnum;
 		return texnum;
 	}
 
-	Sys_Error ("AllocBlock: full");
-	return 0; //johnfitz -- shut up compiler
+	if (lightmap_count == MAX_SANITY_LIGHTMAPS)
+		Sys_Error ("AllocBlock: full");
+
+	texnum = lightmap_count++;
+	lightmaps = (struct lightmap_s *) realloc(lightmaps, sizeof(*lightmaps)*lightmap_count);
+	memset(&lightmaps[texnum], 0, sizeof(lightmaps[texnum]));
+	lightmaps[texnum].data = (byte *) calloc(1, 4*LMBLOCK_WIDTH*LMBLOCK_HEIGHT);
+	allocated = (int *) realloc(allocated, sizeof(*allocated)*LMBLOCK_WIDTH*lightmap_count);
+	if (!allocated)
+		Sys_Error ("AllocBlock: out of memory");
+
+	skyline = allocated + texnum * LMBLOCK_WIDTH;
+	memset(skyline, 0, sizeof(*allocated)*LMBLOCK_WIDTH);
+	*x = *y = 0;
+	for (i=0 ; i<w ; i++)
+		skyline[i] = h;
+
+	return texnum;
+}
+
+/*
+========================
+R_LightmapPackOrder
+
+Taller surfaces first, then wider ones, the surface order breaks ties so
+packing doesn't depend on the qsort implementation
+========================
+*/
+static int R_LightmapPackOrder (const void *a, const void *b)
+{
+	const msurface_t *sa = *(const msurface_t **) a;
+	const msurface_t *sb = *(const msurface_t **) b;
+
+	if (sa->extents[1] != sb->extents[1])
+		return sb->extents[1] - sa->extents[1];
+	if (sa->extents[0] != sb->extents[0])
+		return sb->extents[0] - sa->extents[0];
+	return (sa < sb) ? -1 : (sa > sb);
+}
+
+/*
+========================
+R_LightmapInfo_f
+
+Prints how full the lightmap blocks are, and how many blocks the old
+first fit packing in surface order would have needed
+========================
+*/
+void R_LightmapInfo_f (void)
+{
+	qmodel_t	*m;
+	msurface_t	*surf;
+	int			skyline[LMBLOCK_WIDTH];
+	int			i, j, k, w, h, x, y, used, legacy;
+
+	if (!cl.worldmodel || !lightmap_count)
+	{
+		Con_Printf ("no map loaded\n");
+		return;
+	}
+
+	used = 0;
+	legacy = 1;
+	memset (skyline, 0, sizeof(skyline));
+
+	for (j=1 ; j<MAX_MODELS ; j++)
+	{
+		m = cl.model_precache[j];
+		if (!m)
+			break;
+		if (m->name[0] == '*')
+			continue;
+		for (i=0, surf=m->surfaces ; i<m->numsurfaces ; i++, surf++)
+		{
+			if (surf->flags & SURF_DRAWTILED)
+				continue;
+
+			w = (surf->extents[0]>>4)+1;
+			h = (surf->extents[1]>>4)+1;
+			used += w*h;
+
+			if ((y = R_SkylineFit (skyline, w, h, &x, true)) < 0)
+			{
+				legacy++;
+				memset (skyline, 0, sizeof(skyline));
+				if ((y = R_SkylineFit (skyline, w, h, &x, true)) < 0)
+					continue;
+			}
+			for (k=0 ; k<w ; k++)
+				skyline[x + k] = y + h;
+		}
+	}
+
+	Con_Printf ("%i lightmaps, %.1f%% used\n", lightmap_count,
+		100.0 * used / ((double)lightmap_count * LMBLOCK_WIDTH * LMBLOCK_HEIGHT));
+	Con_Printf ("%i lightmaps, %.1f%% used with first fit packing\n", legacy,
+		100.0 * used / ((double)legacy * LMBLOCK_WIDTH * LMBLOCK_HEIGHT));
 }
 
 
@@ -406,7 +601,6 @@ GL_CreateSurfaceLightmap
 void GL_CreateSurfaceLightmap (msurface_t *surf)
 {
 	int		smax, tmax;
-	byte	*base;
 
 	if (surf->flags & SURF_DRAWTILED)
 	{
@@ -418,9 +612,6 @@ void GL_CreateSurfaceLightmap (msurface_t *surf)
 	tmax = (surf->extents[1]>>4)+1;
 
 	surf->lightmaptexturenum = AllocBlock (smax, tmax, &surf->light_s, &surf->light_t);
-	base = lightmaps[surf->lightmaptexturenum].data;
-	base += (surf->light_t * LMBLOCK_WIDTH + surf->light_s) * lightmap_bytes;
-	R_BuildLightMap (surf, base, LMBLOCK_WIDTH*lightmap_bytes);
 }
 
 /*
@@ -521,6 +712,362 @@ void BuildSurfaceDisplayList (msurface_t *fa)
 		GL_SubdivideSurface (fa);
 }
 
+/*
+=============================================================================
+
+BSP CACHE
+
+Packing the lightmaps and building the surface polygons only depends on the
+brush models that are loaded, so both are saved to bspcache/<map>.cache in
+the game directory and read back when the same models are loaded again. The
+file starts with a key made of the cache version and the size, FNV-1a hash,
+face and vertex counts of every brush model, so a hit needs all of them to
+match. Then come the lightmap count and one record per surface, with its
+polygons in the order they were allocated. Lightmap texels are always
+rebuilt.
+
+=============================================================================
+*/
+
+#define BSPCACHE_IDENT		(('C'<<24)+('P'<<16)+('S'<<8)+'Q')	// little-endian "QSPC"
+#define BSPCACHE_VERSION	2
+
+typedef struct
+{
+	int		ident;
+	int		version;
+	int		blockwidth, blockheight;
+	float	subdivide;
+	int		nummodels;
+} bspcacheheader_t;
+
+typedef struct
+{
+	char	name[MAX_QPATH];
+	int		filesize;
+	unsigned int	filehash;
+	int		numsurfaces;
+	int		numvertexes;
+} bspcachemodel_t;
+
+typedef struct
+{
+	int		lightmaptexturenum;
+	int		light_s, light_t;
+	int		numpolys;
+} bspcachesurf_t;
+
+/*
+====================
+R_BSPCacheKey
+
+Every cache file has to start with this for the loaded brush models, NULL
+if one of them was loaded without a hash
+====================
+*/
+static byte *R_BSPCacheKey (void)
+{
+	bspcacheheader_t	header;
+	bspcachemodel_t		model;
+	qmodel_t	*m;
+	byte		*key;
+	int			j;
+
+	memset (&header, 0, sizeof(header));
+	header.ident = BSPCACHE_IDENT;
+	header.version = BSPCACHE_VERSION;
+	header.blockwidth = LMBLOCK_WIDTH;
+	header.blockheight = LMBLOCK_HEIGHT;
+	header.subdivide = gl_subdivide_size.value;
+	for (j=1 ; j<MAX_MODELS ; j++)
+	{
+		m = cl.model_precache[j];
+		if (!m)
+			break;
+		if (m->name[0] != '*' && m->type == mod_brush)
+			header.nummodels++;
+	}
+
+	key = NULL;
+	Vec_Append ((void **) &key, 1, &header, sizeof(header));
+
+	for (j=1 ; j<MAX_MODELS ; j++)
+	{
+		m = cl.model_precache[j];
+		if (!m)
+			break;
+		if (m->name[0] == '*' || m->type != mod_brush)
+			continue;
+		if (m->filesize == -1)
+		{
+			VEC_FREE (key);
+			return NULL;
+		}
+		memset (&model, 0, sizeof(model));
+		q_strlcpy (model.name, m->name, sizeof(model.name));
+		model.filesize = m->filesize;
+		model.filehash = m->filehash;
+		model.numsurfaces = m->numsurfaces;
+		model.numvertexes = m->numvertexes;
+		Vec_Append ((void **) &key, 1, &model, sizeof(model));
+	}
+
+	return key;
+}
+
+static void R_BSPCachePath (char *path, size_t size)
+{
+	char	mapname[MAX_QPATH];
+
+	COM_FileBase (cl.worldmodel->name, mapname, sizeof(mapname));
+	q_snprintf (path, size, "%s/bspcache/%s.cache", com_gamedir, mapname);
+}
+
+/*
+====================
+R_CacheSurface
+
+Adds the placement and the polygons BuildSurfaceDisplayList gave surf,
+everything in front of oldpolys
+====================
+*/
+static void R_CacheSurface (byte **cache, msurface_t *surf, glpoly_t *oldpolys)
+{
+	static glpoly_t	**polys;
+	bspcachesurf_t	rec;
+	glpoly_t	*p;
+	int			i;
+
+	VEC_CLEAR (polys);
+	for (p = surf->polys; p && p != oldpolys; p = p->next)
+		VEC_PUSH (polys, p);
+
+	memset (&rec, 0, sizeof(rec));
+	rec.lightmaptexturenum = -1;
+	if (!(surf->flags & SURF_DRAWTILED))
+	{
+		rec.lightmaptexturenum = surf->lightmaptexturenum;
+		rec.light_s = surf->light_s;
+		rec.light_t = surf->light_t;
+		rec.numpolys = VEC_SIZE (polys);
+	}
+	Vec_Append ((void **) cache, 1, &rec, sizeof(rec));
+
+	// the display poly, then the subdivided ones, which were put after it
+	// in reverse order
+	for (i=0 ; i<rec.numpolys ; i++)
+	{
+		p = polys[i ? rec.numpolys - i : 0];
+		Vec_Append ((void **) cache, 1, &p->numverts, sizeof(int));
+		Vec_Append ((void **) cache, 1, p->verts, p->numverts * VERTEXSIZE * sizeof(float));
+	}
+}
+
+/*
+====================
+R_ParseBSPCache
+
+Goes over the surfaces of a cache file, first only to check it, then with
+apply to set up the lightmaps and polygons the way GL_BuildLightmaps would
+====================
+*/
+static qboolean R_ParseBSPCache (const byte *data, int len, qboolean apply)
+{
+	const byte	*end = data + len;
+	bspcachesurf_t	rec;
+	qmodel_t	*m;
+	msurface_t	*surf;
+	glpoly_t	*poly;
+	int			i, j, k, count, numverts, smax, tmax;
+	int			*skyline;
+
+	if (len < (int) sizeof(int))
+		return false;
+	memcpy (&count, data, sizeof(int));
+	data += sizeof(int);
+	if (count < 0 || count > (int) MAX_SANITY_LIGHTMAPS)
+		return false;
+
+	if (apply && count)
+	{
+		lightmap_count = count;
+		lightmaps = (struct lightmap_s *) calloc (count, sizeof(*lightmaps));
+		allocated = (int *) calloc (count * LMBLOCK_WIDTH, sizeof(*allocated));
+		if (!lightmaps || !allocated)
+			Sys_Error ("R_ParseBSPCache: out of memory");
+		for (i=0 ; i<count ; i++)
+			lightmaps[i].data = (byte *) calloc (1, 4*LMBLOCK_WIDTH*LMBLOCK_HEIGHT);
+	}
+
+	for (j=1 ; j<MAX_MODELS ; j++)
+	{
+		m = cl.model_precache[j];
+		if (!m)
+			break;
+		if (m->name[0] == '*')
+			continue;
+		for (i=0, surf=m->surfaces ; i<m->numsurfaces ; i++, surf++)
+		{
+			if (end - data < (int) sizeof(rec))
+				return false;
+			memcpy (&rec, data, sizeof(rec));
+			data += sizeof(rec);
+
+			if (surf->flags & SURF_DRAWTILED)
+			{
+				if (rec.numpolys)
+					return false;
+				continue;
+			}
+
+			smax = (surf->extents[0]>>4)+1;
+			tmax = (surf->extents[1]>>4)+1;
+			if (rec.lightmaptexturenum < 0 || rec.lightmaptexturenum >= count ||
+				rec.light_s < 0 || rec.light_s + smax > LMBLOCK_WIDTH ||
+				rec.light_t < 0 || rec.light_t + tmax > LMBLOCK_HEIGHT)
+				return false;
+			if (rec.numpolys < 1 || (rec.numpolys > 1 && !(surf->flags & SURF_DRAWTURB)))
+				return false;
+
+			if (apply)
+			{
+				surf->lightmaptexturenum = rec.lightmaptexturenum;
+				surf->light_s = rec.light_s;
+				surf->light_t = rec.light_t;
+				skyline = allocated + rec.lightmaptexturenum * LMBLOCK_WIDTH + rec.light_s;
+				for (k=0 ; k<smax ; k++)
+					skyline[k] = q_max (skyline[k], rec.light_t + tmax);
+			}
+
+			for (k=0 ; k<rec.numpolys ; k++)
+			{
+				if (end - data < (int) sizeof(int))
+					return false;
+				memcpy (&numverts, data, sizeof(int));
+				data += sizeof(int);
+				if (k ? (numverts < 1 || numverts > 64) : numverts != surf->numedges)
+					return false;
+				if ((end - data) / (VERTEXSIZE * sizeof(float)) < (size_t) numverts)
+					return false;
+
+				if (apply)
+				{
+					poly = (glpoly_t *) Hunk_Alloc (sizeof(glpoly_t) + (numverts-4) * VERTEXSIZE*sizeof(float));
+					poly->numverts = numverts;
+					memcpy (poly->verts, data, numverts * VERTEXSIZE * sizeof(float));
+					if (!k)
+					{
+						poly->next = surf->polys;
+						surf->polys = poly;
+					}
+					else
+					{
+						poly->next = surf->polys->next;
+						surf->polys->next = poly;
+					}
+				}
+				data += numverts * VERTEXSIZE * sizeof(float);
+			}
+		}
+	}
+
+	return data == end;
+}
+
+/*
+====================
+R_LoadBSPCache
+
+Returns false if there is no cache for the loaded models, and nothing has
+been set up
+====================
+*/
+static qboolean R_LoadBSPCache (void)
+{
+	char		path[MAX_OSPATH];
+	byte		*key, *data;
+	FILE		*f;
+	long		len;
+	int			keylen;
+	qboolean	ok;
+
+	if (!r_bspcache.value)
+		return false;
+
+	key = R_BSPCacheKey ();
+	if (!key)
+		return false;
+
+	R_BSPCachePath (path, sizeof(path));
+	f = fopen (path, "rb");
+	if (!f)
+	{
+		VEC_FREE (key);
+		return false;
+	}
+
+	data = NULL;
+	fseek (f, 0, SEEK_END);
+	len = ftell (f);
+	fseek (f, 0, SEEK_SET);
+	if (len > 0 && len < INT_MAX)
+	{
+		data = (byte *) malloc (len);
+		if (data && (long) fread (data, 1, len, f) != len)
+		{
+			free (data);
+			data = NULL;
+		}
+	}
+	fclose (f);
+	if (!data)
+	{
+		VEC_FREE (key);
+		return false;
+	}
+
+	keylen = VEC_SIZE (key);
+	ok = len >= keylen && !memcmp (data, key, keylen) &&
+		R_ParseBSPCache (data + keylen, len - keylen, false);
+	if (ok)
+		R_ParseBSPCache (data + keylen, len - keylen, true);
+	else
+		Con_DPrintf ("%s is out of date\n", path);
+	VEC_FREE (key);
+	free (data);
+
+	return ok;
+}
+
+static void R_SaveBSPCache (const byte *cache)
+{
+	char	path[MAX_OSPATH];
+	byte	*key;
+	FILE	*f;
+
+	key = R_BSPCacheKey ();
+	if (!key)
+		return;
+
+	Sys_mkdir (com_gamedir);
+	q_snprintf (path, sizeof(path), "%s/bspcache", com_gamedir);
+	Sys_mkdir (path);
+
+	R_BSPCachePath (path, sizeof(path));
+	f = fopen (path, "wb");
+	if (!f)
+	{
+		Con_DPrintf ("Couldn't write %s\n", path);
+		VEC_FREE (key);
+		return;
+	}
+
+	fwrite (key, 1, VEC_SIZE (key), f);
+	fwrite (cache, 1, VEC_SIZE (cache), f);
+	VEC_FREE (key);
+	fclose (f);
+}
+
 /*
 ==================
 GL_BuildLightmaps -- called at level load time
@@ -532,9 +1079,13 @@ with all the surfaces from all brush models
 void GL_BuildLightmaps (void)
 {
 	char	name[24];
-	int		i, j;
+	int		i, j, used;
 	struct lightmap_s *lm;
 	qmodel_t	*m;
+	msurface_t	**surfs;
+	glpoly_t	*oldpolys;
+	byte		*cache;
+	qboolean	cached;
 
 	r_framecount = 1; // no dlightcache
 
@@ -543,7 +1094,8 @@ void GL_BuildLightmaps (void)
 		free(lightmaps[i].data);
 	free(lightmaps);
 	lightmaps = NULL;
-	last_lightmap_allocated = 0;
+	free(allocated);
+	allocated = NULL;
 	lightmap_count = 0;
 
 	gl_lightmap_format = GL_RGBA;//FIXME: hardcoded for now!
@@ -560,6 +1112,9 @@ void GL_BuildLightmaps (void)
 		Sys_Error ("GL_BuildLightmaps: bad lightmap format");
 	}
 
+	// pack all surfaces at once, tallest first
+	surfs = NULL;
+	used = 0;
 	for (j=1 ; j<MAX_MODELS ; j++)
 	{
 		m = cl.model_precache[j];
@@ -567,19 +1122,67 @@ void GL_BuildLightmaps (void)
 			break;
 		if (m->name[0] == '*')
 			continue;
-		r_pcurrentvertbase = m->vertexes;
-		currentmodel = m;
 		for (i=0 ; i<m->numsurfaces ; i++)
 		{
 			//johnfitz -- rewritten to use SURF_DRAWTILED instead of the sky/water flags
 			if (m->surfaces[i].flags & SURF_DRAWTILED)
 				continue;
-			GL_CreateSurfaceLightmap (m->surfaces + i);
-			BuildSurfaceDisplayList (m->surfaces + i);
+			VEC_PUSH (surfs, m->surfaces + i);
+			used += ((m->surfaces[i].extents[0]>>4)+1) * ((m->surfaces[i].extents[1]>>4)+1);
 			//johnfitz
 		}
 	}
 
+	// the cache also has the polygons
+	cached = R_LoadBSPCache ();
+
+	if (surfs && !cached)
+		qsort (surfs, VEC_SIZE (surfs), sizeof(*surfs), R_LightmapPackOrder);
+	for (i=0 ; i<(int)VEC_SIZE (surfs) ; i++)
+	{
+		if (!cached)
+			GL_CreateSurfaceLightmap (surfs[i]);
+		R_QueueLightMap (surfs[i]);
+	}
+	VEC_FREE (surfs);
+
+	// the lightmaps are built on the job workers, each with its own
+	// blocklights, set up by R_BuildLightMaps before the jobs start
+	R_FlushLightmapUpdates ();
+
+	cache = NULL;
+	if (!cached && r_bspcache.value)
+		Vec_Append ((void **) &cache, 1, &lightmap_count, sizeof(lightmap_count));
+
+	for (j=1 ; j<MAX_MODELS && !cached ; j++)
+	{
+		m = cl.model_precache[j];
+		if (!m)
+			break;
+		if (m->name[0] == '*')
+			continue;
+		r_pcurrentvertbase = m->vertexes;
+		currentmodel = m;
+		for (i=0 ; i<m->numsurfaces ; i++)
+		{
+			oldpolys = m->surfaces[i].polys;
+			if (!(m->surfaces[i].flags & SURF_DRAWTILED))
+				BuildSurfaceDisplayList (m->surfaces + i);
+			if (cache)
+				R_CacheSurface (&cache, m->surfaces + i, oldpolys);
+		}
+	}
+
+	if (cache)
+	{
+		R_SaveBSPCache (cache);
+		VEC_FREE (cache);
+	}
+
+	if (lightmap_count)
+		Con_DPrintf ("%i lightmaps, %.1f%% used\n", lightmap_count,
+			100.0 * used / ((double)lightmap_count * LMBLOCK_WIDTH * LMBLOCK_HEIGHT));
+
 	//
 	// upload all lightmaps that were filled
 	//
@@ -587,10 +1190,7 @@ void GL_BuildLightmaps (void)
 	{
 		lm = &lightmaps[i];
 		lm->modified = false;
-		lm->rectchange.l = LMBLOCK_WIDTH;
-		lm->rectchange.t = LMBLOCK_HEIGHT;
-		lm->rectchange.w = 0;
-		lm->rectchange.h = 0;
+		lm->numdirty = 0;
 
 		//johnfitz -- use texture manager
 		sprintf(name, "lightmap%07i",i);
@@ -625,6 +1225,7 @@ void GL_DeleteBModelVertexBuffer (void)
 
 	GL_DeleteBuffersFunc (1, &gl_bmodel_vbo);
 	gl_bmodel_vbo = 0;
+	R_FreeWorldIndices ();
 
 	GL_ClearBufferBindings ();
 }
@@ -650,6 +1251,7 @@ void GL_BuildBModelVertexBuffer (void)
 // ask GL for a name for our VBO
 	GL_DeleteBuffersFunc (1, &gl_bmodel_vbo);
 	GL_GenBuffersFunc (1, &gl_bmodel_vbo);
+	R_FreeWorldIndices ();
 	
 // count all verts in all models
 	numverts = 0;
@@ -694,24 +1296,204 @@ void GL_BuildBModelVertexBuffer (void)
 	GL_ClearBufferBindings ();
 }
 
+/*
+=============================================================================
+
+LIGHTMAP KERNELS
+
+blocklights holds 8.8 fixed point RGB triplets for one surface. Every loop
+has a scalar version, which is the reference, and an SSE2 or NEON version
+that gives bit identical results. The SIMD versions are only used when
+simd is set, so r_lightbench can compare both.
+
+=============================================================================
+*/
+
+/*
+===============
+R_AllocBlockLights
+
+Scratch space for every job worker, has to be called on the main thread
+before the workers look at blocklights
+===============
+*/
+static void R_AllocBlockLights (void)
+{
+	int	i;
+
+	for (i = 0; i < Jobs_NumWorkers (); i++)
+	{
+		if (blocklights[i])
+			continue;
+		blocklights[i] = (unsigned *) malloc (LMBLOCK_WIDTH*LMBLOCK_HEIGHT*3 * sizeof(unsigned));
+		if (!blocklights[i])
+			Sys_Error ("R_AllocBlockLights: out of memory");
+	}
+}
+
+/*
+===============
+R_AccumulateLightmap
+
+bl[i] += lightmap[i] * scale for count values
+===============
+*/
+static void R_AccumulateLightmap (unsigned *bl, const byte *lightmap, int count, unsigned scale, qboolean simd)
+{
+	int		i = 0;
+
+#if defined(USE_SSE2)
+	// 16 bit multiply, the product of a byte and scale fits in 24 bits
+	if (simd && scale <= 0xffff)
+	{
+		const __m128i	zero = _mm_setzero_si128 ();
+		const __m128i	s = _mm_set1_epi16 ((short) scale);
+		__m128i			x, lo, hi;
+
+		for ( ; i + 8 <= count; i += 8)
+		{
+			x = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *) (lightmap + i)), zero);
+			lo = _mm_mullo_epi16 (x, s);
+			hi = _mm_mulhi_epu16 (x, s);
+			_mm_storeu_si128 ((__m128i *) (bl + i), _mm_add_epi32 (_mm_loadu_si128 ((const __m128i *) (bl + i)), _mm_unpacklo_epi16 (lo, hi)));
+			_mm_storeu_si128 ((__m128i *) (bl + i + 4), _mm_add_epi32 (_mm_loadu_si128 ((const __m128i *) (bl + i + 4)), _mm_unpackhi_epi16 (lo, hi)));
+		}
+	}
+#elif defined(USE_NEON)
+	if (simd && scale <= 0xffff)
+	{
+		uint16x8_t	x;
+
+		for ( ; i + 8 <= count; i += 8)
+		{
+			x = vmovl_u8 (vld1_u8 (lightmap + i));
+			vst1q_u32 (bl + i, vmlal_n_u16 (vld1q_u32 (bl + i), vget_low_u16 (x), (uint16_t) scale));
+			vst1q_u32 (bl + i + 4, vmlal_n_u16 (vld1q_u32 (bl + i + 4), vget_high_u16 (x), (uint16_t) scale));
+		}
+	}
+#endif
+
+	for ( ; i < count; i++)
+		bl[i] += lightmap[i] * scale;
+}
+
+/*
+===============
+R_AddDynamicLight
+
+Adds one light to a row of blocklights, local is the light position relative
+to the first texel of the row
+===============
+*/
+static void R_AddDynamicLight (unsigned *bl, int smax, float local0, int td, float rad, float minlight, const float *color, qboolean simd)
+{
+	int		s = 0, sd;
+	float	dist, brightness;
+
+#if defined(USE_SSE2)
+	if (simd)
+	{
+		const __m128	c0 = _mm_setr_ps (color[0], color[1], color[2], color[0]);
+		const __m128	c1 = _mm_setr_ps (color[1], color[2], color[0], color[1]);
+		const __m128	c2 = _mm_setr_ps (color[2], color[0], color[1], color[2]);
+		const __m128	step = _mm_setr_ps (0, 16, 32, 48);
+		const __m128	l = _mm_set1_ps (local0);
+		const __m128	r = _mm_set1_ps (rad);
+		const __m128	m = _mm_set1_ps (minlight);
+		const __m128i	t = _mm_set1_epi32 (td);
+		__m128i			sdv, sign, gt, big, small;
+		__m128			distv, b;
+
+		for ( ; s + 4 <= smax; s += 4, bl += 12)
+		{
+			// same rounding as the scalar loop, s*16 is exact
+			sdv = _mm_cvttps_epi32 (_mm_sub_ps (l, _mm_add_ps (_mm_set1_ps (s*16), step)));
+			sign = _mm_srai_epi32 (sdv, 31);
+			sdv = _mm_sub_epi32 (_mm_xor_si128 (sdv, sign), sign);
+
+			gt = _mm_cmpgt_epi32 (sdv, t);
+			big = _mm_or_si128 (_mm_and_si128 (gt, sdv), _mm_andnot_si128 (gt, t));
+			small = _mm_or_si128 (_mm_and_si128 (gt, t), _mm_andnot_si128 (gt, sdv));
+			distv = _mm_cvtepi32_ps (_mm_add_epi32 (big, _mm_srai_epi32 (small, 1)));
+
+			// zero brightness adds nothing to texels out of range
+			b = _mm_and_ps (_mm_cmplt_ps (distv, m), _mm_sub_ps (r, distv));
+
+			// spread the four brightnesses over the interleaved RGB triplets
+			_mm_storeu_si128 ((__m128i *) bl, _mm_add_epi32 (_mm_loadu_si128 ((const __m128i *) bl),
+				_mm_cvttps_epi32 (_mm_mul_ps (_mm_shuffle_ps (b, b, _MM_SHUFFLE (1,0,0,0)), c0))));
+			_mm_storeu_si128 ((__m128i *) (bl + 4), _mm_add_epi32 (_mm_loadu_si128 ((const __m128i *) (bl + 4)),
+				_mm_cvttps_epi32 (_mm_mul_ps (_mm_shuffle_ps (b, b, _MM_SHUFFLE (2,2,1,1)), c1))));
+			_mm_storeu_si128 ((__m128i *) (bl + 8), _mm_add_epi32 (_mm_loadu_si128 ((const __m128i *) (bl + 8)),
+				_mm_cvttps_epi32 (_mm_mul_ps (_mm_shuffle_ps (b, b, _MM_SHUFFLE (3,3,3,2)), c2))));
+		}
+	}
+#elif defined(USE_NEON)
+	if (simd)
+	{
+		static const float	steps[4] = {0, 16, 32, 48};
+		const float32x4_t	step = vld1q_f32 (steps);
+		const float32x4_t	l = vdupq_n_f32 (local0);
+		const float32x4_t	r = vdupq_n_f32 (rad);
+		const float32x4_t	m = vdupq_n_f32 (minlight);
+		const int32x4_t		t = vdupq_n_s32 (td);
+		int32x4_t			sdv;
+		float32x4_t			distv, b;
+		uint32x4x3_t		px;
+
+		for ( ; s + 4 <= smax; s += 4, bl += 12)
+		{
+			sdv = vabsq_s32 (vcvtq_s32_f32 (vsubq_f32 (l, vaddq_f32 (vdupq_n_f32 (s*16), step))));
+			distv = vcvtq_f32_s32 (vaddq_s32 (vmaxq_s32 (sdv, t), vshrq_n_s32 (vminq_s32 (sdv, t), 1)));
+			b = vreinterpretq_f32_u32 (vandq_u32 (vcltq_f32 (distv, m), vreinterpretq_u32_f32 (vsubq_f32 (r, distv))));
+
+			px = vld3q_u32 (bl);
+			px.val[0] = vaddq_u32 (px.val[0], vreinterpretq_u32_s32 (vcvtq_s32_f32 (vmulq_n_f32 (b, color[0]))));
+			px.val[1] = vaddq_u32 (px.val[1], vreinterpretq_u32_s32 (vcvtq_s32_f32 (vmulq_n_f32 (b, color[1]))));
+			px.val[2] = vaddq_u32 (px.val[2], vreinterpretq_u32_s32 (vcvtq_s32_f32 (vmulq_n_f32 (b, color[2]))));
+			vst3q_u32 (bl, px);
+		}
+	}
+#endif
+
+	for ( ; s < smax; s++, bl += 3)
+	{
+		sd = local0 - s*16;
+		if (sd < 0)
+			sd = -sd;
+		if (sd > td)
+			dist = sd + (td>>1);
+		else
+			dist = td + (sd>>1);
+		if (dist < minlight)
+		//johnfitz -- lit support via lordhavoc
+		{
+			brightness = rad - dist;
+			bl[0] += (int) (brightness * color[0]);
+			bl[1] += (int) (brightness * color[1]);
+			bl[2] += (int) (brightness * color[2]);
+		}
+		//johnfitz
+	}
+}
+
 /*
 ===============
 R_AddDynamicLights
 ===============
 */
-void R_AddDynamicLights (msurface_t *surf)
+static void R_AddDynamicLights (msurface_t *surf, unsigned *blocklights, qboolean simd)
 {
 	int			lnum;
-	int			sd, td;
+	int			td;
 	float		dist, rad, minlight;
 	vec3_t		impact, local;
-	int			s, t;
+	int			t;
 	int			i;
 	int			smax, tmax;
 	mtexinfo_t	*tex;
 	//johnfitz -- lit support via lordhavoc
-	float		cred, cgreen, cblue, brightness;
-	unsigned	*bl;
+	float		color[3];
 	//johnfitz
 
 	smax = (surf->extents[0]>>4)+1;
@@ -745,60 +1527,170 @@ void R_AddDynamicLights (msurface_t *surf)
 		local[1] -= surf->texturemins[1];
 
 		//johnfitz -- lit support via lordhavoc
-		bl = blocklights;
-		cred = cl_dlights[lnum].color[0] * 256.0f;
-		cgreen = cl_dlights[lnum].color[1] * 256.0f;
-		cblue = cl_dlights[lnum].color[2] * 256.0f;
+		color[0] = cl_dlights[lnum].color[0] * 256.0f;
+		color[1] = cl_dlights[lnum].color[1] * 256.0f;
+		color[2] = cl_dlights[lnum].color[2] * 256.0f;
 		//johnfitz
 		for (t = 0 ; t<tmax ; t++)
 		{
 			td = local[1] - t*16;
 			if (td < 0)
 				td = -td;
-			for (s=0 ; s<smax ; s++)
-			{
-				sd = local[0] - s*16;
-				if (sd < 0)
-					sd = -sd;
-				if (sd > td)
-					dist = sd + (td>>1);
-				else
-					dist = td + (sd>>1);
-				if (dist < minlight)
-				//johnfitz -- lit support via lordhavoc
-				{
-					brightness = rad - dist;
-					bl[0] += (int) (brightness * cred);
-					bl[1] += (int) (brightness * cgreen);
-					bl[2] += (int) (brightness * cblue);
-				}
-				bl += 3;
-				//johnfitz
-			}
+			R_AddDynamicLight (blocklights + t*smax*3, smax, local[0], td, rad, minlight, color, simd);
 		}
 	}
 }
 
-
 /*
 ===============
-R_BuildLightMap -- johnfitz -- revised for lit support via lordhavoc
+R_StoreLightmap
 
-Combine and scale multiple lightmaps into the 8.8 format in blocklights
+Bound, invert, and shift blocklights into the lightmap texture format
 ===============
 */
-void R_BuildLightMap (msurface_t *surf, byte *dest, int stride)
+static void R_StoreLightmap (const unsigned *bl, int smax, int tmax, byte *dest, int stride, qboolean simd)
 {
 	const int overbright = !!gl_overbright.value;
 	const int wide10bits = !!r_lightmapwide.value;
 
-	int			smax, tmax;
-	unsigned		r, g, b;
-	int			i, j, size;
+	int			i, j;
+	int			shift, rshift, gshift, bshift;
+	unsigned	r, g, b, maxval, extra;
+
+	shift = overbright ? 8 : 7;
+	// artifically clamp to 255 so gl_overbright 0 renders as expected in the wide10bits case
+	maxval = (wide10bits && overbright) ? 1023 : 255;
+
+	// position of each channel in a texel
+	switch (gl_lightmap_format)
+	{
+	case GL_RGBA:
+		if (wide10bits)
+			rshift = 22, gshift = 12, bshift = 2;
+		else
+			rshift = 0, gshift = 8, bshift = 16;
+		break;
+	case GL_BGRA:
+		if (wide10bits)
+			rshift = 2, gshift = 12, bshift = 22;
+		else
+			rshift = 16, gshift = 8, bshift = 0;
+		break;
+	default:
+		Sys_Error ("R_BuildLightMap: bad lightmap format");
+		return;
+	}
+	extra = wide10bits ? 3 : 0xff000000;
+
+	for (i=0 ; i<tmax ; i++, dest += stride)
+	{
+		j = 0;
+
+	// four texels are twelve values, the SIMD versions build native 32 bit
+	// texels, which matches the byte order because they are little endian only
+#if defined(USE_SSE2)
+		if (simd)
+		{
+			const __m128i	maxv = _mm_set1_epi32 (maxval);
+			const __m128i	extrav = _mm_set1_epi32 (extra);
+			const __m128i	sh = _mm_cvtsi32_si128 (shift);
+			const __m128i	rsh = _mm_cvtsi32_si128 (rshift);
+			const __m128i	gsh = _mm_cvtsi32_si128 (gshift);
+			const __m128i	bsh = _mm_cvtsi32_si128 (bshift);
+			__m128			v0, v1, v2;
+			__m128i			rv, gv, bv, gt;
+
+			for ( ; j + 4 <= smax; j += 4, bl += 12)
+			{
+				v0 = _mm_castsi128_ps (_mm_loadu_si128 ((const __m128i *) bl));		// r0 g0 b0 r1
+				v1 = _mm_castsi128_ps (_mm_loadu_si128 ((const __m128i *) (bl + 4)));	// g1 b1 r2 g2
+				v2 = _mm_castsi128_ps (_mm_loadu_si128 ((const __m128i *) (bl + 8)));	// b2 r3 g3 b3
+
+				rv = _mm_castps_si128 (_mm_shuffle_ps (_mm_shuffle_ps (v0, v0, _MM_SHUFFLE (3,3,0,0)),
+					_mm_shuffle_ps (v1, v2, _MM_SHUFFLE (1,1,2,2)), _MM_SHUFFLE (2,0,2,0)));
+				gv = _mm_castps_si128 (_mm_shuffle_ps (_mm_shuffle_ps (v0, v1, _MM_SHUFFLE (0,0,1,1)),
+					_mm_shuffle_ps (v1, v2, _MM_SHUFFLE (2,2,3,3)), _MM_SHUFFLE (2,0,2,0)));
+				bv = _mm_castps_si128 (_mm_shuffle_ps (_mm_shuffle_ps (v0, v1, _MM_SHUFFLE (1,1,2,2)),
+					_mm_shuffle_ps (v2, v2, _MM_SHUFFLE (3,3,0,0)), _MM_SHUFFLE (2,0,2,0)));
+
+				// values are below 2^25 after the shift, so signed compares are fine
+				rv = _mm_srl_epi32 (rv, sh);
+				gt = _mm_cmpgt_epi32 (rv, maxv);
+				rv = _mm_or_si128 (_mm_and_si128 (gt, maxv), _mm_andnot_si128 (gt, rv));
+				gv = _mm_srl_epi32 (gv, sh);
+				gt = _mm_cmpgt_epi32 (gv, maxv);
+				gv = _mm_or_si128 (_mm_and_si128 (gt, maxv), _mm_andnot_si128 (gt, gv));
+				bv = _mm_srl_epi32 (bv, sh);
+				gt = _mm_cmpgt_epi32 (bv, maxv);
+				bv = _mm_or_si128 (_mm_and_si128 (gt, maxv), _mm_andnot_si128 (gt, bv));
+
+				_mm_storeu_si128 ((__m128i *) (dest + j*4), _mm_or_si128 (
+					_mm_or_si128 (_mm_sll_epi32 (rv, rsh), _mm_sll_epi32 (gv, gsh)),
+					_mm_or_si128 (_mm_sll_epi32 (bv, bsh), extrav)));
+			}
+		}
+#elif defined(USE_NEON)
+		if (simd)
+		{
+			const uint32x4_t	maxv = vdupq_n_u32 (maxval);
+			const uint32x4_t	extrav = vdupq_n_u32 (extra);
+			const int32x4_t		sh = vdupq_n_s32 (-shift);
+			const int32x4_t		rsh = vdupq_n_s32 (rshift);
+			const int32x4_t		gsh = vdupq_n_s32 (gshift);
+			const int32x4_t		bsh = vdupq_n_s32 (bshift);
+			uint32x4x3_t		px;
+
+			for ( ; j + 4 <= smax; j += 4, bl += 12)
+			{
+				px = vld3q_u32 (bl);
+				px.val[0] = vminq_u32 (vshlq_u32 (px.val[0], sh), maxv);
+				px.val[1] = vminq_u32 (vshlq_u32 (px.val[1], sh), maxv);
+				px.val[2] = vminq_u32 (vshlq_u32 (px.val[2], sh), maxv);
+
+				vst1q_u32 ((uint32_t *) (dest + j*4), vorrq_u32 (
+					vorrq_u32 (vshlq_u32 (px.val[0], rsh), vshlq_u32 (px.val[1], gsh)),
+					vorrq_u32 (vshlq_u32 (px.val[2], bsh), extrav)));
+			}
+		}
+#endif
+
+		for ( ; j<smax ; j++, bl += 3)
+		{
+			r = bl[0] >> shift;
+			g = bl[1] >> shift;
+			b = bl[2] >> shift;
+			r = (r > maxval) ? maxval : r;
+			g = (g > maxval) ? maxval : g;
+			b = (b > maxval) ? maxval : b;
+
+			if (wide10bits)
+				*(unsigned int*)(dest + j*4) = (r<<rshift) | (g<<gshift) | (b<<bshift) | extra;
+			else
+			{
+				dest[j*4 + (rshift>>3)] = r;
+				dest[j*4 + (gshift>>3)] = g;
+				dest[j*4 + (bshift>>3)] = b;
+				dest[j*4 + 3] = 255;
+			}
+		}
+	}
+}
+
+/*
+===============
+R_BuildSurfaceLightMap -- johnfitz -- revised for lit support via lordhavoc
+
+Combine and scale multiple lightmaps into the 8.8 format in blocklights.
+Only touches the surface and its own part of dest, so surfaces can be built
+on different job workers as long as each has its own blocklights.
+===============
+*/
+static void R_BuildSurfaceLightMap (msurface_t *surf, byte *dest, int stride, unsigned *blocklights, qboolean simd)
+{
+	int			smax, tmax, size;
 	byte		*lightmap;
 	unsigned	scale;
 	int			maps;
-	unsigned	*bl;
 
 	surf->cached_dlight = (surf->dlightframe == r_framecount);
 
@@ -821,20 +1713,15 @@ void R_BuildLightMap (msurface_t *surf, byte *dest, int stride)
 				scale = d_lightstylevalue[surf->styles[maps]];
 				surf->cached_light[maps] = scale;	// 8.8 fraction
 				//johnfitz -- lit support via lordhavoc
-				bl = blocklights;
-				for (i=0 ; i<size ; i++)
-				{
-					*bl++ += *lightmap++ * scale;
-					*bl++ += *lightmap++ * scale;
-					*bl++ += *lightmap++ * scale;
-				}
+				R_AccumulateLightmap (blocklights, lightmap, size * 3, scale, simd);
+				lightmap += size * 3;
 				//johnfitz
 			}
 		}
 
 	// add all the dynamic lights
 		if (surf->dlightframe == r_framecount)
-			R_AddDynamicLights (surf);
+			R_AddDynamicLights (surf, blocklights, simd);
 	}
 	else
 	{
@@ -844,108 +1731,240 @@ void R_BuildLightMap (msurface_t *surf, byte *dest, int stride)
 
 // bound, invert, and shift
 // store:
-	switch (gl_lightmap_format)
+	R_StoreLightmap (blocklights, smax, tmax, dest, stride, simd);
+}
+
+/*
+===============
+R_BuildLightMap
+===============
+*/
+void R_BuildLightMap (msurface_t *surf, byte *dest, int stride)
+{
+	R_AllocBlockLights ();
+	R_BuildSurfaceLightMap (surf, dest, stride, blocklights[0], true);
+}
+
+/*
+=============================================================================
+
+THREADED LIGHTMAP UPDATES
+
+R_RenderDynamicLightmaps only grows the dirty rectangle and queues the
+surface, the queue is built on the job workers once the whole model is
+marked, R_UploadLightmaps then sends the blocks to GL as before. Surfaces
+in one lightmap block never overlap, so they can be written in parallel.
+
+=============================================================================
+*/
+
+#define LIGHTMAP_PARALLEL_MIN	8	// smaller updates aren't worth waking the workers
+
+typedef struct
+{
+	msurface_t	**surfs;
+	byte		*data;		// copy of all lightmap blocks, NULL for lightmaps[].data
+	qboolean	simd;
+} lightupdate_t;
+
+static msurface_t	**lightmap_queue;
+
+static void R_QueueLightMap (msurface_t *surf)
+{
+	VEC_PUSH (lightmap_queue, surf);
+}
+
+static void R_BuildQueuedLightMap (void *data, int index, int worker)
+{
+	lightupdate_t	*update = (lightupdate_t *) data;
+	msurface_t		*surf = update->surfs[index];
+	byte			*base;
+
+	if (update->data)
+		base = update->data + surf->lightmaptexturenum * LMBLOCK_WIDTH*LMBLOCK_HEIGHT*lightmap_bytes;
+	else
+		base = lightmaps[surf->lightmaptexturenum].data;
+	base += surf->light_t * LMBLOCK_WIDTH * lightmap_bytes + surf->light_s * lightmap_bytes;
+
+	R_BuildSurfaceLightMap (surf, base, LMBLOCK_WIDTH*lightmap_bytes, blocklights[worker], update->simd);
+}
+
+static void R_BuildLightMaps (lightupdate_t *update, int count, qboolean parallel)
+{
+	int	i;
+
+	R_AllocBlockLights ();
+
+	if (parallel)
+		Jobs_ParallelFor (R_BuildQueuedLightMap, update, count);
+	else
 	{
-	case GL_RGBA:
-		stride -= smax * 4;
-		bl = blocklights;
-		for (i=0 ; i<tmax ; i++, dest += stride)
-		{
-			for (j=0 ; j<smax ; j++)
-			{
-				if (overbright)
-				{
-					r = *bl++ >> 8;
-					g = *bl++ >> 8;
-					b = *bl++ >> 8;
-				}
-				else
-				{
-					r = *bl++ >> 7;
-					g = *bl++ >> 7;
-					b = *bl++ >> 7;
-					if (wide10bits) {
-						// artifically clamp to 255 so gl_overbright 0 renders as expected in the wide10bits case
-						r = (r > 255) ? 255 : r;
-						g = (g > 255) ? 255 : g;
-						b = (b > 255) ? 255 : b;
-						goto loc0;
-					}
-				}
-				if (wide10bits)
-				{
-					r = (r > 1023)? 1023 : r;
-					g = (g > 1023)? 1023 : g;
-					b = (b > 1023)? 1023 : b;
-					loc0:
-					*(unsigned int*)dest = (r<<22) | (g<<12) | (b<<2) | 3;
-					dest += 4;
-				}
-				else
-				{
-					*dest++ = (r > 255)? 255 : r;
-					*dest++ = (g > 255)? 255 : g;
-					*dest++ = (b > 255)? 255 : b;
-					*dest++ = 255;
-				}
-			}
-		}
-		break;
-	case GL_BGRA:
-		stride -= smax * 4;
-		bl = blocklights;
-		for (i=0 ; i<tmax ; i++, dest += stride)
+		for (i = 0; i < count; i++)
+			R_BuildQueuedLightMap (update, i, 0);
+	}
+}
+
+/*
+===============
+R_FlushLightmapUpdates
+
+Builds all queued surfaces, called after a model is marked
+===============
+*/
+void R_FlushLightmapUpdates (void)
+{
+	lightupdate_t	update;
+	int				count;
+
+	count = VEC_SIZE (lightmap_queue);
+	if (!count)
+		return;
+
+	update.surfs = lightmap_queue;
+	update.data = NULL;
+	update.simd = true;
+	R_BuildLightMaps (&update, count, r_parallellightmaps.value && count >= LIGHTMAP_PARALLEL_MIN);
+
+	VEC_CLEAR (lightmap_queue);
+}
+
+/*
+===============
+R_LightBench_f
+
+Builds the lightmaps of all world surfaces hit by a number of dynamic
+lights scattered around the view, with the scalar and the SIMD code on the
+main thread and with the SIMD code on the job workers. The results go to
+copies of the lightmap blocks, so nothing on screen changes.
+===============
+*/
+void R_LightBench_f (void)
+{
+	dlight_t	oldlights[MAX_DLIGHTS], *dl;
+	msurface_t	**surfs, *surf;
+	lightupdate_t	update;
+	byte		*reference, *test;
+	size_t		blocksize, offset;
+	int			i, j, numlights, frames, count, texels, mismatches, rowbytes;
+	double		start, scalar, simd, parallel;
+
+	if (!cl.worldmodel || !lightmap_count)
+	{
+		Con_Printf ("r_lightbench: no map loaded\n");
+		return;
+	}
+
+	numlights = (Cmd_Argc () > 1) ? atoi (Cmd_Argv (1)) : 32;
+	numlights = CLAMP (1, numlights, MAX_DLIGHTS);
+	frames = (Cmd_Argc () > 2) ? atoi (Cmd_Argv (2)) : 100;
+	frames = q_max (frames, 1);
+
+	// place rocket and explosion sized lights around the view
+	memcpy (oldlights, cl_dlights, sizeof(oldlights));
+	memset (cl_dlights, 0, sizeof(cl_dlights));
+	for (i = 0, dl = cl_dlights; i < numlights; i++, dl++)
+	{
+		for (j = 0; j < 3; j++)
+			dl->origin[j] = r_refdef.vieworg[j] + (rand () % 1024) - 512;
+		dl->radius = 200 + (rand () % 150);
+		dl->die = cl.time + 1;
+		dl->color[0] = 1;
+		dl->color[1] = 0.5f + (rand () % 50) / 100.0f;
+		dl->color[2] = 0.25f + (rand () % 50) / 100.0f;
+	}
+
+	// marks surfaces as dynamic for r_framecount + 1
+	R_PushDlights ();
+	r_framecount++;
+
+	surfs = NULL;
+	texels = 0;
+	for (i = 0, surf = cl.worldmodel->surfaces; i < cl.worldmodel->numsurfaces; i++, surf++)
+	{
+		if (surf->flags & SURF_DRAWTILED || surf->dlightframe != r_framecount)
+			continue;
+		VEC_PUSH (surfs, surf);
+		texels += ((surf->extents[0]>>4)+1) * ((surf->extents[1]>>4)+1);
+	}
+	count = VEC_SIZE (surfs);
+
+	blocksize = (size_t) LMBLOCK_WIDTH*LMBLOCK_HEIGHT*lightmap_bytes;
+	reference = (byte *) malloc (blocksize * lightmap_count);
+	test = (byte *) malloc (blocksize * lightmap_count);
+	if (!reference || !test)
+		Sys_Error ("R_LightBench_f: out of memory");
+	for (i = 0; i < lightmap_count; i++)
+		memcpy (reference + blocksize * i, lightmaps[i].data, blocksize);
+	memcpy (test, reference, blocksize * lightmap_count);
+
+	update.surfs = surfs;
+	update.data = reference;
+	update.simd = false;
+	start = Sys_DoubleTime ();
+	for (i = 0; i < frames; i++)
+		R_BuildLightMaps (&update, count, false);
+	scalar = Sys_DoubleTime () - start;
+
+	update.data = test;
+	update.simd = true;
+	start = Sys_DoubleTime ();
+	for (i = 0; i < frames; i++)
+		R_BuildLightMaps (&update, count, false);
+	simd = Sys_DoubleTime () - start;
+
+	// clear the copy again, so the parallel run is checked on its own
+	memcpy (test, reference, blocksize * lightmap_count);
+	start = Sys_DoubleTime ();
+	for (i = 0; i < frames; i++)
+		R_BuildLightMaps (&update, count, true);
+	parallel = Sys_DoubleTime () - start;
+
+	mismatches = 0;
+	for (i = 0; i < count; i++)
+	{
+		surf = surfs[i];
+		rowbytes = ((surf->extents[0]>>4)+1) * lightmap_bytes;
+		for (j = 0; j < (surf->extents[1]>>4)+1; j++)
 		{
-			for (j=0 ; j<smax ; j++)
+			offset = surf->lightmaptexturenum * blocksize + ((surf->light_t + j) * LMBLOCK_WIDTH + surf->light_s) * lightmap_bytes;
+			if (memcmp (reference + offset, test + offset, rowbytes))
 			{
-				if (overbright)
-				{
-					r = *bl++ >> 8;
-					g = *bl++ >> 8;
-					b = *bl++ >> 8;
-				}
-				else
-				{
-					r = *bl++ >> 7;
-					g = *bl++ >> 7;
-					b = *bl++ >> 7;
-					if (wide10bits) {
-						// artifically clamp to 255 so gl_overbright 0 renders as expected in the wide10bits case
-						r = (r > 255) ? 255 : r;
-						g = (g > 255) ? 255 : g;
-						b = (b > 255) ? 255 : b;
-						goto loc1;
-					}
-				}
-				if (wide10bits)
-				{
-					r = (r > 1023)? 1023 : r;
-					g = (g > 1023)? 1023 : g;
-					b = (b > 1023)? 1023 : b;
-					loc1:
-					*(unsigned int*)dest = (b<<22) | (g<<12) | (r<<2) | 3;
-					dest += 4;
-				}
-				else
-				{
-					*dest++ = (b > 255)? 255 : b;
-					*dest++ = (g > 255)? 255 : g;
-					*dest++ = (r > 255)? 255 : r;
-					*dest++ = 255;
-				}
+				mismatches++;
+				break;
 			}
 		}
-		break;
-	default:
-		Sys_Error ("R_BuildLightMap: bad lightmap format");
 	}
+
+	free (reference);
+	free (test);
+
+	// the real lights are pushed again next frame, the touched surfaces get
+	// rebuilt then, since the cached lightmaps don't match the blocks anymore
+	for (i = 0; i < count; i++)
+	{
+		surfs[i]->dlightframe = 0;
+		surfs[i]->cached_dlight = true;
+	}
+	VEC_FREE (surfs);
+	r_framecount--;
+	memcpy (cl_dlights, oldlights, sizeof(oldlights));
+
+	Con_Printf ("%i lights, %i frames, %i surfaces, %i texels per frame\n", numlights, frames, count, texels);
+	Con_Printf ("scalar   %7.3f ms per frame\n", scalar * 1000.0 / frames);
+	Con_Printf ("%-8s %7.3f ms per frame, %.2fx\n", LIGHTMAP_SIMD_NAME,
+		simd * 1000.0 / frames, simd > 0 ? scalar / simd : 0.0);
+	Con_Printf ("parallel %7.3f ms per frame, %i workers, %.2fx\n",
+		parallel * 1000.0 / frames, Jobs_NumWorkers (), parallel > 0 ? scalar / parallel : 0.0);
+	if (mismatches)
+		Con_Printf ("WARNING: %i surfaces differ from the scalar result\n", mismatches);
 }
 
 /*
 ===============
 R_UploadLightmap -- johnfitz -- uploads the modified lightmap to opengl if necessary
 
-assumes lightmap texture is already bound
+assumes lightmap texture is already bound and GL_UNPACK_ROW_LENGTH is
+set to the block width, so only the dirty rectangles are sent
 ===============
 */
 static void R_UploadLightmap(int lmap)
@@ -954,18 +1973,22 @@ static void R_UploadLightmap(int lmap)
 	const GLenum type = wide10bits ?
 	    GL_UNSIGNED_INT_10_10_10_2 : GL_UNSIGNED_BYTE;
 	struct lightmap_s *lm = &lightmaps[lmap];
+	glRect_t *rect;
+	int i;
 
 	if (!lm->modified)
 		return;
 
 	lm->modified = false;
 
-	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, lm->rectchange.t, LMBLOCK_WIDTH, lm->rectchange.h, gl_lightmap_format,
-			type, lm->data + lm->rectchange.t*LMBLOCK_WIDTH*lightmap_bytes);
-	lm->rectchange.l = LMBLOCK_WIDTH;
-	lm->rectchange.t = LMBLOCK_HEIGHT;
-	lm->rectchange.h = 0;
-	lm->rectchange.w = 0;
+	for (i = 0, rect = lm->dirty; i < lm->numdirty; i++, rect++)
+	{
+		glTexSubImage2D(GL_TEXTURE_2D, 0, rect->l, rect->t, rect->w, rect->h, gl_lightmap_format,
+				type, lm->data + (rect->t*LMBLOCK_WIDTH + rect->l)*lightmap_bytes);
+		rs_lightmapbytes += RECT_AREA (rect) * lightmap_bytes;
+	}
+	rs_lightmaprects += lm->numdirty;
+	lm->numdirty = 0;
 
 	rs_dynamiclightmaps++;
 }
@@ -983,6 +2006,8 @@ void R_UploadLightmaps (void)
 		hack_rebuildLightmaps = false;
 	}
 
+	glPixelStorei (GL_UNPACK_ROW_LENGTH, LMBLOCK_WIDTH);
+
 	for (lmap = 0; lmap < lightmap_count; lmap++)
 	{
 		if (!lightmaps[lmap].modified)
@@ -991,6 +2016,8 @@ void R_UploadLightmaps (void)
 		GL_Bind (lightmaps[lmap].texture);
 		R_UploadLightmap(lmap);
 	}
+
+	glPixelStorei (GL_UNPACK_ROW_LENGTH, 0);
 }
 
 /*
@@ -1006,7 +2033,6 @@ void R_RebuildAllLightmaps (void)
 	int			i, j;
 	qmodel_t	*mod;
 	msurface_t	*fa;
-	byte		*base;
 
 	if (!cl.worldmodel) // is this the correct test?
 		return;
@@ -1021,11 +2047,10 @@ void R_RebuildAllLightmaps (void)
 		{
 			if (fa->flags & SURF_DRAWTILED)
 				continue;
-			base = lightmaps[fa->lightmaptexturenum].data;
-			base += fa->light_t * LMBLOCK_WIDTH * lightmap_bytes + fa->light_s * lightmap_bytes;
-			R_BuildLightMap (fa, base, LMBLOCK_WIDTH*lightmap_bytes);
+			R_QueueLightMap (fa);
 		}
 	}
+	R_FlushLightmapUpdates ();
 
 	//for each lightmap, upload it
 	for (i=0; i<lightmap_count; i++)
@@ -23,6 +23,14 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "quakedef.h"
 
+#if defined(USE_SSE)
+#define PARTICLE_SIMD_NAME	"sse"
+#elif defined(USE_NEON)
+#define PARTICLE_SIMD_NAME	"neon"
+#else
+#define PARTICLE_SIMD_NAME	"nosimd"
+#endif
+
 #define ABSOLUTE_MAX_PARTICLES	32768		// default max # of particles at one time
 #define ABSOLUTE_MIN_PARTICLES	512		// no fewer than this no matter what's
 										//  on the command line
@@ -32,10 +40,39 @@ static int	ramp1[8] = {0x6f, 0x6d, 0x6b, 0x69, 0x67, 0x65, 0x63, 0x61};
 static int	ramp2[8] = {0x6f, 0x6e, 0x6d, 0x6c, 0x6b, 0x6a, 0x68, 0x66};
 static int	ramp3[8] = {0x6d, 0x6b, 6, 5, 4, 3};
 
-static particle_t	*active_particles, *free_particles, *particles;
+#define NUM_PARTICLE_TYPES	(pt_blob2 + 1)
+#define PARTICLE_BATCH		1024	// particles per draw call
+
+// every type keeps its particles packed at the start of its own arrays, dead
+// particles are replaced by the last one, so the free slots are always the
+// tail and the simulation runs straight loops per type
+typedef struct
+{
+	int		count, maxcount;
+	float	*org[3];
+	float	*vel[3];
+	float	*ramp;
+	float	*die;
+	byte	*color;
+} particlelist_t;
+
+typedef struct
+{
+	particlelist_t	types[NUM_PARTICLE_TYPES];
+	int				numactive, maxactive;
+} particlestore_t;
+
+static particlestore_t	particles;
 
 static int	r_numparticles;
 
+static float	partverts[PARTICLE_BATCH*4][3];
+static float	parttexcoords[PARTICLE_BATCH*4][2];
+static unsigned	partcolors[PARTICLE_BATCH*4];
+static unsigned short	partfanindexes[PARTICLE_BATCH*6];	// quads as triangle fans for r_showtris
+static unsigned	partpalette[256];
+static int		parttexcoordmode = -1;
+
 static gltexture_t *particletexture, *particletexture1, *particletexture2, *particletexture3; //johnfitz
 static float texturescalefactor; //johnfitz -- compensate for apparent size of different particle textures
 
@@ -139,6 +176,132 @@ static void R_SetParticleTexture_f (cvar_t *var)
 	}
 }
 
+/*
+==============================================================================
+
+PARTICLE STORE
+
+==============================================================================
+*/
+
+/*
+===============
+R_GrowParticleList
+===============
+*/
+static void R_GrowParticleList (particlelist_t *list, int maxcount)
+{
+	int		i;
+
+	for (i = 0; i < 3; i++)
+	{
+		list->org[i] = (float *) realloc (list->org[i], maxcount * sizeof(float));
+		list->vel[i] = (float *) realloc (list->vel[i], maxcount * sizeof(float));
+		if (!list->org[i] || !list->vel[i])
+			Sys_Error ("R_GrowParticleList: out of memory");
+	}
+	list->ramp = (float *) realloc (list->ramp, maxcount * sizeof(float));
+	list->die = (float *) realloc (list->die, maxcount * sizeof(float));
+	list->color = (byte *) realloc (list->color, maxcount);
+	if (!list->ramp || !list->die || !list->color)
+		Sys_Error ("R_GrowParticleList: out of memory");
+
+	list->maxcount = maxcount;
+}
+
+/*
+===============
+R_FreeParticleStore
+===============
+*/
+static void R_FreeParticleStore (particlestore_t *store)
+{
+	particlelist_t	*list;
+	int				i, j;
+
+	for (i = 0; i < NUM_PARTICLE_TYPES; i++)
+	{
+		list = &store->types[i];
+		for (j = 0; j < 3; j++)
+		{
+			free (list->org[j]);
+			free (list->vel[j]);
+		}
+		free (list->ramp);
+		free (list->die);
+		free (list->color);
+	}
+
+	memset (store, 0, sizeof(*store));
+}
+
+/*
+===============
+R_AddParticle
+
+Copies p into the list of its type, returns false if the store is full
+===============
+*/
+static qboolean R_AddParticle (particlestore_t *store, const particle_t *p)
+{
+	particlelist_t	*list;
+	int				i;
+
+	if (store->numactive >= store->maxactive)
+		return false;
+
+	list = &store->types[p->type];
+	if (list->count == list->maxcount)
+		R_GrowParticleList (list, q_min (q_max (list->maxcount * 2, 256), store->maxactive));
+
+	i = list->count++;
+	list->org[0][i] = p->org[0];
+	list->org[1][i] = p->org[1];
+	list->org[2][i] = p->org[2];
+	list->vel[0][i] = p->vel[0];
+	list->vel[1][i] = p->vel[1];
+	list->vel[2][i] = p->vel[2];
+	list->ramp[i] = p->ramp;
+	list->die[i] = p->die;
+	list->color[i] = (byte) p->color;
+
+	store->numactive++;
+	return true;
+}
+
+/*
+===============
+R_KillParticles
+
+Removes the particles that died before time, the last particle of the list
+moves into the freed slot
+===============
+*/
+static void R_KillParticles (particlestore_t *store, particlelist_t *list, double time)
+{
+	int		i, j, last;
+
+	for (i = 0; i < list->count; )
+	{
+		if (list->die[i] >= time)
+		{
+			i++;
+			continue;
+		}
+
+		last = --list->count;
+		for (j = 0; j < 3; j++)
+		{
+			list->org[j][i] = list->org[j][last];
+			list->vel[j][i] = list->vel[j][last];
+		}
+		list->ramp[i] = list->ramp[last];
+		list->die[i] = list->die[last];
+		list->color[i] = list->color[last];
+		store->numactive--;
+	}
+}
+
 /*
 ===============
 R_InitParticles
@@ -163,8 +326,17 @@ void R_InitParticles (void)
 		r_numparticles = DEFAULT_NUM_PARTICLES;
 	}
 
-	particles = (particle_t *)
-			Hunk_AllocName (r_numparticles * sizeof(particle_t), "particles");
+	particles.maxactive = r_numparticles;
+
+	for (i = 0; i < PARTICLE_BATCH; i++)
+	{
+		partfanindexes[i*6 + 0] = i*4;
+		partfanindexes[i*6 + 1] = i*4 + 1;
+		partfanindexes[i*6 + 2] = i*4 + 2;
+		partfanindexes[i*6 + 3] = i*4;
+		partfanindexes[i*6 + 4] = i*4 + 2;
+		partfanindexes[i*6 + 5] = i*4 + 3;
+	}
 
 	Cvar_RegisterVariable (&r_particles); //johnfitz
 	Cvar_SetCallback (&r_particles, R_SetParticleTexture_f);
@@ -184,7 +356,7 @@ static float	beamlength = 16;
 void R_EntityParticles (entity_t *ent)
 {
 	int		i;
-	particle_t	*p;
+	particle_t	p;
 	float		angle;
 	float		sp, sy, cp, cy;
 //	float		sr, cr;
@@ -205,6 +377,8 @@ void R_EntityParticles (entity_t *ent)
 		}
 	}
 
+	memset (&p, 0, sizeof(p));
+
 	for (i = 0; i < NUMVERTEXNORMALS; i++)
 	{
 		angle = cl.time * avelocities[i][0];
@@ -221,20 +395,16 @@ void R_EntityParticles (entity_t *ent)
 		forward[1] = cp*sy;
 		forward[2] = -sp;
 
-		if (!free_particles)
-			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+		p.die = cl.time + 0.01;
+		p.color = 0x6f;
+		p.type = pt_explode;
 
-		p->die = cl.time + 0.01;
-		p->color = 0x6f;
-		p->type = pt_explode;
+		p.org[0] = ent->origin[0] + r_avertexnormals[i][0]*dist + forward[0]*beamlength;
+		p.org[1] = ent->origin[1] + r_avertexnormals[i][1]*dist + forward[1]*beamlength;
+		p.org[2] = ent->origin[2] + r_avertexnormals[i][2]*dist + forward[2]*beamlength;
 
-		p->org[0] = ent->origin[0] + r_avertexnormals[i][0]*dist + forward[0]*beamlength;
-		p->org[1] = ent->origin[1] + r_avertexnormals[i][1]*dist + forward[1]*beamlength;
-		p->org[2] = ent->origin[2] + r_avertexnormals[i][2]*dist + forward[2]*beamlength;
+		if (!R_AddParticle (&particles, &p))
+			return;
 	}
 }
 
@@ -247,12 +417,9 @@ void R_ClearParticles (void)
 {
 	int		i;
 
-	free_particles = &particles[0];
-	active_particles = NULL;
-
-	for (i=0 ;i<r_numparticles ; i++)
-		particles[i].next = &particles[i+1];
-	particles[r_numparticles-1].next = NULL;
+	for (i = 0; i < NUM_PARTICLE_TYPES; i++)
+		particles.types[i].count = 0;
+	particles.numactive = 0;
 }
 
 /*
@@ -266,7 +433,7 @@ void R_ReadPointFile_f (void)
 	vec3_t	org;
 	int		r;
 	int		c;
-	particle_t	*p;
+	particle_t	p;
 	char	name[MAX_QPATH];
 
 	if (cls.state != ca_connected)
@@ -291,21 +458,18 @@ void R_ReadPointFile_f (void)
 			break;
 		c++;
 
-		if (!free_particles)
+		p.die = 99999;
+		p.color = (-c)&15;
+		p.ramp = 0;
+		p.type = pt_static;
+		VectorCopy (vec3_origin, p.vel);
+		VectorCopy (org, p.org);
+
+		if (!R_AddParticle (&particles, &p))
 		{
 			Con_Printf ("Not enough free particles\n");
 			break;
 		}
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
-		p->die = 99999;
-		p->color = (-c)&15;
-		p->type = pt_static;
-		VectorCopy (vec3_origin, p->vel);
-		VectorCopy (org, p->org);
 	}
 
 	fclose (f);
@@ -321,22 +485,17 @@ Parse an effect out of the server message
 */
 void R_ParseParticleEffect (void)
 {
-	vec3_t		org, dir;
-	int			i, count, msgcount, color;
+	particleeffect_t	effect;
+	int			count;
 
-	for (i=0 ; i<3 ; i++)
-		org[i] = MSG_ReadCoord (cl.protocolflags);
-	for (i=0 ; i<3 ; i++)
-		dir[i] = MSG_ReadChar () * (1.0/16);
-	msgcount = MSG_ReadByte ();
-	color = MSG_ReadByte ();
+	CL_ReadParticleEffect (CL_ServerReader (), &effect);
 
-	if (msgcount == 255)
+	if (effect.count == 255)
 		count = 1024;
 	else
-		count = msgcount;
+		count = effect.count;
 
-	R_RunParticleEffect (org, dir, color, count);
+	R_RunParticleEffect (effect.origin, effect.dir, effect.color, count);
 }
 
 /*
@@ -347,38 +506,36 @@ R_ParticleExplosion
 void R_ParticleExplosion (vec3_t org)
 {
 	int			i, j;
-	particle_t	*p;
+	particle_t	p;
+
+	memset (&p, 0, sizeof(p));
 
 	for (i=0 ; i<1024 ; i++)
 	{
-		if (!free_particles)
-			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
-		p->die = cl.time + 5;
-		p->color = ramp1[0];
-		p->ramp = rand()&3;
+		p.die = cl.time + 5;
+		p.color = ramp1[0];
+		p.ramp = rand()&3;
 		if (i & 1)
 		{
-			p->type = pt_explode;
+			p.type = pt_explode;
 			for (j=0 ; j<3 ; j++)
 			{
-				p->org[j] = org[j] + ((rand()%32)-16);
-				p->vel[j] = (rand()%512)-256;
+				p.org[j] = org[j] + ((rand()%32)-16);
+				p.vel[j] = (rand()%512)-256;
 			}
 		}
 		else
 		{
-			p->type = pt_explode2;
+			p.type = pt_explode2;
 			for (j=0 ; j<3 ; j++)
 			{
-				p->org[j] = org[j] + ((rand()%32)-16);
-				p->vel[j] = (rand()%512)-256;
+				p.org[j] = org[j] + ((rand()%32)-16);
+				p.vel[j] = (rand()%512)-256;
 			}
 		}
+
+		if (!R_AddParticle (&particles, &p))
+			return;
 	}
 }
 
@@ -390,28 +547,26 @@ R_ParticleExplosion2
 void R_ParticleExplosion2 (vec3_t org, int colorStart, int colorLength)
 {
 	int			i, j;
-	particle_t	*p;
+	particle_t	p;
 	int			colorMod = 0;
 
+	memset (&p, 0, sizeof(p));
+
 	for (i=0; i<512; i++)
 	{
-		if (!free_particles)
-			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
-		p->die = cl.time + 0.3;
-		p->color = colorStart + (colorMod % colorLength);
+		p.die = cl.time + 0.3;
+		p.color = colorStart + (colorMod % colorLength);
 		colorMod++;
 
-		p->type = pt_blob;
+		p.type = pt_blob;
 		for (j=0 ; j<3 ; j++)
 		{
-			p->org[j] = org[j] + ((rand()%32)-16);
-			p->vel[j] = (rand()%512)-256;
+			p.org[j] = org[j] + ((rand()%32)-16);
+			p.vel[j] = (rand()%512)-256;
 		}
+
+		if (!R_AddParticle (&particles, &p))
+			return;
 	}
 }
 
@@ -423,39 +578,37 @@ R_BlobExplosion
 void R_BlobExplosion (vec3_t org)
 {
 	int			i, j;
-	particle_t	*p;
+	particle_t	p;
+
+	memset (&p, 0, sizeof(p));
 
 	for (i=0 ; i<1024 ; i++)
 	{
-		if (!free_particles)
-			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
-		p->die = cl.time + 1 + (rand()&8)*0.05;
+		p.die = cl.time + 1 + (rand()&8)*0.05;
 
 		if (i & 1)
 		{
-			p->type = pt_blob;
-			p->color = 66 + rand()%6;
+			p.type = pt_blob;
+			p.color = 66 + rand()%6;
 			for (j=0 ; j<3 ; j++)
 			{
-				p->org[j] = org[j] + ((rand()%32)-16);
-				p->vel[j] = (rand()%512)-256;
+				p.org[j] = org[j] + ((rand()%32)-16);
+				p.vel[j] = (rand()%512)-256;
 			}
 		}
 		else
 		{
-			p->type = pt_blob2;
-			p->color = 150 + rand()%6;
+			p.type = pt_blob2;
+			p.color = 150 + rand()%6;
 			for (j=0 ; j<3 ; j++)
 			{
-				p->org[j] = org[j] + ((rand()%32)-16);
-				p->vel[j] = (rand()%512)-256;
+				p.org[j] = org[j] + ((rand()%32)-16);
+				p.vel[j] = (rand()%512)-256;
 			}
 		}
+
+		if (!R_AddParticle (&particles, &p))
+			return;
 	}
 }
 
@@ -467,52 +620,50 @@ R_RunParticleEffect
 void R_RunParticleEffect (vec3_t org, vec3_t dir, int color, int count)
 {
 	int			i, j;
-	particle_t	*p;
+	particle_t	p;
+
+	memset (&p, 0, sizeof(p));
 
 	for (i=0 ; i<count ; i++)
 	{
-		if (!free_particles)
-			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
 		if (count == 1024)
 		{	// rocket explosion
-			p->die = cl.time + 5;
-			p->color = ramp1[0];
-			p->ramp = rand()&3;
+			p.die = cl.time + 5;
+			p.color = ramp1[0];
+			p.ramp = rand()&3;
 			if (i & 1)
 			{
-				p->type = pt_explode;
+				p.type = pt_explode;
 				for (j=0 ; j<3 ; j++)
 				{
-					p->org[j] = org[j] + ((rand()%32)-16);
-					p->vel[j] = (rand()%512)-256;
+					p.org[j] = org[j] + ((rand()%32)-16);
+					p.vel[j] = (rand()%512)-256;
 				}
 			}
 			else
 			{
-				p->type = pt_explode2;
+				p.type = pt_explode2;
 				for (j=0 ; j<3 ; j++)
 				{
-					p->org[j] = org[j] + ((rand()%32)-16);
-					p->vel[j] = (rand()%512)-256;
+					p.org[j] = org[j] + ((rand()%32)-16);
+					p.vel[j] = (rand()%512)-256;
 				}
 			}
 		}
 		else
 		{
-			p->die = cl.time + 0.1*(rand()%5);
-			p->color = (color&~7) + (rand()&7);
-			p->type = pt_slowgrav;
+			p.die = cl.time + 0.1*(rand()%5);
+			p.color = (color&~7) + (rand()&7);
+			p.type = pt_slowgrav;
 			for (j=0 ; j<3 ; j++)
 			{
-				p->org[j] = org[j] + ((rand()&15)-8);
-				p->vel[j] = dir[j]*15;// + (rand()%300)-150;
+				p.org[j] = org[j] + ((rand()&15)-8);
+				p.vel[j] = dir[j]*15;// + (rand()%300)-150;
 			}
 		}
+
+		if (!R_AddParticle (&particles, &p))
+			return;
 	}
 }
 
@@ -524,36 +675,34 @@ R_LavaSplash
 void R_LavaSplash (vec3_t org)
 {
 	int			i, j, k;
-	particle_t	*p;
+	particle_t	p;
 	float		vel;
 	vec3_t		dir;
 
+	memset (&p, 0, sizeof(p));
+
 	for (i=-16 ; i<16 ; i++)
 		for (j=-16 ; j<16 ; j++)
 			for (k=0 ; k<1 ; k++)
 			{
-				if (!free_particles)
-					return;
-				p = free_particles;
-				free_particles = p->next;
-				p->next = active_particles;
-				active_particles = p;
-
-				p->die = cl.time + 2 + (rand()&31) * 0.02;
-				p->color = 224 + (rand()&7);
-				p->type = pt_slowgrav;
+				p.die = cl.time + 2 + (rand()&31) * 0.02;
+				p.color = 224 + (rand()&7);
+				p.type = pt_slowgrav;
 
 				dir[0] = j*8 + (rand()&7);
 				dir[1] = i*8 + (rand()&7);
 				dir[2] = 256;
 
-				p->org[0] = org[0] + dir[0];
-				p->org[1] = org[1] + dir[1];
-				p->org[2] = org[2] + (rand()&63);
+				p.org[0] = org[0] + dir[0];
+				p.org[1] = org[1] + dir[1];
+				p.org[2] = org[2] + (rand()&63);
 
 				VectorNormalize (dir);
 				vel = 50 + (rand()&63);
-				VectorScale (dir, vel, p->vel);
+				VectorScale (dir, vel, p.vel);
+
+				if (!R_AddParticle (&particles, &p))
+					return;
 			}
 }
 
@@ -565,38 +714,36 @@ R_TeleportSplash
 void R_TeleportSplash (vec3_t org)
 {
 	int			i, j, k;
-	particle_t	*p;
+	particle_t	p;
 	float		vel;
 	vec3_t		dir;
 
+	memset (&p, 0, sizeof(p));
+
 	for (i=-16 ; i<16 ; i+=4)
 	{
 		for (j=-16 ; j<16 ; j+=4)
 		{
 			for (k=-24 ; k<32 ; k+=4)
 			{
-				if (!free_particles)
-					return;
-				p = free_particles;
-				free_particles = p->next;
-				p->next = active_particles;
-				active_particles = p;
-
-				p->die = cl.time + 0.2 + (rand()&7) * 0.02;
-				p->color = 7 + (rand()&7);
-				p->type = pt_slowgrav;
+				p.die = cl.time + 0.2 + (rand()&7) * 0.02;
+				p.color = 7 + (rand()&7);
+				p.type = pt_slowgrav;
 
 				dir[0] = j*8;
 				dir[1] = i*8;
 				dir[2] = k*8;
 
-				p->org[0] = org[0] + i + (rand()&3);
-				p->org[1] = org[1] + j + (rand()&3);
-				p->org[2] = org[2] + k + (rand()&3);
+				p.org[0] = org[0] + i + (rand()&3);
+				p.org[1] = org[1] + j + (rand()&3);
+				p.org[2] = org[2] + k + (rand()&3);
 
 				VectorNormalize (dir);
 				vel = 50 + (rand()&63);
-				VectorScale (dir, vel, p->vel);
+				VectorScale (dir, vel, p.vel);
+
+				if (!R_AddParticle (&particles, &p))
+					return;
 			}
 		}
 	}
@@ -614,10 +761,12 @@ void R_RocketTrail (vec3_t start, vec3_t end, int type)
 	vec3_t		vec;
 	float		len;
 	int			j;
-	particle_t	*p;
+	particle_t	p;
 	int			dec;
 	static int	tracercount;
 
+	memset (&p, 0, sizeof(p));
+
 	VectorSubtract (end, start, vec);
 	len = VectorNormalize (vec);
 	if (type < 128)
@@ -632,187 +781,248 @@ void R_RocketTrail (vec3_t start, vec3_t end, int type)
 	{
 		len -= dec;
 
-		if (!free_particles)
-			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
-		VectorCopy (vec3_origin, p->vel);
-		p->die = cl.time + 2;
+		VectorCopy (vec3_origin, p.vel);
+		p.die = cl.time + 2;
 
 		switch (type)
 		{
 			case 0:	// rocket trail
-				p->ramp = (rand()&3);
-				p->color = ramp3[(int)p->ramp];
-				p->type = pt_fire;
+				p.ramp = (rand()&3);
+				p.color = ramp3[(int)p.ramp];
+				p.type = pt_fire;
 				for (j=0 ; j<3 ; j++)
-					p->org[j] = start[j] + ((rand()%6)-3);
+					p.org[j] = start[j] + ((rand()%6)-3);
 				break;
 
 			case 1:	// smoke smoke
-				p->ramp = (rand()&3) + 2;
-				p->color = ramp3[(int)p->ramp];
-				p->type = pt_fire;
+				p.ramp = (rand()&3) + 2;
+				p.color = ramp3[(int)p.ramp];
+				p.type = pt_fire;
 				for (j=0 ; j<3 ; j++)
-					p->org[j] = start[j] + ((rand()%6)-3);
+					p.org[j] = start[j] + ((rand()%6)-3);
 				break;
 
 			case 2:	// blood
-				p->type = pt_grav;
-				p->color = 67 + (rand()&3);
+				p.type = pt_grav;
+				p.color = 67 + (rand()&3);
 				for (j=0 ; j<3 ; j++)
-					p->org[j] = start[j] + ((rand()%6)-3);
+					p.org[j] = start[j] + ((rand()%6)-3);
 				break;
 
 			case 3:
 			case 5:	// tracer
-				p->die = cl.time + 0.5;
-				p->type = pt_static;
+				p.die = cl.time + 0.5;
+				p.type = pt_static;
 				if (type == 3)
-					p->color = 52 + ((tracercount&4)<<1);
+					p.color = 52 + ((tracercount&4)<<1);
 				else
-					p->color = 230 + ((tracercount&4)<<1);
+					p.color = 230 + ((tracercount&4)<<1);
 
 				tracercount++;
 
-				VectorCopy (start, p->org);
+				VectorCopy (start, p.org);
 				if (tracercount & 1)
 				{
-					p->vel[0] = 30*vec[1];
-					p->vel[1] = 30*-vec[0];
+					p.vel[0] = 30*vec[1];
+					p.vel[1] = 30*-vec[0];
 				}
 				else
 				{
-					p->vel[0] = 30*-vec[1];
-					p->vel[1] = 30*vec[0];
+					p.vel[0] = 30*-vec[1];
+					p.vel[1] = 30*vec[0];
 				}
 				break;
 
 			case 4:	// slight blood
-				p->type = pt_grav;
-				p->color = 67 + (rand()&3);
+				p.type = pt_grav;
+				p.color = 67 + (rand()&3);
 				for (j=0 ; j<3 ; j++)
-					p->org[j] = start[j] + ((rand()%6)-3);
+					p.org[j] = start[j] + ((rand()%6)-3);
 				len -= 3;
 				break;
 
 			case 6:	// voor trail
-				p->color = 9*16 + 8 + (rand()&3);
-				p->type = pt_static;
-				p->die = cl.time + 0.3;
+				p.color = 9*16 + 8 + (rand()&3);
+				p.type = pt_static;
+				p.die = cl.time + 0.3;
 				for (j=0 ; j<3 ; j++)
-					p->org[j] = start[j] + ((rand()&15)-8);
+					p.org[j] = start[j] + ((rand()&15)-8);
 				break;
 		}
 
+		if (!R_AddParticle (&particles, &p))
+			return;
+
 		VectorAdd (start, vec, start);
 	}
 }
 
+/*
+==============================================================================
+
+PARTICLE SIMULATION
+
+==============================================================================
+*/
+
+/*
+===============
+R_ParticleMA
+
+dst[i] += src[i] * scale for count values, dst may be src
+===============
+*/
+static void R_ParticleMA (float *dst, const float *src, float scale, int count, qboolean simd)
+{
+	int		i = 0;
+
+#if defined(USE_SSE)
+	if (simd)
+	{
+		const __m128	s = _mm_set1_ps (scale);
+
+		for ( ; i + 4 <= count; i += 4)
+			_mm_storeu_ps (dst + i, _mm_add_ps (_mm_loadu_ps (dst + i), _mm_mul_ps (_mm_loadu_ps (src + i), s)));
+	}
+#elif defined(USE_NEON)
+	// separate multiply and add, so the result matches the scalar code
+	if (simd)
+	{
+		const float32x4_t	s = vdupq_n_f32 (scale);
+
+		for ( ; i + 4 <= count; i += 4)
+			vst1q_f32 (dst + i, vaddq_f32 (vld1q_f32 (dst + i), vmulq_f32 (vld1q_f32 (src + i), s)));
+	}
+#endif
+
+	for ( ; i < count; i++)
+		dst[i] += src[i] * scale;
+}
+
 /*
 ===============
-CL_RunParticles -- johnfitz -- all the particle behavior, separated from R_DrawParticles
+R_ParticleAdd
+
+dst[i] += value for count values
 ===============
 */
-void CL_RunParticles (void)
+static void R_ParticleAdd (float *dst, float value, int count, qboolean simd)
 {
-	particle_t		*p, *kill;
-	int				i;
-	float			time1, time2, time3, dvel, frametime, grav;
-	extern	cvar_t	sv_gravity;
+	int		i = 0;
+
+#if defined(USE_SSE)
+	if (simd)
+	{
+		const __m128	v = _mm_set1_ps (value);
+
+		for ( ; i + 4 <= count; i += 4)
+			_mm_storeu_ps (dst + i, _mm_add_ps (_mm_loadu_ps (dst + i), v));
+	}
+#elif defined(USE_NEON)
+	if (simd)
+	{
+		const float32x4_t	v = vdupq_n_f32 (value);
+
+		for ( ; i + 4 <= count; i += 4)
+			vst1q_f32 (dst + i, vaddq_f32 (vld1q_f32 (dst + i), v));
+	}
+#endif
+
+	for ( ; i < count; i++)
+		dst[i] += value;
+}
+
+/*
+===============
+R_ParticleRamp
+
+Advances the color ramp, particles past the end die on the next frame
+===============
+*/
+static void R_ParticleRamp (particlelist_t *list, const int *ramp, float step, float limit, qboolean simd)
+{
+	int		i;
+
+	R_ParticleAdd (list->ramp, step, list->count, simd);
+
+	for (i = 0; i < list->count; i++)
+	{
+		if (list->ramp[i] >= limit)
+			list->die[i] = -1;
+		else
+			list->color[i] = ramp[(int)list->ramp[i]];
+	}
+}
+
+/*
+===============
+R_SimulateParticles
+
+Runs one frame of particle physics on every type in turn
+===============
+*/
+static void R_SimulateParticles (particlestore_t *store, double time, float frametime, float grav, qboolean simd)
+{
+	particlelist_t	*list;
+	float			time1, time2, time3, dvel;
+	int				i, j, count;
 
-	frametime = cl.time - cl.oldtime;
 	time3 = frametime * 15;
 	time2 = frametime * 10;
 	time1 = frametime * 5;
-	grav = frametime * sv_gravity.value * 0.05;
 	dvel = 4*frametime;
 
-	for ( ;; )
+	for (i = 0; i < NUM_PARTICLE_TYPES; i++)
 	{
-		kill = active_particles;
-		if (kill && kill->die < cl.time)
-		{
-			active_particles = kill->next;
-			kill->next = free_particles;
-			free_particles = kill;
-			continue;
-		}
-		break;
-	}
+		list = &store->types[i];
 
-	for (p=active_particles ; p ; p=p->next)
-	{
-		for ( ;; )
-		{
-			kill = p->next;
-			if (kill && kill->die < cl.time)
-			{
-				p->next = kill->next;
-				kill->next = free_particles;
-				free_particles = kill;
-				continue;
-			}
-			break;
-		}
+		R_KillParticles (store, list, time);
+
+		count = list->count;
+		if (!count)
+			continue;
 
-		p->org[0] += p->vel[0]*frametime;
-		p->org[1] += p->vel[1]*frametime;
-		p->org[2] += p->vel[2]*frametime;
+		for (j = 0; j < 3; j++)
+			R_ParticleMA (list->org[j], list->vel[j], frametime, count, simd);
 
-		switch (p->type)
+		switch (i)
 		{
 		case pt_static:
 			break;
 		case pt_fire:
-			p->ramp += time1;
-			if (p->ramp >= 6)
-				p->die = -1;
-			else
-				p->color = ramp3[(int)p->ramp];
-			p->vel[2] += grav;
+			R_ParticleRamp (list, ramp3, time1, 6, simd);
+			R_ParticleAdd (list->vel[2], grav, count, simd);
 			break;
 
 		case pt_explode:
-			p->ramp += time2;
-			if (p->ramp >=8)
-				p->die = -1;
-			else
-				p->color = ramp1[(int)p->ramp];
-			for (i=0 ; i<3 ; i++)
-				p->vel[i] += p->vel[i]*dvel;
-			p->vel[2] -= grav;
+			R_ParticleRamp (list, ramp1, time2, 8, simd);
+			for (j = 0; j < 3; j++)
+				R_ParticleMA (list->vel[j], list->vel[j], dvel, count, simd);
+			R_ParticleAdd (list->vel[2], -grav, count, simd);
 			break;
 
 		case pt_explode2:
-			p->ramp += time3;
-			if (p->ramp >=8)
-				p->die = -1;
-			else
-				p->color = ramp2[(int)p->ramp];
-			for (i=0 ; i<3 ; i++)
-				p->vel[i] -= p->vel[i]*frametime;
-			p->vel[2] -= grav;
+			R_ParticleRamp (list, ramp2, time3, 8, simd);
+			for (j = 0; j < 3; j++)
+				R_ParticleMA (list->vel[j], list->vel[j], -frametime, count, simd);
+			R_ParticleAdd (list->vel[2], -grav, count, simd);
 			break;
 
 		case pt_blob:
-			for (i=0 ; i<3 ; i++)
-				p->vel[i] += p->vel[i]*dvel;
-			p->vel[2] -= grav;
+			for (j = 0; j < 3; j++)
+				R_ParticleMA (list->vel[j], list->vel[j], dvel, count, simd);
+			R_ParticleAdd (list->vel[2], -grav, count, simd);
 			break;
 
 		case pt_blob2:
-			for (i=0 ; i<2 ; i++)
-				p->vel[i] -= p->vel[i]*dvel;
-			p->vel[2] -= grav;
+			for (j = 0; j < 2; j++)
+				R_ParticleMA (list->vel[j], list->vel[j], -dvel, count, simd);
+			R_ParticleAdd (list->vel[2], -grav, count, simd);
 			break;
 
 		case pt_grav:
 		case pt_slowgrav:
-			p->vel[2] -= grav;
+			R_ParticleAdd (list->vel[2], -grav, count, simd);
 			break;
 		}
 	}
@@ -820,118 +1030,217 @@ void CL_RunParticles (void)
 
 /*
 ===============
-R_DrawParticles -- johnfitz -- moved all non-drawing code to CL_RunParticles
+CL_RunParticles -- johnfitz -- all the particle behavior, separated from R_DrawParticles
 ===============
 */
-void R_DrawParticles (void)
+void CL_RunParticles (void)
 {
-	particle_t		*p;
-	float			scale;
-	vec3_t			up, right, p_up, p_right, p_upright; //johnfitz -- p_ vectors
-	GLubyte			color[4], *c; //johnfitz -- particle transparency
-	extern	cvar_t	r_particles; //johnfitz
-	//float			alpha; //johnfitz -- particle transparency
+	float			frametime, grav;
+	extern	cvar_t	sv_gravity;
 
-	if (!r_particles.value)
-		return;
+	frametime = cl.time - cl.oldtime;
+	grav = frametime * sv_gravity.value * 0.05;
 
-	//ericw -- avoid empty glBegin(),glEnd() pair below; causes issues on AMD
-	if (!active_particles)
-		return;
+	R_SimulateParticles (&particles, cl.time, frametime, grav, true);
+}
+
+/*
+==============================================================================
+
+PARTICLE DRAWING
+
+==============================================================================
+*/
+
+/*
+===============
+R_EmitParticles
+
+Writes the corners of count particles starting at first, 4 per particle for
+quads and 3 for triangles
+===============
+*/
+static void R_EmitParticles (const particlelist_t *list, int first, int count, qboolean quads, float (*verts)[3], unsigned *colors)
+{
+	float		scale, x, y, z;
+	vec3_t		up, right, p_up;
+	unsigned	color;
+	int			i, j;
 
 	VectorScale (vup, 1.5, up);
 	VectorScale (vright, 1.5, right);
 
-	GL_Bind(particletexture);
-	glEnable (GL_BLEND);
-	glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-	glDepthMask (GL_FALSE); //johnfitz -- fix for particle z-buffer bug
-
-	if (r_quadparticles.value) //johnitz -- quads save fillrate
+	for (i = first; i < first + count; i++)
 	{
-		glBegin (GL_QUADS);
-		for (p=active_particles ; p ; p=p->next)
-		{
-			// hack a scale up to keep particles from disapearing
-			scale = (p->org[0] - r_origin[0]) * vpn[0]
-				  + (p->org[1] - r_origin[1]) * vpn[1]
-				  + (p->org[2] - r_origin[2]) * vpn[2];
-			if (scale < 20)
-				scale = 1 + 0.08; //johnfitz -- added .08 to be consistent
-			else
-				scale = 1 + scale * 0.004;
+		x = list->org[0][i];
+		y = list->org[1][i];
+		z = list->org[2][i];
+
+		// hack a scale up to keep particles from disapearing
+		scale = (x - r_origin[0]) * vpn[0]
+			  + (y - r_origin[1]) * vpn[1]
+			  + (z - r_origin[2]) * vpn[2];
+		if (scale < 20)
+			scale = 1 + 0.08; //johnfitz -- added .08 to be consistent
+		else
+			scale = 1 + scale * 0.004;
 
+		if (quads)
 			scale /= 2.0; //quad is half the size of triangle
 
-			scale *= texturescalefactor; //johnfitz -- compensate for apparent size of different particle textures
+		scale *= texturescalefactor; //johnfitz -- compensate for apparent size of different particle textures
 
-			//johnfitz -- particle transparency and fade out
-			c = (GLubyte *) &d_8to24table[(int)p->color];
-			color[0] = c[0];
-			color[1] = c[1];
-			color[2] = c[2];
-			//alpha = CLAMP(0, p->die + 0.5 - cl.time, 1);
-			color[3] = 255; //(int)(alpha * 255);
-			glColor4ubv(color);
-			//johnfitz
+		verts[0][0] = x;
+		verts[0][1] = y;
+		verts[0][2] = z;
 
-			glTexCoord2f (0,0);
-			glVertex3fv (p->org);
+		for (j = 0; j < 3; j++)
+			p_up[j] = verts[0][j] + scale * up[j];
+		VectorCopy (p_up, verts[1]);
 
-			glTexCoord2f (0.5,0);
-			VectorMA (p->org, scale, up, p_up);
-			glVertex3fv (p_up);
+		if (quads)
+		{
+			for (j = 0; j < 3; j++)
+			{
+				verts[2][j] = p_up[j] + scale * right[j];
+				verts[3][j] = verts[0][j] + scale * right[j];
+			}
+		}
+		else
+		{
+			for (j = 0; j < 3; j++)
+				verts[2][j] = verts[0][j] + scale * right[j];
+		}
 
-			glTexCoord2f (0.5,0.5);
-			VectorMA (p_up, scale, right, p_upright);
-			glVertex3fv (p_upright);
+		color = partpalette[list->color[i]];
+		for (j = 0; j < (quads ? 4 : 3); j++)
+			colors[j] = color;
 
-			glTexCoord2f (0,0.5);
-			VectorMA (p->org, scale, right, p_right);
-			glVertex3fv (p_right);
-		}
-		glEnd ();
+		verts += quads ? 4 : 3;
+		colors += quads ? 4 : 3;
 	}
-	else //johnitz --  triangles save verts
+}
+
+/*
+===============
+R_SetupParticleArrays
+===============
+*/
+static void R_SetupParticleArrays (qboolean quads)
+{
+	static const float	quadcoords[4][2] = {{0,0}, {0.5,0}, {0.5,0.5}, {0,0.5}};
+	static const float	tricoords[3][2] = {{0,0}, {1,0}, {0,1}};
+	int		i;
+
+	// johnfitz -- particle transparency
+	for (i = 0; i < 256; i++)
+	{
+		partpalette[i] = d_8to24table[i];
+		((byte *) &partpalette[i])[3] = 255;
+	}
+
+	if (parttexcoordmode != quads)
 	{
-		glBegin (GL_TRIANGLES);
-		for (p=active_particles ; p ; p=p->next)
+		for (i = 0; i < PARTICLE_BATCH*4; i++)
 		{
-			// hack a scale up to keep particles from disapearing
-			scale = (p->org[0] - r_origin[0]) * vpn[0]
-				  + (p->org[1] - r_origin[1]) * vpn[1]
-				  + (p->org[2] - r_origin[2]) * vpn[2];
-			if (scale < 20)
-				scale = 1 + 0.08; //johnfitz -- added .08 to be consistent
+			if (quads)
+				memcpy (parttexcoords[i], quadcoords[i & 3], sizeof(parttexcoords[i]));
 			else
-				scale = 1 + scale * 0.004;
-
-			scale *= texturescalefactor; //johnfitz -- compensate for apparent size of different particle textures
-
-			//johnfitz -- particle transparency and fade out
-			c = (GLubyte *) &d_8to24table[(int)p->color];
-			color[0] = c[0];
-			color[1] = c[1];
-			color[2] = c[2];
-			//alpha = CLAMP(0, p->die + 0.5 - cl.time, 1);
-			color[3] = 255; //(int)(alpha * 255);
-			glColor4ubv(color);
-			//johnfitz
-
-			glTexCoord2f (0,0);
-			glVertex3fv (p->org);
-
-			glTexCoord2f (1,0);
-			VectorMA (p->org, scale, up, p_up);
-			glVertex3fv (p_up);
-
-			glTexCoord2f (0,1);
-			VectorMA (p->org, scale, right, p_right);
-			glVertex3fv (p_right);
+				memcpy (parttexcoords[i], tricoords[i % 3], sizeof(parttexcoords[i]));
+		}
+		parttexcoordmode = quads;
+	}
+
+	// client side arrays
+	GL_BindBuffer (GL_ARRAY_BUFFER, 0);
+	GL_BindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+/*
+===============
+R_FlushParticles
+===============
+*/
+static void R_FlushParticles (int count, qboolean quads, qboolean showtris)
+{
+	if (quads && showtris)
+		glDrawElements (GL_TRIANGLES, count * 6, GL_UNSIGNED_SHORT, partfanindexes);
+	else
+		glDrawArrays (quads ? GL_QUADS : GL_TRIANGLES, 0, count * (quads ? 4 : 3));
+}
+
+/*
+===============
+R_DrawParticleBatches
+
+Emits every particle into the vertex arrays, PARTICLE_BATCH at a time
+===============
+*/
+static void R_DrawParticleBatches (qboolean showtris)
+{
+	particlelist_t	*list;
+	qboolean		quads = r_quadparticles.value != 0; //johnfitz -- quads save fillrate, triangles save verts
+	int				i, first, count, batched, nverts;
+
+	nverts = quads ? 4 : 3;
+	batched = 0;
+
+	for (i = 0; i < NUM_PARTICLE_TYPES; i++)
+	{
+		list = &particles.types[i];
+		for (first = 0; first < list->count; first += count)
+		{
+			count = q_min (list->count - first, PARTICLE_BATCH - batched);
+			R_EmitParticles (list, first, count, quads, partverts + batched * nverts, partcolors + batched * nverts);
+			batched += count;
+
+			if (batched == PARTICLE_BATCH)
+			{
+				R_FlushParticles (batched, quads, showtris);
+				batched = 0;
+			}
 		}
-		glEnd ();
 	}
 
+	if (batched)
+		R_FlushParticles (batched, quads, showtris);
+}
+
+/*
+===============
+R_DrawParticles -- johnfitz -- moved all non-drawing code to CL_RunParticles
+===============
+*/
+void R_DrawParticles (void)
+{
+	extern	cvar_t	r_particles; //johnfitz
+
+	if (!r_particles.value)
+		return;
+
+	if (!particles.numactive)
+		return;
+
+	R_SetupParticleArrays (r_quadparticles.value != 0);
+
+	GL_Bind(particletexture);
+	glEnable (GL_BLEND);
+	glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+	glDepthMask (GL_FALSE); //johnfitz -- fix for particle z-buffer bug
+
+	glEnableClientState (GL_VERTEX_ARRAY);
+	glEnableClientState (GL_TEXTURE_COORD_ARRAY);
+	glEnableClientState (GL_COLOR_ARRAY);
+	glVertexPointer (3, GL_FLOAT, 0, partverts);
+	glTexCoordPointer (2, GL_FLOAT, 0, parttexcoords);
+	glColorPointer (4, GL_UNSIGNED_BYTE, 0, partcolors);
+
+	R_DrawParticleBatches (false);
+
+	glDisableClientState (GL_COLOR_ARRAY);
+	glDisableClientState (GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState (GL_VERTEX_ARRAY);
+
 	glDepthMask (GL_TRUE); //johnfitz -- fix for particle z-buffer bug
 	glDisable (GL_BLEND);
 	glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
@@ -946,75 +1255,191 @@ R_DrawParticles_ShowTris -- johnfitz
 */
 void R_DrawParticles_ShowTris (void)
 {
-	particle_t		*p;
-	float			scale;
-	vec3_t			up, right, p_up, p_right, p_upright;
 	extern	cvar_t	r_particles;
 
 	if (!r_particles.value)
 		return;
 
-	VectorScale (vup, 1.5, up);
-	VectorScale (vright, 1.5, right);
+	if (!particles.numactive)
+		return;
 
-	if (r_quadparticles.value)
-	{
-		for (p=active_particles ; p ; p=p->next)
-		{
-			glBegin (GL_TRIANGLE_FAN);
-
-			// hack a scale up to keep particles from disapearing
-			scale = (p->org[0] - r_origin[0]) * vpn[0]
-				  + (p->org[1] - r_origin[1]) * vpn[1]
-				  + (p->org[2] - r_origin[2]) * vpn[2];
-			if (scale < 20)
-				scale = 1 + 0.08; //johnfitz -- added .08 to be consistent
-			else
-				scale = 1 + scale * 0.004;
+	R_SetupParticleArrays (r_quadparticles.value != 0);
 
-			scale /= 2.0; //quad is half the size of triangle
+	glEnableClientState (GL_VERTEX_ARRAY);
+	glVertexPointer (3, GL_FLOAT, 0, partverts);
 
-			scale *= texturescalefactor; //compensate for apparent size of different particle textures
+	R_DrawParticleBatches (true);
 
-			glVertex3fv (p->org);
+	glDisableClientState (GL_VERTEX_ARRAY);
+}
 
-			VectorMA (p->org, scale, up, p_up);
-			glVertex3fv (p_up);
+/*
+==============================================================================
+
+PARTICLE BENCHMARK
+
+==============================================================================
+*/
+
+/*
+===============
+R_BenchRandom
+===============
+*/
+static int R_BenchRandom (unsigned *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return (*seed >> 16) & 0x7fff;
+}
 
-			VectorMA (p_up, scale, right, p_upright);
-			glVertex3fv (p_upright);
+/*
+===============
+R_FillBenchParticles
 
-			VectorMA (p->org, scale, right, p_right);
-			glVertex3fv (p_right);
+Tops the store up to its limit with a mix of every particle type
+===============
+*/
+static void R_FillBenchParticles (particlestore_t *store, double time, unsigned *seed)
+{
+	particle_t	p;
+	int			j;
 
-			glEnd ();
+	while (store->numactive < store->maxactive)
+	{
+		p.type = (ptype_t) (R_BenchRandom (seed) % NUM_PARTICLE_TYPES);
+		p.die = time + 0.5 + (R_BenchRandom (seed) & 255) * 0.02;
+		p.ramp = R_BenchRandom (seed) & 3;
+		p.color = R_BenchRandom (seed) & 255;
+		for (j = 0; j < 3; j++)
+		{
+			p.org[j] = (R_BenchRandom (seed) % 2048) - 1024;
+			p.vel[j] = (R_BenchRandom (seed) % 512) - 256;
 		}
+		R_AddParticle (store, &p);
 	}
-	else
+}
+
+/*
+===============
+R_RunBenchParticles
+
+Returns the simulation time, the store is refilled every frame so that the
+load stays at its limit
+===============
+*/
+static double R_RunBenchParticles (particlestore_t *store, int frames, qboolean simd)
+{
+	const float	frametime = 1.0 / 72;
+	double		time, elapsed, start;
+	unsigned	seed = 1;
+	int			i;
+
+	elapsed = 0;
+	time = 0;
+
+	for (i = 0; i < frames; i++)
 	{
-		glBegin (GL_TRIANGLES);
-		for (p=active_particles ; p ; p=p->next)
-		{
-			// hack a scale up to keep particles from disapearing
-			scale = (p->org[0] - r_origin[0]) * vpn[0]
-				  + (p->org[1] - r_origin[1]) * vpn[1]
-				  + (p->org[2] - r_origin[2]) * vpn[2];
-			if (scale < 20)
-				scale = 1 + 0.08; //johnfitz -- added .08 to be consistent
-			else
-				scale = 1 + scale * 0.004;
+		R_FillBenchParticles (store, time, &seed);
+
+		time += frametime;
+		start = Sys_DoubleTime ();
+		R_SimulateParticles (store, time, frametime, frametime * 800 * 0.05, simd);
+		elapsed += Sys_DoubleTime () - start;
+	}
+
+	return elapsed;
+}
+
+/*
+===============
+R_CompareParticleStores
+===============
+*/
+static int R_CompareParticleStores (const particlestore_t *a, const particlestore_t *b)
+{
+	const particlelist_t	*la, *lb;
+	int						i, j, mismatches;
 
-			scale *= texturescalefactor; //compensate for apparent size of different particle textures
+	mismatches = 0;
 
-			glVertex3fv (p->org);
+	for (i = 0; i < NUM_PARTICLE_TYPES; i++)
+	{
+		la = &a->types[i];
+		lb = &b->types[i];
 
-			VectorMA (p->org, scale, up, p_up);
-			glVertex3fv (p_up);
+		if (la->count != lb->count)
+		{
+			mismatches++;
+			continue;
+		}
 
-			VectorMA (p->org, scale, right, p_right);
-			glVertex3fv (p_right);
+		for (j = 0; j < 3; j++)
+		{
+			if (memcmp (la->org[j], lb->org[j], la->count * sizeof(float)) ||
+				memcmp (la->vel[j], lb->vel[j], la->count * sizeof(float)))
+				mismatches++;
 		}
-		glEnd ();
+		if (memcmp (la->ramp, lb->ramp, la->count * sizeof(float)) ||
+			memcmp (la->die, lb->die, la->count * sizeof(float)) ||
+			memcmp (la->color, lb->color, la->count))
+			mismatches++;
 	}
+
+	return mismatches;
 }
 
+/*
+===============
+R_ParticleBench_f -- r_particlebench [particles] [frames]
+
+Runs the particle simulation on its own store, scalar and SIMD, and times the
+vertex emission. Nothing is drawn.
+===============
+*/
+void R_ParticleBench_f (void)
+{
+	particlestore_t	scalarstore, simdstore;
+	particlelist_t	*list;
+	double			scalar, simd, emit, start;
+	int				count, frames, i, j, first, batch, mismatches;
+
+	count = (Cmd_Argc () > 1) ? atoi (Cmd_Argv (1)) : r_numparticles;
+	count = CLAMP (1, count, ABSOLUTE_MAX_PARTICLES);
+	frames = (Cmd_Argc () > 2) ? atoi (Cmd_Argv (2)) : 500;
+	frames = q_max (frames, 1);
+
+	memset (&scalarstore, 0, sizeof(scalarstore));
+	memset (&simdstore, 0, sizeof(simdstore));
+	scalarstore.maxactive = simdstore.maxactive = count;
+
+	scalar = R_RunBenchParticles (&scalarstore, frames, false);
+	simd = R_RunBenchParticles (&simdstore, frames, true);
+	mismatches = R_CompareParticleStores (&scalarstore, &simdstore);
+
+	R_SetupParticleArrays (r_quadparticles.value != 0);
+	start = Sys_DoubleTime ();
+	for (i = 0; i < frames; i++)
+	{
+		for (j = 0; j < NUM_PARTICLE_TYPES; j++)
+		{
+			list = &simdstore.types[j];
+			for (first = 0; first < list->count; first += batch)
+			{
+				batch = q_min (list->count - first, PARTICLE_BATCH);
+				R_EmitParticles (list, first, batch, r_quadparticles.value != 0, partverts, partcolors);
+			}
+		}
+	}
+	emit = Sys_DoubleTime () - start;
+
+	R_FreeParticleStore (&scalarstore);
+	R_FreeParticleStore (&simdstore);
+
+	Con_Printf ("%i particles, %i frames\n", count, frames);
+	Con_Printf ("scalar   %7.3f ms per frame\n", scalar * 1000.0 / frames);
+	Con_Printf ("%-8s %7.3f ms per frame, %.2fx\n", PARTICLE_SIMD_NAME,
+		simd * 1000.0 / frames, simd > 0 ? scalar / simd : 0);
+	Con_Printf ("emit     %7.3f ms per frame\n", emit * 1000.0 / frames);
+	if (mismatches)
+		Con_Printf ("WARNING: %i arrays differ from the scalar result\n", mismatches);
+}
@@ -53,7 +53,7 @@ mspriteframe_t *R_GetSpriteFrame (entity_t *currentent)
 	{
 		// erysdren - angled sprites code backported from FTEQW
 		vec3_t axis[3];
-		AngleVectors(currententity->angles, axis[0], axis[1], axis[2]);
+		AngleVectors(currentent->angles, axis[0], axis[1], axis[2]);
 		{
 			float f = DotProduct(vpn, axis[0]);
 			float r = DotProduct(vright, axis[0]);
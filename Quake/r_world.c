@@ -25,8 +25,11 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 
 extern cvar_t gl_fullbrights, r_drawflat, gl_overbright, r_oldwater, r_oldskyleaf, r_showtris; //johnfitz
+extern cvar_t r_parallelcull;
 
 byte *SV_FatPVS (vec3_t org, qmodel_t *worldmodel);
+void R_SetFrustum (float fovx, float fovy);
+extern float r_fovx, r_fovy;
 
 //==============================================================================
 //
@@ -87,6 +90,297 @@ qboolean R_BackFaceCull (msurface_t *surf)
 	return false;
 }
 
+/*
+==============================================================================
+
+PVS SURFACE CACHE
+
+Marksurfaces of all leaves in the PVS are gathered into one flat array and
+reused while the view stays in the same leaf and the PVS doesn't change, so
+a frame only culls leaf bounds and surfaces instead of walking every leaf.
+
+Leaf and surface bounds are copied next to each other, so that R_CullBoxes
+can test them in batches.
+
+With r_parallelcull the leaves are split into fixed size chunks that are
+culled by the job system. Every chunk writes the surfaces that passed into
+its own part of pvscache.visible, and the main thread merges the chunks in
+order, so texture chains come out the same regardless of the worker count.
+==============================================================================
+*/
+
+#define PVS_CHUNK_LEAFS	128
+
+typedef struct
+{
+	mleaf_t		*leaf;
+	int			firstsurf;	// index into pvscache.surfs
+	int			numsurfs;
+} pvsleaf_t;
+
+typedef struct
+{
+	int			firstleaf;	// index into pvscache.leafs
+	int			numleafs;
+
+	// cull results
+	int			numvisible;		// at pvscache.visible[first surface of the first leaf]
+	int			numefragleafs;	// at pvscache.efragleafs[firstleaf]
+	int			numsurfs;		// marksurfaces tested
+} pvschunk_t;
+
+typedef enum
+{
+	pvs_leaf,
+	pvs_fat,	// near water portal, depends on exact view origin
+	pvs_novis
+} pvsmode_t;
+
+static struct
+{
+	qmodel_t	*model;
+	mleaf_t		*viewleaf;
+	pvsmode_t	mode;
+	vec3_t		origin;		// only for pvs_fat
+	qboolean	oldskyleaf;
+	byte		*vis;		// copy of the PVS the cache was built from
+	int			visbytes;
+	pvsleaf_t	*leafs;
+	msurface_t	**surfs;
+
+	cullboxes_t	leafbounds;		// [VEC_SIZE(leafs)]
+	cullboxes_t	surfbounds;		// [VEC_SIZE(surfs)]
+	byte		*leafvisible;	// [VEC_SIZE(leafs)] R_CullBoxes results
+	byte		*surfvisible;	// [VEC_SIZE(surfs)]
+
+	pvschunk_t	*chunks;
+	msurface_t	**visible;		// [VEC_SIZE(surfs)]
+	mleaf_t		**efragleafs;	// [VEC_SIZE(leafs)]
+} pvscache;
+
+/*
+===============
+R_InvalidatePVSCache
+
+Must be called when leaves or surfaces of the world change
+===============
+*/
+void R_InvalidatePVSCache (void)
+{
+	pvscache.model = NULL;
+	pvscache.viewleaf = NULL;
+}
+
+static void R_AllocCullBoxes (cullboxes_t *boxes, int count)
+{
+	int		i;
+
+	for (i = 0; i < 3; i++)
+	{
+		free (boxes->mins[i]);
+		free (boxes->maxs[i]);
+		boxes->mins[i] = (float *) malloc (q_max (count, 1) * sizeof(float));
+		boxes->maxs[i] = (float *) malloc (q_max (count, 1) * sizeof(float));
+	}
+}
+
+static void R_BuildPVSCache (byte *vis)
+{
+	pvsleaf_t	pvsleaf;
+	pvschunk_t	chunk;
+	mleaf_t		*leaf;
+	msurface_t	*surf;
+	int			i, j, numleafs, numsurfs;
+
+	VEC_CLEAR (pvscache.leafs);
+	VEC_CLEAR (pvscache.surfs);
+	VEC_CLEAR (pvscache.chunks);
+
+	leaf = &cl.worldmodel->leafs[1];
+	for (i=0 ; i<cl.worldmodel->numleafs ; i++, leaf++)
+	{
+		if (!(vis[i>>3] & (1<<(i&7))))
+			continue;
+
+		pvsleaf.leaf = leaf;
+		pvsleaf.firstsurf = VEC_SIZE (pvscache.surfs);
+		pvsleaf.numsurfs = 0;
+
+		if (pvscache.oldskyleaf || leaf->contents != CONTENTS_SKY)
+		{
+			pvsleaf.numsurfs = leaf->nummarksurfaces;
+			Vec_Append ((void **)&pvscache.surfs, sizeof(msurface_t *), leaf->firstmarksurface, leaf->nummarksurfaces);
+		}
+
+		VEC_PUSH (pvscache.leafs, pvsleaf);
+	}
+
+	numleafs = VEC_SIZE (pvscache.leafs);
+	memset (&chunk, 0, sizeof(chunk));
+
+	for (i = 0; i < numleafs; i += PVS_CHUNK_LEAFS)
+	{
+		chunk.firstleaf = i;
+		chunk.numleafs = q_min (numleafs - i, PVS_CHUNK_LEAFS);
+		VEC_PUSH (pvscache.chunks, chunk);
+	}
+
+	numsurfs = VEC_SIZE (pvscache.surfs);
+
+	R_AllocCullBoxes (&pvscache.leafbounds, numleafs);
+	R_AllocCullBoxes (&pvscache.surfbounds, numsurfs);
+
+	for (i = 0; i < numleafs; i++)
+	{
+		leaf = pvscache.leafs[i].leaf;
+		for (j = 0; j < 3; j++)
+		{
+			pvscache.leafbounds.mins[j][i] = leaf->minmaxs[j];
+			pvscache.leafbounds.maxs[j][i] = leaf->minmaxs[3 + j];
+		}
+	}
+
+	for (i = 0; i < numsurfs; i++)
+	{
+		surf = pvscache.surfs[i];
+		for (j = 0; j < 3; j++)
+		{
+			pvscache.surfbounds.mins[j][i] = surf->mins[j];
+			pvscache.surfbounds.maxs[j][i] = surf->maxs[j];
+		}
+	}
+
+	free (pvscache.visible);
+	free (pvscache.efragleafs);
+	free (pvscache.leafvisible);
+	free (pvscache.surfvisible);
+	pvscache.visible = (msurface_t **) malloc (q_max (numsurfs, 1) * sizeof(msurface_t *));
+	pvscache.efragleafs = (mleaf_t **) malloc (q_max (numleafs, 1) * sizeof(mleaf_t *));
+	pvscache.leafvisible = (byte *) malloc (q_max (numleafs, 1));
+	pvscache.surfvisible = (byte *) malloc (q_max (numsurfs, 1));
+
+	rs_pvsrebuilds++;
+}
+
+// returns true when cached surfaces can be used for the current view
+static qboolean R_CheckPVSCache (pvsmode_t mode)
+{
+	return pvscache.model == cl.worldmodel
+		&& pvscache.viewleaf == r_viewleaf
+		&& pvscache.mode == mode
+		&& pvscache.oldskyleaf == (r_oldskyleaf.value != 0)
+		&& (mode != pvs_fat || VectorCompare (pvscache.origin, r_origin));
+}
+
+static void R_UpdatePVSCache (pvsmode_t mode)
+{
+	byte	*vis;
+	int		visbytes;
+
+	if (R_CheckPVSCache (mode))
+		return;
+
+	if (mode == pvs_novis)
+		vis = Mod_NoVisPVS (cl.worldmodel);
+	else if (mode == pvs_fat)
+		vis = SV_FatPVS (r_origin, cl.worldmodel);
+	else
+		vis = Mod_LeafPVS (r_viewleaf, cl.worldmodel);
+
+	visbytes = (cl.worldmodel->numleafs + 7) >> 3;
+
+	// moving inside of a water portal leaf rarely changes the fat PVS
+	if (pvscache.model != cl.worldmodel || pvscache.oldskyleaf != (r_oldskyleaf.value != 0)
+		|| pvscache.visbytes != visbytes || memcmp (pvscache.vis, vis, visbytes))
+	{
+		if (pvscache.visbytes < visbytes)
+		{
+			free (pvscache.vis);
+			pvscache.vis = (byte *) malloc (visbytes);
+		}
+
+		memcpy (pvscache.vis, vis, visbytes);
+		pvscache.visbytes = visbytes;
+		pvscache.oldskyleaf = (r_oldskyleaf.value != 0);
+
+		R_BuildPVSCache (vis);
+	}
+
+	pvscache.model = cl.worldmodel;
+	pvscache.viewleaf = r_viewleaf;
+	pvscache.mode = mode;
+	VectorCopy (r_origin, pvscache.origin);
+}
+
+/*
+===============
+R_CullPVSChunk
+
+Job that culls one chunk of the cached PVS leaves, only reads shared state.
+data points to a qboolean that enables SIMD culling.
+===============
+*/
+static void R_CullPVSChunk (void *data, int index, int worker)
+{
+	pvschunk_t	*chunk = &pvscache.chunks[index];
+	pvsleaf_t	*pvsleaf;
+	mleaf_t		*leaf, **efragleafs;
+	msurface_t	**mark, **visible;
+	qboolean	simd = *(qboolean *) data;
+	byte		*surfvisible;
+	int			i, j;
+
+	pvsleaf = &pvscache.leafs[chunk->firstleaf];
+	visible = &pvscache.visible[pvsleaf->firstsurf];
+	efragleafs = &pvscache.efragleafs[chunk->firstleaf];
+
+	chunk->numvisible = 0;
+	chunk->numefragleafs = 0;
+	chunk->numsurfs = 0;
+
+	if (!R_CullBoxes (&pvscache.leafbounds, chunk->firstleaf, chunk->numleafs, pvscache.leafvisible, simd))
+		return;
+
+	for (i=0 ; i<chunk->numleafs ; i++, pvsleaf++)
+	{
+		if (!pvscache.leafvisible[chunk->firstleaf + i])
+			continue;
+
+		leaf = pvsleaf->leaf;
+
+		// surfaces shared with other leaves are tested again, the merge drops duplicates
+		if (R_CullBoxes (&pvscache.surfbounds, pvsleaf->firstsurf, pvsleaf->numsurfs, pvscache.surfvisible, simd))
+		{
+			mark = &pvscache.surfs[pvsleaf->firstsurf];
+			surfvisible = &pvscache.surfvisible[pvsleaf->firstsurf];
+			for (j=0 ; j<pvsleaf->numsurfs ; j++)
+			{
+				if (surfvisible[j] && !R_BackFaceCull (mark[j]))
+					visible[chunk->numvisible++] = mark[j];
+			}
+		}
+
+		chunk->numsurfs += pvsleaf->numsurfs;
+
+		if (leaf->efrags)
+			efragleafs[chunk->numefragleafs++] = leaf;
+	}
+}
+
+/*
+===============
+R_MarkVisibleSurface
+===============
+*/
+static void R_MarkVisibleSurface (msurface_t *surf)
+{
+	rs_brushpolys++; //count wpolys here
+	R_ChainSurface(surf, chain_world);
+	R_RenderDynamicLightmaps(surf);
+	if (surf->texinfo->texture->warpimage)
+		surf->texinfo->texture->update_warp = true;
+}
+
 /*
 ===============
 R_MarkSurfaces -- johnfitz -- mark surfaces based on PVS and rebuild texture chains
@@ -94,11 +388,11 @@ R_MarkSurfaces -- johnfitz -- mark surfaces based on PVS and rebuild texture cha
 */
 void R_MarkSurfaces (void)
 {
-	byte		*vis;
-	mleaf_t		*leaf;
+	pvschunk_t	*chunk;
 	msurface_t	*surf, **mark;
-	int			i, j;
-	qboolean	nearwaterportal;
+	int			i, j, numchunks;
+	qboolean	nearwaterportal, simd = true;
+	pvsmode_t	mode;
 
 	// clear lightmap chains
 	for (i=0 ; i<lightmap_count ; i++)
@@ -113,11 +407,13 @@ void R_MarkSurfaces (void)
 
 	// choose vis data
 	if (r_novis.value || r_viewleaf->contents == CONTENTS_SOLID || r_viewleaf->contents == CONTENTS_SKY)
-		vis = Mod_NoVisPVS (cl.worldmodel);
+		mode = pvs_novis;
 	else if (nearwaterportal)
-		vis = SV_FatPVS (r_origin, cl.worldmodel);
+		mode = pvs_fat;
 	else
-		vis = Mod_LeafPVS (r_viewleaf, cl.worldmodel);
+		mode = pvs_leaf;
+
+	R_UpdatePVSCache (mode);
 
 	r_visframecount++;
 
@@ -126,38 +422,181 @@ void R_MarkSurfaces (void)
 		if (cl.worldmodel->textures[i])
 			cl.worldmodel->textures[i]->texturechains[chain_world] = NULL;
 
-	// iterate through leaves, marking surfaces
-	leaf = &cl.worldmodel->leafs[1];
-	for (i=0 ; i<cl.worldmodel->numleafs ; i++, leaf++)
+	numchunks = VEC_SIZE (pvscache.chunks);
+
+	if (r_parallelcull.value && Jobs_NumWorkers () > 1 && numchunks > 1)
+		Jobs_ParallelFor (R_CullPVSChunk, &simd, numchunks);
+	else
 	{
-		if (vis[i>>3] & (1<<(i&7)))
+		for (i=0 ; i<numchunks ; i++)
+			R_CullPVSChunk (&simd, i, 0);
+	}
+
+	// merge in chunk order, the first occurrence of a surface wins
+	for (i=0, chunk = pvscache.chunks ; i<numchunks ; i++, chunk++)
+	{
+		mark = &pvscache.visible[pvscache.leafs[chunk->firstleaf].firstsurf];
+		for (j=0 ; j<chunk->numvisible ; j++, mark++)
 		{
-			if (R_CullBox(leaf->minmaxs, leaf->minmaxs + 3))
-				continue;
+			surf = *mark;
+			if (surf->visframe != r_visframecount)
+			{
+				surf->visframe = r_visframecount;
+				R_MarkVisibleSurface (surf);
+			}
+		}
 
-			if (r_oldskyleaf.value || leaf->contents != CONTENTS_SKY)
-				for (j=0, mark = leaf->firstmarksurface; j<leaf->nummarksurfaces; j++, mark++)
-				{
-					surf = *mark;
-					if (surf->visframe != r_visframecount)
-					{
-						surf->visframe = r_visframecount;
-						if (!R_CullBox(surf->mins, surf->maxs) && !R_BackFaceCull (surf))
-						{
-							rs_brushpolys++; //count wpolys here
-							R_ChainSurface(surf, chain_world);
-							R_RenderDynamicLightmaps(surf);
-							if (surf->texinfo->texture->warpimage)
-								surf->texinfo->texture->update_warp = true;
-						}
-					}
-				}
+		// add static models
+		for (j=0 ; j<chunk->numefragleafs ; j++)
+			R_StoreEfrags (&pvscache.efragleafs[chunk->firstleaf + j]->efrags);
+
+		rs_pvsleafs += chunk->numleafs;
+		rs_pvssurfs += chunk->numsurfs;
+	}
+
+	R_FlushLightmapUpdates ();
+}
+
+/*
+===============
+R_CheckCullBoxes
+
+Returns the number of leaf and surface boxes where R_CullBoxes disagrees
+with R_CullBox
+===============
+*/
+static int R_CheckCullBoxes (void)
+{
+	mleaf_t		*leaf;
+	msurface_t	*surf;
+	int			i, numleafs, numsurfs, mismatches;
+
+	numleafs = VEC_SIZE (pvscache.leafs);
+	numsurfs = VEC_SIZE (pvscache.surfs);
+	mismatches = 0;
+
+	R_CullBoxes (&pvscache.leafbounds, 0, numleafs, pvscache.leafvisible, true);
+	R_CullBoxes (&pvscache.surfbounds, 0, numsurfs, pvscache.surfvisible, true);
+
+	for (i = 0; i < numleafs; i++)
+	{
+		leaf = pvscache.leafs[i].leaf;
+		if (pvscache.leafvisible[i] == R_CullBox (leaf->minmaxs, leaf->minmaxs + 3))
+			mismatches++;
+	}
+
+	for (i = 0; i < numsurfs; i++)
+	{
+		surf = pvscache.surfs[i];
+		if (pvscache.surfvisible[i] == R_CullBox (surf->mins, surf->maxs))
+			mismatches++;
+	}
+
+	return mismatches;
+}
 
-			// add static models
-			if (leaf->efrags)
-				R_StoreEfrags (&leaf->efrags);
+/*
+===============
+R_CullBench_f
+
+Times the culling pass over the current view without drawing anything:
+scalar and SIMD on the main thread only, then SIMD with the job system.
+The view is turned around a full circle over all iterations, and every
+frame R_CullBoxes is checked against R_CullBox box by box.
+===============
+*/
+void R_CullBench_f (void)
+{
+	vec3_t		angles, oldvpn, oldvright, oldvup;
+	mplane_t	oldfrustum[4];
+	pvschunk_t	*chunk;
+	msurface_t	**results, **first;
+	int			i, j, frames, numchunks, numsurfs, visible, mismatches, boxmismatches;
+	double		start, scalar, serial, parallel;
+	qboolean	novis, simd;
+
+	if (!cl.worldmodel || !r_viewleaf)
+	{
+		Con_Printf ("r_cullbench: no map loaded\n");
+		return;
+	}
+
+	frames = (Cmd_Argc () > 1) ? atoi (Cmd_Argv (1)) : 100;
+	frames = q_max (frames, 1);
+	novis = (Cmd_Argc () > 2) && !q_strcasecmp (Cmd_Argv (2), "novis");
+
+	R_UpdatePVSCache (novis ? pvs_novis : pvs_leaf);
+	numchunks = VEC_SIZE (pvscache.chunks);
+	numsurfs = VEC_SIZE (pvscache.surfs);
+
+	VectorCopy (vpn, oldvpn);
+	VectorCopy (vright, oldvright);
+	VectorCopy (vup, oldvup);
+	memcpy (oldfrustum, frustum, sizeof(frustum));
+
+	// visible surfaces of the scalar run, same layout as pvscache.visible
+	results = (msurface_t **) malloc (q_max (numsurfs, 1) * sizeof(msurface_t *));
+	scalar = serial = parallel = 0;
+	visible = mismatches = boxmismatches = 0;
+	VectorCopy (r_refdef.viewangles, angles);
+
+	for (i = 0; i < frames; i++)
+	{
+		angles[YAW] = r_refdef.viewangles[YAW] + 360.0 * i / frames;
+		AngleVectors (angles, vpn, vright, vup);
+		R_SetFrustum (r_fovx, r_fovy);
+
+		simd = false;
+		start = Sys_DoubleTime ();
+		for (j = 0; j < numchunks; j++)
+			R_CullPVSChunk (&simd, j, 0);
+		scalar += Sys_DoubleTime () - start;
+
+		memcpy (results, pvscache.visible, numsurfs * sizeof(msurface_t *));
+		for (j = 0, chunk = pvscache.chunks; j < numchunks; j++, chunk++)
+			visible += chunk->numvisible;
+
+		simd = true;
+		start = Sys_DoubleTime ();
+		for (j = 0; j < numchunks; j++)
+			R_CullPVSChunk (&simd, j, 0);
+		serial += Sys_DoubleTime () - start;
+
+		start = Sys_DoubleTime ();
+		Jobs_ParallelFor (R_CullPVSChunk, &simd, numchunks);
+		parallel += Sys_DoubleTime () - start;
+
+		for (j = 0, chunk = pvscache.chunks; j < numchunks; j++, chunk++)
+		{
+			first = &pvscache.visible[pvscache.leafs[chunk->firstleaf].firstsurf];
+			if (memcmp (first, results + (first - pvscache.visible), chunk->numvisible * sizeof(msurface_t *)))
+				mismatches++;
 		}
+
+		boxmismatches += R_CheckCullBoxes ();
 	}
+
+	free (results);
+
+	VectorCopy (oldvpn, vpn);
+	VectorCopy (oldvright, vright);
+	VectorCopy (oldvup, vup);
+	memcpy (frustum, oldfrustum, sizeof(frustum));
+
+	// next frame picks up the real PVS again
+	R_InvalidatePVSCache ();
+
+	Con_Printf ("%i frames, %i leafs, %i marksurfs, %i chunks, %.1f visible per frame\n",
+		frames, (int)VEC_SIZE (pvscache.leafs), numsurfs, numchunks, (double)visible / frames);
+	Con_Printf ("scalar   %7.3f ms per frame\n", scalar * 1000.0 / frames);
+	Con_Printf ("simd     %7.3f ms per frame, %.2fx\n",
+		serial * 1000.0 / frames, serial > 0 ? scalar / serial : 0.0);
+	Con_Printf ("parallel %7.3f ms per frame, %i workers, %.2fx\n",
+		parallel * 1000.0 / frames, Jobs_NumWorkers (), parallel > 0 ? scalar / parallel : 0.0);
+	if (mismatches)
+		Con_Printf ("WARNING: %i chunk results differ\n", mismatches);
+	if (boxmismatches)
+		Con_Printf ("WARNING: %i boxes differ from R_CullBox\n", boxmismatches);
 }
 
 //==============================================================================
@@ -399,6 +838,160 @@ static void R_BatchSurface (msurface_t *s)
 	num_vbo_indices += num_surf_indices;
 }
 
+/*
+=============================================================================
+
+WORLD INDEX CACHE
+
+The GLSL path draws the world from one element buffer holding the indices of
+all visible surfaces in draw order, with a batch for every run of surfaces
+sharing texture and lightmap. While the texture chains list the same
+surfaces as when the buffer was built, it is drawn again as it is, so a
+static view neither generates nor uploads any indices.
+
+=============================================================================
+*/
+
+typedef struct
+{
+	int			texnum;
+	int			lightmap;
+	int			firstindex;
+	int			numindexes;
+	int			numsurfs;
+} worldbatch_t;
+
+static struct
+{
+	qboolean		valid;
+	msurface_t		**surfs;	// chain order the buffer was built from
+	unsigned int	*indices;
+	worldbatch_t	*batches;
+	GLuint			ibo;
+	int				ibosize;	// bytes
+} worldindices;
+
+/*
+================
+R_FreeWorldIndices
+
+Called when the brush model vertex buffer is rebuilt or deleted
+================
+*/
+void R_FreeWorldIndices (void)
+{
+	if (worldindices.ibo)
+		GL_DeleteBuffersFunc (1, &worldindices.ibo);
+	worldindices.ibo = 0;
+	worldindices.ibosize = 0;
+	worldindices.valid = false;
+
+	VEC_FREE (worldindices.surfs);
+	VEC_FREE (worldindices.indices);
+	VEC_FREE (worldindices.batches);
+}
+
+// same textures R_DrawTextureChains_GLSL draws
+static qboolean R_WorldIndicesSkipTexture (texture_t *t, texchain_t chain)
+{
+	return !t || !t->texturechains[chain] || t->texturechains[chain]->flags & (SURF_DRAWTURB | SURF_DRAWTILED | SURF_NOTEXTURE);
+}
+
+/*
+================
+R_WorldIndicesMatch
+================
+*/
+static qboolean R_WorldIndicesMatch (qmodel_t *model, texchain_t chain)
+{
+	msurface_t	*s, **cached;
+	int			i, count;
+
+	if (!worldindices.valid)
+		return false;
+
+	cached = worldindices.surfs;
+	count = VEC_SIZE (worldindices.surfs);
+
+	for (i=0 ; i<model->numtextures ; i++)
+	{
+		if (R_WorldIndicesSkipTexture (model->textures[i], chain))
+			continue;
+
+		for (s = model->textures[i]->texturechains[chain]; s; s = s->texturechain, cached++, count--)
+			if (!count || *cached != s)
+				return false;
+	}
+
+	return count == 0;
+}
+
+/*
+================
+R_BuildWorldIndices
+================
+*/
+static void R_BuildWorldIndices (qmodel_t *model, texchain_t chain)
+{
+	msurface_t		*s;
+	worldbatch_t	batch, *last;
+	int				i, numindexes, size;
+
+	VEC_CLEAR (worldindices.surfs);
+	VEC_CLEAR (worldindices.indices);
+	VEC_CLEAR (worldindices.batches);
+
+	for (i=0 ; i<model->numtextures ; i++)
+	{
+		if (R_WorldIndicesSkipTexture (model->textures[i], chain))
+			continue;
+
+		last = NULL;
+		for (s = model->textures[i]->texturechains[chain]; s; s = s->texturechain)
+		{
+			VEC_PUSH (worldindices.surfs, s);
+
+			numindexes = R_NumTriangleIndicesForSurf (s);
+			if (numindexes <= 0)
+				continue;
+
+			if (!last || last->lightmap != s->lightmaptexturenum)
+			{
+				batch.texnum = i;
+				batch.lightmap = s->lightmaptexturenum;
+				batch.firstindex = VEC_SIZE (worldindices.indices);
+				batch.numindexes = 0;
+				batch.numsurfs = 0;
+				VEC_PUSH (worldindices.batches, batch);
+				last = &worldindices.batches[VEC_SIZE (worldindices.batches) - 1];
+			}
+
+			Vec_Grow ((void **)&worldindices.indices, sizeof(unsigned int), numindexes);
+			R_TriangleIndicesForSurf (s, worldindices.indices + VEC_SIZE (worldindices.indices));
+			VEC_HEADER (worldindices.indices).size += numindexes;
+
+			last->numindexes += numindexes;
+			last->numsurfs++;
+		}
+	}
+
+	if (!worldindices.ibo)
+		GL_GenBuffersFunc (1, &worldindices.ibo);
+
+	size = VEC_SIZE (worldindices.indices) * sizeof(unsigned int);
+	GL_BindBuffer (GL_ELEMENT_ARRAY_BUFFER, worldindices.ibo);
+	if (size > worldindices.ibosize)
+	{
+		// leave room, so that turning around doesn't reallocate all the time
+		worldindices.ibosize = size + size / 2;
+		GL_BufferDataFunc (GL_ELEMENT_ARRAY_BUFFER, worldindices.ibosize, NULL, GL_DYNAMIC_DRAW);
+	}
+	if (size > 0)
+		GL_BufferSubDataFunc (GL_ELEMENT_ARRAY_BUFFER, 0, size, worldindices.indices);
+
+	worldindices.valid = true;
+}
+
 /*
 ================
 R_DrawTextureChains_Multitexture -- johnfitz
@@ -622,7 +1215,7 @@ void R_DrawTextureChains_Water (qmodel_t *model, entity_t *ent, texchain_t chain
 
 		has_lit_water = true;
 
-		GL_UseProgramFunc (r_world_program);
+		GL_UseProgram (r_world_program);
 
 		// Bind the buffers
 		GL_BindBuffer (GL_ARRAY_BUFFER, gl_bmodel_vbo);
@@ -706,7 +1299,7 @@ void R_DrawTextureChains_Water (qmodel_t *model, entity_t *ent, texchain_t chain
 		GL_DisableVertexAttribArrayFunc (vertAttrIndex);
 		GL_DisableVertexAttribArrayFunc (texCoordsAttrIndex);
 		GL_DisableVertexAttribArrayFunc (LMCoordsAttrIndex);
-		GL_UseProgramFunc (0);
+		GL_UseProgram (0);
 		GL_SelectTexture (GL_TEXTURE0);
 	}
 	else
@@ -923,6 +1516,7 @@ void R_DrawTextureChains_GLSL (qmodel_t *model, entity_t *ent, texchain_t chain)
 	qboolean	bound;
 	int		lastlightmap;
 	gltexture_t	*fullbright = NULL;
+	worldbatch_t	*batch, *lastbatch;
 
 // enable blending / disable depth writes
 	if (entalpha < 1)
@@ -931,11 +1525,23 @@ void R_DrawTextureChains_GLSL (qmodel_t *model, entity_t *ent, texchain_t chain)
 		glEnable (GL_BLEND);
 	}
 
-	GL_UseProgramFunc (r_world_program);
+	GL_UseProgram (r_world_program);
 
 // Bind the buffers
 	GL_BindBuffer (GL_ARRAY_BUFFER, gl_bmodel_vbo);
-	GL_BindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0); // indices come from client memory!
+	if (model == cl.worldmodel && chain == chain_world)
+	{
+		if (!R_WorldIndicesMatch (model, chain))
+			R_BuildWorldIndices (model, chain);
+		GL_BindBuffer (GL_ELEMENT_ARRAY_BUFFER, worldindices.ibo);
+		batch = worldindices.batches;
+		lastbatch = batch + VEC_SIZE (worldindices.batches);
+	}
+	else
+	{
+		GL_BindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0); // indices come from client memory!
+		batch = lastbatch = NULL;
+	}
 
 	GL_EnableVertexAttribArrayFunc (vertAttrIndex);
 	GL_EnableVertexAttribArrayFunc (texCoordsAttrIndex);
@@ -974,6 +1580,27 @@ void R_DrawTextureChains_GLSL (qmodel_t *model, entity_t *ent, texchain_t chain)
 		else
 			GL_Uniform1iFunc (useFullbrightTexLoc, 0);
 
+		// world surfaces come from the cached element buffer
+		if (batch)
+		{
+			GL_SelectTexture (GL_TEXTURE0);
+			GL_Bind ((R_TextureAnimation(t, ent != NULL ? ent->frame : 0))->gltexture);
+			if (t->texturechains[chain]->flags & SURF_DRAWFENCE)
+				GL_Uniform1iFunc (useAlphaTestLoc, 1); // Flip alpha test back on
+
+			for ( ; batch < lastbatch && batch->texnum == i; batch++)
+			{
+				GL_SelectTexture (GL_TEXTURE1);
+				GL_Bind (lightmaps[batch->lightmap].texture);
+				glDrawElements (GL_TRIANGLES, batch->numindexes, GL_UNSIGNED_INT, (void *)(intptr_t)(batch->firstindex * sizeof(unsigned int)));
+				rs_brushpasses += batch->numsurfs;
+			}
+
+			if (t->texturechains[chain]->flags & SURF_DRAWFENCE)
+				GL_Uniform1iFunc (useAlphaTestLoc, 0); // Flip alpha test back off
+			continue;
+		}
+
 		R_ClearBatch ();
 
 		bound = false;
@@ -1013,7 +1640,7 @@ void R_DrawTextureChains_GLSL (qmodel_t *model, entity_t *ent, texchain_t chain)
 	GL_DisableVertexAttribArrayFunc (texCoordsAttrIndex);
 	GL_DisableVertexAttribArrayFunc (LMCoordsAttrIndex);
 
-	GL_UseProgramFunc (0);
+	GL_UseProgram (0);
 	GL_SelectTexture (GL_TEXTURE0);
 
 	if (entalpha < 1)
@@ -1038,7 +1665,7 @@ void R_DrawLightmapChains_GLSL(qmodel_t* model, entity_t* ent, texchain_t chain)
 	texture_t* t;
 	int		lastlightmap;
 
-	GL_UseProgramFunc(r_world_program);
+	GL_UseProgram (r_world_program);
 
 	// Bind the buffers
 	GL_BindBuffer(GL_ARRAY_BUFFER, gl_bmodel_vbo);
@@ -1103,7 +1730,7 @@ void R_DrawLightmapChains_GLSL(qmodel_t* model, entity_t* ent, texchain_t chain)
 	GL_DisableVertexAttribArrayFunc(texCoordsAttrIndex);
 	GL_DisableVertexAttribArrayFunc(LMCoordsAttrIndex);
 
-	GL_UseProgramFunc(0);
+	GL_UseProgram (0);
 	GL_SelectTexture(GL_TEXTURE0);
 }
 
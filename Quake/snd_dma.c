@@ -66,6 +66,11 @@ portable_samplepair_t	s_rawsamples[MAX_RAW_SAMPLES];
 static sfx_t	*known_sfx = NULL;	// hunk allocated [MAX_SFX]
 static int	num_sfx;
 
+#define	SFX_HASH_SIZE	(MAX_SFX * 2)	// power of two
+static int	sfx_hash[SFX_HASH_SIZE];	// first known_sfx index of every chain, -1 if empty
+static int	sfx_hashnext[MAX_SFX];
+static int	sfx_lookups, sfx_probes;
+
 static sfx_t	*ambient_sfx[NUM_AMBIENTS];
 
 static qboolean	sound_started = false;
@@ -217,6 +222,7 @@ void S_Init (void)
 
 	known_sfx = (sfx_t *) Hunk_AllocName (MAX_SFX*sizeof(sfx_t), "sfx_t");
 	num_sfx = 0;
+	memset (sfx_hash, 0xff, sizeof(sfx_hash));
 
 	snd_initialized = true;
 
@@ -268,6 +274,7 @@ S_FindName
 static sfx_t *S_FindName (const char *name)
 {
 	int		i;
+	unsigned	hash;
 	sfx_t	*sfx;
 
 	if (!name)
@@ -277,8 +284,11 @@ static sfx_t *S_FindName (const char *name)
 		Sys_Error ("Sound name too long: %s", name);
 
 // see if already loaded
-	for (i = 0; i < num_sfx; i++)
+	sfx_lookups++;
+	hash = COM_HashString (name) & (SFX_HASH_SIZE - 1);
+	for (i = sfx_hash[hash]; i >= 0; i = sfx_hashnext[i])
 	{
+		sfx_probes++;
 		if (!strcmp(known_sfx[i].name, name))
 		{
 			return &known_sfx[i];
@@ -288,9 +298,11 @@ static sfx_t *S_FindName (const char *name)
 	if (num_sfx == MAX_SFX)
 		Sys_Error ("S_FindName: out of sfx_t");
 
-	sfx = &known_sfx[i];
+	sfx = &known_sfx[num_sfx];
 	q_strlcpy (sfx->name, name, sizeof(sfx->name));
 
+	sfx_hashnext[num_sfx] = sfx_hash[hash];
+	sfx_hash[hash] = num_sfx;
 	num_sfx++;
 
 	return sfx;
@@ -331,7 +343,7 @@ sfx_t *S_PrecacheSound (const char *name)
 
 // cache it in
 	if (precache.value)
-		S_LoadSound (sfx);
+		S_RequestSound (sfx);
 
 	return sfx;
 }
@@ -1030,6 +1042,8 @@ static void S_SoundList (void)
 		Con_SafePrintf("(%2db) %6i : %s\n", sc->width*8, size, sfx->name); //johnfitz -- was Con_Printf
 	}
 	Con_Printf ("%i sounds, %i bytes\n", num_sfx, total); //johnfitz -- added count
+	Con_Printf ("%i lookups, %.2f compares per lookup\n", sfx_lookups,
+		sfx_lookups ? (double) sfx_probes / sfx_lookups : 0.0);
 }
 
 
@@ -26,30 +26,28 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 /*
 ================
 ResampleSfx
+
+Converts to speed, touches nothing but sc and data so that it can run on
+a loader thread
 ================
 */
-static void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
+static void ResampleSfx (sfxcache_t *sc, int inrate, int inwidth, const byte *data, int speed, qboolean as8bit)
 {
 	int		outcount;
 	int		srcsample;
 	float	stepscale;
 	int		i;
 	int		sample, fracstep;
-	sfxcache_t	*sc;
-
-	sc = (sfxcache_t *) Cache_Check (&sfx->cache);
-	if (!sc)
-		return;
 
-	stepscale = (float)inrate / shm->speed;	// this is usually 0.5, 1, or 2
+	stepscale = (float)inrate / speed;	// this is usually 0.5, 1, or 2
 
 	outcount = sc->length / stepscale;
 	sc->length = outcount;
 	if (sc->loopstart != -1)
 		sc->loopstart = sc->loopstart / stepscale;
 
-	sc->speed = shm->speed;
-	if (loadas8bit.value)
+	sc->speed = speed;
+	if (as8bit)
 		sc->width = 1;
 	else
 		sc->width = inwidth;
@@ -89,48 +87,17 @@ static void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
 
 /*
 ==============
-S_LoadSound
+S_LoadWav
 ==============
 */
-sfxcache_t *S_LoadSound (sfx_t *s)
+static sfxcache_t *S_LoadWav (sfx_t *s, byte *data, int size)
 {
-	char	namebuffer[256];
-	byte	*data;
 	wavinfo_t	info;
 	int		len;
 	float	stepscale;
 	sfxcache_t	*sc;
-	byte	stackbuf[1*1024];		// avoid dirtying the cache heap
-
-// see if still in memory
-	sc = (sfxcache_t *) Cache_Check (&s->cache);
-	if (sc)
-		return sc;
-
-//	Con_Printf ("S_LoadSound: %x\n", (int)stackbuf);
-
-// load it in
-	q_strlcpy(namebuffer, "sound/", sizeof(namebuffer));
-	q_strlcat(namebuffer, s->name, sizeof(namebuffer));
-
-//	Con_Printf ("loading %s\n",namebuffer);
-
-	data = COM_LoadStackFile(namebuffer, stackbuf, sizeof(stackbuf), NULL);
-
-	if (!data)
-	{
-		extern cvar_t allowloaderrors;
 
-		if (allowloaderrors.value)
-			data = COM_LoadStackFile("sound/misc/null.wav", stackbuf, sizeof(stackbuf), NULL);
-		else
-		{
-			Con_Printf ("Couldn't load %s\n", namebuffer);
-			return NULL;
-		}
-	}
-
-	info = GetWavinfo (s->name, data, com_filesize);
+	info = GetWavinfo (s->name, data, size);
 	if (info.channels != 1)
 	{
 		Con_Printf ("%s is a stereo sample\n",s->name);
@@ -164,11 +131,175 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	sc->width = info.width;
 	sc->stereo = info.channels;
 
-	ResampleSfx (s, sc->speed, sc->width, data + info.dataofs);
+	ResampleSfx (sc, sc->speed, sc->width, data + info.dataofs, shm->speed, loadas8bit.value != 0);
 
 	return sc;
 }
 
+/*
+==============
+S_LoadSound
+==============
+*/
+sfxcache_t *S_LoadSound (sfx_t *s)
+{
+	char	namebuffer[256];
+	mappedfile_t	file;
+	sfxcache_t	*sc;
+
+// see if still in memory
+	sc = (sfxcache_t *) Cache_Check (&s->cache);
+	if (sc)
+		return sc;
+
+// needed now, so don't wait for the next frame
+	if (s->request)
+	{
+		Async_Finish (s->request);
+		sc = (sfxcache_t *) Cache_Check (&s->cache);
+		if (sc)
+			return sc;
+	}
+
+// load it in
+	q_strlcpy(namebuffer, "sound/", sizeof(namebuffer));
+	q_strlcat(namebuffer, s->name, sizeof(namebuffer));
+
+//	Con_Printf ("loading %s\n",namebuffer);
+
+	if (!COM_MapFile(namebuffer, &file, NULL))
+	{
+		extern cvar_t allowloaderrors;
+
+		if (!allowloaderrors.value || !COM_MapFile("sound/misc/null.wav", &file, NULL))
+		{
+			Con_Printf ("Couldn't load %s\n", namebuffer);
+			return NULL;
+		}
+	}
+
+	sc = S_LoadWav (s, file.data, file.len);
+	COM_UnmapFile (&file);
+
+	return sc;
+}
+
+typedef struct
+{
+	sfx_t		*sfx;
+	char		name[MAX_QPATH];
+	int			speed;		// shm->speed and loadas8bit when it was requested
+	qboolean	as8bit;
+	sfxcache_t	*decoded;	// malloc'd by S_DecodeSound, NULL if S_LoadWav has to do it
+	int			size;
+} soundrequest_t;
+
+static wavinfo_t ParseWav (const char *name, byte *wav, int wavlength, qboolean verbose);
+
+/*
+==============
+S_DecodeSound
+
+S_LoadWav without the cache allocation, on a loader thread. Sounds it
+would complain about are left to it.
+==============
+*/
+static void S_DecodeSound (const byte *data, int len, void *userdata)
+{
+	soundrequest_t	*req = (soundrequest_t *) userdata;
+	wavinfo_t	info;
+	float	stepscale;
+	int		size;
+	sfxcache_t	*sc;
+
+	info = ParseWav (req->name, (byte *) data, len, false);
+	if (info.channels != 1 || (info.width != 1 && info.width != 2) || info.rate <= 0 || info.samples == 0 || info.dataofs == 0)
+		return;
+
+	stepscale = (float)info.rate / req->speed;
+	size = info.samples / stepscale;
+
+	size = size * info.width * info.channels;
+	if (size == 0)
+		return;
+
+	sc = (sfxcache_t *) malloc (size + sizeof(sfxcache_t));
+	if (!sc)
+		return;
+
+	sc->length = info.samples;
+	sc->loopstart = info.loopstart;
+	sc->speed = info.rate;
+	sc->width = info.width;
+	sc->stereo = info.channels;
+
+	ResampleSfx (sc, sc->speed, sc->width, data + info.dataofs, req->speed, req->as8bit);
+
+	req->decoded = sc;
+	req->size = size + sizeof(sfxcache_t);
+}
+
+static void S_SoundRead (byte *data, int len, void *userdata)
+{
+	soundrequest_t	*req = (soundrequest_t *) userdata;
+	sfx_t	*s = req->sfx;
+	sfxcache_t	*sc;
+
+	s->request = NULL;
+
+	// a failed read is reported by S_LoadSound once the sound is used
+	if (data && !Cache_Check (&s->cache))
+	{
+		if (req->decoded && req->speed == shm->speed && req->as8bit == (loadas8bit.value != 0))
+		{
+			sc = (sfxcache_t *) Cache_Alloc (&s->cache, req->size, s->name);
+			if (sc)
+				memcpy (sc, req->decoded, req->size);
+		}
+		else
+			S_LoadWav (s, data, len);
+	}
+
+	free (req->decoded);
+	free (req);
+	free (data);
+}
+
+/*
+==============
+S_RequestSound
+
+Like S_LoadSound, but the file is read and resampled in the background and
+the sound is only cached once it is in
+==============
+*/
+void S_RequestSound (sfx_t *s)
+{
+	char	namebuffer[256];
+	soundrequest_t	*req;
+
+	if (s->request || Cache_Check (&s->cache))
+		return;
+
+	q_strlcpy(namebuffer, "sound/", sizeof(namebuffer));
+	q_strlcat(namebuffer, s->name, sizeof(namebuffer));
+
+	req = (soundrequest_t *) calloc (1, sizeof(soundrequest_t));
+	if (!req)
+		Sys_Error ("S_RequestSound: out of memory");
+	req->sfx = s;
+	q_strlcpy (req->name, s->name, sizeof(req->name));
+	req->speed = shm->speed;
+	req->as8bit = loadas8bit.value != 0;
+
+	s->request = Async_ProcessFile (namebuffer, NULL, S_DecodeSound, S_SoundRead, req);
+	if (!s->request)
+	{
+		free (req);
+		S_LoadSound (s);	// missing, complain or fall back to null.wav right away
+	}
+}
+
 
 
 /*
@@ -179,89 +310,99 @@ WAV loading
 ===============================================================================
 */
 
-static byte	*data_p;
-static byte	*iff_end;
-static byte	*last_chunk;
-static byte	*iff_data;
-static int	iff_chunk_len;
-
-static short GetLittleShort (void)
+// parser state, on the stack so that sounds can be parsed on loader threads
+typedef struct
+{
+	byte	*data_p;
+	byte	*iff_end;
+	byte	*last_chunk;
+	byte	*iff_data;
+	int		iff_chunk_len;
+	qboolean	verbose;	// otherwise anything worth a message fails
+} wavparse_t;
+
+static short GetLittleShort (wavparse_t *wp)
 {
 	short val = 0;
-	val = *data_p;
-	val = val + (*(data_p+1)<<8);
-	data_p += 2;
+	val = *wp->data_p;
+	val = val + (*(wp->data_p+1)<<8);
+	wp->data_p += 2;
 	return val;
 }
 
-static int GetLittleLong (void)
+static int GetLittleLong (wavparse_t *wp)
 {
 	int val = 0;
-	val = *data_p;
-	val = val + (*(data_p+1)<<8);
-	val = val + (*(data_p+2)<<16);
-	val = val + (*(data_p+3)<<24);
-	data_p += 4;
+	val = *wp->data_p;
+	val = val + (*(wp->data_p+1)<<8);
+	val = val + (*(wp->data_p+2)<<16);
+	val = val + (*(wp->data_p+3)<<24);
+	wp->data_p += 4;
 	return val;
 }
 
-static void FindNextChunk (const char *name)
+static void FindNextChunk (wavparse_t *wp, const char *name)
 {
 	while (1)
 	{
 	// Need at least 8 bytes for a chunk
-		if (last_chunk + 8 >= iff_end)
+		if (wp->last_chunk + 8 >= wp->iff_end)
 		{
-			data_p = NULL;
+			wp->data_p = NULL;
 			return;
 		}
 
-		data_p = last_chunk + 4;
-		iff_chunk_len = GetLittleLong();
-		if (iff_chunk_len < 0 || iff_chunk_len > iff_end - data_p)
+		wp->data_p = wp->last_chunk + 4;
+		wp->iff_chunk_len = GetLittleLong(wp);
+		if (wp->iff_chunk_len < 0 || wp->iff_chunk_len > wp->iff_end - wp->data_p)
 		{
-			data_p = NULL;
-			Con_DPrintf2("bad \"%s\" chunk length (%d)\n", name, iff_chunk_len);
+			wp->data_p = NULL;
+			if (wp->verbose)
+				Con_DPrintf2("bad \"%s\" chunk length (%d)\n", name, wp->iff_chunk_len);
 			return;
 		}
-		last_chunk = data_p + ((iff_chunk_len + 1) & ~1);
-		data_p -= 8;
-		if (!strncmp((char *)data_p, name, 4))
+		wp->last_chunk = wp->data_p + ((wp->iff_chunk_len + 1) & ~1);
+		wp->data_p -= 8;
+		if (!strncmp((char *)wp->data_p, name, 4))
 			return;
 	}
 }
 
-static void FindChunk (const char *name)
+static void FindChunk (wavparse_t *wp, const char *name)
 {
-	last_chunk = iff_data;
-	FindNextChunk (name);
+	wp->last_chunk = wp->iff_data;
+	FindNextChunk (wp, name);
 }
 
 #if 0
-static void DumpChunks (void)
+static void DumpChunks (wavparse_t *wp)
 {
 	char	str[5];
 
 	str[4] = 0;
-	data_p = iff_data;
+	wp->data_p = wp->iff_data;
 	do
 	{
-		memcpy (str, data_p, 4);
-		data_p += 4;
-		iff_chunk_len = GetLittleLong();
-		Con_Printf ("0x%x : %s (%d)\n", (int)(data_p - 4), str, iff_chunk_len);
-		data_p += (iff_chunk_len + 1) & ~1;
-	} while (data_p < iff_end);
+		memcpy (str, wp->data_p, 4);
+		wp->data_p += 4;
+		wp->iff_chunk_len = GetLittleLong(wp);
+		Con_Printf ("0x%x : %s (%d)\n", (int)(wp->data_p - 4), str, wp->iff_chunk_len);
+		wp->data_p += (wp->iff_chunk_len + 1) & ~1;
+	} while (wp->data_p < wp->iff_end);
 }
 #endif
 
 /*
 ============
-GetWavinfo
+ParseWav
+
+Without verbose nothing is printed, and a sound that would print anything
+comes back with 0 samples
 ============
 */
-wavinfo_t GetWavinfo (const char *name, byte *wav, int wavlength)
+static wavinfo_t ParseWav (const char *name, byte *wav, int wavlength, qboolean verbose)
 {
+	wavparse_t	parse, *wp = &parse;
 	wavinfo_t	info;
 	int	i;
 	int	format;
@@ -272,64 +413,69 @@ wavinfo_t GetWavinfo (const char *name, byte *wav, int wavlength)
 	if (!wav)
 		return info;
 
-	iff_data = wav;
-	iff_end = wav + wavlength;
+	memset (wp, 0, sizeof(*wp));
+	wp->verbose = verbose;
+	wp->iff_data = wav;
+	wp->iff_end = wav + wavlength;
 
 // find "RIFF" chunk
-	FindChunk("RIFF");
-	if (!(data_p && !strncmp((char *)data_p + 8, "WAVE", 4)))
+	FindChunk(wp, "RIFF");
+	if (!(wp->data_p && !strncmp((char *)wp->data_p + 8, "WAVE", 4)))
 	{
-		Con_Printf("%s missing RIFF/WAVE chunks\n", name);
+		if (verbose)
+			Con_Printf("%s missing RIFF/WAVE chunks\n", name);
 		return info;
 	}
 
 // get "fmt " chunk
-	iff_data = data_p + 12;
+	wp->iff_data = wp->data_p + 12;
 #if 0
-	DumpChunks ();
+	DumpChunks (wp);
 #endif
 
-	FindChunk("fmt ");
-	if (!data_p)
+	FindChunk(wp, "fmt ");
+	if (!wp->data_p)
 	{
-		Con_Printf("%s is missing fmt chunk\n", name);
+		if (verbose)
+			Con_Printf("%s is missing fmt chunk\n", name);
 		return info;
 	}
-	data_p += 8;
-	format = GetLittleShort();
+	wp->data_p += 8;
+	format = GetLittleShort(wp);
 	if (format != WAV_FORMAT_PCM)
 	{
-		Con_Printf("%s is not Microsoft PCM format\n", name);
+		if (verbose)
+			Con_Printf("%s is not Microsoft PCM format\n", name);
 		return info;
 	}
 
-	info.channels = GetLittleShort();
-	info.rate = GetLittleLong();
-	data_p += 4 + 2;
-	i = GetLittleShort();
+	info.channels = GetLittleShort(wp);
+	info.rate = GetLittleLong(wp);
+	wp->data_p += 4 + 2;
+	i = GetLittleShort(wp);
 	if (i != 8 && i != 16)
 		return info;
 	info.width = i / 8;
 
 // get cue chunk
-	FindChunk("cue ");
-	if (data_p)
+	FindChunk(wp, "cue ");
+	if (wp->data_p)
 	{
-		data_p += 32;
-		info.loopstart = GetLittleLong();
+		wp->data_p += 32;
+		info.loopstart = GetLittleLong(wp);
 	//	Con_Printf("loopstart=%d\n", sfx->loopstart);
 
 	// if the next chunk is a LIST chunk, look for a cue length marker
-		FindNextChunk ("LIST");
-		if (data_p)
+		FindNextChunk (wp, "LIST");
+		if (wp->data_p)
 		{
-			if (iff_chunk_len >= 32)
+			if (wp->iff_chunk_len >= 32)
 			{
-				if (!strncmp((char *)data_p + 28, "mark", 4))
+				if (!strncmp((char *)wp->data_p + 28, "mark", 4))
 				{
 					// this is not a proper parse, but it works with cooledit...
-					data_p += 24;
-					i = GetLittleLong();	// samples in loop
+					wp->data_p += 24;
+					i = GetLittleLong(wp);	// samples in loop
 					info.samples = info.loopstart + i;
 //					Con_Printf("looped length: %i\n", i);
 				}
@@ -340,32 +486,57 @@ wavinfo_t GetWavinfo (const char *name, byte *wav, int wavlength)
 		info.loopstart = -1;
 
 // find data chunk
-	FindChunk("data");
-	if (!data_p)
+	FindChunk(wp, "data");
+	if (!wp->data_p)
 	{
-		Con_Printf("%s is missing data chunk\n", name);
+		if (verbose)
+			Con_Printf("%s is missing data chunk\n", name);
+		info.samples = 0;	// may be set by a cue length marker
 		return info;
 	}
 
-	data_p += 4;
-	samples = GetLittleLong() / info.width;
+	wp->data_p += 4;
+	samples = GetLittleLong(wp) / info.width;
 
 	if (info.samples)
 	{
 		if (samples < info.samples)
+		{
+			if (!verbose)
+			{
+				info.samples = 0;
+				return info;
+			}
 			Sys_Error ("%s has a bad loop length", name);
+		}
 	}
 	else
 		info.samples = samples;
 
 	if (info.loopstart >= info.samples)
 	{
+		if (!verbose)
+		{
+			info.samples = 0;
+			return info;
+		}
 		Con_Warning ("%s has loop start >= end\n", name);
 		info.loopstart = -1;
 		info.samples = samples;
 	}
 
-	info.dataofs = data_p - wav;
+	info.dataofs = wp->data_p - wav;
 
 	return info;
 }
+
+
+/*
+============
+GetWavinfo
+============
+*/
+wavinfo_t GetWavinfo (const char *name, byte *wav, int wavlength)
+{
+	return ParseWav (name, wav, wavlength, true);
+}
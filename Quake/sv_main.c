@@ -1515,6 +1515,9 @@ void SV_SpawnServer (const char *server)
 	Con_DPrintf ("SpawnServer: %s\n",server);
 	svs.changelevel_issued = false;		// now safe to issue another
 
+	COM_InvalidateLooseFiles ();	// pick up files added since the last map
+	COM_BeginFileTrace (server);	// prefetch what the last load of this map read
+
 //
 // tell all connected clients that we are going to a new level
 //
@@ -1594,6 +1597,7 @@ void SV_SpawnServer (const char *server)
 	{
 		Con_Printf ("Couldn't spawn server %s\n", sv.modelname);
 		sv.active = false;
+		COM_EndFileTrace (false);
 		return;
 	}
 	sv.models[1] = sv.worldmodel;
@@ -1662,6 +1666,10 @@ void SV_SpawnServer (const char *server)
 		if (host_client->active)
 			SV_SendServerinfo (host_client);
 
+	// the local client finishes the trace once it has loaded its share
+	if (isDedicated)
+		COM_EndFileTrace (true);
+
 	Con_DPrintf ("Server spawned.\n");
 }
 
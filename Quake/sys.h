@@ -35,10 +35,16 @@ void Sys_Init (void);
 int Sys_FileOpenRead (const char *path, int *hndl);
 
 int Sys_FileOpenWrite (const char *path);
+int Sys_FileOpenTemp (void);
+// returns -1 on failure, the file is deleted when it is closed
 void Sys_FileClose (int handle);
 void Sys_FileSeek (int handle, int position);
 int Sys_FileRead (int handle, void *dest, int count);
 int Sys_FileWrite (int handle,const void *data, int count);
+void *Sys_FileMap (int handle, int offset, int len, void **mapping, size_t *mapsize);
+// returns a private copy on write view of len bytes at offset, or NULL if
+// the file can't be mapped. The view outlives the handle until Sys_FileUnmap.
+void Sys_FileUnmap (void *mapping, size_t mapsize);
 void Sys_mkdir (const char *path);
 
 int Sys_FileType (const char *path);
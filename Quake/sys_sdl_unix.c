@@ -33,6 +33,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 #ifdef DO_USERDIRS
 #include <pwd.h>
 #endif
@@ -119,6 +120,21 @@ int Sys_FileOpenWrite (const char *path)
 	return i;
 }
 
+int Sys_FileOpenTemp (void)
+{
+	FILE	*f;
+	int		i;
+
+	i = findhandle ();
+	f = tmpfile ();
+
+	if (!f)
+		return -1;
+
+	sys_handles[i] = f;
+	return i;
+}
+
 void Sys_FileClose (int handle)
 {
 	fclose (sys_handles[handle]);
@@ -140,6 +156,32 @@ int Sys_FileWrite (int handle, const void *data, int count)
 	return fwrite (data, 1, count, sys_handles[handle]);
 }
 
+void *Sys_FileMap (int handle, int offset, int len, void **mapping, size_t *mapsize)
+{
+	long	pagesize = sysconf (_SC_PAGESIZE);
+	int		start;
+	void	*base;
+
+	if (len <= 0 || offset < 0 || pagesize <= 0)
+		return NULL;
+
+	// the mapping has to start on a page boundary
+	start = offset - offset % pagesize;
+	*mapsize = (size_t) len + (offset - start);
+
+	base = mmap (NULL, *mapsize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno (sys_handles[handle]), start);
+	if (base == MAP_FAILED)
+		return NULL;
+
+	*mapping = base;
+	return (byte *) base + (offset - start);
+}
+
+void Sys_FileUnmap (void *mapping, size_t mapsize)
+{
+	munmap (mapping, mapsize);
+}
+
 int Sys_FileType (const char *path)
 {
 	/*
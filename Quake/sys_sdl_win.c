@@ -118,6 +118,21 @@ int Sys_FileOpenWrite (const char *path)
 	return i;
 }
 
+int Sys_FileOpenTemp (void)
+{
+	FILE	*f;
+	int		i;
+
+	i = findhandle ();
+	f = tmpfile ();
+
+	if (!f)
+		return -1;
+
+	sys_handles[i] = f;
+	return i;
+}
+
 void Sys_FileClose (int handle)
 {
 	fclose (sys_handles[handle]);
@@ -139,6 +154,15 @@ int Sys_FileWrite (int handle, const void *data, int count)
 	return fwrite (data, 1, count, sys_handles[handle]);
 }
 
+void *Sys_FileMap (int handle, int offset, int len, void **mapping, size_t *mapsize)
+{
+	return NULL;	// not implemented, callers read the file instead
+}
+
+void Sys_FileUnmap (void *mapping, size_t mapsize)
+{
+}
+
 #ifndef INVALID_FILE_ATTRIBUTES
 #define INVALID_FILE_ATTRIBUTES	((DWORD)-1)
 #endif
@@ -268,16 +268,16 @@ void V_ParseDamage (void)
 {
 	int		armor, blood;
 	vec3_t	from;
-	int		i;
 	vec3_t	forward, right, up;
 	entity_t	*ent;
 	float	side;
 	float	count;
+	damage_t	damage;
 
-	armor = MSG_ReadByte ();
-	blood = MSG_ReadByte ();
-	for (i=0 ; i<3 ; i++)
-		from[i] = MSG_ReadCoord (cl.protocolflags);
+	CL_ReadDamage (CL_ServerReader (), &damage);
+	armor = damage.armor;
+	blood = damage.blood;
+	VectorCopy (damage.from, from);
 
 	count = blood*0.5 + armor*0.5;
 	if (count < 10)
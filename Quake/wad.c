@@ -26,6 +26,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 int				wad_numlumps;
 lumpinfo_t		*wad_lumps;
 byte			*wad_base = NULL;
+static mappedfile_t	wad_file;
 
 void SwapPic (qpic_t *pic);
 
@@ -73,11 +74,9 @@ void W_LoadWadFile (void) //johnfitz -- filename is now hard-coded for honesty
 	int			infotableofs;
 	const char		*filename = WADFILENAME;
 
-	//johnfitz -- modified to use malloc
-	//TODO: use cache_alloc
-	if (wad_base)
-		free (wad_base);
-	wad_base = COM_LoadMallocFile (filename, NULL);
+	if (wad_file.data)
+		COM_UnmapFile (&wad_file);
+	wad_base = COM_MapFile (filename, &wad_file, NULL) ? wad_file.data : NULL;
 	if (!wad_base)
 		Sys_Error ("W_LoadWadFile: couldn't load %s\n\n"
 			   "Basedir is: %s\n\n"